@@ -88,6 +88,12 @@ set(_std_c_headers
 check_include_files("${_std_c_headers}" STDC_HEADERS LANGUAGE C)
 unset(_std_c_headers)
 
+# The per-pixel math kernels are additionally built for AVX2/FMA and picked at runtime if the CPU has them.
+# Runtime detection uses __builtin_cpu_supports, which is only available with GCC and Clang.
+if(NOT MSVC AND NOT ENABLE_EMSCRIPTEN AND CMAKE_SYSTEM_PROCESSOR MATCHES "^(x86_64|AMD64|amd64|i.86)$")
+    check_cxx_compiler_flag("-mavx2 -mfma" HAVE_AVX2_KERNELS)
+endif()
+
 # Create global configuration header
 file(MAKE_DIRECTORY "${CMAKE_BINARY_DIR}/include")
 configure_file(config.h.cmake.in "${CMAKE_BINARY_DIR}/include/config.h")
@@ -0,0 +1,25 @@
+#include "AllocationCounter.hpp"
+
+#include <atomic>
+
+namespace {
+
+std::atomic<std::size_t> allocations{ 0 };
+
+}
+
+bool AllocationCounter::enabled()
+{
+    // the replacement operator new counts from the first allocation of the program on
+    return count() > 0;
+}
+
+std::size_t AllocationCounter::count()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void AllocationCounter::countAllocation()
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,26 @@
+#ifndef ALLOCATION_COUNTER_HPP
+#define ALLOCATION_COUNTER_HPP
+
+#include <cstddef>
+
+/// Counts the heap allocations made through operator new, so tests can check that the render loop
+/// does not allocate once it has warmed up.
+///
+/// The library does not touch the allocator of the application. The test executable replaces
+/// operator new (see projectM-test/CountingOperatorNew.cpp) and reports every allocation here.
+/// Memory from malloc() and friends is not counted.
+namespace AllocationCounter
+{
+
+/// True if allocations are being counted, otherwise count() always returns 0
+bool enabled();
+
+/// Number of allocations made so far by all threads
+std::size_t count();
+
+/// Called by the replacement operator new for every allocation
+void countAllocation();
+
+}
+
+#endif
@@ -112,7 +112,7 @@ int BuiltinParams::load_builtin_param_float(const std::string& name, void* engin
 int BuiltinParams::destroy_builtin_param_db()
 {
 
-    traverse<TraverseFunctors::Delete<Param> >(builtin_param_tree);
+    traverse<TraverseFunctors::Delete<Param> >(builtin_param_table);
     return PROJECTM_SUCCESS;
 }
 
@@ -123,41 +123,14 @@ int BuiltinParams::insert_param_alt_name(Param* param, const std::string& alt_na
 
     assert(param);
 
-    aliasMap.insert(std::make_pair(alt_name, param->name));
+    builtin_param_table.insert_alias(alt_name, param);
 
     return PROJECTM_SUCCESS;
 }
 
-Param* BuiltinParams::find_builtin_param(const std::string& name)
+Param* BuiltinParams::find_builtin_param(const ParamTable::Key& name)
 {
-
-
-    AliasMap::iterator pos = aliasMap.find(name);
-    Param* param = 0;
-    //std::cerr << "[BuiltinParams] find_builtin_param: name is " << name << std::endl;
-    if (pos == aliasMap.end())
-    {
-        std::map<std::string, Param*>::iterator builtinPos = builtin_param_tree.find(name);
-
-        if (builtinPos != builtin_param_tree.end())
-        {
-            //  std::cerr << "[BuiltinParams] find_builtin_param: found it directly." << std::endl;
-            param = builtinPos->second;
-        }
-    }
-    else
-    {
-
-        std::map<std::string, Param*>::iterator builtinPos = builtin_param_tree.find(pos->second);
-
-        if (builtinPos != builtin_param_tree.end())
-        {
-            //std::cerr << "[BuiltinParams] find_builtin_param: found it indirectly." << std::endl;
-            param = builtinPos->second;
-
-        }
-    }
-    return param;
+    return builtin_param_table.find(name);
 }
 
 
@@ -258,10 +231,7 @@ int BuiltinParams::load_builtin_param_bool(const std::string& name, void* engine
 /* Inserts a parameter into the builtin database */
 int BuiltinParams::insert_builtin_param(Param* param)
 {
-    std::pair<std::map<std::string, Param*>::iterator, bool> inserteePos = builtin_param_tree.insert(
-        std::make_pair(param->name, param));
-
-    return inserteePos.second;
+    return builtin_param_table.insert(param);
 }
 
 
@@ -276,6 +246,9 @@ int BuiltinParams::init_builtin_param_db(const PresetInputs& presetInputs, Prese
         fflush(stdout);
     }
 
+    /* There are about 170 names including the alternate ones, make room so the table does not grow while loading */
+    builtin_param_table.reserve(256);
+
     /* Loads all builtin parameters into the database */
     if (load_all_builtin_param(presetInputs, presetOutputs) < 0)
     {
@@ -347,29 +320,29 @@ int BuiltinParams::load_all_builtin_param(const PresetInputs& presetInputs, Pres
     load_builtin_param_bool("wave_dots", (void*) &presetOutputs->wave.dots, P_FLAG_NONE, false, "bwavedots");
     load_builtin_param_bool("wave_thick", (void*) &presetOutputs->wave.thick, P_FLAG_NONE, false, "bwavethick");
     // warp is turned on by default in milkdrop2
-    load_builtin_param_float("warp", (void*) &presetOutputs->warp, presetOutputs->warp_mesh,
+    load_builtin_param_float("warp", (void*) &presetOutputs->warp, &presetOutputs->warp_mesh,
                              P_FLAG_PER_PIXEL | P_FLAG_NONE, 1.0, MAX_DOUBLE_SIZE, MIN_DOUBLE_SIZE, "");
     // zoom=1 is the 'do nothing' value, 0 causes Inf values in PresetOutputs::PerPixelMath()
-    load_builtin_param_float("zoom", (void*) &presetOutputs->zoom, presetOutputs->zoom_mesh,
+    load_builtin_param_float("zoom", (void*) &presetOutputs->zoom, &presetOutputs->zoom_mesh,
                              P_FLAG_PER_PIXEL | P_FLAG_NONE, 1.0, MAX_DOUBLE_SIZE, MIN_DOUBLE_SIZE, "");
-    load_builtin_param_float("rot", (void*) &presetOutputs->rot, presetOutputs->rot_mesh,
+    load_builtin_param_float("rot", (void*) &presetOutputs->rot, &presetOutputs->rot_mesh,
                              P_FLAG_PER_PIXEL | P_FLAG_NONE, 0.0, MAX_DOUBLE_SIZE, MIN_DOUBLE_SIZE, "");
     // zoomexp=1 is the 'do nothing' value, 0 effectively forces zoom=1
-    load_builtin_param_float("zoomexp", (void*) &presetOutputs->zoomexp, presetOutputs->zoomexp_mesh,
+    load_builtin_param_float("zoomexp", (void*) &presetOutputs->zoomexp, &presetOutputs->zoomexp_mesh,
                              P_FLAG_PER_PIXEL | P_FLAG_NONE, 1.0, MAX_DOUBLE_SIZE, 0, "fzoomexponent");
 
-    load_builtin_param_float("cx", (void*) &presetOutputs->cx, presetOutputs->cx_mesh, P_FLAG_PER_PIXEL | P_FLAG_NONE,
+    load_builtin_param_float("cx", (void*) &presetOutputs->cx, &presetOutputs->cx_mesh, P_FLAG_PER_PIXEL | P_FLAG_NONE,
                              0.0, MAX_DOUBLE_SIZE, MIN_DOUBLE_SIZE, "");
-    load_builtin_param_float("cy", (void*) &presetOutputs->cy, presetOutputs->cy_mesh, P_FLAG_PER_PIXEL | P_FLAG_NONE,
+    load_builtin_param_float("cy", (void*) &presetOutputs->cy, &presetOutputs->cy_mesh, P_FLAG_PER_PIXEL | P_FLAG_NONE,
                              0.0, MAX_DOUBLE_SIZE, MIN_DOUBLE_SIZE, "");
-    load_builtin_param_float("dx", (void*) &presetOutputs->dx, presetOutputs->dx_mesh, P_FLAG_PER_PIXEL | P_FLAG_NONE,
+    load_builtin_param_float("dx", (void*) &presetOutputs->dx, &presetOutputs->dx_mesh, P_FLAG_PER_PIXEL | P_FLAG_NONE,
                              0.0, MAX_DOUBLE_SIZE, MIN_DOUBLE_SIZE, "");
-    load_builtin_param_float("dy", (void*) &presetOutputs->dy, presetOutputs->dy_mesh, P_FLAG_PER_PIXEL | P_FLAG_NONE,
+    load_builtin_param_float("dy", (void*) &presetOutputs->dy, &presetOutputs->dy_mesh, P_FLAG_PER_PIXEL | P_FLAG_NONE,
                              0.0, MAX_DOUBLE_SIZE, MIN_DOUBLE_SIZE, "");
     // sx=1 and sy=1 are the 'do nothing' values, 0 causes Inf values in PresetOutputs::PerPixelMath()
-    load_builtin_param_float("sx", (void*) &presetOutputs->sx, presetOutputs->sx_mesh, P_FLAG_PER_PIXEL | P_FLAG_NONE,
+    load_builtin_param_float("sx", (void*) &presetOutputs->sx, &presetOutputs->sx_mesh, P_FLAG_PER_PIXEL | P_FLAG_NONE,
                              1.0, MAX_DOUBLE_SIZE, MIN_DOUBLE_SIZE, "");
-    load_builtin_param_float("sy", (void*) &presetOutputs->sy, presetOutputs->sy_mesh, P_FLAG_PER_PIXEL | P_FLAG_NONE,
+    load_builtin_param_float("sy", (void*) &presetOutputs->sy, &presetOutputs->sy_mesh, P_FLAG_PER_PIXEL | P_FLAG_NONE,
                              1.0, MAX_DOUBLE_SIZE, MIN_DOUBLE_SIZE, "");
 
 
@@ -430,16 +403,16 @@ int BuiltinParams::load_all_builtin_param(const PresetInputs& presetInputs, Pres
     load_builtin_param_float("progress", (void*) &presetInputs.progress, NULL, P_FLAG_READONLY, 0.0, 1, 0, "");
     load_builtin_param_int("fps", (void*) &presetInputs.fps, P_FLAG_READONLY, 15, MAX_INT_SIZE, 0, "");
 
-    load_builtin_param_float("x", (void*) &presetInputs.x_per_pixel, presetInputs.origx,
+    load_builtin_param_float("x", (void*) &presetInputs.x_per_pixel, (void*) &presetInputs.origx,
                              P_FLAG_PER_PIXEL | P_FLAG_ALWAYS_MATRIX | P_FLAG_READONLY | P_FLAG_NONE,
                              0, MAX_DOUBLE_SIZE, -MAX_DOUBLE_SIZE, "");
-    load_builtin_param_float("y", (void*) &presetInputs.y_per_pixel, presetInputs.origy,
+    load_builtin_param_float("y", (void*) &presetInputs.y_per_pixel, (void*) &presetInputs.origy,
                              P_FLAG_PER_PIXEL | P_FLAG_ALWAYS_MATRIX | P_FLAG_READONLY | P_FLAG_NONE,
                              0, MAX_DOUBLE_SIZE, -MAX_DOUBLE_SIZE, "");
-    load_builtin_param_float("ang", (void*) &presetInputs.ang_per_pixel, presetInputs.origtheta,
+    load_builtin_param_float("ang", (void*) &presetInputs.ang_per_pixel, (void*) &presetInputs.origtheta,
                              P_FLAG_PER_PIXEL | P_FLAG_ALWAYS_MATRIX | P_FLAG_READONLY | P_FLAG_NONE,
                              0, MAX_DOUBLE_SIZE, -MAX_DOUBLE_SIZE, "");
-    load_builtin_param_float("rad", (void*) &presetInputs.rad_per_pixel, presetInputs.origrad,
+    load_builtin_param_float("rad", (void*) &presetInputs.rad_per_pixel, (void*) &presetInputs.origrad,
                              P_FLAG_PER_PIXEL | P_FLAG_ALWAYS_MATRIX | P_FLAG_READONLY | P_FLAG_NONE,
                              0, MAX_DOUBLE_SIZE, -MAX_DOUBLE_SIZE, "");
 
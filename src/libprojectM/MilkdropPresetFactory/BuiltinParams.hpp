@@ -30,6 +30,7 @@
 #include <string>
 #include "PresetFrameIO.hpp"
 #include "Param.hpp"
+#include "ParamTable.hpp"
 #include <map>
 #include <cstdio>
 
@@ -37,8 +38,6 @@ class BuiltinParams
 {
 
 public:
-    typedef std::map<std::string, std::string> AliasMap;
-
     /** Default constructor leaves database in an uninitialized state.  */
     BuiltinParams();
 
@@ -50,7 +49,7 @@ public:
 
     int insert_param_alt_name(Param* param, const std::string& salt_name);
 
-    Param* find_builtin_param(const std::string& name);
+    Param* find_builtin_param(const ParamTable::Key& name);
 
     int load_builtin_param_float(const std::string& name, void* engine_val, void* matrix,
                                  short int flags,
@@ -71,7 +70,7 @@ public:
     template<class Fun>
     void apply(Fun& fun)
     {
-        traverse(builtin_param_tree, fun);
+        traverse(builtin_param_table, fun);
     }
 
 
@@ -86,11 +85,8 @@ protected:
 private:
     static const bool BUILTIN_PARAMS_DEBUG = false;
 
-    // Used to associate multiple string names to one parameter
-    AliasMap aliasMap;
-
-    // Internal datastructure to store the parameters
-    std::map<std::string, Param*> builtin_param_tree;
+    // Internal datastructure to store the parameters, under their names and their alternate names
+    ParamTable builtin_param_table;
 };
 
 #endif
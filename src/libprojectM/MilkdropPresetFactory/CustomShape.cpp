@@ -239,6 +239,14 @@ CustomShape::~CustomShape()
 
 }
 
+void CustomShape::createPrograms()
+{
+	std::vector<Expr *> steps;
+	for ( std::vector<PerFrameEqn*>::iterator pos = per_frame_eqn_tree.begin(); pos != per_frame_eqn_tree.end(); ++pos )
+		steps.push_back ( ( *pos )->assign_expr );
+	per_frame_program.set ( Expr::create_program_expr ( steps, false ) );
+}
+
 void CustomShape::loadUnspecInitConds()
 {
 
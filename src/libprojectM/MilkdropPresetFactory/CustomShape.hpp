@@ -31,7 +31,9 @@
 
 #define CUSTOM_SHAPE_DEBUG 0
 #include <map>
+#include "ExprCompiler.hpp"
 #include "Param.hpp"
+#include "ParamTable.hpp"
 #include "PerFrameEqn.hpp"
 #include "InitCond.hpp"
 #include "Renderer/Renderable.hpp"
@@ -47,7 +49,7 @@ public:
     int per_frame_count;
 
     /* Parameter tree associated with this custom shape */
-    std::map<std::string,Param*> param_tree;
+    ParamTable param_tree;
 
     /* Engine variables */
 
@@ -69,9 +71,10 @@ public:
     // Data structure to hold per frame  / per frame init equations
     std::map<std::string,InitCond*>  init_cond_tree;
     std::vector<PerFrameEqn*>  per_frame_eqn_tree;
+    ExprProgram per_frame_program;
     std::map<std::string,InitCond*>  per_frame_init_eqn_tree;
 
-    std::map<std::string, Param*> text_properties_tree;
+    ParamTable text_properties_tree;
 
 
     /// Allocate a new custom shape, including param associations, per point equations, and initial values.
@@ -81,6 +84,9 @@ public:
     virtual ~CustomShape();
 
     void loadUnspecInitConds();
+
+    /// Collects the per frame equations into a program, once they have all been parsed
+    void createPrograms();
     void evalInitConds();
 
   };
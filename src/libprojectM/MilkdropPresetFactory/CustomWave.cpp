@@ -49,8 +49,7 @@ CustomWave::CustomWave(int _id) : Waveform(512),
     r(0),
     g(0),
     b(0),
-    a(0),
-    per_point_program(nullptr)
+    a(0)
 {
 
   Param * param;
@@ -429,7 +428,7 @@ CustomWave::~CustomWave()
   for (std::map<std::string, InitCond*>::iterator pos = per_frame_init_eqn_tree.begin(); pos != per_frame_init_eqn_tree.end(); ++pos)
     delete(pos->second);
 
-  for (std::map<std::string, Param*>::iterator pos = param_tree.begin(); pos != param_tree.end(); ++pos)
+  for (ParamTable::iterator pos = param_tree.begin(); pos != param_tree.end(); ++pos)
     delete(pos->second);
 
   free(r_mesh);
@@ -499,23 +498,8 @@ void CustomWave::evalInitConds()
 
 ColoredPoint CustomWave::PerPoint(ColoredPoint p, const WaveformContext context)
 {
-    if (nullptr == per_point_program)
-    {
-        // see comment in MilkdropPreset, collect a list of assignments into one ProgramExpr
-        // which (theoretically) could be compiled together.
-        std::vector<Expr *> steps;
-        for (auto pos = per_point_eqn_tree.begin(); pos != per_point_eqn_tree.end();++pos)
-            steps.push_back((*pos)->assign_expr);
-        Expr *program_expr  = Expr::create_program_expr(steps, false);
-        Expr *jit = nullptr;
-#if HAVE_LLVM
-        char buffer[100];
-        sprintf(buffer, "wave_%d", id);
-        if (!steps.empty())
-            jit = Expr::jit(program_expr, buffer);
-#endif
-        per_point_program = jit ? jit : program_expr;
-    }
+    if (!per_point_program)
+        createPrograms();
 
     r_mesh[context.sample_int] = r;
     g_mesh[context.sample_int] = g;
@@ -527,7 +511,7 @@ ColoredPoint CustomWave::PerPoint(ColoredPoint p, const WaveformContext context)
     v1 = context.left;
     v2 = context.right;
 
-    per_point_program->eval(context.sample_int, -1);
+    per_point_program.get()->eval(context.sample_int, -1);
 
     p.a = a_mesh[context.sample_int];
     p.r = r_mesh[context.sample_int];
@@ -540,6 +524,21 @@ ColoredPoint CustomWave::PerPoint(ColoredPoint p, const WaveformContext context)
 }
 
 
+void CustomWave::createPrograms()
+{
+    // see comment in MilkdropPreset, collect a list of assignments into one ProgramExpr
+    // which is compiled together with the other programs of the preset.
+    std::vector<Expr *> steps;
+    for (auto pos = per_frame_eqn_tree.begin(); pos != per_frame_eqn_tree.end(); ++pos)
+        steps.push_back((*pos)->assign_expr);
+    per_frame_program.set(Expr::create_program_expr(steps, false));
+
+    steps.clear();
+    for (auto pos = per_point_eqn_tree.begin(); pos != per_point_eqn_tree.end(); ++pos)
+        steps.push_back((*pos)->assign_expr);
+    per_point_program.set(Expr::create_program_expr(steps, false));
+}
+
 void CustomWave::loadUnspecInitConds()
 {
 
@@ -39,7 +39,9 @@ class Preset;
 #include <vector>
 
 #include "Common.hpp"
+#include "ExprCompiler.hpp"
 #include "Param.hpp"
+#include "ParamTable.hpp"
 #include "PerFrameEqn.hpp"
 #include "Renderer/Waveform.hpp"
 
@@ -65,7 +67,7 @@ public:
     int per_frame_count;
 
     /* Parameter tree associated with this custom wave */
-    std::map<std::string,Param*> param_tree;
+    ParamTable param_tree;
 
     /* Engine variables */
     float x; /* x position for per point equations */
@@ -105,7 +107,8 @@ public:
     std::map<std::string,InitCond*>  init_cond_tree;
     std::vector<PerFrameEqn*>  per_frame_eqn_tree;
     std::vector<PerPointEqn*>  per_point_eqn_tree;
-    Expr *per_point_program;
+    ExprProgram per_frame_program;
+    ExprProgram per_point_program;
     std::map<std::string,InitCond*>  per_frame_init_eqn_tree;
 
     /* Denotes the index of the last character for each string buffer */
@@ -119,6 +122,9 @@ public:
 
     void loadUnspecInitConds();
 
+    /// Collects the per frame and per point equations into programs, once they have all been parsed
+    void createPrograms();
+
     void evalInitConds();
 
 };
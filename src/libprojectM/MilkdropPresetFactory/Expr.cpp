@@ -22,17 +22,33 @@
 #include "wipemalloc.h"
 
 #include "Expr.hpp"
+#include "ExprBytecode.hpp"
+#include <atomic>
 #include <cassert>
+#include <set>
 
 #include "Eval.hpp"
 #include "BuiltinFuncs.hpp"
+#include "Param.hpp"
 
 #include "JitContext.hpp"
+#include "JitObjectCache.hpp"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
+// largest argument count of a builtin function, see PrefunExpr::eval_lanes()
+#define MAX_LANE_ARGS 3
+
+
+/* Default batched evaluation, one point after the other */
+void Expr::eval_lanes(const ExprLanes &lanes, float *out)
+{
+    for (int k = 0; k < lanes.count; k++)
+        out[k] = eval(lanes.mesh_i + k, lanes.mesh_j);
+}
+
 /* A function expression in prefix form */
 class PrefunExpr : public Expr
 {
@@ -43,7 +59,7 @@ public:
     Expr **expr_list;
 
 protected:
-    PrefunExpr() : Expr(FUNCTION) {}
+    PrefunExpr() : Expr(FUNCTION), function(nullptr), func_ptr(nullptr), num_args(0), expr_list(nullptr) {}
 public:
     PrefunExpr(Func *func, Expr **expr_list);
     ~PrefunExpr() override;
@@ -51,6 +67,18 @@ public:
     /* Evaluates functions in prefix form */
     Expr *_optimize() override;
     float eval(int mesh_i, int mesh_j) override;
+    void eval_lanes(const ExprLanes &lanes, float *out) override;
+    void _get_child_slots(std::vector<Expr **> &slots) override
+    {
+        for (int i = 0; i < num_args; i++)
+            slots.push_back(&expr_list[i]);
+    }
+    int _bytecode(BytecodeCompiler &bc) override
+    {
+        if (num_args > MAX_LANE_ARGS)
+            return bc.fallback(this);
+        return bc.call(func_ptr, expr_list, num_args);
+    }
     std::ostream& to_string(std::ostream &out) override;
 #if HAVE_LLVM
     llvm::Value *_llvm(JitContext &jitx) override;
@@ -83,6 +111,28 @@ float PrefunExpr::eval ( int mesh_i, int mesh_j )
 	return value;
 }
 
+void PrefunExpr::eval_lanes(const ExprLanes &lanes, float *out)
+{
+    assert ( func_ptr );
+    if (num_args > MAX_LANE_ARGS)
+    {
+        Expr::eval_lanes(lanes, out);
+        return;
+    }
+
+    float args[MAX_LANE_ARGS][ExprLanes::MAX_LANES];
+    for (int i = 0; i < num_args; i++)
+        expr_list[i]->eval_lanes(lanes, args[i]);
+
+    float arg_list[MAX_LANE_ARGS];
+    for (int k = 0; k < lanes.count; k++)
+    {
+        for (int i = 0; i < num_args; i++)
+            arg_list[i] = args[i][k];
+        out[k] = ( func_ptr ) ( arg_list );
+    }
+}
+
 
 #if HAVE_LLVM
 llvm::Value *PrefunExpr::_llvm(JitContext &jitx)
@@ -126,11 +176,11 @@ llvm::Value *PrefunExpr::_llvm(JitContext &jitx)
             clib_fn = acosf;
         else
             clib_fn = atanf;
-        llvm::Constant *fn_const = llvm::ConstantInt::get(llvm::Type::getInt64Ty(jitx.context), (uint64_t)clib_fn);
+        llvm::Constant *fn_const = jitx.CreateAddress((const void *)clib_fn);
         auto function_ptr = llvm::ConstantExpr::getIntToPtr(fn_const , prefun_ptr_type);
         std::vector<llvm::Value *> args;
         args.push_back(x);
-        return jitx.builder.CreateCall(function_ptr, args);
+        return jitx.builder.CreateCall(prefun_type, function_ptr, args);
     }
 
     // fallback, call function wrapper e.g. float (*fn)(float *)
@@ -148,12 +198,12 @@ llvm::Value *PrefunExpr::_llvm(JitContext &jitx)
     arg_types.push_back(llvm::PointerType::get(jitx.floatType,1)); // float *
     auto prefun_type = llvm::FunctionType::get(jitx.floatType, arg_types, false);
     auto prefun_ptr_type = llvm::PointerType::get(prefun_type,1);
-    llvm::Constant *fn_const = llvm::ConstantInt::get(llvm::Type::getInt64Ty(jitx.context), (uint64_t)func_ptr);
+    llvm::Constant *fn_const = jitx.CreateAddress((const void *)func_ptr);
     auto function_ptr = llvm::ConstantExpr::getIntToPtr(fn_const , prefun_ptr_type);
 
     std::vector<llvm::Value *> args;
     args.push_back(array);
-    return jitx.builder.CreateCall(function_ptr, args);
+    return jitx.builder.CreateCall(prefun_type, function_ptr, args);
 }
 #endif
 
@@ -170,6 +220,34 @@ public:
 };
 
 
+/* Batched if/else. A branch is only evaluated if at least one point takes it, so uniform conditions
+ * cost no more than the scalar code. Evaluating a branch for points that do not take it is harmless,
+ * prepare_lanes() rejects programs with side effects. */
+static void select_lanes(const ExprLanes &lanes, const bool *cond, Expr *then_expr, Expr *else_expr, float *out)
+{
+	int taken = 0;
+	for (int k = 0; k < lanes.count; k++)
+		taken += cond[k];
+
+	if (taken == lanes.count)
+	{
+		then_expr->eval_lanes(lanes, out);
+		return;
+	}
+	if (taken == 0)
+	{
+		else_expr->eval_lanes(lanes, out);
+		return;
+	}
+
+	float else_val[ExprLanes::MAX_LANES];
+	then_expr->eval_lanes(lanes, out);
+	else_expr->eval_lanes(lanes, else_val);
+	for (int k = 0; k < lanes.count; k++)
+		out[k] = cond[k] ? out[k] : else_val[k];
+}
+
+
 class IfAboveExpr : public PrefunExpr
 {
 public:
@@ -192,6 +270,20 @@ public:
 		else
 			return expr_list[3]->eval(mesh_i,mesh_j);
 	}
+	void eval_lanes(const ExprLanes &lanes, float *out) override
+	{
+		float aval[ExprLanes::MAX_LANES], bval[ExprLanes::MAX_LANES];
+		bool cond[ExprLanes::MAX_LANES];
+		expr_list[0]->eval_lanes(lanes, aval);
+		expr_list[1]->eval_lanes(lanes, bval);
+		for (int k = 0; k < lanes.count; k++)
+			cond[k] = aval[k] > bval[k];
+		select_lanes(lanes, cond, expr_list[2], expr_list[3], out);
+	}
+	int _bytecode(BytecodeCompiler &bc) override
+	{
+		return bc.branch(BC_IF_ABOVE, expr_list[0], expr_list[1], expr_list[2], expr_list[3]);
+	}
 #if HAVE_LLVM
     llvm::Value *_llvm(JitContext &jitx) override
     {
@@ -235,6 +327,20 @@ public:
 		else
 			return expr_list[3]->eval(mesh_i,mesh_j);
 	}
+	void eval_lanes(const ExprLanes &lanes, float *out) override
+	{
+		float aval[ExprLanes::MAX_LANES], bval[ExprLanes::MAX_LANES];
+		bool cond[ExprLanes::MAX_LANES];
+		expr_list[0]->eval_lanes(lanes, aval);
+		expr_list[1]->eval_lanes(lanes, bval);
+		for (int k = 0; k < lanes.count; k++)
+			cond[k] = aval[k] == bval[k];
+		select_lanes(lanes, cond, expr_list[2], expr_list[3], out);
+	}
+	int _bytecode(BytecodeCompiler &bc) override
+	{
+		return bc.branch(BC_IF_EQUAL, expr_list[0], expr_list[1], expr_list[2], expr_list[3]);
+	}
 #if HAVE_LLVM
     llvm::Value *_llvm(JitContext &jitx) override
     {
@@ -270,6 +376,19 @@ public:
 			return expr_list[2]->eval ( mesh_i, mesh_j );
 		return expr_list[1]->eval ( mesh_i, mesh_j );
 	}
+	void eval_lanes(const ExprLanes &lanes, float *out) override
+	{
+		float val[ExprLanes::MAX_LANES];
+		bool cond[ExprLanes::MAX_LANES];
+		expr_list[0]->eval_lanes(lanes, val);
+		for (int k = 0; k < lanes.count; k++)
+			cond[k] = val[k] != 0;
+		select_lanes(lanes, cond, expr_list[1], expr_list[2], out);
+	}
+	int _bytecode(BytecodeCompiler &bc) override
+	{
+		return bc.branch(BC_IF, expr_list[0], nullptr, expr_list[1], expr_list[2]);
+	}
 
 	Expr *_optimize() override
 	{
@@ -328,6 +447,16 @@ public:
         float val = expr_list[0]->eval ( mesh_i, mesh_j );
         return sinf(val);
     }
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        expr_list[0]->eval_lanes(lanes, out);
+        for (int k = 0; k < lanes.count; k++)
+            out[k] = sinf(out[k]);
+    }
+    int _bytecode(BytecodeCompiler &bc) override
+    {
+        return bc.unary(BC_SIN, expr_list[0]);
+    }
 };
 
 
@@ -340,6 +469,16 @@ public:
         float val = expr_list[0]->eval ( mesh_i, mesh_j );
         return cosf(val);
     }
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        expr_list[0]->eval_lanes(lanes, out);
+        for (int k = 0; k < lanes.count; k++)
+            out[k] = cosf(out[k]);
+    }
+    int _bytecode(BytecodeCompiler &bc) override
+    {
+        return bc.unary(BC_COS, expr_list[0]);
+    }
 };
 
 
@@ -352,6 +491,16 @@ public:
         float val = expr_list[0]->eval( mesh_i, mesh_j );
         return logf(val);
     }
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        expr_list[0]->eval_lanes(lanes, out);
+        for (int k = 0; k < lanes.count; k++)
+            out[k] = logf(out[k]);
+    }
+    int _bytecode(BytecodeCompiler &bc) override
+    {
+        return bc.unary(BC_LOG, expr_list[0]);
+    }
 };
 
 
@@ -369,6 +518,15 @@ public:
     {
         return constant;
     }
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        for (int k = 0; k < lanes.count; k++)
+            out[k] = constant;
+    }
+    int _bytecode(BytecodeCompiler &bc) override
+    {
+        return bc.constant(constant);
+    }
     std::ostream &to_string(std::ostream &out)
     {
         out << constant; return out;
@@ -403,6 +561,33 @@ public:
         float c_value = c->eval(mesh_i,mesh_j);
         return a_value * b_value + c_value;
     }
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        float b_value[ExprLanes::MAX_LANES], c_value[ExprLanes::MAX_LANES];
+        a->eval_lanes(lanes, out);
+        b->eval_lanes(lanes, b_value);
+        c->eval_lanes(lanes, c_value);
+        for (int k = 0; k < lanes.count; k++)
+            out[k] = out[k] * b_value[k] + c_value[k];
+    }
+    void _get_child_slots(std::vector<Expr **> &slots) override
+    {
+        slots.push_back(&a);
+        slots.push_back(&b);
+        slots.push_back(&c);
+    }
+    int _bytecode(BytecodeCompiler &bc) override
+    {
+        int a_reg = bc.compile(a);
+        int b_reg = bc.compile(b);
+        int c_reg = bc.compile(c);
+        bc.release(a_reg);
+        bc.release(b_reg);
+        bc.release(c_reg);
+        int dst = bc.temporary();
+        bc.emit(BC_MUL_ADD, dst, a_reg, b_reg, c_reg);
+        return dst;
+    }
     std::ostream &to_string(std::ostream &out) override
     {
         out << "(" << a << " * " << b << ") + " << c;
@@ -439,6 +624,25 @@ public:
         float value = expr->eval(mesh_i,mesh_j);
         return value * c;
     }
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        expr->eval_lanes(lanes, out);
+        for (int k = 0; k < lanes.count; k++)
+            out[k] = out[k] * c;
+    }
+    void _get_child_slots(std::vector<Expr **> &slots) override
+    {
+        slots.push_back(&expr);
+    }
+    int _bytecode(BytecodeCompiler &bc) override
+    {
+        int value = bc.compile(expr);
+        int constant = bc.constant(c);
+        bc.release(value);
+        int dst = bc.temporary();
+        bc.emit(BC_MUL, dst, value, constant);
+        return dst;
+    }
     std::ostream &to_string(std::ostream &out) override
     {
         out << "(" << expr << " * " << c << ") + " << c;
@@ -604,6 +808,96 @@ float TreeExpr::eval ( int mesh_i, int mesh_j )
     }
 }
 
+/* Batched version of eval(), the switch is hoisted out of the per point loops */
+void TreeExpr::eval_lanes(const ExprLanes &lanes, float *out)
+{
+    float right_arg[ExprLanes::MAX_LANES];
+    const int count = lanes.count;
+
+    /* shouldn't be null if we've called _optimize() */
+    assert(NULL != infix_op);
+
+    left->eval_lanes(lanes, out);
+    right->eval_lanes(lanes, right_arg);
+
+    switch ( infix_op->type )
+    {
+        case INFIX_ADD:
+            for (int k = 0; k < count; k++)
+                out[k] = out[k] + right_arg[k];
+            break;
+        case INFIX_MINUS:
+            for (int k = 0; k < count; k++)
+                out[k] = out[k] - right_arg[k];
+            break;
+        case INFIX_MULT:
+            for (int k = 0; k < count; k++)
+                out[k] = out[k] * right_arg[k];
+            break;
+        case INFIX_MOD:
+            for (int k = 0; k < count; k++)
+            {
+                const int l = ( int ) out[k];
+                const int r = ( int ) right_arg[k];
+                // x % -1 is always 0, but INT_MIN % -1 traps on x86
+                out[k] = ( r == 0 || r == -1 ) ? 0 : l % r;
+            }
+            break;
+        case INFIX_OR:
+            for (int k = 0; k < count; k++)
+                out[k] = ( int ) out[k] | ( int ) right_arg[k];
+            break;
+        case INFIX_AND:
+            for (int k = 0; k < count; k++)
+                out[k] = ( int ) out[k] & ( int ) right_arg[k];
+            break;
+        case INFIX_DIV:
+            for (int k = 0; k < count; k++)
+                out[k] = right_arg[k] == 0 ? MAX_DOUBLE_SIZE : out[k] / right_arg[k];
+            break;
+        default:
+            for (int k = 0; k < count; k++)
+                out[k] = EVAL_ERROR;
+            break;
+    }
+}
+
+void TreeExpr::_get_child_slots(std::vector<Expr **> &slots)
+{
+    if (gen_expr != NULL)
+        slots.push_back(&gen_expr);
+    if (left != NULL)
+        slots.push_back(&left);
+    if (right != NULL)
+        slots.push_back(&right);
+}
+
+int TreeExpr::_bytecode(BytecodeCompiler &bc)
+{
+    if (NULL == infix_op || NULL == left || NULL == right)
+        return bc.fallback(this);
+
+    switch ( infix_op->type )
+    {
+        case INFIX_ADD:
+            return bc.binary(BC_ADD, left, right);
+        case INFIX_MINUS:
+            return bc.binary(BC_SUB, left, right);
+        case INFIX_MULT:
+            return bc.binary(BC_MUL, left, right);
+        case INFIX_MOD:
+            return bc.binary(BC_MOD, left, right);
+        case INFIX_OR:
+            return bc.binary(BC_OR, left, right);
+        case INFIX_AND:
+            return bc.binary(BC_AND, left, right);
+        case INFIX_DIV:
+            return bc.binary(BC_DIV, left, right);
+        default:
+            return bc.fallback(this);
+    }
+}
+
 #if HAVE_LLVM
 llvm::Value *TreeExpr::_llvm(JitContext &jitx)
 {
@@ -737,6 +1031,14 @@ public:
     {
         return left->eval(mesh_i, mesh_j) + right->eval(mesh_i, mesh_j);
     }
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        float right_arg[ExprLanes::MAX_LANES];
+        left->eval_lanes(lanes, out);
+        right->eval_lanes(lanes, right_arg);
+        for (int k = 0; k < lanes.count; k++)
+            out[k] = out[k] + right_arg[k];
+    }
 #if HAVE_LLVM
     llvm::Value *_llvm(JitContext &jitx) override
     {
@@ -758,6 +1060,14 @@ public:
     {
         return left->eval(mesh_i, mesh_j) - right->eval(mesh_i, mesh_j);
     }
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        float right_arg[ExprLanes::MAX_LANES];
+        left->eval_lanes(lanes, out);
+        right->eval_lanes(lanes, right_arg);
+        for (int k = 0; k < lanes.count; k++)
+            out[k] = out[k] - right_arg[k];
+    }
 };
 
 class TreeExprMult : public TreeExpr
@@ -769,6 +1079,14 @@ public:
     {
         return left->eval(mesh_i, mesh_j) * right->eval(mesh_i, mesh_j);
     }
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        float right_arg[ExprLanes::MAX_LANES];
+        left->eval_lanes(lanes, out);
+        right->eval_lanes(lanes, right_arg);
+        for (int k = 0; k < lanes.count; k++)
+            out[k] = out[k] * right_arg[k];
+    }
 };
 
 // NOTE: Parser expects left and right to be TreeExpr, but other code paths don't require this
@@ -928,6 +1246,19 @@ public:
 
     LValue *getLValue() { return lhs; }
 
+    // the assigned LValue is not a child, it is written rather than evaluated
+    void _get_child_slots(std::vector<Expr **> &slots) override
+    {
+        slots.push_back(&rhs);
+    }
+
+    int _bytecode(BytecodeCompiler &bc) override
+    {
+        if (lhs->clazz != PARAMETER)
+            return bc.fallback(this);
+        return bc.assign(BC_SET, (Param *)lhs, rhs);
+    }
+
     std::ostream& to_string(std::ostream &out) override
     {
         out << lhs << " = " << rhs;
@@ -942,6 +1273,9 @@ public:
             return nullptr;
         // TODO optimze to only call set_matrix() once at end of program
         Expr::generate_set_call(jitx, this->lhs, value);
+        // the assignment evaluates to the unclipped value, later reads see what set_param() stored
+        Param *param = (Param *)this->lhs;
+        jitx.assignSymbolValue(param, param->_llvm_set_param_value(jitx, value));
         return value;
     }
 #endif
@@ -966,6 +1300,19 @@ public:
         return v;
     }
 
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        rhs->eval_lanes(lanes, out);
+        lhs->set_matrix_lanes(lanes, out);
+    }
+
+    int _bytecode(BytecodeCompiler &bc) override
+    {
+        if (lhs->clazz != PARAMETER)
+            return bc.fallback(this);
+        return bc.assign(BC_SET_MATRIX, (Param *)lhs, rhs);
+    }
+
     std::ostream &to_string(std::ostream &out) override
     {
         out << lhs << "[i,j] = " << rhs;
@@ -980,7 +1327,7 @@ public:
             return nullptr;
         // TODO optimze to only call set_matrix() once at end of program
         LValue *lvalue = this->lhs;
-        lvalue->_llvm_set_matrix(jitx, value);
+        jitx.assignSymbolValue((Param *)lvalue, lvalue->_llvm_set_matrix(jitx, value));
         return value;
     }
 #endif
@@ -1006,6 +1353,87 @@ Expr *Expr::optimize(Expr *expr)
 }
 
 
+#if HAVE_LLVM
+static std::atomic<int> selectedEngine(EXPR_ENGINE_JIT);
+#else
+static std::atomic<int> selectedEngine(EXPR_ENGINE_BYTECODE);
+#endif
+
+void Expr::set_engine(ExprEngine engine)
+{
+    selectedEngine = engine;
+}
+
+ExprEngine Expr::engine()
+{
+    return (ExprEngine) selectedEngine.load();
+}
+
+static std::atomic<JitObjectCache *> jitObjectCache(nullptr);
+
+void Expr::set_jit_cache(JitObjectCache *cache)
+{
+    jitObjectCache = cache;
+}
+
+ExprEngine Expr::engine_from_name(const std::string &name, ExprEngine fallback)
+{
+    if (name == "tree")
+        return EXPR_ENGINE_TREE;
+    if (name == "bytecode")
+        return EXPR_ENGINE_BYTECODE;
+    if (name == "jit")
+        return EXPR_ENGINE_JIT;
+    return fallback;
+}
+
+Expr *Expr::compile(Expr *program, const std::string &name)
+{
+    Expr *compiled = nullptr;
+    switch (engine())
+    {
+    case EXPR_ENGINE_JIT:
+#if HAVE_LLVM
+        compiled = Expr::jit(program, name);
+#else
+        (void)name;
+#endif
+        break;
+    case EXPR_ENGINE_BYTECODE:
+        compiled = Expr::compile_bytecode(program);
+        break;
+    default:
+        break;
+    }
+    return nullptr != compiled ? compiled : program;
+}
+
+std::vector<Expr *> Expr::compile_module(const std::vector<Expr *> &programs, const std::string &name)
+{
+    std::vector<Expr *> compiled(programs.size(), nullptr);
+    switch (engine())
+    {
+    case EXPR_ENGINE_JIT:
+#if HAVE_LLVM
+        compiled = Expr::jit_module(programs, name);
+#else
+        (void)name;
+#endif
+        break;
+    case EXPR_ENGINE_BYTECODE:
+        for (size_t i = 0; i < programs.size(); i++)
+        {
+            if (nullptr != programs[i])
+                compiled[i] = Expr::compile_bytecode(programs[i], false);
+        }
+        break;
+    default:
+        break;
+    }
+    return compiled;
+}
+
+
 class ProgramExpr : public Expr
 {
 protected:
@@ -1029,6 +1457,32 @@ public:
             f = (*it)->eval(mesh_i,mesh_j);
         return f;
     }
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        for (auto it=steps.begin() ; it<steps.end() ; it++)
+            (*it)->eval_lanes(lanes, out);
+    }
+    void _get_child_slots(std::vector<Expr **> &slots) override
+    {
+        for (auto it=steps.begin() ; it<steps.end() ; it++)
+            slots.push_back(&*it);
+    }
+    int _bytecode(BytecodeCompiler &bc) override
+    {
+        int value = bc.constant(0.0f);
+        for (auto it=steps.begin() ; it<steps.end() ; it++)
+        {
+            bc.release(value);
+            value = bc.compile(*it);
+        }
+        return value;
+    }
+    std::ostream &to_string(std::ostream &out) override
+    {
+        for (auto it=steps.begin() ; it<steps.end() ; it++)
+            out << *it << "; ";
+        return out;
+    }
 #if HAVE_LLVM
     llvm::Value *_llvm(JitContext &jitx) override
     {
@@ -1047,11 +1501,241 @@ Expr *Expr::create_program_expr(std::vector<Expr*> &steps_, bool ownSteps)
 }
 
 
+/* Collects the parameters read by expr, fails if it contains anything eval_lanes() cannot reorder */
+static bool collect_lane_reads(Expr *expr, std::vector<Param *> &reads)
+{
+    switch (expr->clazz)
+    {
+    case PARAMETER:
+        reads.push_back((Param *)expr);
+        return true;
+    case FUNCTION:
+    {
+        // the if/above/equal specializations have no Func, they are pure
+        auto *prefun = (PrefunExpr *)expr;
+        if (nullptr != prefun->function &&
+            (prefun->num_args > MAX_LANE_ARGS || !isConstantFn(prefun->func_ptr)))
+            return false;
+        break;
+    }
+    case ASSIGN:
+    case PROGRAM:
+    case JIT:
+    case BYTECODE:
+        return false;
+    default:
+        break;
+    }
+
+    std::vector<Expr *> children;
+    expr->_get_children(children);
+    for (Expr *child : children)
+    {
+        if (!collect_lane_reads(child, reads))
+            return false;
+    }
+    return true;
+}
+
+int Expr::prepare_lanes(Expr *program)
+{
+    if (nullptr == program || program->clazz != PROGRAM)
+        return -1;
+
+    std::vector<Expr *> steps;
+    program->_get_children(steps);
+
+    std::set<Param *> assigned;
+    for (Expr *step : steps)
+    {
+        auto *assign = dynamic_cast<AssignMatrixExpr *>(step);
+        if (nullptr == assign || assign->getLValue()->clazz != PARAMETER)
+            return -1;
+        assigned.insert((Param *)assign->getLValue());
+    }
+
+    // A variable without per point storage carries its value from one point to the next. Reading it
+    // before it is assigned would observe the previous point, which is not available in batched mode.
+    std::set<Param *> written;
+    std::vector<Param *> locals;
+    std::vector<Param *> reads;
+    for (Expr *step : steps)
+    {
+        auto *assign = (AssignMatrixExpr *)step;
+        std::vector<Expr *> rhs;
+        assign->_get_children(rhs);
+
+        reads.clear();
+        if (!collect_lane_reads(rhs[0], reads))
+            return -1;
+        for (Param *param : reads)
+        {
+            if (!param->is_per_point() && assigned.count(param) && !written.count(param))
+                return -1;
+        }
+
+        auto *lhs = (Param *)assign->getLValue();
+        if (written.insert(lhs).second && !lhs->is_per_point())
+            locals.push_back(lhs);
+    }
+
+    for (size_t i = 0; i < locals.size(); i++)
+        locals[i]->lane_slot = (int)i;
+    return (int)locals.size();
+}
+
+
+/* A subexpression of a per pixel program with the same value at every point, see Expr::hoist_invariants() */
+class HoistedExpr : public Expr
+{
+    Expr *expr;
+    float value;
+public:
+    explicit HoistedExpr(Expr *expr_) : Expr(OTHER), expr(expr_), value(0.0f) {}
+    ~HoistedExpr() override
+    {
+        Expr::delete_expr(expr);
+    }
+    void update()
+    {
+        value = expr->eval(0, 0);
+    }
+    float eval(int mesh_i, int mesh_j) override
+    {
+        return value;
+    }
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        for (int k = 0; k < lanes.count; k++)
+            out[k] = value;
+    }
+    int _bytecode(BytecodeCompiler &bc) override
+    {
+        return bc.load(&value, nullptr);
+    }
+    // the hoisted expression is not evaluated per point, so it is not a child
+    std::ostream &to_string(std::ostream &out) override
+    {
+        out << "hoisted(" << expr << ")";
+        return out;
+    }
+#if HAVE_LLVM
+    llvm::Value *_llvm(JitContext &jitx) override
+    {
+        llvm::Constant *ptr = jitx.CreateFloatPtr(&value);
+        return jitx.builder.CreateLoad(jitx.floatType, ptr, "hoisted");
+    }
+#endif
+};
+
+
+static void collect_assigned(Expr *expr, std::set<Param *> &assigned)
+{
+    if (expr->clazz == ASSIGN)
+    {
+        LValue *lhs = ((AssignExpr *)expr)->getLValue();
+        if (lhs->clazz == PARAMETER)
+            assigned.insert((Param *)lhs);
+    }
+    std::vector<Expr *> children;
+    expr->_get_children(children);
+    for (Expr *child : children)
+        collect_assigned(child, assigned);
+}
+
+/* Returns whether expr has the same value at every point and counts its nodes. Below nodes that vary from
+ * point to point the largest invariant subexpressions are replaced by HoistedExpr. Lone constants and
+ * parameters are left alone, reading them costs as much as reading the hoisted value. */
+static bool hoist_subtree(Expr *expr, const std::set<Param *> &assigned, std::vector<Expr *> &invariants,
+                          ExprHoistStats &stats, int &size)
+{
+    const short varying_flags = P_FLAG_PER_PIXEL | P_FLAG_ALWAYS_MATRIX | P_FLAG_PER_POINT;
+    bool invariant = true;
+    size = 1;
+    switch (expr->clazz)
+    {
+    case PARAMETER:
+    {
+        auto *param = (Param *)expr;
+        return !(param->flags & varying_flags) && !param->is_per_point() && !assigned.count(param);
+    }
+    case FUNCTION:
+    {
+        // the if/above/equal specializations have no Func, they are pure
+        auto *prefun = (PrefunExpr *)expr;
+        invariant = nullptr == prefun->function || isConstantFn(prefun->func_ptr);
+        break;
+    }
+    case ASSIGN:
+    case PROGRAM:
+    case JIT:
+    case BYTECODE:
+        invariant = false;
+        break;
+    default:
+        break;
+    }
+
+    std::vector<Expr **> slots;
+    expr->_get_child_slots(slots);
+    std::vector<bool> child_invariant(slots.size());
+    std::vector<int> child_size(slots.size());
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        int n;
+        child_invariant[i] = hoist_subtree(*slots[i], assigned, invariants, stats, n);
+        child_size[i] = n;
+        invariant = invariant && child_invariant[i];
+        size += n;
+    }
+
+    if (!invariant)
+    {
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            if (!child_invariant[i] || child_size[i] < 2)
+                continue;
+            auto *hoisted = new HoistedExpr(*slots[i]);
+            *slots[i] = hoisted;
+            invariants.push_back(hoisted);
+            stats.removed += child_size[i] - 1;
+            stats.invariants++;
+        }
+    }
+    return invariant;
+}
+
+std::vector<Expr *> Expr::hoist_invariants(Expr *program, ExprHoistStats &stats)
+{
+    std::vector<Expr *> invariants;
+    if (nullptr == program || program->clazz != PROGRAM)
+        return invariants;
+
+    std::set<Param *> assigned;
+    collect_assigned(program, assigned);
+
+    // the program itself is never invariant, so everything worth hoisting ends up below it
+    int size;
+    hoist_subtree(program, assigned, invariants, stats, size);
+    stats.nodes += size - 1;
+    return invariants;
+}
+
+void Expr::eval_invariants(const std::vector<Expr *> &invariants)
+{
+    for (Expr *invariant : invariants)
+        ((HoistedExpr *)invariant)->update();
+}
+
+
 
 
 // TESTS
 
 #include <TestRunner.hpp>
+#include <algorithm>
+#include <cstring>
+#include "Renderer/MeshBuffer.hpp"
 
 #ifndef NDEBUG
 
@@ -1113,6 +1797,189 @@ public:
         return true;
     }
 
+    Expr *call(const char *function, Expr *a, Expr *b=nullptr, Expr *c=nullptr)
+    {
+        Func *fn = BuiltinFuncs::find_func(function);
+        Expr **expr_list = (Expr **)malloc(3 * sizeof(Expr *));
+        expr_list[0] = a;
+        expr_list[1] = b;
+        expr_list[2] = c;
+        return Expr::prefun_to_expr(fn, expr_list);
+    }
+
+    Expr *assign(Param *lhs, Expr *rhs)
+    {
+        return Expr::create_matrix_assignment(lhs, Expr::optimize(rhs));
+    }
+
+    // batched evaluation of a per pixel program has to give exactly the scalar results
+    bool eval_lanes()
+    {
+        BuiltinFuncs::init_builtin_func_db();
+        const int gx = 2 * ExprLanes::MAX_LANES + 5, gy = 3;
+
+        float x_value = 0, zoom_value = 0.9f;
+        MeshBuffer mesh;
+        mesh.allocate(gx, gy, 2);
+        MeshPlane x_matrix = mesh.plane(0), zoom_matrix = mesh.plane(1);
+        float *zoom_begin = zoom_matrix.data(), *zoom_end = zoom_begin + mesh.planeSize();
+        for (int j = 0; j < gy; j++)
+            for (int i = 0; i < gx; i++)
+                x_matrix(i, j) = (float)(j * gx + i) / (gx - 1) - 0.75f;
+        Param *x = Param::new_param_float("x", P_FLAG_PER_PIXEL | P_FLAG_ALWAYS_MATRIX | P_FLAG_READONLY, &x_value,
+                                          &x_matrix, MAX_DOUBLE_SIZE, -MAX_DOUBLE_SIZE, 0);
+        Param *zoom = Param::new_param_float("zoom", P_FLAG_PER_PIXEL, &zoom_value, &zoom_matrix,
+                                             MAX_DOUBLE_SIZE, 0, 1);
+        Param *t = Param::createUser("t");
+        Param *u = Param::createUser("u");
+
+        std::vector<Expr *> steps;
+        // t = sin(x*3)*0.5 + x
+        steps.push_back(assign(t, TreeExpr::create(Eval::infix_add,
+            TreeExpr::create(Eval::infix_mult, call("sin", TreeExpr::create(Eval::infix_mult, x, Expr::const_to_expr(3))),
+                Expr::const_to_expr(0.5f)), x)));
+        // zoom = if(above(t,0.2), zoom*t, cos(t)/(x-0.25))
+        steps.push_back(assign(zoom, call("if", call("above", t, Expr::const_to_expr(0.2f)),
+            TreeExpr::create(Eval::infix_mult, zoom, t),
+            TreeExpr::create(Eval::infix_div, call("cos", t),
+                TreeExpr::create(Eval::infix_minus, x, Expr::const_to_expr(0.25f))))));
+        // u = zoom*2 + (x*7 % 3)
+        steps.push_back(assign(u, TreeExpr::create(Eval::infix_add,
+            TreeExpr::create(Eval::infix_mult, zoom, Expr::const_to_expr(2)),
+            TreeExpr::create(Eval::infix_mod, TreeExpr::create(Eval::infix_mult, x, Expr::const_to_expr(7)),
+                Expr::const_to_expr(3)))));
+        // zoom = zoom - u*0.25
+        steps.push_back(assign(zoom, TreeExpr::create(Eval::infix_minus, zoom,
+            TreeExpr::create(Eval::infix_mult, u, Expr::const_to_expr(0.25f)))));
+        Expr *program = Expr::create_program_expr(steps, true);
+
+        std::fill(zoom_begin, zoom_end, zoom_value);
+        for (int j = 0; j < gy; j++)
+            for (int i = 0; i < gx; i++)
+                program->eval(i, j);
+        std::vector<float> expected(zoom_begin, zoom_end);
+        float expected_u = u->eval(-1, -1);
+
+        int slots = Expr::prepare_lanes(program);
+        TEST(2 == slots);
+        std::vector<float> locals(slots * ExprLanes::MAX_LANES);
+        float result[ExprLanes::MAX_LANES];
+        ExprLanes lanes;
+        lanes.locals = locals.data();
+        std::fill(zoom_begin, zoom_end, zoom_value);
+        u->set_param(0.0f);
+        for (int j = 0; j < gy; j++)
+        {
+            lanes.mesh_j = j;
+            for (int i = 0; i < gx; i += ExprLanes::MAX_LANES)
+            {
+                lanes.mesh_i = i;
+                lanes.count = std::min(gx - i, (int)ExprLanes::MAX_LANES);
+                lanes.write_back = j == gy - 1 && i + lanes.count == gx;
+                program->eval_lanes(lanes, result);
+            }
+        }
+        TEST(0 == memcmp(expected.data(), zoom_begin, expected.size() * sizeof(float)));
+        TEST(expected_u == u->eval(-1, -1));
+        Expr::delete_expr(program);
+
+        // t carries over from the previous point
+        steps.clear();
+        steps.push_back(assign(zoom, TreeExpr::create(Eval::infix_add, zoom, t)));
+        steps.push_back(assign(t, TreeExpr::create(Eval::infix_add, t, x)));
+        program = Expr::create_program_expr(steps, true);
+        TEST(-1 == Expr::prepare_lanes(program));
+        Expr::delete_expr(program);
+
+        // rand() has to be called in point order
+        steps.clear();
+        steps.push_back(assign(zoom, call("rand", Expr::const_to_expr(10))));
+        program = Expr::create_program_expr(steps, true);
+        TEST(-1 == Expr::prepare_lanes(program));
+        Expr::delete_expr(program);
+
+        delete x;
+        delete zoom;
+        delete t;
+        delete u;
+        return true;
+    }
+
+    // subexpressions reading only per frame values run once per frame and give the same results
+    bool hoist_invariants()
+    {
+        BuiltinFuncs::init_builtin_func_db();
+        const int gx = 5, gy = 3;
+
+        float x_value = 0, zoom_value = 0.9f;
+        MeshBuffer mesh;
+        mesh.allocate(gx, gy, 2);
+        MeshPlane x_matrix = mesh.plane(0), zoom_matrix = mesh.plane(1);
+        float *zoom_begin = zoom_matrix.data(), *zoom_end = zoom_begin + mesh.planeSize();
+        for (int j = 0; j < gy; j++)
+            for (int i = 0; i < gx; i++)
+                x_matrix(i, j) = (float)(j * gx + i) / (gx - 1);
+        Param *x = Param::new_param_float("x", P_FLAG_PER_PIXEL | P_FLAG_ALWAYS_MATRIX | P_FLAG_READONLY, &x_value,
+                                          &x_matrix, MAX_DOUBLE_SIZE, -MAX_DOUBLE_SIZE, 0);
+        Param *zoom = Param::new_param_float("zoom", P_FLAG_PER_PIXEL, &zoom_value, &zoom_matrix,
+                                             MAX_DOUBLE_SIZE, 0, 1);
+        Param *q = Param::createUser("q");
+        Param *bass = Param::createUser("bass");
+        Param *t = Param::createUser("t");
+
+        std::vector<Expr *> steps;
+        // t = q + x
+        steps.push_back(assign(t, TreeExpr::create(Eval::infix_add, q, x)));
+        // zoom = zoom + sin(q*2)*0.5 + t*(q+bass)
+        steps.push_back(assign(zoom, TreeExpr::create(Eval::infix_add,
+            TreeExpr::create(Eval::infix_add, zoom,
+                TreeExpr::create(Eval::infix_mult, call("sin", TreeExpr::create(Eval::infix_mult, q, Expr::const_to_expr(2))),
+                    Expr::const_to_expr(0.5f))),
+            TreeExpr::create(Eval::infix_mult, t, TreeExpr::create(Eval::infix_add, q, bass)))));
+        Expr *program = Expr::create_program_expr(steps, true);
+
+        std::vector<Expr *> invariants;
+        auto run = [&](float q_value) {
+            q->set_param(q_value);
+            bass->set_param(q_value * 3);
+            Expr::eval_invariants(invariants);
+            std::fill(zoom_begin, zoom_end, zoom_value);
+            for (int j = 0; j < gy; j++)
+                for (int i = 0; i < gx; i++)
+                    program->eval(i, j);
+            return std::vector<float>(zoom_begin, zoom_end);
+        };
+        std::vector<float> expected1 = run(0.3f), expected2 = run(-1.7f);
+
+        ExprHoistStats stats;
+        invariants = Expr::hoist_invariants(program, stats);
+        TEST(2 == invariants.size());
+        TEST(2 == stats.invariants);
+        TEST(5 == stats.removed);
+        TEST(expected1 == run(0.3f));
+        TEST(expected2 == run(-1.7f));
+        TEST(1 == Expr::prepare_lanes(program));
+        Expr::delete_expr(program);
+
+        // rand() stays per point, its invariant argument is hoisted
+        steps.clear();
+        steps.push_back(assign(zoom, call("rand", TreeExpr::create(Eval::infix_add,
+            TreeExpr::create(Eval::infix_mult, q, Expr::const_to_expr(3)), Expr::const_to_expr(1)))));
+        program = Expr::create_program_expr(steps, true);
+        stats = ExprHoistStats();
+        invariants = Expr::hoist_invariants(program, stats);
+        TEST(1 == invariants.size());
+        TEST(-1 == Expr::prepare_lanes(program));
+        Expr::delete_expr(program);
+
+        delete x;
+        delete zoom;
+        delete q;
+        delete bass;
+        delete t;
+        return true;
+    }
+
 #if HAVE_LLVM
     bool jit()
     {
@@ -1213,6 +2080,8 @@ public:
         Eval::init_infix_ops();
         bool result = true;
         result &= optimize_constant_expr();
+        result &= eval_lanes();
+        result &= hoist_invariants();
 #if HAVE_LLVM
         result &= jit();
 #endif
@@ -1237,17 +2106,44 @@ Test* Expr::test()
 
 
 #if HAVE_LLVM
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
 using namespace llvm;
 
+// All presets share getGlobalContext(), which is not thread safe. Presets may be parsed
+// (and therefore compiled) on the prefetch and compiler threads while another one is destroyed.
+static std::mutex jitMutex;
 
+static void delete_execution_engine(ExecutionEngine *engine)
+{
+    if (nullptr == engine)
+        return;
+    std::lock_guard<std::mutex> lock(jitMutex);
+    delete engine;
+}
+
+
+// One function of a module, the functions of a module share its execution engine
 class JitExpr : public Expr
 {
-    ExecutionEngine *engine;
+    std::shared_ptr<ExecutionEngine> engine;
     Expr *expr;
     float (*fn)(int,int);
 
 public:
-    JitExpr(ExecutionEngine *engine_, Expr *orig, float (*fn_)(int,int)) : Expr(JIT), engine(engine_), expr(orig), fn(fn_)
+    // orig is owned if not null
+    JitExpr(std::shared_ptr<ExecutionEngine> engine_, Expr *orig, float (*fn_)(int,int)) :
+        Expr(JIT), engine(std::move(engine_)), expr(orig), fn(fn_)
     {
 
     }
@@ -1260,7 +2156,6 @@ public:
     ~JitExpr() override
     {
         Expr::delete_expr(expr);
-        delete engine;
     }
 
     Value *_llvm(JitContext &jit) override
@@ -1310,11 +2205,11 @@ LLVMContext& getGlobalContext()
 Value * Expr::generate_eval_call(JitContext &jitx, Expr *expr, const char *name)
 {
     // turn this into "void *"
-    ConstantInt * thisConstant = ConstantInt::get(IntegerType::getInt64Ty(jitx.context), (uint64_t)expr, false);
+    Constant * thisConstant = jitx.CreateAddress(expr);
 
     // thunk_expr into float ()(void *,int, int)
     // use eval_thunk
-    ConstantInt * thunkConstant = ConstantInt::get(IntegerType::getInt64Ty(jitx.context), (uint64_t)eval_thunk, false);
+    Constant * thunkConstant = jitx.CreateAddress((const void *)eval_thunk);
     // TODO create type once
     std::vector<Type*> exprEvalFunctionArgs;
     exprEvalFunctionArgs.push_back(IntegerType::getInt64Ty(jitx.context));    // Expr *
@@ -1329,7 +2224,7 @@ Value * Expr::generate_eval_call(JitContext &jitx, Expr *expr, const char *name)
     args.push_back(thisConstant);
     args.push_back(jitx.mesh_i);
     args.push_back(jitx.mesh_j);
-    Value *ret = jitx.builder.CreateCall(thunkFunctionPtr, args, name);
+    Value *ret = jitx.builder.CreateCall(evalFunctionType, thunkFunctionPtr, args, name);
     return ret;
 }
 
@@ -1337,11 +2232,11 @@ Value * Expr::generate_eval_call(JitContext &jitx, Expr *expr, const char *name)
 Value * Expr::generate_set_call(JitContext &jitx, Expr *expr, Value *value)
 {
     // turn expr into "void *"
-    ConstantInt * thisConstant = ConstantInt::get(IntegerType::getInt64Ty(jitx.context), (uint64_t)expr, false);
+    Constant * thisConstant = jitx.CreateAddress(expr);
 
     // thunk_expr into float ()(void *,int, int, float)
     // use eval_thunk
-    ConstantInt * thunkConstant = ConstantInt::get(IntegerType::getInt64Ty(jitx.context), (uint64_t)set_thunk, false);
+    Constant * thunkConstant = jitx.CreateAddress((const void *)set_thunk);
     // TODO create type once
     std::vector<Type*> setMatrixFunctionArgs;
     setMatrixFunctionArgs.push_back(IntegerType::getInt64Ty(jitx.context));    // Expr *
@@ -1354,7 +2249,7 @@ Value * Expr::generate_set_call(JitContext &jitx, Expr *expr, Value *value)
     std::vector<Value *> args;
     args.push_back(thisConstant);
     args.push_back(value);
-    jitx.builder.CreateCall(thunkFunctionPtr, args);
+    jitx.builder.CreateCall(evalFunctionType, thunkFunctionPtr, args);
     return value;
 }
 
@@ -1362,11 +2257,11 @@ Value * Expr::generate_set_call(JitContext &jitx, Expr *expr, Value *value)
 Value * Expr::generate_set_matrix_call(JitContext &jitx, Expr *expr, Value *value)
 {
     // turn expr into "void *"
-    ConstantInt * thisConstant = ConstantInt::get(IntegerType::getInt64Ty(jitx.context), (uint64_t)expr, false);
+    Constant * thisConstant = jitx.CreateAddress(expr);
 
     // thunk_expr into float ()(void *,int, int, float)
     // use eval_thunk
-    ConstantInt * thunkConstant = ConstantInt::get(IntegerType::getInt64Ty(jitx.context), (uint64_t)set_matrix_thunk, false);
+    Constant * thunkConstant = jitx.CreateAddress((const void *)set_matrix_thunk);
     // TODO create type once
     std::vector<Type*> setMatrixFunctionArgs;
     setMatrixFunctionArgs.push_back(IntegerType::getInt64Ty(jitx.context));    // Expr *
@@ -1383,7 +2278,7 @@ Value * Expr::generate_set_matrix_call(JitContext &jitx, Expr *expr, Value *valu
     args.push_back(jitx.mesh_i);
     args.push_back(jitx.mesh_j);
     args.push_back(value);
-    jitx.builder.CreateCall(thunkFunctionPtr, args);
+    jitx.builder.CreateCall(evalFunctionType, thunkFunctionPtr, args);
     return value;
 }
 
@@ -1395,10 +2290,106 @@ Value *Expr::llvm(JitContext &jitx, Expr *root)
     {
         return jitx.getSymbolValue((Param *)root);
     }
-    Value *value = root->_llvm(jitx);
-    if (root->clazz == ASSIGN)
-        jitx.assignSymbolValue((Param *)((AssignExpr *)root)->getLValue(), value);
-    return value;
+    return root->_llvm(jitx);
+}
+
+
+// Hands the object code of the module being linked to and from the JitObjectCache
+class JitObjectCacheAdapter : public ObjectCache
+{
+public:
+    std::vector<char> loaded;
+    std::vector<char> compiled;
+
+    void notifyObjectCompiled(const Module *, MemoryBufferRef object) override
+    {
+        compiled.assign(object.getBufferStart(), object.getBufferEnd());
+    }
+
+    std::unique_ptr<MemoryBuffer> getObject(const Module *) override
+    {
+        if (loaded.empty())
+            return nullptr;
+        return MemoryBuffer::getMemBufferCopy(StringRef(loaded.data(), loaded.size()));
+    }
+};
+
+// The compiler and the CPU the object code is generated for
+static const std::string &jit_host()
+{
+    static const std::string host = [] {
+        std::string description = "LLVM " LLVM_VERSION_STRING " ";
+        description += sys::getHostCPUName().str();
+        StringMap<bool> features;
+        std::vector<std::string> enabled;
+        if (sys::getHostCPUFeatures(features))
+        {
+            for (auto &feature : features)
+            {
+                if (feature.getValue())
+                    enabled.push_back(feature.getKey().str());
+            }
+        }
+        std::sort(enabled.begin(), enabled.end());
+        for (const std::string &feature : enabled)
+            description += " +" + feature;
+        return description;
+    }();
+    return host;
+}
+
+// Optimizes the module of jitx and links it, unless the JitObjectCache has its object code from an
+// earlier run. Called with jitMutex held, the caller has to release the engine after unlocking it.
+static std::shared_ptr<ExecutionEngine> create_execution_engine(JitContext &jitx)
+{
+    const auto begin = std::chrono::steady_clock::now();
+    JitObjectCache *cache = jitObjectCache.load();
+    if (nullptr != cache && !cache->enabled())
+        cache = nullptr;
+
+    JitObjectCacheAdapter adapter;
+    JitObjectCache::Key key = 0;
+    if (nullptr != cache)
+    {
+        // the functions name the addresses they use by symbol, so their text identifies the object code
+        std::string text;
+        raw_string_ostream stream(text);
+        for (const Function &function : *jitx.module)
+            function.print(stream);
+        stream.flush();
+        key = JitObjectCache::key(text, jit_host());
+        cache->load(key, adapter.loaded);
+    }
+
+    // cached object code was optimized before it was stored
+    if (adapter.loaded.empty())
+        jitx.OptimizePass();
+
+#ifdef DEBUG_LLVM
+    outs() << "MODULE OPTIMIZED\n\n" << *jitx.module << "\n\n"; outs().flush();
+#endif
+
+    std::shared_ptr<ExecutionEngine> executionEngine(EngineBuilder(std::move(jitx.module_ptr)).create(),
+                                                     delete_execution_engine);
+    if (!executionEngine)
+        return executionEngine;
+    jitx.MapAddresses(*executionEngine);
+
+    if (nullptr == cache)
+    {
+        executionEngine->finalizeObject();
+        return executionEngine;
+    }
+    executionEngine->setObjectCache(&adapter);
+    executionEngine->finalizeObject();
+    executionEngine->setObjectCache(nullptr);
+    if (adapter.loaded.empty())
+    {
+        const double milliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        cache->store(key, adapter.compiled, milliseconds);
+    }
+    return executionEngine;
 }
 
 
@@ -1407,24 +2398,11 @@ Expr *Expr::jit(Expr *root, std::string name)
 #ifdef NEVER_JIT
     return root;
 #endif
-    LLVMContext &Context = getGlobalContext();
+    std::lock_guard<std::mutex> lock(jitMutex);
 
     // Create some module to put our function into it.
     JitContext jitx(name);
-
-    std::vector<Type *> arg_typess;
-    arg_typess.push_back(IntegerType::get(Context,32));
-    arg_typess.push_back(IntegerType::get(Context,32));
-    FunctionCallee functionCallee = jitx.module->getOrInsertFunction<Type*>("Expr_eval",
-            Type::getFloatTy(Context),
-            IntegerType::get(Context,32),
-            IntegerType::get(Context,32));
-    Value *c = functionCallee.getCallee();
-    auto *expr_eval_fun = cast<Function>(c);
-    BasicBlock *BB = BasicBlock::Create(Context, "EntryBlock", expr_eval_fun);
-    jitx.builder.SetInsertPoint(BB);
-    jitx.mesh_i = &expr_eval_fun->arg_begin()[0];
-    jitx.mesh_j = &expr_eval_fun->arg_begin()[1];
+    jitx.StartFunction("Expr_eval");
 
     // Generate IR Code!
     Value *retValue = Expr::llvm(jitx, root);
@@ -1441,16 +2419,55 @@ Expr *Expr::jit(Expr *root, std::string name)
 #endif
 
 	// and JIT!
-	jitx.OptimizePass();
+    std::shared_ptr<ExecutionEngine> executionEngine = create_execution_engine(jitx);
+    if (!executionEngine)
+        return nullptr;
 
-#ifdef DEBUG_LLVM
-    outs() << "MODULE OPTIMIZED\n\n" << *jitx.module << "\n\n"; outs().flush();
-#endif
+    auto fn = (float (*)(int,int))executionEngine->getFunctionAddress("Expr_eval");
 
-    ExecutionEngine* executionEngine = EngineBuilder(std::move(jitx.module_ptr)).create();
+    return new JitExpr(std::move(executionEngine), root, fn);
+}
 
-    auto fn = (float (*)(int,int))executionEngine->getFunctionAddress("Expr_eval");
+std::vector<Expr *> Expr::jit_module(const std::vector<Expr *> &programs, const std::string &name)
+{
+    std::vector<Expr *> compiled(programs.size(), nullptr);
+#ifdef NEVER_JIT
+    return compiled;
+#endif
+    // declared before the lock, the engine locks it again when it is released
+    std::shared_ptr<ExecutionEngine> executionEngine;
+    std::lock_guard<std::mutex> lock(jitMutex);
+
+    JitContext jitx(name);
+    std::vector<std::string> functions(programs.size());
+    for (size_t i = 0; i < programs.size(); i++)
+    {
+        if (nullptr == programs[i])
+            continue;
+        std::string function_name = "Expr_eval_" + std::to_string(i);
+        Function *function = jitx.StartFunction(function_name);
+        Value *retValue = Expr::llvm(jitx, programs[i]);
+        if (nullptr == retValue)
+        {
+            // this program stays on the tree
+            function->eraseFromParent();
+            continue;
+        }
+        jitx.builder.CreateRet(retValue);
+        functions[i] = function_name;
+    }
 
-    return new JitExpr(executionEngine, root, fn);
+    executionEngine = create_execution_engine(jitx);
+    if (!executionEngine)
+        return compiled;
+    for (size_t i = 0; i < programs.size(); i++)
+    {
+        if (functions[i].empty())
+            continue;
+        auto fn = (float (*)(int,int))executionEngine->getFunctionAddress(functions[i]);
+        if (nullptr != fn)
+            compiled[i] = new JitExpr(executionEngine, nullptr, fn);
+    }
+    return compiled;
 }
 #endif
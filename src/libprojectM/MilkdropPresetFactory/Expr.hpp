@@ -34,12 +34,14 @@
 #include "CValue.hpp"
 #include "Func.hpp"
 #include <iostream>
+#include <string>
 #include <vector>
 
 class Test;
 class Param;
 class LValue;
 class JitContext;
+class BytecodeCompiler;
 
 #ifdef HAVE_LLVM
 namespace llvm {
@@ -73,9 +75,40 @@ public:
 };
  
 
+/// A run of consecutive points of one mesh row, (mesh_i, mesh_j) .. (mesh_i + count - 1, mesh_j),
+/// evaluated together by Expr::eval_lanes().
+struct ExprLanes
+{
+  static const int MAX_LANES = 16;
+
+  int mesh_i;
+  int mesh_j;
+  int count; /* 1 .. MAX_LANES */
+  float *locals; /* per point values of the program's local variables, MAX_LANES floats per slot */
+  /* Set for the run holding the last point of the mesh. Local variables are only written back to their
+   * parameters for this run, so runs of other rows may be evaluated concurrently. */
+  bool write_back;
+};
+
+/// Node evaluations per mesh point of a per pixel program, see Expr::hoist_invariants()
+struct ExprHoistStats
+{
+  int nodes = 0; /* per point before hoisting */
+  int removed = 0; /* no longer evaluated per point, the hoisted subexpressions run once per frame instead */
+  int invariants = 0; /* hoisted subexpressions */
+};
+
 enum ExprClass
 {
-  TREE, CONSTANT, PARAMETER, FUNCTION, ASSIGN, PROGRAM, JIT, OTHER
+  TREE, CONSTANT, PARAMETER, FUNCTION, ASSIGN, PROGRAM, JIT, BYTECODE, OTHER
+};
+
+/// How Expr::compile() prepares programs for evaluation
+enum ExprEngine
+{
+  EXPR_ENGINE_TREE,      /* walk the expression tree */
+  EXPR_ENGINE_BYTECODE,  /* run bytecode on a small register machine, see ExprBytecode.hpp */
+  EXPR_ENGINE_JIT        /* compile to machine code with LLVM, only available with HAVE_LLVM */
 };
 
 class Expr
@@ -87,9 +120,13 @@ public:
 
   virtual bool isConstant() { return false; };
   virtual float eval(int mesh_i, int mesh_j) = 0;
+  /// Evaluates the expression for every point of the batch and writes one result per point to out.
+  /// The results are exactly the ones eval() returns point by point, the default implementation
+  /// simply does that. Only valid for programs accepted by prepare_lanes().
+  virtual void eval_lanes(const ExprLanes &lanes, float *out);
   virtual std::ostream& to_string(std::ostream &out)
   {
-      std::cout << "nyi"; return out;
+      out << "nyi"; return out;
   }
 
   static Test *test();
@@ -104,10 +141,54 @@ public:
   static void delete_expr(Expr *expr) { if (nullptr != expr) expr->_delete_from_tree(); }
   static Expr *optimize(Expr *root);
   static Expr *jit(Expr *root, std::string name="Expr::jit");
+  /// Compiles several programs into one LLVM module, see compile_module()
+  static std::vector<Expr *> jit_module(const std::vector<Expr *> &programs, const std::string &name);
+  /// Translates root into bytecode for the register machine in ExprBytecode.cpp. The result owns root if own is set.
+  /// \returns nullptr if the program is too large for the machine
+  static Expr *compile_bytecode(Expr *root, bool own = true);
+  /// Prepares a program for evaluation with the engine selected by set_engine(), falling back to the
+  /// tree if that engine is not available or can't handle the program. The result owns program.
+  /// Batched evaluation with eval_lanes() is supported by the tree and the bytecode, not by JIT code.
+  static Expr *compile(Expr *program, const std::string &name);
+  /// Compiles the programs of a preset together with the selected engine. Unlike compile() the results
+  /// do not own the programs, which have to outlive them. Null programs are skipped.
+  /// \returns one entry per program, nullptr where the program has to stay on the tree
+  static std::vector<Expr *> compile_module(const std::vector<Expr *> &programs, const std::string &name);
+  static void set_engine(ExprEngine engine);
+  static ExprEngine engine();
+  /// Keeps the object code of JIT compiled modules between runs, nullptr compiles every module from scratch.
+  /// The cache must outlive all compilation.
+  static void set_jit_cache(class JitObjectCache *cache);
+  /// Parses "tree", "bytecode" or "jit", returns fallback for anything else
+  static ExprEngine engine_from_name(const std::string &name, ExprEngine fallback);
+  /// Checks whether a per pixel program can be run with eval_lanes(), which evaluates each step for a whole
+  /// batch of points before moving on to the next one. That is only allowed if no point can observe the
+  /// order, i.e. the program does not call rand() and reads variables without per point storage only after
+  /// assigning them. Those variables get a slot in ExprLanes::locals.
+  /// \returns the number of local slots the caller has to provide, or -1 if the program has to be run point by point
+  static int prepare_lanes(Expr *program);
+  /// Moves the subexpressions of a per pixel program that have the same value at every point of the mesh
+  /// out of the per point evaluation. Those read no per pixel or per point variables, no variable the program
+  /// assigns and call no function with side effects. Each of them is replaced by a node reading a value
+  /// computed by eval_invariants(), which has to be called once per frame before the program runs.
+  /// Call this before jit() and prepare_lanes().
+  /// \returns the hoisted subexpressions, owned by the program's steps
+  static std::vector<Expr *> hoist_invariants(Expr *program, ExprHoistStats &stats);
+  static void eval_invariants(const std::vector<Expr *> &invariants);
 
 public: // but don't call these from outside Expr.cpp
 
   virtual Expr *_optimize() { return this; };
+  // appends the addresses of the direct subexpressions of this node, so passes can replace them
+  virtual void _get_child_slots(std::vector<Expr **> &) {}
+  // appends the direct subexpressions of this node
+  void _get_children(std::vector<Expr *> &children)
+  {
+    std::vector<Expr **> slots;
+    _get_child_slots(slots);
+    for (Expr **slot : slots)
+      children.push_back(*slot);
+  }
 #if HAVE_LLVM
   static  llvm::Value *llvm(JitContext &jit, Expr *);
   virtual llvm::Value *_llvm(JitContext &jit) = 0;  //ONLY called by llvm()
@@ -116,6 +197,10 @@ public: // but don't call these from outside Expr.cpp
   static llvm::Value *generate_set_matrix_call(JitContext &jitx, Expr *expr, llvm::Value *value);
 #endif
 
+  /// Emits the instructions computing this node, returns the register holding the value. The default
+  /// emits a call of eval(), so nodes without an override still work in bytecode.
+  virtual int _bytecode(BytecodeCompiler &bc);
+
   // override if this expr is not 'owned' by the containg expression tree
   virtual void _delete_from_tree()
   {
@@ -155,6 +240,9 @@ public:
   
   Expr *_optimize() override;
   float eval(int mesh_i, int mesh_j) override;
+  void eval_lanes(const ExprLanes &lanes, float *out) override;
+  void _get_child_slots(std::vector<Expr **> &slots) override;
+  int _bytecode(BytecodeCompiler &bc) override;
 #if HAVE_LLVM
   llvm::Value *_llvm(JitContext &jitx) override;
 #endif
@@ -168,7 +256,14 @@ public:
     explicit LValue(ExprClass c) : Expr(c) {};
     virtual void set(float value) = 0;
     virtual void set_matrix(int mesh_i, int mesh_j, float value) = 0;
+    /// Batched set_matrix(), see Expr::eval_lanes()
+    virtual void set_matrix_lanes(const ExprLanes &lanes, const float *values)
+    {
+        for (int k = 0; k < lanes.count; k++)
+            set_matrix(lanes.mesh_i + k, lanes.mesh_j, values[k]);
+    }
 #if HAVE_LLVM
+    /// Generates set_matrix(rhs), returns the value eval() reads back afterwards
     virtual llvm::Value *_llvm_set_matrix(JitContext &jitx, llvm::Value *rhs)
     {
         Expr::generate_set_matrix_call(jitx, this, rhs);
@@ -0,0 +1,925 @@
+#include "ExprBytecode.hpp"
+
+#include "Common.hpp"
+#include "Param.hpp"
+#include "JitContext.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const char *const opNames[BC_OP_COUNT] = {
+    "mov", "load", "load_param", "eval", "add", "sub", "mul", "div", "mod", "or", "and", "mul_add",
+    "sin", "cos", "log", "call", "if_above", "if_equal", "if", "jump", "set", "set_matrix", "return"
+};
+
+/// A program compiled by Expr::compile_bytecode(), keeps the tree for the nodes called through BC_EVAL
+class BytecodeExpr : public Expr
+{
+public:
+    Expr *expr;
+    bool own;
+    BytecodeProgram program;
+
+    BytecodeExpr(Expr *expr_, bool own_) : Expr(BYTECODE), expr(expr_), own(own_) {}
+
+    ~BytecodeExpr() override
+    {
+        if (own)
+            Expr::delete_expr(expr);
+    }
+
+    float eval(int mesh_i, int mesh_j) override
+    {
+        return program.run(mesh_i, mesh_j);
+    }
+
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        program.run_lanes(lanes, out);
+    }
+
+    std::ostream &to_string(std::ostream &out) override
+    {
+        out << expr;
+        return out;
+    }
+
+#if HAVE_LLVM
+    llvm::Value *_llvm(JitContext &jitx) override
+    {
+        return Expr::generate_eval_call(jitx, this);
+    }
+#endif
+};
+
+}
+
+
+int Expr::_bytecode(BytecodeCompiler &bc)
+{
+    return bc.fallback(this);
+}
+
+Expr *Expr::compile_bytecode(Expr *root, bool own)
+{
+    auto *compiled = new BytecodeExpr(root, own);
+    BytecodeCompiler bc(compiled->program);
+    int result = bc.compile(root);
+    bc.emit(BC_RETURN, 0, result);
+    if (bc.failed())
+    {
+        // the tree stays with the caller
+        compiled->expr = nullptr;
+        delete compiled;
+        return nullptr;
+    }
+    compiled->program.finish();
+    return compiled;
+}
+
+
+BytecodeCompiler::BytecodeCompiler(BytecodeProgram &program) : _program(program), _failed(false)
+{
+    // register 0 holds 0, it is passed for the arguments BC_CALL does not use
+    constant(0.0f);
+}
+
+int BytecodeCompiler::compile(Expr *expr)
+{
+    return expr->_bytecode(*this);
+}
+
+int BytecodeCompiler::fallback(Expr *expr)
+{
+    int dst = temporary();
+    emit(BC_EVAL, dst, index(_program.exprs, expr));
+    return dst;
+}
+
+int BytecodeCompiler::allocate()
+{
+    if (_program.registers.size() >= BytecodeProgram::MAX_REGISTERS)
+    {
+        _failed = true;
+        return 0;
+    }
+    _program.registers.push_back(0.0f);
+    _temporary.push_back(false);
+    return static_cast<int>(_program.registers.size() - 1);
+}
+
+int BytecodeCompiler::constant(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto it = _constants.find(bits);
+    if (it != _constants.end())
+        return it->second;
+
+    int reg = allocate();
+    if (_failed)
+        return 0;
+    _program.registers[reg] = value;
+    _program.constants.push_back(static_cast<uint16_t>(reg));
+    _constants[bits] = reg;
+    return reg;
+}
+
+int BytecodeCompiler::temporary()
+{
+    if (!_free.empty())
+    {
+        int reg = _free.back();
+        _free.pop_back();
+        return reg;
+    }
+    int reg = allocate();
+    _temporary[reg] = !_failed;
+    return reg;
+}
+
+void BytecodeCompiler::release(int reg)
+{
+    if (_temporary[reg])
+        _free.push_back(reg);
+}
+
+template<typename T>
+int BytecodeCompiler::index(std::vector<T> &table, T entry)
+{
+    auto it = std::find(table.begin(), table.end(), entry);
+    if (it != table.end())
+        return static_cast<int>(it - table.begin());
+    if (table.size() >= BytecodeProgram::NO_PARAM)
+    {
+        _failed = true;
+        return 0;
+    }
+    table.push_back(entry);
+    return static_cast<int>(table.size() - 1);
+}
+
+int BytecodeCompiler::load(float *pointer, Param *param)
+{
+    int dst = temporary();
+    emit(BC_LOAD, dst, index(_program.pointers, pointer),
+         nullptr == param ? BytecodeProgram::NO_PARAM : index(_program.params, param));
+    return dst;
+}
+
+int BytecodeCompiler::load_param(Param *param)
+{
+    int dst = temporary();
+    emit(BC_LOAD_PARAM, dst, index(_program.params, param));
+    return dst;
+}
+
+int BytecodeCompiler::unary(BytecodeOp op, Expr *a)
+{
+    int ra = compile(a);
+    release(ra);
+    int dst = temporary();
+    emit(op, dst, ra);
+    return dst;
+}
+
+int BytecodeCompiler::binary(BytecodeOp op, Expr *a, Expr *b)
+{
+    int ra = compile(a);
+    int rb = compile(b);
+    release(ra);
+    release(rb);
+    int dst = temporary();
+    emit(op, dst, ra, rb);
+    return dst;
+}
+
+int BytecodeCompiler::call(float (*function)(float *), Expr **args, int count)
+{
+    int regs[3] = {0, 0, 0};
+    for (int i = 0; i < count; i++)
+        regs[i] = compile(args[i]);
+    for (int i = 0; i < count; i++)
+        release(regs[i]);
+    int dst = temporary();
+    emit(BC_CALL, dst, regs[0], regs[1], regs[2], index(_program.functions, function));
+    return dst;
+}
+
+int BytecodeCompiler::branch(BytecodeOp op, Expr *a, Expr *b, Expr *then_expr, Expr *else_expr)
+{
+    int ra = compile(a);
+    int rb = nullptr == b ? 0 : compile(b);
+    release(ra);
+    release(rb);
+    int dst = temporary();
+    std::size_t test = emit(op, dst, ra, rb);
+
+    int value = compile(then_expr);
+    release(value);
+    emit(BC_MOV, dst, value);
+    std::size_t jump = emit(BC_JUMP);
+
+    if (!_failed)
+        _program.code[test].c = static_cast<uint16_t>(_program.code.size());
+    value = compile(else_expr);
+    release(value);
+    emit(BC_MOV, dst, value);
+    if (!_failed)
+        _program.code[jump].c = static_cast<uint16_t>(_program.code.size());
+    return dst;
+}
+
+int BytecodeCompiler::assign(BytecodeOp op, Param *lhs, Expr *rhs)
+{
+    int value = compile(rhs);
+    emit(op, 0, index(_program.params, lhs), value);
+    return value;
+}
+
+std::size_t BytecodeCompiler::emit(BytecodeOp op, int dst, int a, int b, int c, int d)
+{
+    // one more for the final BC_RETURN, so branch targets stay below MAX_INSTRUCTIONS
+    if (_program.code.size() + 1 >= BytecodeProgram::MAX_INSTRUCTIONS)
+    {
+        _failed = true;
+        return 0;
+    }
+    BytecodeInstruction instruction;
+    instruction.handler = nullptr;
+    instruction.op = op;
+    instruction.dst = static_cast<uint16_t>(dst);
+    instruction.a = static_cast<uint16_t>(a);
+    instruction.b = static_cast<uint16_t>(b);
+    instruction.c = static_cast<uint16_t>(c);
+    instruction.d = static_cast<uint16_t>(d);
+    _program.code.push_back(instruction);
+    return _program.code.size() - 1;
+}
+
+
+void BytecodeProgram::finish()
+{
+#if EXPR_BYTECODE_THREADED
+    const void *const *table;
+    execute(*this, 0, 0, &table);
+    for (auto &instruction : code)
+        instruction.handler = table[instruction.op];
+#endif
+}
+
+float BytecodeProgram::run(int mesh_i, int mesh_j)
+{
+    return execute(*this, mesh_i, mesh_j, nullptr);
+}
+
+#if EXPR_BYTECODE_THREADED
+#define VM_OP(op) L_##op:
+#define VM_DISPATCH() goto *pc->handler
+#define VM_BEGIN() VM_DISPATCH();
+#define VM_END()
+#else
+#define VM_OP(op) case op:
+#define VM_DISPATCH() continue
+#define VM_BEGIN() for (;;) { switch (pc->op) {
+#define VM_END() default: return 0.0f; } }
+#endif
+#define VM_NEXT() { ++pc; VM_DISPATCH(); }
+
+float BytecodeProgram::execute(BytecodeProgram &program, int mesh_i, int mesh_j, const void *const **table)
+{
+#if EXPR_BYTECODE_THREADED
+    // in the order of BytecodeOp
+    static const void *const handlers[BC_OP_COUNT] = {
+        &&L_BC_MOV, &&L_BC_LOAD, &&L_BC_LOAD_PARAM, &&L_BC_EVAL, &&L_BC_ADD, &&L_BC_SUB, &&L_BC_MUL,
+        &&L_BC_DIV, &&L_BC_MOD, &&L_BC_OR, &&L_BC_AND, &&L_BC_MUL_ADD, &&L_BC_SIN, &&L_BC_COS, &&L_BC_LOG,
+        &&L_BC_CALL, &&L_BC_IF_ABOVE, &&L_BC_IF_EQUAL, &&L_BC_IF, &&L_BC_JUMP, &&L_BC_SET, &&L_BC_SET_MATRIX,
+        &&L_BC_RETURN
+    };
+    if (nullptr != table)
+    {
+        *table = handlers;
+        return 0.0f;
+    }
+#endif
+
+    float *const r = program.registers.data();
+    float *const *const pointers = program.pointers.data();
+    Param *const *const params = program.params.data();
+    Expr *const *const exprs = program.exprs.data();
+    float (*const *const functions)(float *) = program.functions.data();
+    const BytecodeInstruction *const code = program.code.data();
+    const BytecodeInstruction *pc = code;
+
+    VM_BEGIN()
+
+    VM_OP(BC_MOV)
+        r[pc->dst] = r[pc->a];
+        VM_NEXT()
+    VM_OP(BC_LOAD)
+        r[pc->dst] = *pointers[pc->a];
+        VM_NEXT()
+    VM_OP(BC_LOAD_PARAM)
+        r[pc->dst] = params[pc->a]->eval(mesh_i, mesh_j);
+        VM_NEXT()
+    VM_OP(BC_EVAL)
+        r[pc->dst] = exprs[pc->a]->eval(mesh_i, mesh_j);
+        VM_NEXT()
+    VM_OP(BC_ADD)
+        r[pc->dst] = r[pc->a] + r[pc->b];
+        VM_NEXT()
+    VM_OP(BC_SUB)
+        r[pc->dst] = r[pc->a] - r[pc->b];
+        VM_NEXT()
+    VM_OP(BC_MUL)
+        r[pc->dst] = r[pc->a] * r[pc->b];
+        VM_NEXT()
+    VM_OP(BC_DIV)
+    {
+        const float divisor = r[pc->b];
+        r[pc->dst] = divisor == 0 ? (float) MAX_DOUBLE_SIZE : r[pc->a] / divisor;
+        VM_NEXT()
+    }
+    VM_OP(BC_MOD)
+    {
+        const int l = (int) r[pc->a];
+        const int m = (int) r[pc->b];
+        // x % -1 is always 0, but INT_MIN % -1 traps on x86
+        r[pc->dst] = (m == 0 || m == -1) ? 0 : l % m;
+        VM_NEXT()
+    }
+    VM_OP(BC_OR)
+        r[pc->dst] = (int) r[pc->a] | (int) r[pc->b];
+        VM_NEXT()
+    VM_OP(BC_AND)
+        r[pc->dst] = (int) r[pc->a] & (int) r[pc->b];
+        VM_NEXT()
+    VM_OP(BC_MUL_ADD)
+        r[pc->dst] = r[pc->a] * r[pc->b] + r[pc->c];
+        VM_NEXT()
+    VM_OP(BC_SIN)
+        r[pc->dst] = sinf(r[pc->a]);
+        VM_NEXT()
+    VM_OP(BC_COS)
+        r[pc->dst] = cosf(r[pc->a]);
+        VM_NEXT()
+    VM_OP(BC_LOG)
+        r[pc->dst] = logf(r[pc->a]);
+        VM_NEXT()
+    VM_OP(BC_CALL)
+    {
+        float args[3] = {r[pc->a], r[pc->b], r[pc->c]};
+        r[pc->dst] = functions[pc->d](args);
+        VM_NEXT()
+    }
+    VM_OP(BC_IF_ABOVE)
+        pc = r[pc->a] > r[pc->b] ? pc + 1 : code + pc->c;
+        VM_DISPATCH();
+    VM_OP(BC_IF_EQUAL)
+        pc = r[pc->a] == r[pc->b] ? pc + 1 : code + pc->c;
+        VM_DISPATCH();
+    VM_OP(BC_IF)
+        pc = r[pc->a] != 0 ? pc + 1 : code + pc->c;
+        VM_DISPATCH();
+    VM_OP(BC_JUMP)
+        pc = code + pc->c;
+        VM_DISPATCH();
+    VM_OP(BC_SET)
+        params[pc->a]->set(r[pc->b]);
+        VM_NEXT()
+    VM_OP(BC_SET_MATRIX)
+        params[pc->a]->set_matrix(mesh_i, mesh_j, r[pc->b]);
+        VM_NEXT()
+    VM_OP(BC_RETURN)
+        return r[pc->a];
+
+    VM_END()
+}
+
+#undef VM_OP
+#undef VM_DISPATCH
+#undef VM_BEGIN
+#undef VM_END
+#undef VM_NEXT
+
+void BytecodeProgram::run_lanes(const ExprLanes &lanes, float *out)
+{
+    LaneRegister r[MAX_REGISTERS];
+    for (uint16_t reg : constants)
+    {
+        const float value = registers[reg];
+        for (int k = 0; k < lanes.count; k++)
+            r[reg][k] = value;
+    }
+    execute_lanes(code.data(), code.data() + code.size(), lanes, r, out);
+}
+
+/* Batches only need a handful of dispatches per point, so this one simply switches over the opcode */
+void BytecodeProgram::execute_lanes(const BytecodeInstruction *pc, const BytecodeInstruction *end,
+                                    const ExprLanes &lanes, LaneRegister *r, float *out)
+{
+    const int count = lanes.count;
+    const BytecodeInstruction *const base = code.data();
+
+    while (pc < end)
+    {
+        float *const dst = r[pc->dst];
+        const float *const a = r[pc->a];
+        const float *const b = r[pc->b];
+        bool cond[ExprLanes::MAX_LANES];
+
+        switch (pc->op)
+        {
+            case BC_MOV:
+                std::memcpy(dst, a, count * sizeof(float));
+                break;
+            case BC_LOAD:
+            {
+                Param *param = pc->b == NO_PARAM ? nullptr : params[pc->b];
+                if (nullptr != param && param->lane_slot >= 0)
+                {
+                    param->eval_lanes(lanes, dst);
+                    break;
+                }
+                const float value = *pointers[pc->a];
+                for (int k = 0; k < count; k++)
+                    dst[k] = value;
+                break;
+            }
+            case BC_LOAD_PARAM:
+                params[pc->a]->eval_lanes(lanes, dst);
+                break;
+            case BC_EVAL:
+                exprs[pc->a]->eval_lanes(lanes, dst);
+                break;
+            case BC_ADD:
+                for (int k = 0; k < count; k++)
+                    dst[k] = a[k] + b[k];
+                break;
+            case BC_SUB:
+                for (int k = 0; k < count; k++)
+                    dst[k] = a[k] - b[k];
+                break;
+            case BC_MUL:
+                for (int k = 0; k < count; k++)
+                    dst[k] = a[k] * b[k];
+                break;
+            case BC_DIV:
+                for (int k = 0; k < count; k++)
+                    dst[k] = b[k] == 0 ? (float) MAX_DOUBLE_SIZE : a[k] / b[k];
+                break;
+            case BC_MOD:
+                for (int k = 0; k < count; k++)
+                {
+                    const int l = (int) a[k];
+                    const int m = (int) b[k];
+                    dst[k] = (m == 0 || m == -1) ? 0 : l % m;
+                }
+                break;
+            case BC_OR:
+                for (int k = 0; k < count; k++)
+                    dst[k] = (int) a[k] | (int) b[k];
+                break;
+            case BC_AND:
+                for (int k = 0; k < count; k++)
+                    dst[k] = (int) a[k] & (int) b[k];
+                break;
+            case BC_MUL_ADD:
+            {
+                const float *const c = r[pc->c];
+                for (int k = 0; k < count; k++)
+                    dst[k] = a[k] * b[k] + c[k];
+                break;
+            }
+            case BC_SIN:
+                for (int k = 0; k < count; k++)
+                    dst[k] = sinf(a[k]);
+                break;
+            case BC_COS:
+                for (int k = 0; k < count; k++)
+                    dst[k] = cosf(a[k]);
+                break;
+            case BC_LOG:
+                for (int k = 0; k < count; k++)
+                    dst[k] = logf(a[k]);
+                break;
+            case BC_CALL:
+            {
+                const float *const c = r[pc->c];
+                float (*function)(float *) = functions[pc->d];
+                for (int k = 0; k < count; k++)
+                {
+                    float args[3] = {a[k], b[k], c[k]};
+                    dst[k] = function(args);
+                }
+                break;
+            }
+            case BC_IF_ABOVE:
+            case BC_IF_EQUAL:
+            case BC_IF:
+            {
+                int taken = 0;
+                for (int k = 0; k < count; k++)
+                {
+                    cond[k] = pc->op == BC_IF_ABOVE ? a[k] > b[k] : pc->op == BC_IF_EQUAL ? a[k] == b[k] : a[k] != 0;
+                    taken += cond[k];
+                }
+                const BytecodeInstruction *else_begin = base + pc->c;
+                if (taken == count)
+                    break;
+                if (taken == 0)
+                {
+                    pc = else_begin;
+                    continue;
+                }
+
+                // mixed batch, run both branches. Programs with side effects are never batched, see prepare_lanes().
+                const BytecodeInstruction *join = base + (else_begin - 1)->c;
+                float then_value[ExprLanes::MAX_LANES];
+                execute_lanes(pc + 1, else_begin - 1, lanes, r, out);
+                std::memcpy(then_value, dst, count * sizeof(float));
+                execute_lanes(else_begin, join, lanes, r, out);
+                for (int k = 0; k < count; k++)
+                    dst[k] = cond[k] ? then_value[k] : dst[k];
+                pc = join;
+                continue;
+            }
+            case BC_JUMP:
+                pc = base + pc->c;
+                continue;
+            case BC_SET:
+                for (int k = 0; k < count; k++)
+                    params[pc->a]->set(b[k]);
+                break;
+            case BC_SET_MATRIX:
+                params[pc->a]->set_matrix_lanes(lanes, b);
+                break;
+            case BC_RETURN:
+                std::memcpy(out, a, count * sizeof(float));
+                return;
+            default:
+                break;
+        }
+        ++pc;
+    }
+}
+
+std::ostream &BytecodeProgram::to_string(std::ostream &out) const
+{
+    for (std::size_t i = 0; i < code.size(); i++)
+    {
+        const BytecodeInstruction &instruction = code[i];
+        out << i << ": " << opNames[instruction.op] << " r" << instruction.dst << " " << instruction.a << " "
+            << instruction.b << " " << instruction.c << " " << instruction.d << std::endl;
+    }
+    return out;
+}
+
+
+// TESTS
+
+#include <TestRunner.hpp>
+
+#ifndef NDEBUG
+
+#include "BuiltinFuncs.hpp"
+#include "Eval.hpp"
+#include "MilkdropPreset.hpp"
+#include "PCM.hpp"
+#include "Renderer/PipelineContext.hpp"
+#include "PresetLoader.hpp"
+#include "RandomNumberGenerators.hpp"
+#include "Renderer/BeatDetect.hpp"
+#include "Renderer/MeshBuffer.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+#define TEST(cond) if (!verify(#cond,cond)) return false
+
+struct ExprBytecodeTest : public Test
+{
+    ExprBytecodeTest() : Test("ExprBytecodeTest")
+    {}
+
+    Expr *call(const char *function, Expr *a, Expr *b=nullptr, Expr *c=nullptr)
+    {
+        Func *fn = BuiltinFuncs::find_func(function);
+        Expr **expr_list = (Expr **)malloc(3 * sizeof(Expr *));
+        expr_list[0] = a;
+        expr_list[1] = b;
+        expr_list[2] = c;
+        return Expr::prefun_to_expr(fn, expr_list);
+    }
+
+    Expr *assign(Param *lhs, Expr *rhs)
+    {
+        return Expr::create_matrix_assignment(lhs, Expr::optimize(rhs));
+    }
+
+    // the bytecode has to give exactly the results of the tree, point by point and in batches
+    bool same_results()
+    {
+        BuiltinFuncs::init_builtin_func_db();
+        const int gx = 2 * ExprLanes::MAX_LANES + 5, gy = 3;
+
+        float x_value = 0, zoom_value = 0.9f;
+        MeshBuffer mesh;
+        mesh.allocate(gx, gy, 2);
+        MeshPlane x_matrix = mesh.plane(0), zoom_matrix = mesh.plane(1);
+        float *zoom_begin = zoom_matrix.data(), *zoom_end = zoom_begin + mesh.planeSize();
+        for (int j = 0; j < gy; j++)
+            for (int i = 0; i < gx; i++)
+                x_matrix(i, j) = (float)(j * gx + i) / (gx - 1) - 0.75f;
+        Param *x = Param::new_param_float("x", P_FLAG_PER_PIXEL | P_FLAG_ALWAYS_MATRIX | P_FLAG_READONLY, &x_value,
+                                          &x_matrix, MAX_DOUBLE_SIZE, -MAX_DOUBLE_SIZE, 0);
+        Param *zoom = Param::new_param_float("zoom", P_FLAG_PER_PIXEL, &zoom_value, &zoom_matrix,
+                                             MAX_DOUBLE_SIZE, 0, 1);
+        Param *t = Param::createUser("t");
+        Param *u = Param::createUser("u");
+
+        std::vector<Expr *> steps;
+        // t = sin(x*3)*0.5 + x
+        steps.push_back(assign(t, TreeExpr::create(Eval::infix_add,
+            TreeExpr::create(Eval::infix_mult, call("sin", TreeExpr::create(Eval::infix_mult, x, Expr::const_to_expr(3))),
+                Expr::const_to_expr(0.5f)), x)));
+        // zoom = if(above(t,0.2), zoom*t, cos(t)/(x-0.25))
+        steps.push_back(assign(zoom, call("if", call("above", t, Expr::const_to_expr(0.2f)),
+            TreeExpr::create(Eval::infix_mult, zoom, t),
+            TreeExpr::create(Eval::infix_div, call("cos", t),
+                TreeExpr::create(Eval::infix_minus, x, Expr::const_to_expr(0.25f))))));
+        // u = zoom*2 + (x*7 % 3) + min(x, t)/(x-x)
+        steps.push_back(assign(u, TreeExpr::create(Eval::infix_add,
+            TreeExpr::create(Eval::infix_add,
+                TreeExpr::create(Eval::infix_mult, zoom, Expr::const_to_expr(2)),
+                TreeExpr::create(Eval::infix_mod, TreeExpr::create(Eval::infix_mult, x, Expr::const_to_expr(7)),
+                    Expr::const_to_expr(3))),
+            TreeExpr::create(Eval::infix_div, call("min", x, t), TreeExpr::create(Eval::infix_minus, x, x)))));
+        // zoom = zoom - u*0.25
+        steps.push_back(assign(zoom, TreeExpr::create(Eval::infix_minus, zoom,
+            TreeExpr::create(Eval::infix_mult, u, Expr::const_to_expr(0.25f)))));
+        Expr *program = Expr::create_program_expr(steps, true);
+
+        std::fill(zoom_begin, zoom_end, zoom_value);
+        for (int j = 0; j < gy; j++)
+            for (int i = 0; i < gx; i++)
+                program->eval(i, j);
+        std::vector<float> expected(zoom_begin, zoom_end);
+        float expected_u = u->eval(-1, -1);
+
+        Expr *compiled = Expr::compile_bytecode(program);
+        TEST(nullptr != compiled);
+        TEST(compiled->clazz == BYTECODE);
+
+        std::fill(zoom_begin, zoom_end, zoom_value);
+        u->set_param(0.0f);
+        for (int j = 0; j < gy; j++)
+            for (int i = 0; i < gx; i++)
+                compiled->eval(i, j);
+        TEST(0 == memcmp(expected.data(), zoom_begin, expected.size() * sizeof(float)));
+        TEST(expected_u == u->eval(-1, -1));
+
+        int slots = Expr::prepare_lanes(program);
+        TEST(2 == slots);
+        std::vector<float> locals(slots * ExprLanes::MAX_LANES);
+        float result[ExprLanes::MAX_LANES];
+        ExprLanes lanes;
+        lanes.locals = locals.data();
+        std::fill(zoom_begin, zoom_end, zoom_value);
+        u->set_param(0.0f);
+        for (int j = 0; j < gy; j++)
+        {
+            lanes.mesh_j = j;
+            for (int i = 0; i < gx; i += ExprLanes::MAX_LANES)
+            {
+                lanes.mesh_i = i;
+                lanes.count = std::min(gx - i, (int)ExprLanes::MAX_LANES);
+                lanes.write_back = j == gy - 1 && i + lanes.count == gx;
+                compiled->eval_lanes(lanes, result);
+            }
+        }
+        TEST(0 == memcmp(expected.data(), zoom_begin, expected.size() * sizeof(float)));
+        TEST(expected_u == u->eval(-1, -1));
+        Expr::delete_expr(compiled);
+
+        delete x;
+        delete zoom;
+        delete t;
+        delete u;
+        return true;
+    }
+
+    struct Run
+    {
+        double per_pixel_seconds = 0;
+        double per_point_seconds = 0;
+        std::vector<std::vector<float>> outputs;
+    };
+
+    // compares bit patterns, so NaN equals NaN
+    static bool identical(const std::vector<std::vector<float>> &a, const std::vector<std::vector<float>> &b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (std::size_t i = 0; i < a.size(); i++)
+        {
+            if (a[i].size() != b[i].size() || 0 != memcmp(a[i].data(), b[i].data(), a[i].size() * sizeof(float)))
+                return false;
+        }
+        return true;
+    }
+
+    // within a relative tolerance, for the JIT whose rounding differs; NaN and infinities must match
+    static bool close(const std::vector<std::vector<float>> &a, const std::vector<std::vector<float>> &b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (std::size_t i = 0; i < a.size(); i++)
+        {
+            if (a[i].size() != b[i].size())
+                return false;
+            for (std::size_t k = 0; k < a[i].size(); k++)
+            {
+                const float x = a[i][k], y = b[i][k];
+                if (std::isfinite(x) && std::isfinite(y) ? std::abs(x - y) > 1e-3f * (1 + std::abs(x) + std::abs(y))
+                                                         : memcmp(&x, &y, sizeof(float)) != 0)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // Renders a preset with the selected engine, keeping the per pixel meshes and the custom wave points
+    bool render(const std::string &url, const std::string &presetName, PresetLoader &loader, Run &run)
+    {
+        const int frames = 10;
+        RandomNumberGenerators::seed(1);
+        std::unique_ptr<Preset> preset;
+        try {
+            preset = loader.loadPreset(url, presetName);
+        } catch (...) {
+            return false;
+        }
+        auto milkdropPreset = dynamic_cast<MilkdropPreset *>(preset.get());
+        if (nullptr == milkdropPreset)
+            return false;
+        milkdropPreset->waitForCompiledPrograms();
+
+        PCM pcm;
+        BeatDetect beatDetect(&pcm);
+        PipelineContext context;
+        context.fps = 60;
+        float samples[512];
+        for (int frame = 0; frame <= frames; frame++)
+        {
+            for (int i = 0; i < 512; i++)
+                samples[i] = 0.5f * sinf((frame * 512 + i) * 0.05f);
+            pcm.addPCMfloat(samples, 512);
+            pcm.drainQueue();
+            beatDetect.detectFromSamples();
+            context.time = frame / 60.0f;
+            context.frame = frame;
+
+            // the first frame installs the compiled programs
+            auto begin = std::chrono::steady_clock::now();
+            milkdropPreset->Render(beatDetect, context);
+            auto end = std::chrono::steady_clock::now();
+            if (frame > 0)
+                run.per_pixel_seconds += std::chrono::duration<double>(end - begin).count();
+
+            for (CustomWave *wave : milkdropPreset->customWaves)
+            {
+                if (wave->per_point_eqn_tree.empty())
+                    continue;
+                WaveformContext waveContext(wave->samples, &beatDetect);
+                std::vector<float> points;
+                begin = std::chrono::steady_clock::now();
+                for (int i = 0; i < wave->samples; i++)
+                {
+                    waveContext.sample = i / (float)(wave->samples - 1);
+                    waveContext.sample_int = i;
+                    waveContext.left = samples[i % 512];
+                    waveContext.right = -samples[i % 512];
+                    ColoredPoint p = wave->PerPoint(ColoredPoint(), waveContext);
+                    points.insert(points.end(), {p.x, p.y, p.r, p.g, p.b, p.a});
+                }
+                end = std::chrono::steady_clock::now();
+                if (frame > 0)
+                    run.per_point_seconds += std::chrono::duration<double>(end - begin).count();
+                run.outputs.push_back(points);
+            }
+        }
+
+        const PresetOutputs &outputs = milkdropPreset->presetOutputs();
+        for (const MeshPlane *plane : {&outputs.zoom_mesh, &outputs.zoomexp_mesh, &outputs.rot_mesh,
+                                       &outputs.sx_mesh, &outputs.sy_mesh, &outputs.dx_mesh, &outputs.dy_mesh,
+                                       &outputs.cx_mesh, &outputs.cy_mesh, &outputs.warp_mesh})
+        {
+            std::vector<float> values;
+            for (int j = 0; j < 24; j++)
+                values.insert(values.end(), plane->row(j), plane->row(j) + 32);
+            run.outputs.push_back(values);
+        }
+        return true;
+    }
+
+    // Runs the bundled presets with every engine, compares the results with the tree and reports the times
+    bool benchmark()
+    {
+        const char *dir = getenv("PROJECTM_TEST_PRESET_DIR");
+        PresetLoader loader(32, 24, dir ? dir : "presets");
+        if (0 == loader.size())
+        {
+            std::cout << "ExprBytecodeTest: no presets found, skipping benchmark" << std::endl;
+            return true;
+        }
+
+        const ExprEngine selected = Expr::engine();
+        std::vector<ExprEngine> engines = {EXPR_ENGINE_TREE, EXPR_ENGINE_BYTECODE};
+#if HAVE_LLVM
+        engines.push_back(EXPR_ENGINE_JIT);
+#endif
+        std::vector<Run> totals(engines.size());
+        int presets = 0;
+        bool same = true;
+        int jitDiffers = 0;
+        const PresetIndex step = std::max<PresetIndex>(1, loader.size() / 200);
+        for (PresetIndex i = 0; i < loader.size(); i += step)
+        {
+            std::vector<Run> runs(engines.size());
+            bool loaded = true;
+            for (std::size_t e = 0; e < engines.size() && loaded; e++)
+            {
+                Expr::set_engine(engines[e]);
+                loaded = render(loader.getPresetURL(i), loader.getPresetName(i), loader, runs[e]);
+            }
+            if (!loaded)
+                continue;
+
+            presets++;
+            for (std::size_t e = 0; e < engines.size(); e++)
+            {
+                totals[e].per_pixel_seconds += runs[e].per_pixel_seconds;
+                totals[e].per_point_seconds += runs[e].per_point_seconds;
+                if (engines[e] == EXPR_ENGINE_BYTECODE && !identical(runs[e].outputs, runs[0].outputs))
+                {
+                    std::cout << "ExprBytecodeTest: bytecode differs from the tree in " << loader.getPresetName(i)
+                              << std::endl;
+                    same = false;
+                }
+                // the JIT may contract multiplications and additions, so it only has to come close
+                if (engines[e] == EXPR_ENGINE_JIT && !close(runs[e].outputs, runs[0].outputs))
+                {
+                    std::cout << "ExprBytecodeTest: jit differs from the tree in " << loader.getPresetName(i)
+                              << std::endl;
+                    jitDiffers++;
+                }
+            }
+        }
+        Expr::set_engine(selected);
+
+        const char *names[] = {"tree", "bytecode", "jit"};
+        for (std::size_t e = 0; e < engines.size(); e++)
+            std::cout << "ExprBytecodeTest: " << names[engines[e]] << " " << presets << " presets, 10 frames: "
+                      << totals[e].per_pixel_seconds * 1000 << " ms frames, " << totals[e].per_point_seconds * 1000
+                      << " ms custom wave points" << std::endl;
+#if HAVE_LLVM
+        std::cout << "ExprBytecodeTest: jit differs from the tree in " << jitDiffers << " of " << presets << " presets"
+                  << std::endl;
+#else
+        std::cout << "ExprBytecodeTest: jit not built" << std::endl;
+#endif
+        TEST(same);
+        // a few presets amplify the rounding, e.g. sin(1e7*y) or sector%4, but a wrong JIT differs in many
+        TEST(jitDiffers * 20 <= presets);
+        return true;
+    }
+
+    bool test() override
+    {
+        Eval::init_infix_ops();
+        bool result = true;
+        result &= same_results();
+        result &= benchmark();
+        return result;
+    }
+};
+
+Test* BytecodeProgram::test()
+{
+    return new ExprBytecodeTest();
+}
+
+#else
+
+Test* BytecodeProgram::test()
+{
+    return nullptr;
+}
+
+#endif
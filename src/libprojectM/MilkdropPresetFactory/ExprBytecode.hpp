@@ -0,0 +1,155 @@
+#ifndef EXPR_BYTECODE_HPP
+#define EXPR_BYTECODE_HPP
+
+#include "Expr.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+class Param;
+class Test;
+
+/// Register machine evaluating compiled expressions, the engine between the tree walk and the LLVM JIT.
+///
+/// Expr::compile_bytecode() translates a tree into a flat array of instructions, each node becoming at
+/// most one instruction that reads and writes numbered float registers. Constants get registers of their
+/// own that are filled in once. Parameters, functions and nodes without instructions of their own are
+/// referenced through tables, so the code itself holds no pointers.
+///
+/// The same code runs point by point with run() and for a batch of points with run_lanes(), where every
+/// register holds one value per point of the batch. With GCC and Clang run() dispatches through the
+/// handler address stored in each instruction (direct threading), otherwise both use a switch.
+
+#if defined(__GNUC__) || defined(__clang__)
+#define EXPR_BYTECODE_THREADED 1
+#else
+#define EXPR_BYTECODE_THREADED 0
+#endif
+
+/// Operands are register numbers unless noted otherwise
+enum BytecodeOp : uint16_t
+{
+    BC_MOV,         //!< dst = a
+    BC_LOAD,        //!< dst = *pointers[a]. Reads the local slot of params[b] in batches if it has one.
+    BC_LOAD_PARAM,  //!< dst = params[a]
+    BC_EVAL,        //!< dst = exprs[a]->eval(), for nodes without instructions of their own
+    BC_ADD,         //!< dst = a + b
+    BC_SUB,         //!< dst = a - b
+    BC_MUL,         //!< dst = a * b
+    BC_DIV,         //!< dst = a / b, MAX_DOUBLE_SIZE for b == 0
+    BC_MOD,         //!< dst = (int) a % (int) b, 0 for b == 0
+    BC_OR,          //!< dst = (int) a | (int) b
+    BC_AND,         //!< dst = (int) a & (int) b
+    BC_MUL_ADD,     //!< dst = a * b + c
+    BC_SIN,         //!< dst = sinf(a)
+    BC_COS,         //!< dst = cosf(a)
+    BC_LOG,         //!< dst = logf(a)
+    BC_CALL,        //!< dst = functions[d]({a, b, c})
+    BC_IF_ABOVE,    //!< runs the following then branch if a > b, else jumps to instruction c. See below.
+    BC_IF_EQUAL,    //!< the same for a == b
+    BC_IF,          //!< the same for a != 0
+    BC_JUMP,        //!< continues at instruction c
+    BC_SET,         //!< params[a]->set(b)
+    BC_SET_MATRIX,  //!< params[a]->set_matrix(b) at the current point
+    BC_RETURN,      //!< ends the program, its value is a
+    BC_OP_COUNT
+};
+
+/// Both branches of an if write their value to the dst register of the BC_IF_* instruction. The then branch
+/// ends with a BC_JUMP past the else branch, which starts at instruction c. A batch whose points disagree
+/// on the condition runs both branches and picks each point's value.
+struct BytecodeInstruction
+{
+    const void *handler; /* interpreter code for op, set by BytecodeProgram::finish() when threaded */
+    uint16_t op;
+    uint16_t dst;
+    uint16_t a;
+    uint16_t b;
+    uint16_t c;
+    uint16_t d;
+};
+
+class BytecodeProgram
+{
+public:
+    static const int MAX_REGISTERS = 256;
+    static const std::size_t MAX_INSTRUCTIONS = 65535;
+    static const uint16_t NO_PARAM = 0xffff;
+
+    std::vector<BytecodeInstruction> code;
+    std::vector<float> registers; /* constants, followed by temporaries */
+    std::vector<uint16_t> constants; /* registers holding constants */
+    std::vector<float *> pointers;
+    std::vector<Param *> params;
+    std::vector<Expr *> exprs;
+    std::vector<float (*)(float *)> functions;
+
+    /// Prepares the code for running, after the last instruction has been added
+    void finish();
+
+    /// Runs the program for one point. Not reentrant, the temporaries live in the program.
+    float run(int mesh_i, int mesh_j);
+    /// Runs the program for a batch of points, see Expr::eval_lanes()
+    void run_lanes(const ExprLanes &lanes, float *out);
+
+    std::ostream &to_string(std::ostream &out) const;
+
+    static Test *test();
+
+private:
+    typedef float LaneRegister[ExprLanes::MAX_LANES];
+
+    /// Interpreter loop of run(). Called with table != nullptr it only returns its handler addresses.
+    static float execute(BytecodeProgram &program, int mesh_i, int mesh_j, const void *const **table);
+    void execute_lanes(const BytecodeInstruction *pc, const BytecodeInstruction *end, const ExprLanes &lanes,
+                       LaneRegister *r, float *out);
+};
+
+/// Builds a BytecodeProgram from an expression tree, see Expr::_bytecode()
+class BytecodeCompiler
+{
+public:
+    explicit BytecodeCompiler(BytecodeProgram &program);
+
+    /// Emits the code for expr, returns the register holding its value. The caller has to release() it.
+    int compile(Expr *expr);
+    /// The code of a node without instructions of its own, calls its eval()
+    int fallback(Expr *expr);
+
+    int constant(float value);
+    int temporary();
+    /// Frees a register returned by compile() once its value has been used. Constants stay allocated.
+    void release(int reg);
+
+    /// Loads a float, taking the batched local value of param if it has one. param may be null.
+    int load(float *pointer, Param *param);
+    int load_param(Param *param);
+
+    int unary(BytecodeOp op, Expr *a);
+    int binary(BytecodeOp op, Expr *a, Expr *b);
+    int call(float (*function)(float *), Expr **args, int count);
+    /// An if, a and b are the operands of the condition, b is null for BC_IF
+    int branch(BytecodeOp op, Expr *a, Expr *b, Expr *then_expr, Expr *else_expr);
+    /// Stores the value of rhs in lhs with BC_SET or BC_SET_MATRIX, returns the register holding it
+    int assign(BytecodeOp op, Param *lhs, Expr *rhs);
+
+    std::size_t emit(BytecodeOp op, int dst = 0, int a = 0, int b = 0, int c = 0, int d = 0);
+
+    /// True if the program ran out of registers or instructions
+    bool failed() const { return _failed; }
+
+private:
+    BytecodeProgram &_program;
+    std::map<uint32_t, int> _constants; /* by bit pattern, so 0 and -0 stay apart */
+    std::vector<bool> _temporary;
+    std::vector<int> _free;
+    bool _failed;
+
+    int allocate();
+    template<typename T>
+    int index(std::vector<T> &table, T entry);
+};
+
+#endif
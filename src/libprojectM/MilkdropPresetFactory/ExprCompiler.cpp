@@ -0,0 +1,273 @@
+#include "ExprCompiler.hpp"
+
+#include "Expr.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+ExprProgram::~ExprProgram()
+{
+    set(nullptr);
+}
+
+void ExprProgram::set(Expr *tree)
+{
+    Expr::delete_expr(_compiled);
+    _compiled = nullptr;
+    Expr::delete_expr(_tree);
+    _tree = tree;
+}
+
+void ExprProgram::install(Expr *compiled)
+{
+    Expr::delete_expr(_compiled);
+    _compiled = compiled;
+}
+
+
+ExprCompileJob::~ExprCompileJob()
+{
+    for (Expr *compiled : _compiled)
+        Expr::delete_expr(compiled);
+}
+
+void ExprCompileJob::install()
+{
+    for (std::size_t i = 0; i < _compiled.size(); i++)
+    {
+        if (nullptr != _compiled[i])
+            _programs[i]->install(_compiled[i]);
+        _compiled[i] = nullptr;
+    }
+}
+
+
+ExprCompiler::ExprCompiler()
+{
+#if USE_THREADS
+    _worker = std::thread(&ExprCompiler::workerLoop, this);
+#endif
+}
+
+ExprCompiler::~ExprCompiler()
+{
+#if USE_THREADS
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+        _queue.clear();
+    }
+    _condition.notify_all();
+    _worker.join();
+#endif
+}
+
+ExprCompiler &ExprCompiler::instance()
+{
+    static ExprCompiler compiler;
+    return compiler;
+}
+
+std::shared_ptr<ExprCompileJob> ExprCompiler::submit(const std::vector<ExprProgram *> &programs,
+                                                     const std::string &name)
+{
+    if (Expr::engine() == EXPR_ENGINE_TREE || programs.empty())
+        return nullptr;
+
+    auto job = std::make_shared<ExprCompileJob>();
+    job->_name = name;
+    job->_programs = programs;
+
+#if USE_THREADS
+    ExprCompiler &compiler = instance();
+    {
+        std::lock_guard<std::mutex> lock(compiler._mutex);
+        compiler._queue.push_back(job);
+    }
+    compiler._condition.notify_all();
+#else
+    compile(*job);
+#endif
+    return job;
+}
+
+void ExprCompiler::cancel(const std::shared_ptr<ExprCompileJob> &job)
+{
+    if (!job)
+        return;
+
+#if USE_THREADS
+    ExprCompiler &compiler = instance();
+    {
+        std::unique_lock<std::mutex> lock(compiler._mutex);
+        compiler._queue.erase(std::remove(compiler._queue.begin(), compiler._queue.end(), job), compiler._queue.end());
+        compiler._condition.wait(lock, [&compiler, &job] { return compiler._running != job; });
+    }
+#endif
+
+    for (Expr *&compiled : job->_compiled)
+    {
+        Expr::delete_expr(compiled);
+        compiled = nullptr;
+    }
+}
+
+void ExprCompiler::wait(const std::shared_ptr<ExprCompileJob> &job)
+{
+    if (!job)
+        return;
+
+#if USE_THREADS
+    ExprCompiler &compiler = instance();
+    std::unique_lock<std::mutex> lock(compiler._mutex);
+    compiler._condition.wait(lock, [&job] { return job->done(); });
+#endif
+}
+
+void ExprCompiler::compile(ExprCompileJob &job)
+{
+    const auto begin = std::chrono::steady_clock::now();
+
+    std::vector<Expr *> trees;
+    for (ExprProgram *program : job._programs)
+        trees.push_back(program->tree());
+    job._compiled = Expr::compile_module(trees, job._name);
+
+    job._milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    job._done.store(true, std::memory_order_release);
+}
+
+#if USE_THREADS
+void ExprCompiler::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        _condition.wait(lock, [this] { return _stop || !_queue.empty(); });
+
+        if (_stop)
+            return;
+
+        _running = _queue.front();
+        _queue.pop_front();
+        lock.unlock();
+
+        compile(*_running);
+
+        lock.lock();
+        _running.reset();
+        _condition.notify_all();
+    }
+}
+#endif
+
+
+// TESTS
+
+#include <TestRunner.hpp>
+
+#ifndef NDEBUG
+
+#include "BuiltinFuncs.hpp"
+#include "Eval.hpp"
+#include "Param.hpp"
+
+#include <thread>
+
+#define TEST(cond) if (!verify(#cond,cond)) return false
+
+struct ExprCompilerTest : public Test
+{
+    ExprCompilerTest() : Test("ExprCompilerTest")
+    {}
+
+    // t = t*0.5 + u; u = u + 1
+    Expr *program(Param *t, Param *u)
+    {
+        std::vector<Expr *> steps;
+        steps.push_back(Expr::create_assignment(t, TreeExpr::create(Eval::infix_add,
+            TreeExpr::create(Eval::infix_mult, t, Expr::const_to_expr(0.5f)), u)));
+        steps.push_back(Expr::create_assignment(u, TreeExpr::create(Eval::infix_add, u, Expr::const_to_expr(1))));
+        return Expr::create_program_expr(steps, true);
+    }
+
+    // the programs keep running on the tree until the compiled code is installed, which carries on from there
+    bool install()
+    {
+        BuiltinFuncs::init_builtin_func_db();
+        const ExprEngine selected = Expr::engine();
+        Expr::set_engine(EXPR_ENGINE_BYTECODE);
+
+        Param *t = Param::createUser("t");
+        Param *u = Param::createUser("u");
+        ExprProgram a, b;
+        a.set(program(t, u));
+        b.set(program(t, u));
+
+        std::shared_ptr<ExprCompileJob> job = ExprCompiler::submit({&a, &b}, "ExprCompilerTest");
+        TEST(nullptr != job);
+        float expected = 0;
+        for (int frame = 0; frame < 4; frame++)
+        {
+            TEST(a.get() == a.tree());
+            expected = expected * 0.5f + frame;
+            a.get()->eval(-1, -1);
+            TEST(expected == t->eval(-1, -1));
+        }
+
+        ExprCompiler::wait(job);
+        TEST(job->done());
+        TEST(!a.compiled());
+        job->install();
+        TEST(a.compiled() && b.compiled());
+        TEST(a.get() != a.tree());
+        for (int frame = 4; frame < 8; frame++)
+        {
+            expected = expected * 0.5f + frame;
+            a.get()->eval(-1, -1);
+            TEST(expected == t->eval(-1, -1));
+        }
+
+        // a job whose programs go away before it ran
+        ExprProgram c;
+        c.set(program(t, u));
+        job = ExprCompiler::submit({&c}, "ExprCompilerTest");
+        ExprCompiler::cancel(job);
+        job->install();
+        TEST(!c.compiled());
+        job.reset();
+
+        // the tree needs no compilation
+        Expr::set_engine(EXPR_ENGINE_TREE);
+        TEST(nullptr == ExprCompiler::submit({&c}, "ExprCompilerTest"));
+
+        Expr::set_engine(selected);
+        a.set(nullptr);
+        b.set(nullptr);
+        c.set(nullptr);
+        delete t;
+        delete u;
+        return true;
+    }
+
+    bool test() override
+    {
+        Eval::init_infix_ops();
+        return install();
+    }
+};
+
+Test* ExprCompiler::test()
+{
+    return new ExprCompilerTest();
+}
+
+#else
+
+Test* ExprCompiler::test()
+{
+    return nullptr;
+}
+
+#endif
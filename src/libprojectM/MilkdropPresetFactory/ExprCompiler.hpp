@@ -0,0 +1,119 @@
+#ifndef EXPR_COMPILER_HPP
+#define EXPR_COMPILER_HPP
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if USE_THREADS
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
+
+class Expr;
+class Test;
+
+/// One equation block of a preset. It runs on the tree until compiled code for it is installed.
+class ExprProgram
+{
+public:
+    ExprProgram() = default;
+    ExprProgram(const ExprProgram &) = delete;
+    ExprProgram &operator=(const ExprProgram &) = delete;
+
+    /// Deletes the compiled code and the tree
+    ~ExprProgram();
+
+    /// Replaces the program, taking ownership of tree
+    void set(Expr *tree);
+
+    /// Switches to compiled code for the tree, which keeps owning the tree. Only called between frames.
+    void install(Expr *compiled);
+
+    /// The program to evaluate, compiled code once it has been installed
+    Expr *get() const { return nullptr != _compiled ? _compiled : _tree; }
+
+    Expr *tree() const { return _tree; }
+
+    bool compiled() const { return nullptr != _compiled; }
+
+    explicit operator bool() const { return nullptr != _tree; }
+
+private:
+    Expr *_tree{ nullptr };
+    Expr *_compiled{ nullptr };
+};
+
+/// The programs of one preset, compiled together by ExprCompiler
+class ExprCompileJob
+{
+public:
+    ~ExprCompileJob();
+
+    /// True once the compiled code is ready to be installed
+    bool done() const { return _done.load(std::memory_order_acquire); }
+
+    /// Hands the compiled code to the programs, which then run it from their next evaluation on.
+    /// Must be called on the thread evaluating them, after done() returned true.
+    void install();
+
+    /// Milliseconds the compilation took, once done
+    double milliseconds() const { return _milliseconds; }
+
+private:
+    friend class ExprCompiler;
+
+    std::string _name;
+    std::vector<ExprProgram *> _programs;
+    std::vector<Expr *> _compiled;
+    std::atomic<bool> _done{ false };
+    double _milliseconds{ 0 };
+};
+
+/// Compiles preset programs on a background thread with the engine selected by Expr::set_engine(), so
+/// loading a preset never waits for code generation. The presets run on the tree in the meantime.
+///
+/// All programs of a preset are compiled together, which puts them into one module with the LLVM JIT.
+class ExprCompiler
+{
+public:
+    /// Queues the programs for compilation. Their trees must not change until the job is done or cancelled.
+    /// Without thread support the programs are compiled right away.
+    /// \param name names the module of the compiled code
+    /// \returns the job to install from, nullptr if the selected engine is the tree
+    static std::shared_ptr<ExprCompileJob> submit(const std::vector<ExprProgram *> &programs,
+                                                  const std::string &name);
+
+    /// Takes a job off the queue, or waits for it if it is being compiled. Code that was not installed
+    /// is deleted with the job. Must be called before the programs of the job are deleted.
+    static void cancel(const std::shared_ptr<ExprCompileJob> &job);
+
+    /// Blocks until the job is done
+    static void wait(const std::shared_ptr<ExprCompileJob> &job);
+
+    static Test *test();
+
+private:
+    ExprCompiler();
+    ~ExprCompiler();
+
+    static ExprCompiler &instance();
+
+    static void compile(ExprCompileJob &job);
+
+#if USE_THREADS
+    void workerLoop();
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<std::shared_ptr<ExprCompileJob>> _queue;
+    std::shared_ptr<ExprCompileJob> _running;
+    bool _stop{ false };
+    std::thread _worker;
+#endif
+};
+
+#endif
@@ -49,6 +49,8 @@ struct JitContext
     llvm::Value *mesh_i;
     llvm::Value *mesh_j;
     std::map<Param *,Symbol *> symbols;
+    std::map<const void *,llvm::GlobalVariable *> address_symbols;
+    std::vector<std::pair<std::string,const void *> > addresses;
 
 
     JitContext(std::string name="LLVMModule") :
@@ -80,6 +82,29 @@ struct JitContext
 
     // helpers
 
+    // Adds the function float name(int mesh_i, int mesh_j) to the module and starts generating its body.
+    // Loaded symbol values and unfinished ternaries belong to the previous function, so they are forgotten.
+    llvm::Function *StartFunction(const std::string &name)
+    {
+        traverse<TraverseFunctors::Delete<Symbol> >(symbols);
+        symbols.clear();
+        parent.clear();
+        then_block.clear();
+        else_block.clear();
+        merge_block.clear();
+
+        llvm::FunctionCallee functionCallee = module->getOrInsertFunction<llvm::Type*>(name,
+                floatType,
+                llvm::IntegerType::get(context,32),
+                llvm::IntegerType::get(context,32));
+        auto *function = llvm::cast<llvm::Function>(functionCallee.getCallee());
+        llvm::BasicBlock *block = llvm::BasicBlock::Create(context, "EntryBlock", function);
+        builder.SetInsertPoint(block);
+        mesh_i = &function->arg_begin()[0];
+        mesh_j = &function->arg_begin()[1];
+        return function;
+    }
+
     void OptimizePass()
     {
         auto end = module->end();
@@ -97,8 +122,31 @@ struct JitContext
     }
     llvm::Constant *CreateFloatPtr(float *p)
     {
-        llvm::ConstantInt *pv = llvm::ConstantInt::get(llvm::Type::getInt64Ty(context), (uint64_t)p);
-        return llvm::ConstantExpr::getIntToPtr(pv , llvm::PointerType::get(floatType, 1));
+        return llvm::ConstantExpr::getIntToPtr(CreateAddress(p), llvm::PointerType::get(floatType, 1));
+    }
+    // An address in this process as a 64 bit integer. It is taken from an external symbol named by the
+    // order of first use instead of being put into the code, so the object code of a module does not
+    // depend on where things live and can be kept in the JitObjectCache between runs.
+    llvm::Constant *CreateAddress(const void *p)
+    {
+        llvm::GlobalVariable *&symbol = address_symbols[p];
+        if (nullptr == symbol)
+        {
+            std::string name = "projectM_address_" + std::to_string(addresses.size());
+            symbol = new llvm::GlobalVariable(*module, llvm::Type::getInt8Ty(context), false,
+                                              llvm::GlobalValue::ExternalLinkage, nullptr, name);
+            addresses.push_back(std::make_pair(name, p));
+        }
+        return llvm::ConstantExpr::getPtrToInt(symbol, llvm::Type::getInt64Ty(context));
+    }
+    // Resolves the symbols of CreateAddress(), before the engine links the module
+    void MapAddresses(llvm::ExecutionEngine &engine)
+    {
+        std::string prefix;
+        if (char globalPrefix = engine.getDataLayout().getGlobalPrefix())
+            prefix = globalPrefix;
+        for (auto &address : addresses)
+            engine.addGlobalMapping(prefix + address.first, (uint64_t)address.second);
     }
     llvm::Value *CallIntrinsic(llvm::Intrinsic::ID id, llvm::Value *value)
     {
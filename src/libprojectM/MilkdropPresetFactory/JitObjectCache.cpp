@@ -0,0 +1,359 @@
+#include "JitObjectCache.hpp"
+#include "Renderer/ShaderCache.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef WIN32
+#include "dirent.h"
+#include <direct.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <utime.h>
+#endif
+
+namespace {
+
+// start of every entry, followed by the header and the object code
+const char MAGIC[4] = { 'P', 'M', 'J', '1' };
+const char EXTENSION[] = ".jit";
+
+struct Header
+{
+    JitObjectCache::Key key;
+    std::uint64_t size;
+    std::uint64_t checksum;
+    double milliseconds;
+};
+
+struct Entry
+{
+    std::string path;
+    std::size_t size;
+    time_t lastUse;
+
+    bool operator<(const Entry &other) const
+    {
+        return lastUse != other.lastUse ? lastUse < other.lastUse : path < other.path;
+    }
+};
+
+std::uint64_t checksum(const std::vector<char> &object)
+{
+    return ShaderCache::hash(ShaderCache::INITIAL_HASH, std::string(object.begin(), object.end()));
+}
+
+std::vector<Entry> listEntries(const std::string &directory)
+{
+    std::vector<Entry> entries;
+    DIR *dir = opendir(directory.c_str());
+    if (dir == NULL)
+        return entries;
+
+    const std::size_t extensionLength = sizeof(EXTENSION) - 1;
+    struct dirent *dir_entry;
+    while ((dir_entry = readdir(dir)) != NULL)
+    {
+        const std::string name = dir_entry->d_name;
+        if (name.size() <= extensionLength || name.compare(name.size() - extensionLength, extensionLength, EXTENSION) != 0)
+            continue;
+
+        Entry entry;
+        entry.path = directory + "/" + name;
+        struct stat status;
+        if (stat(entry.path.c_str(), &status) != 0)
+            continue;
+        entry.size = static_cast<std::size_t>(status.st_size);
+        entry.lastUse = status.st_mtime;
+        entries.push_back(entry);
+    }
+    closedir(dir);
+    return entries;
+}
+
+}
+
+JitObjectCache::JitObjectCache(std::size_t sizeLimit) : _sizeLimit(sizeLimit)
+{}
+
+void JitObjectCache::setDirectory(const std::string &directory)
+{
+    _directory = directory;
+    if (_directory.empty())
+        return;
+
+#ifdef WIN32
+    _mkdir(_directory.c_str());
+#else
+    mkdir(_directory.c_str(), 0755);
+#endif
+}
+
+JitObjectCache::Key JitObjectCache::key(const std::string &module, const std::string &host)
+{
+    return ShaderCache::hash(ShaderCache::hash(ShaderCache::INITIAL_HASH, host), module);
+}
+
+std::string JitObjectCache::path(Key key) const
+{
+    char name[24];
+    snprintf(name, sizeof(name), "%016llx%s", static_cast<unsigned long long>(key), EXTENSION);
+    return _directory + "/" + name;
+}
+
+bool JitObjectCache::load(Key key, std::vector<char> &object)
+{
+    if (!enabled())
+        return false;
+
+    const std::string entryPath = path(key);
+    bool found = false, intact = false;
+    Header header;
+    {
+        std::ifstream file(entryPath.c_str(), std::ios_base::in | std::ios_base::binary);
+        found = static_cast<bool>(file);
+        char magic[sizeof(MAGIC)];
+        if (found && file.read(magic, sizeof(magic)) && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0 &&
+            file.read(reinterpret_cast<char *>(&header), sizeof(header)) && header.key == key)
+        {
+            object.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            intact = !object.empty() && object.size() == header.size && checksum(object) == header.checksum;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_statsMutex);
+    if (!intact)
+    {
+        object.clear();
+        _stats.misses++;
+        if (found)
+        {
+            // the entry is of no use to anyone, it is replaced once the module is compiled again
+            _stats.corrupt++;
+            std::remove(entryPath.c_str());
+        }
+        return false;
+    }
+
+    _stats.hits++;
+    _stats.millisecondsSaved += header.milliseconds;
+
+    // the modification time orders the entries for eviction
+    utime(entryPath.c_str(), NULL);
+    return true;
+}
+
+void JitObjectCache::store(Key key, const std::vector<char> &object, double milliseconds)
+{
+    if (!enabled() || object.empty() || object.size() > _sizeLimit)
+        return;
+
+    Header header;
+    header.key = key;
+    header.size = object.size();
+    header.checksum = checksum(object);
+    header.milliseconds = milliseconds;
+
+    // write to a temporary file first, so a reader never sees a partial entry
+    const std::string target = path(key);
+    const std::string temporary = target + ".tmp";
+    {
+        std::ofstream file(temporary.c_str(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+        if (!file)
+            return;
+        file.write(MAGIC, sizeof(MAGIC));
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(object.data(), object.size());
+        if (!file)
+        {
+            file.close();
+            std::remove(temporary.c_str());
+            return;
+        }
+    }
+    std::remove(target.c_str());
+    if (std::rename(temporary.c_str(), target.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        return;
+    }
+
+    evict();
+}
+
+void JitObjectCache::remove(Key key)
+{
+    if (enabled())
+        std::remove(path(key).c_str());
+}
+
+std::size_t JitObjectCache::size() const
+{
+    std::size_t total = 0;
+    for (const Entry &entry : listEntries(_directory))
+        total += entry.size;
+    return total;
+}
+
+JitObjectCache::Stats JitObjectCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(_statsMutex);
+    return _stats;
+}
+
+void JitObjectCache::resetStats()
+{
+    std::lock_guard<std::mutex> lock(_statsMutex);
+    _stats = Stats();
+}
+
+void JitObjectCache::evict()
+{
+    std::vector<Entry> entries = listEntries(_directory);
+
+    std::size_t total = 0;
+    for (const Entry &entry : entries)
+        total += entry.size;
+    if (total <= _sizeLimit)
+        return;
+
+    std::sort(entries.begin(), entries.end());
+    for (std::vector<Entry>::const_iterator oldest = entries.begin(); oldest != entries.end() && total > _sizeLimit; ++oldest)
+    {
+        if (std::remove(oldest->path.c_str()) == 0)
+            total -= oldest->size;
+    }
+}
+
+
+// TESTS
+
+#include <iostream>
+#include "TestRunner.hpp"
+
+#ifndef NDEBUG
+
+#include <ctime>
+
+#define TEST(cond) if (!verify(__FILE__ ": " #cond,cond)) return false
+
+struct JitObjectCacheTest : public Test
+{
+    JitObjectCacheTest() : Test("JitObjectCacheTest")
+    {}
+
+    const std::string directory = "JitObjectCacheTest.tmp";
+
+    std::string entryPath(JitObjectCache::Key key)
+    {
+        char fileName[24];
+        snprintf(fileName, sizeof(fileName), "%016llx.jit", static_cast<unsigned long long>(key));
+        return directory + "/" + fileName;
+    }
+
+    // sets the last use of an entry, the file system only keeps seconds
+    void setLastUse(JitObjectCache::Key key, time_t time)
+    {
+        struct utimbuf times;
+        times.actime = time;
+        times.modtime = time;
+        utime(entryPath(key).c_str(), &times);
+    }
+
+    bool test_entries(JitObjectCache &cache)
+    {
+        const std::vector<char> a(100, 'a'), b(100, 'b'), c(100, 'c');
+        std::vector<char> object;
+
+        const JitObjectCache::Key keyA = JitObjectCache::key("module a", "host");
+        TEST(keyA != JitObjectCache::key("module a", "other host"));
+        TEST(keyA != JitObjectCache::key("module b", "host"));
+        TEST(!cache.load(keyA, object));
+
+        cache.store(keyA, a, 20);
+        TEST(cache.load(keyA, object));
+        TEST(object == a);
+
+        JitObjectCache::Stats stats = cache.stats();
+        TEST(stats.hits == 1 && stats.misses == 1 && stats.corrupt == 0);
+        TEST(stats.millisecondsSaved == 20);
+        TEST(stats.hitRate() == 0.5);
+
+        // a damaged entry is a miss and goes away
+        {
+            std::fstream file(entryPath(keyA).c_str(), std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+            file.seekp(-1, std::ios_base::end);
+            file.put('x');
+        }
+        TEST(!cache.load(keyA, object));
+        TEST(object.empty());
+        TEST(cache.stats().corrupt == 1);
+        TEST(cache.size() == 0);
+
+        // so does a truncated one
+        cache.store(keyA, a, 20);
+        {
+            std::vector<char> contents;
+            {
+                std::ifstream file(entryPath(keyA).c_str(), std::ios_base::in | std::ios_base::binary);
+                contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            }
+            std::ofstream file(entryPath(keyA).c_str(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+            file.write(contents.data(), contents.size() / 2);
+        }
+        TEST(!cache.load(keyA, object));
+        TEST(cache.stats().corrupt == 2);
+
+        cache.resetStats();
+        TEST(cache.stats().hits == 0 && cache.stats().millisecondsSaved == 0);
+
+        // the least recently used entry goes first, a hit counts as a use
+        const time_t now = time(NULL);
+        cache.store(keyA, a, 1);
+        setLastUse(keyA, now - 100);
+        const JitObjectCache::Key keyB = JitObjectCache::key("module b", "host");
+        cache.store(keyB, b, 1);
+        setLastUse(keyB, now - 50);
+        TEST(cache.load(keyA, object));
+
+        const JitObjectCache::Key keyC = JitObjectCache::key("module c", "host");
+        cache.store(keyC, c, 1);
+        TEST(cache.size() <= 300);
+        TEST(cache.load(keyA, object) && object == a);
+        TEST(!cache.load(keyB, object));
+        TEST(cache.load(keyC, object) && object == c);
+        return true;
+    }
+
+    bool test() override
+    {
+        // each entry has 36 bytes of header, so two entries of 100 bytes fit
+        JitObjectCache cache(300);
+        cache.setDirectory(directory);
+        const bool result = test_entries(cache);
+
+        for (const char *module : { "module a", "module b", "module c" })
+            cache.remove(JitObjectCache::key(module, "host"));
+        std::remove(directory.c_str());
+        return result;
+    }
+};
+
+Test* JitObjectCache::test()
+{
+    return new JitObjectCacheTest();
+}
+
+#else
+
+Test* JitObjectCache::test()
+{
+    return nullptr;
+}
+
+#endif
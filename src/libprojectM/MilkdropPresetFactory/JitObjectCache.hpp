@@ -0,0 +1,79 @@
+#ifndef JIT_OBJECT_CACHE_HPP
+#define JIT_OBJECT_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Test;
+
+/// Object code of JIT compiled preset modules, kept between runs so a preset that was compiled before
+/// loads its native code instead of running the optimizer and the code generator again.
+///
+/// Entries are addressed by a hash of the module and the host it was compiled for, carry a checksum
+/// that is verified on load, and are evicted least-recently-used when the directory grows past the
+/// size limit. An empty directory disables the cache.
+class JitObjectCache
+{
+public:
+    typedef std::uint64_t Key;
+
+    struct Stats
+    {
+        std::size_t hits{ 0 };
+        std::size_t misses{ 0 };
+        /// Entries dropped on load because they were truncated or failed the checksum
+        std::size_t corrupt{ 0 };
+        /// Compile time recorded with the entries that were hit
+        double millisecondsSaved{ 0 };
+
+        double hitRate() const
+        {
+            return hits + misses > 0 ? static_cast<double>(hits) / (hits + misses) : 0;
+        }
+    };
+
+    explicit JitObjectCache(std::size_t sizeLimit = 64 * 1024 * 1024);
+
+    /// Creates the directory if it does not exist yet
+    void setDirectory(const std::string &directory);
+
+    bool enabled() const { return !_directory.empty(); }
+
+    /// \param module the text of the module before optimization
+    /// \param host the compiler version and the CPU name and features the code is generated for
+    static Key key(const std::string &module, const std::string &host);
+
+    /// \returns true and the object code if there is an intact entry, a corrupt one is removed
+    bool load(Key key, std::vector<char> &object);
+
+    /// Adds an entry and evicts the least recently used ones above the size limit
+    /// \param milliseconds the time it took to compile the object, credited to the stats on every hit
+    void store(Key key, const std::vector<char> &object, double milliseconds);
+
+    void remove(Key key);
+
+    /// Bytes used by all entries in the directory
+    std::size_t size() const;
+
+    Stats stats() const;
+
+    void resetStats();
+
+    static Test *test();
+
+private:
+    std::string path(Key key) const;
+    void evict();
+
+    std::string _directory;
+    std::size_t _sizeLimit;
+
+    /// Lookups happen on the compiler thread, the stats are read from any other
+    mutable std::mutex _statsMutex;
+    Stats _stats;
+};
+
+#endif
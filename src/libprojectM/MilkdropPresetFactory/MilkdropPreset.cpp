@@ -46,6 +46,9 @@
 
 #include "PresetFactoryManager.hpp"
 #include "MilkdropPresetFactory.hpp"
+#include "WorkerPool.hpp"
+
+#include <algorithm>
 
 #ifdef __SSE2__
 
@@ -58,7 +61,7 @@ MilkdropPreset::MilkdropPreset(MilkdropPresetFactory* factory, std::istream& in,
                                PresetOutputs* presetOutputs)
     : Preset(presetName)
     , builtinParams(_presetInputs, presetOutputs)
-    , per_pixel_program(nullptr)
+    , per_pixel_lane_slots(-1)
     , _factory(factory)
     , _presetOutputs(presetOutputs)
 {
@@ -70,7 +73,7 @@ MilkdropPreset::MilkdropPreset(MilkdropPresetFactory* factory, const std::string
                                const std::string& presetName, PresetOutputs* presetOutputs)
     : Preset(presetName)
     , builtinParams(_presetInputs, presetOutputs)
-    , per_pixel_program(nullptr)
+    , per_pixel_lane_slots(-1)
     , _filename(parseFilename(absoluteFilePath))
     , _absoluteFilePath(absoluteFilePath)
     , _factory(factory)
@@ -83,13 +86,14 @@ MilkdropPreset::MilkdropPreset(MilkdropPresetFactory* factory, const std::string
 
 MilkdropPreset::~MilkdropPreset()
 {
+    // the compiler may still be reading the equations
+    ExprCompiler::cancel(_compileJob);
 
     traverse<TraverseFunctors::Delete<InitCond> >(init_cond_tree);
 
     traverse<TraverseFunctors::Delete<InitCond> >(per_frame_init_eqn_tree);
 
     traverse<TraverseFunctors::Delete<PerPixelEqn> >(per_pixel_eqn_tree);
-    Expr::delete_expr(per_pixel_program);
 
     traverseVector<TraverseFunctors::Delete<PerFrameEqn> >(per_frame_eqn_tree);
 
@@ -212,12 +216,7 @@ void MilkdropPreset::evalCustomWavePerFrameEquations()
             _pos->second->evaluate();
         }
 
-        std::vector<PerFrameEqn*>& per_frame_eqn_tree2 = (*pos)->per_frame_eqn_tree;
-        for (std::vector<PerFrameEqn*>::iterator _pos = per_frame_eqn_tree2.begin();
-             _pos != per_frame_eqn_tree2.end(); ++_pos)
-        {
-            (*_pos)->evaluate();
-        }
+        (*pos)->per_frame_program.get()->eval(-1, -1);
     }
 
 }
@@ -236,12 +235,7 @@ void MilkdropPreset::evalCustomShapePerFrameEquations()
             _pos->second->evaluate();
         }
 
-        std::vector<PerFrameEqn*>& per_frame_eqn_tree2 = (*pos)->per_frame_eqn_tree;
-        for (std::vector<PerFrameEqn*>::iterator _pos = per_frame_eqn_tree2.begin();
-             _pos != per_frame_eqn_tree2.end(); ++_pos)
-        {
-            (*_pos)->evaluate();
-        }
+        (*pos)->per_frame_program.get()->eval(-1, -1);
     }
 
 }
@@ -267,10 +261,7 @@ void MilkdropPreset::evalPerFrameEquations()
         pos->second->evaluate();
     }
 
-    for (std::vector<PerFrameEqn*>::iterator pos = per_frame_eqn_tree.begin(); pos != per_frame_eqn_tree.end(); ++pos)
-    {
-        (*pos)->evaluate();
-    }
+    per_frame_program.get()->eval(-1, -1);
 
 }
 
@@ -298,6 +289,8 @@ void MilkdropPreset::postloadInitialize()
     this->loadCustomWaveUnspecInitConds();
     this->loadCustomShapeUnspecInitConds();
 
+    this->compilePrograms();
+
 
 /// @bug are you handling all the q variables conditions? in particular, the un-init case?
 //    if (_presetOutputs)
@@ -314,11 +307,72 @@ void MilkdropPreset::postloadInitialize()
 
 }
 
+void MilkdropPreset::compilePrograms()
+{
+    // This is a little forward looking, but if we want to JIT assignments expressions, we might
+    // as well JIT the batch all together rather than one at a time.  At the moment ProgramExpr is
+    // just a different place to loop over the individual steps, but the idea is that this encapsulates
+    // an optimizable chunk of work.
+    // See also CustomWave which does the same for PerPointEqn
+    std::vector<Expr*> steps;
+    for (std::vector<PerFrameEqn*>::iterator pos = per_frame_eqn_tree.begin(); pos != per_frame_eqn_tree.end(); ++pos)
+    {
+        steps.push_back((*pos)->assign_expr);
+    }
+    per_frame_program.set(Expr::create_program_expr(steps, false));
+
+    std::vector<ExprProgram*> programs;
+    programs.push_back(&per_frame_program);
+
+    if (!per_pixel_eqn_tree.empty())
+    {
+        steps.clear();
+        for (std::map<int, PerPixelEqn*>::iterator pos = per_pixel_eqn_tree.begin();
+             pos != per_pixel_eqn_tree.end(); ++pos)
+        {
+            steps.push_back(pos->second->assign_expr);
+        }
+        Expr* program_expr = Expr::create_program_expr(steps, false);
+        per_pixel_invariants = Expr::hoist_invariants(program_expr, per_pixel_hoist_stats);
+        if (MILKDROP_PRESET_DEBUG)
+        {
+            std::cerr << "[Preset] " << name() << ": hoisted " << per_pixel_hoist_stats.invariants
+                      << " per pixel subexpressions, " << per_pixel_hoist_stats.removed << " of "
+                      << per_pixel_hoist_stats.nodes << " node evaluations per point removed" << std::endl;
+        }
+        per_pixel_lane_slots = Expr::prepare_lanes(program_expr);
+        per_pixel_program.set(program_expr);
+        programs.push_back(&per_pixel_program);
+    }
+
+    for (PresetOutputs::cwave_container::iterator pos = customWaves.begin(); pos != customWaves.end(); ++pos)
+    {
+        (*pos)->createPrograms();
+        programs.push_back(&(*pos)->per_frame_program);
+        programs.push_back(&(*pos)->per_point_program);
+    }
+
+    for (PresetOutputs::cshape_container::iterator pos = customShapes.begin(); pos != customShapes.end(); ++pos)
+    {
+        (*pos)->createPrograms();
+        programs.push_back(&(*pos)->per_frame_program);
+    }
+
+    // The preset runs on the tree until the compiled code is installed by evaluateFrame(). Per frame init
+    // equations and initial conditions only run before the first frame, they always stay on the tree.
+    _compileJob = ExprCompiler::submit(programs, _filename);
+}
+
+void MilkdropPreset::waitForCompiledPrograms()
+{
+    ExprCompiler::wait(_compileJob);
+}
+
 void MilkdropPreset::Render(const BeatDetect& music, const PipelineContext& context)
 {
     _presetInputs.update(music, context);
 
-    evaluateFrame();
+    evaluateFrame(context.workerPool);
     pipeline().Render(music, context);
 
 }
@@ -400,9 +454,21 @@ void MilkdropPreset::loadCustomShapeUnspecInitConds()
 }
 
 
-void MilkdropPreset::evaluateFrame()
+void MilkdropPreset::evaluateFrame(WorkerPool* workerPool)
 {
 
+    // Switch to the compiled programs between frames, once they are ready
+    if (_compileJob && _compileJob->done())
+    {
+        if (MILKDROP_PRESET_DEBUG)
+        {
+            std::cerr << "[Preset] " << name() << ": installing programs compiled in "
+                      << _compileJob->milliseconds() << " ms" << std::endl;
+        }
+        _compileJob->install();
+        _compileJob.reset();
+    }
+
     // Evaluate all equation objects according to milkdrop flow diagram
 
     evalPerFrameInitEquations();
@@ -415,7 +481,7 @@ void MilkdropPreset::evaluateFrame()
 
     initialize_PerPixelMeshes();
 
-    evalPerPixelEqns();
+    evalPerPixelEqns(workerPool);
 
     evalCustomWaveInitConditions();
     evalCustomWavePerFrameEquations();
@@ -423,43 +489,40 @@ void MilkdropPreset::evaluateFrame()
     evalCustomShapeInitConditions();
     evalCustomShapePerFrameEquations();
 
-    // Setup pointers of the custom waves and shapes to the preset outputs instance
+    // Setup pointers of the custom waves and shapes to the preset outputs instance.
+    // assign() keeps the capacity, so this only allocates on the first frame.
     if (_presetOutputs)
     {
-        /// @slow an extra O(N) per frame, could do this during eval
-        _presetOutputs->customWaves = PresetOutputs::cwave_container(customWaves);
-        _presetOutputs->customShapes = PresetOutputs::cshape_container(customShapes);
+        _presetOutputs->customWaves.assign(customWaves.begin(), customWaves.end());
+        _presetOutputs->customShapes.assign(customShapes.begin(), customShapes.end());
     }
 
 }
 
 
+// Fills the rows including their padding, so the vectorized PerPixelMath sees sane values everywhere
 #ifdef __SSE2__
 
-inline void init_mesh(float** mesh, const float value, const int gx, const int gy)
+inline void init_mesh(MeshPlane &mesh, const float value, const int gy)
 {
     __m128 mvalue = _mm_set_ps1(value);
-    for (int x = 0; x < gx; x++)
+    float *data = mesh.data();
+    const int count = mesh.stride() * gy;
+    for (int i = 0; i < count; i += 4)
     {
-        for (int y = 0; y < gy; y += 4)
-        {
-            _mm_store_ps(&mesh[x][y], mvalue);
-        }
+        _mm_store_ps(data + i, mvalue);
     }
 }
 
 #else
-inline void init_mesh(float **mesh, const float value, const int gx, const int gy)
+inline void init_mesh(MeshPlane &mesh, const float value, const int gy)
 {
-    for (int x=0; x<gx; x++)
-        for (int y=0; y<gy; y++)
-            mesh[x][y] = value;
+    std::fill(mesh.data(), mesh.data() + mesh.stride() * gy, value);
 }
 #endif
 
 void MilkdropPreset::initialize_PerPixelMeshes()
 {
-    int gx = presetInputs().gx;
     int gy = presetInputs().gy;
 
     if (!_presetOutputs)
@@ -467,21 +530,21 @@ void MilkdropPreset::initialize_PerPixelMeshes()
         return;
     }
 
-    init_mesh(_presetOutputs->cx_mesh, _presetOutputs->cx, gx, gy);
-    init_mesh(_presetOutputs->cy_mesh, _presetOutputs->cy, gx, gy);
-    init_mesh(_presetOutputs->sx_mesh, _presetOutputs->sx, gx, gy);
-    init_mesh(_presetOutputs->sy_mesh, _presetOutputs->sy, gx, gy);
-    init_mesh(_presetOutputs->dx_mesh, _presetOutputs->dx, gx, gy);
-    init_mesh(_presetOutputs->dy_mesh, _presetOutputs->dy, gx, gy);
-    init_mesh(_presetOutputs->zoom_mesh, _presetOutputs->zoom, gx, gy);
-    init_mesh(_presetOutputs->zoomexp_mesh, _presetOutputs->zoomexp, gx, gy);
-    init_mesh(_presetOutputs->rot_mesh, _presetOutputs->rot, gx, gy);
-    init_mesh(_presetOutputs->warp_mesh, _presetOutputs->warp, gx, gy);
+    init_mesh(_presetOutputs->cx_mesh, _presetOutputs->cx, gy);
+    init_mesh(_presetOutputs->cy_mesh, _presetOutputs->cy, gy);
+    init_mesh(_presetOutputs->sx_mesh, _presetOutputs->sx, gy);
+    init_mesh(_presetOutputs->sy_mesh, _presetOutputs->sy, gy);
+    init_mesh(_presetOutputs->dx_mesh, _presetOutputs->dx, gy);
+    init_mesh(_presetOutputs->dy_mesh, _presetOutputs->dy, gy);
+    init_mesh(_presetOutputs->zoom_mesh, _presetOutputs->zoom, gy);
+    init_mesh(_presetOutputs->zoomexp_mesh, _presetOutputs->zoomexp, gy);
+    init_mesh(_presetOutputs->rot_mesh, _presetOutputs->rot, gy);
+    init_mesh(_presetOutputs->warp_mesh, _presetOutputs->warp, gy);
 }
 
 
-// Evaluates all per-pixel equations
-void MilkdropPreset::evalPerPixelEqns()
+// Evaluates all per-pixel equations, spread over the worker pool if there is one and the program allows it
+void MilkdropPreset::evalPerPixelEqns(WorkerPool* workerPool)
 {
     // Quick bail out if there is nothing to do.
     if (per_pixel_eqn_tree.empty())
@@ -489,35 +552,81 @@ void MilkdropPreset::evalPerPixelEqns()
         return;
     }
 
-    if (nullptr == per_pixel_program)
+    Expr::eval_invariants(per_pixel_invariants);
+
+    // JIT code only runs point by point, the tree and the bytecode also take batches
+    Expr* program = per_pixel_program.get();
+    if (per_pixel_lane_slots < 0 || program->clazz == JIT)
     {
-        // This is a little forward looking, but if we want to JIT assignments expressions, we might
-        // as well JIT the batch all together rather than one at a time.  At the moment ProgramExpr is
-        // just a different place to loop over the individual steps, but the idea is that this encapsulates
-        // an optimizable chunk of work.
-        // See also CustomWave which does the same for PerPointEqn
-        std::vector<Expr*> steps;
-        for (std::map<int, PerPixelEqn*>::iterator pos = per_pixel_eqn_tree.begin();
-             pos != per_pixel_eqn_tree.end(); ++pos)
+        for (int mesh_y = 0; mesh_y < presetInputs().gy; mesh_y++)
         {
-            steps.push_back(pos->second->assign_expr);
+            for (int mesh_x = 0; mesh_x < presetInputs().gx; mesh_x++)
+            {
+                program->eval(mesh_x, mesh_y);
+            }
         }
-        Expr* program_expr = Expr::create_program_expr(steps, false);
-        Expr* jit = nullptr;
-#if HAVE_LLVM
-        std::string module_name = this->_filename + "_per_pixel";
-        if (!steps.empty())
-            jit = Expr::jit(program_expr, module_name);
-#endif
-        per_pixel_program = jit ? jit : program_expr;
+        return;
     }
 
-    for (int mesh_x = 0; mesh_x < presetInputs().gx; mesh_x++)
+    const int gy = presetInputs().gy;
+    const unsigned int participants = (workerPool && gy > 2) ? workerPool->size() : 1;
+    const std::size_t localsPerParticipant = per_pixel_lane_slots * ExprLanes::MAX_LANES;
+    if (per_pixel_lane_locals.size() < localsPerParticipant * participants)
     {
-        for (int mesh_y = 0; mesh_y < presetInputs().gy; mesh_y++)
+        per_pixel_lane_locals.resize(localsPerParticipant * participants);
+    }
+
+    // The first row runs on its own. It sets the per point flag of every matrix the program assigns,
+    // after that the rows only depend on their own points and can be evaluated concurrently.
+    evalPerPixelRow(0, per_pixel_lane_locals.data());
+
+    if (participants == 1)
+    {
+        for (int mesh_y = 1; mesh_y < gy; mesh_y++)
+        {
+            evalPerPixelRow(mesh_y, per_pixel_lane_locals.data());
+        }
+        return;
+    }
+
+    // Several bands per participant, so threads that finish early have something to steal.
+    struct
+    {
+        int gy;
+        int bandHeight;
+        std::size_t localsPerParticipant;
+    } bands = { gy, std::max(1, (gy - 1) / static_cast<int>(participants * 4)), localsPerParticipant };
+
+    const std::size_t bandCount = (gy - 1 + bands.bandHeight - 1) / bands.bandHeight;
+    workerPool->run(bandCount, [this, &bands](std::size_t band, unsigned int participant) {
+        float* locals = per_pixel_lane_locals.data() + participant * bands.localsPerParticipant;
+        const int first = 1 + static_cast<int>(band) * bands.bandHeight;
+        const int last = std::min(bands.gy, first + bands.bandHeight);
+        for (int mesh_y = first; mesh_y < last; mesh_y++)
         {
-            per_pixel_program->eval(mesh_x, mesh_y);
+            evalPerPixelRow(mesh_y, locals);
         }
+    });
+}
+
+// Evaluates one row of the mesh in runs of consecutive points, so every expression node handles a
+// whole run per call. The mesh is stored row by row, see MeshPlane.
+void MilkdropPreset::evalPerPixelRow(int mesh_y, float* locals)
+{
+    const int gx = presetInputs().gx;
+    const int gy = presetInputs().gy;
+
+    float result[ExprLanes::MAX_LANES];
+    ExprLanes lanes;
+    lanes.mesh_j = mesh_y;
+    lanes.locals = locals;
+    for (int mesh_x = 0; mesh_x < gx; mesh_x += ExprLanes::MAX_LANES)
+    {
+        const int remaining = gx - mesh_x;
+        lanes.mesh_i = mesh_x;
+        lanes.count = remaining < ExprLanes::MAX_LANES ? remaining : ExprLanes::MAX_LANES;
+        lanes.write_back = mesh_y == gy - 1 && remaining <= ExprLanes::MAX_LANES;
+        per_pixel_program.get()->eval_lanes(lanes, result);
     }
 }
 
@@ -529,14 +638,16 @@ int MilkdropPreset::readIn(std::istream& fs)
         _presetOutputs->warpShader.programSource.clear();
     }
 
+    Parser parser;
+
     /* Parse any comments (aka "[preset00]") */
     /* We don't do anything with this info so it's okay if it's missing */
-    if (Parser::parse_top_comment(fs) == PROJECTM_SUCCESS)
+    if (parser.parse_top_comment(fs) == PROJECTM_SUCCESS)
     {
         /* Parse the preset name and a left bracket */
         char tmp_name[MAX_TOKEN_SIZE];
 
-        if (Parser::parse_preset_name(fs, tmp_name) < 0)
+        if (parser.parse_preset_name(fs, tmp_name) < 0)
         {
             std::cerr << "[Preset::readIn] loading of preset name failed" << std::endl;
             fs.seekg(0);
@@ -556,7 +667,7 @@ int MilkdropPreset::readIn(std::istream& fs)
     // Loop through each line in file, trying to successfully parse the file.
     // If a line does not parse correctly, keep trucking along to next line.
     int retval;
-    while ((retval = Parser::parse_line(fs, this)) != EOF)
+    while ((retval = parser.parse_line(fs, this)) != EOF)
     {
         if (retval == PROJECTM_PARSE_ERROR)
         {
@@ -34,6 +34,7 @@
 #include <string>
 #include <cassert>
 #include <map>
+#include <memory>
 
 #ifdef DEBUG
 /* 0 for no debugging, 1 for normal, 2 for insane */
@@ -45,6 +46,7 @@
 #include "CustomShape.hpp"
 #include "CustomWave.hpp"
 #include "Expr.hpp"
+#include "ExprCompiler.hpp"
 #include "PerPixelEqn.hpp"
 #include "PerFrameEqn.hpp"
 #include "BuiltinParams.hpp"
@@ -60,9 +62,13 @@ class CustomShape;
 
 class InitCond;
 
+class WorkerPool;
+
 
 class MilkdropPreset : public Preset
 {
+    /// Declared before builtinParams, which initializes it
+    PresetInputs _presetInputs;
 
 public:
 
@@ -135,11 +141,16 @@ public:
     /// @bug encapsulate
     /* Data structures that contain equation and initial condition information */
     std::vector<PerFrameEqn*> per_frame_eqn_tree;   /* per frame equations */
+    ExprProgram per_frame_program;
     std::map<int, PerPixelEqn*> per_pixel_eqn_tree; /* per pixel equation tree */
-    Expr* per_pixel_program;
+    ExprProgram per_pixel_program;
+    int per_pixel_lane_slots; /* local slots for batched evaluation of per_pixel_program, -1 to run it point by point */
+    std::vector<Expr*> per_pixel_invariants; /* subexpressions of per_pixel_program evaluated once per frame */
+    ExprHoistStats per_pixel_hoist_stats;
+    std::vector<float> per_pixel_lane_locals;
     std::map<std::string, InitCond*> per_frame_init_eqn_tree; /* per frame initial equations */
     std::map<std::string, InitCond*> init_cond_tree; /* initial conditions */
-    std::map<std::string, Param*> user_param_tree; /* user parameter splay tree */
+    ParamTable user_param_tree; /* user parameter table */
 
 
     PresetOutputs& pipeline()
@@ -149,6 +160,10 @@ public:
 
     void Render(const BeatDetect& music, const PipelineContext& context);
 
+    /// Blocks until the background compilation of the equations is done, so the next frame already runs
+    /// the compiled code. Frames render without waiting otherwise.
+    void waitForCompiledPrograms();
+
     const std::string& name() const;
 
     const std::string& filename() const
@@ -158,11 +173,11 @@ public:
 
 private:
     std::string _filename;
-    PresetInputs _presetInputs;
 
     /// Evaluates the MilkdropPreset for a frame given the current values of MilkdropPreset inputs / outputs
     /// All calculated values are stored in the associated MilkdropPreset outputs instance
-    void evaluateFrame();
+    /// \param workerPool threads to spread the per pixel equations over, may be null
+    void evaluateFrame(WorkerPool* workerPool);
 
     // The absolute file path of the MilkdropPreset
     std::string _absoluteFilePath;
@@ -192,12 +207,17 @@ private:
 
     void evalCustomShapeInitConditions();
 
-    void evalPerPixelEqns();
+    void evalPerPixelEqns(WorkerPool* workerPool);
+
+    void evalPerPixelRow(int mesh_y, float* locals);
 
     void evalPerFrameEquations();
 
     void initialize_PerPixelMeshes();
 
+    /// Collects the equations into programs and queues them for compilation, see ExprCompiler
+    void compilePrograms();
+
     int readIn(std::istream& fs);
 
     void preloadInitialize();
@@ -206,6 +226,7 @@ private:
 
     MilkdropPresetFactory* _factory{ nullptr };
     PresetOutputs* _presetOutputs{ nullptr };
+    std::shared_ptr<ExprCompileJob> _compileJob; /* programs being compiled, null once installed */
 
     template<class CustomObject>
     void transfer_q_variables(std::vector<CustomObject*>& customObjects);
@@ -223,14 +223,14 @@ std::unique_ptr<Preset>
 MilkdropPresetFactory::allocate(const std::string& url, const std::string& name, const std::string& author)
 {
 
-    PresetOutputs* presetOutputs;
+    PresetOutputs* presetOutputs{ nullptr };
     // use cached PresetOutputs if there is one, otherwise allocate
-    if (_presetOutputsCache)
     {
+        std::lock_guard<std::mutex> lock(_presetOutputsCacheMutex);
         presetOutputs = _presetOutputsCache;
         _presetOutputsCache = nullptr;
     }
-    else
+    if (!presetOutputs)
     {
         presetOutputs = createPresetOutputs(gx, gy);
     }
@@ -260,12 +260,14 @@ void MilkdropPresetFactory::releasePreset(Preset* preset)
     }
 
     // return PresetOutputs to the cache
-    if (!_presetOutputsCache)
     {
-        _presetOutputsCache = milkdropPreset->_presetOutputs;
-    }
-    else
-    {
-        delete milkdropPreset->_presetOutputs;
+        std::lock_guard<std::mutex> lock(_presetOutputsCacheMutex);
+        if (!_presetOutputsCache)
+        {
+            _presetOutputsCache = milkdropPreset->_presetOutputs;
+            return;
+        }
     }
+
+    delete milkdropPreset->_presetOutputs;
 }
@@ -13,6 +13,7 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include "../PresetFactory.hpp"
 
 class DLLEXPORT PresetOutputs;
@@ -46,4 +47,5 @@ private:
     int gx{ 0 };
     int gy{ 0 };
     PresetOutputs* _presetOutputsCache{ nullptr };
+    std::mutex _presetOutputsCacheMutex; //!< Presets may be allocated on the prefetch thread.
 };
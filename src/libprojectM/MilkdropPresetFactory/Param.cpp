@@ -32,9 +32,11 @@
 #include "CustomShape.hpp"
 #include "Eval.hpp"
 #include "Expr.hpp"
+#include "ExprBytecode.hpp"
 #include "InitCond.hpp"
 #include "Param.hpp"
 #include "Preset.hpp"
+#include "Renderer/MeshBuffer.hpp"
 #include <map>
 #include <iostream>
 #include <cassert>
@@ -222,11 +224,74 @@ struct _Param : public Param
     {
         set_param(value);
     }
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        if (lane_slot < 0)
+        {
+            Param::eval_lanes(lanes, out);
+            return;
+        }
+        const float *local = lanes.locals + lane_slot * ExprLanes::MAX_LANES;
+        for (int k = 0; k < lanes.count; k++)
+            out[k] = local[k];
+    }
+    void set_matrix_lanes(const ExprLanes &lanes, const float *values) override
+    {
+        if (lane_slot < 0)
+        {
+            Param::set_matrix_lanes(lanes, values);
+            return;
+        }
+        float *local = lanes.locals + lane_slot * ExprLanes::MAX_LANES;
+        for (int k = 0; k < lanes.count; k++)
+            local[k] = assigned_value(values[k]);
+
+        // The engine value ends up holding the last point, just like after running the points in order.
+        if (lanes.write_back)
+            set_matrix(lanes.mesh_i + lanes.count - 1, lanes.mesh_j, values[lanes.count - 1]);
+    }
+    /// The value eval() returns after set_matrix(value), without storing it. Mirrors set_param().
+    virtual float assigned_value(float value)
+    {
+        switch (type)
+        {
+        case P_TYPE_BOOL:
+            return value > 0 ? 1 : 0;
+        case P_TYPE_INT:
+            value = floor(value);
+            if (value < lower_bound.int_val)
+                return lower_bound.int_val;
+            if (value > upper_bound.int_val)
+                return upper_bound.int_val;
+            return (int)value;
+        case P_TYPE_DOUBLE:
+            if (value < lower_bound.float_val)
+                return lower_bound.float_val;
+            if (value > upper_bound.float_val)
+                return upper_bound.float_val;
+            return value;
+        default:
+            return 0;
+        }
+    }
+    int _bytecode(BytecodeCompiler &bc) override
+    {
+        return bc.load_param(this);
+    }
+    std::ostream &to_string(std::ostream &out) override
+    {
+        out << name; return out;
+    }
 #if HAVE_LLVM
     llvm::Value *_llvm(JitContext &jit) override
     {
         return Expr::generate_eval_call(jit, this, name.c_str());
     }
+    llvm::Value *_llvm_set_matrix(JitContext &jitx, llvm::Value *rhs) override
+    {
+        Expr::generate_set_matrix_call(jitx, this, rhs);
+        return _llvm_set_param_value(jitx, rhs);
+    }
 #endif
 };
 
@@ -287,14 +352,31 @@ public:
     {
         return *(float *)engine_val;
     }
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        if (lane_slot >= 0)
+        {
+            _Param::eval_lanes(lanes, out);
+            return;
+        }
+        const float value = *(float *)engine_val;
+        for (int k = 0; k < lanes.count; k++)
+            out[k] = value;
+    }
+    int _bytecode(BytecodeCompiler &bc) override
+    {
+        return bc.load((float *)engine_val, this);
+    }
 #if HAVE_LLVM
     llvm::Value *_llvm(JitContext &jitx) override
     {
         llvm::Constant *ptr = jitx.CreateFloatPtr((float *)engine_val);
-        return jitx.builder.CreateLoad(ptr, name);
+        return jitx.builder.CreateLoad(jitx.floatType, ptr, name);
     }
-    virtual llvm::Value *_llvm_set_matrix(JitContext &jitx, llvm::Value *rhs)
+    llvm::Value *_llvm_set_matrix(JitContext &jitx, llvm::Value *rhs) override
     {
+        // set_matrix() is set_param(), which clips
+        rhs = _llvm_set_param_value(jitx, rhs);
         llvm::Constant *ptr = jitx.CreateFloatPtr((float *)engine_val);
         jitx.builder.CreateStore(rhs, ptr, false);
         return rhs;
@@ -317,14 +399,14 @@ public:
     float eval(int mesh_i, int mesh_j) override
     {
         assert( mesh_i >=0 && mesh_j >= 0 );
-        return ((float **)matrix)[mesh_i][mesh_j];
+        return (*(MeshPlane *)matrix)(mesh_i, mesh_j);
     }
     void set_matrix(int mesh_i, int mesh_j, float value) override
     {
         assert( mesh_i >=0 && mesh_j >= 0);
         // Yup, presets write to read-only ALWAYS_MATRIX parameters
         // assert(!(flags & P_FLAG_READONLY));
-        ((float **)matrix)[mesh_i][mesh_j] = value;
+        (*(MeshPlane *)matrix)(mesh_i, mesh_j) = value;
     }
 };*/
 
@@ -343,9 +425,29 @@ public:
         //    e.g. per_point1=dx=dx*1.01
         // any this means that we get called with (i>=0,j==-1)
         if ( matrix_flag && mesh_i >= 0 && mesh_j >= 0)
-            return ( ( ( float** ) matrix ) [mesh_i][mesh_j] );
+            return ( * ( MeshPlane* ) matrix ) ( mesh_i, mesh_j );
         return * ( ( float* ) ( engine_val ) );
     }
+    void eval_lanes(const ExprLanes &lanes, float *out) override
+    {
+        if (lane_slot >= 0)
+        {
+            _Param::eval_lanes(lanes, out);
+            return;
+        }
+        if (matrix_flag)
+        {
+            const float *row = ((MeshPlane *) matrix)->row(lanes.mesh_j) + lanes.mesh_i;
+            for (int k = 0; k < lanes.count; k++)
+                out[k] = row[k];
+        }
+        else
+        {
+            const float value = *(float *)engine_val;
+            for (int k = 0; k < lanes.count; k++)
+                out[k] = value;
+        }
+    }
     void set_matrix(int mesh_i, int mesh_j, float value) override
     {
         if (nullptr == matrix)
@@ -354,10 +456,35 @@ public:
         }
         else
         {
-            ((float **) matrix)[mesh_i][mesh_j] = value;
+            (*(MeshPlane *) matrix)(mesh_i, mesh_j) = value;
             matrix_flag = true;
         }
     }
+    void set_matrix_lanes(const ExprLanes &lanes, const float *values) override
+    {
+        if (nullptr == matrix)
+        {
+            _Param::set_matrix_lanes(lanes, values);
+            return;
+        }
+        float *row = ((MeshPlane *) matrix)->row(lanes.mesh_j) + lanes.mesh_i;
+        for (int k = 0; k < lanes.count; k++)
+            row[k] = values[k];
+        // only written once per frame, so concurrent runs of other rows merely read it
+        if (!matrix_flag)
+            matrix_flag = true;
+    }
+    float assigned_value(float value) override
+    {
+        // only used without a matrix, set_matrix() then stores the value as is
+        return value;
+    }
+#if HAVE_LLVM
+    llvm::Value *_llvm_set_matrix(JitContext &jitx, llvm::Value *rhs) override
+    {
+        return LValue::_llvm_set_matrix(jitx, rhs);
+    }
+#endif
 };
 
 
@@ -390,9 +517,44 @@ public:
             matrix_flag = true;
         }
     }
+#if HAVE_LLVM
+    llvm::Value *_llvm_set_matrix(JitContext &jitx, llvm::Value *rhs) override
+    {
+        return LValue::_llvm_set_matrix(jitx, rhs);
+    }
+#endif
 };
 
 
+#if HAVE_LLVM
+llvm::Value *Param::_llvm_set_param_value(JitContext &jitx, llvm::Value *value)
+{
+    switch (type)
+    {
+    case P_TYPE_BOOL:
+        return jitx.builder.CreateSelect(jitx.builder.CreateFCmpOGT(value, jitx.CreateConstant(0.0f)),
+                                         jitx.CreateConstant(1.0f), jitx.CreateConstant(0.0f));
+    case P_TYPE_INT:
+    {
+        value = jitx.CallIntrinsic(llvm::Intrinsic::floor, value);
+        llvm::Value *lower = jitx.CreateConstant((float)lower_bound.int_val);
+        llvm::Value *upper = jitx.CreateConstant((float)upper_bound.int_val);
+        return jitx.builder.CreateSelect(jitx.builder.CreateFCmpOLT(value, lower), lower,
+               jitx.builder.CreateSelect(jitx.builder.CreateFCmpOGT(value, upper), upper, value));
+    }
+    case P_TYPE_DOUBLE:
+    {
+        llvm::Value *lower = jitx.CreateConstant(lower_bound.float_val);
+        llvm::Value *upper = jitx.CreateConstant(upper_bound.float_val);
+        return jitx.builder.CreateSelect(jitx.builder.CreateFCmpOLT(value, lower), lower,
+               jitx.builder.CreateSelect(jitx.builder.CreateFCmpOGT(value, upper), upper, value));
+    }
+    default:
+        return jitx.CreateConstant(0.0f);
+    }
+}
+#endif
+
 Param * Param::create( const std::string &name, short int type, short int flags,
     void * eqn_val, void *matrix,
     CValue default_init_val, CValue upper_bound,
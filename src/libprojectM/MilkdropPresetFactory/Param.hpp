@@ -83,7 +83,7 @@ public:
 protected:
     short int matrix_flag; /* for optimization purposes */
     void * engine_val; /* pointer to the engine variable */
-    void * matrix; /* per pixel / per point matrix for this variable */
+    void * matrix; /* per pixel (MeshPlane*) / per point (float*) matrix for this variable */
 public:
     CValue default_init_val; /* a default initial condition value */
 protected:
@@ -94,6 +94,13 @@ protected:
     float local_value;
 
 public:
+    /// Slot in ExprLanes::locals holding the per point values while a batched per pixel program runs,
+    /// -1 if the parameter is read from its engine value or matrix. See Expr::prepare_lanes().
+    int lane_slot = -1;
+
+    /// True if assignments from a per pixel/per point equation are stored separately for every point
+    bool is_per_point() const { return nullptr != matrix; }
+
     /// Create a new parameter
     static Param * create(const std::string &name, short int type, short int flags,
            void * eqn_val, void *matrix, CValue default_init_val, CValue upper_bound,
@@ -122,6 +129,8 @@ public:
     static Param * new_param_string(const char * name, short int flags, void * engine_val);
 #if HAVE_LLVM
     virtual llvm::Value *_llvm(JitContext &jit) = 0;
+    /// The value eval() returns after set_param(value), clipped the same way
+    llvm::Value *_llvm_set_param_value(JitContext &jitx, llvm::Value *value);
 #endif
 };
 
@@ -0,0 +1,193 @@
+#include "ParamTable.hpp"
+#include "Param.hpp"
+
+#include <cassert>
+
+ParamTable::Key::Key(const char *name, std::size_t nameLength) : text(name), length(nameLength)
+{
+    // 32 bit FNV-1a
+    std::uint32_t value = 2166136261u;
+    for (std::size_t i = 0; i < length; i++)
+    {
+        value ^= static_cast<unsigned char>(text[i]);
+        value *= 16777619u;
+    }
+    hash = value;
+}
+
+std::size_t ParamTable::probe(const Key &key) const
+{
+    const std::size_t mask = _slots.size() - 1;
+    for (std::size_t index = key.hash & mask; ; index = (index + 1) & mask)
+    {
+        const Slot &slot = _slots[index];
+        if (nullptr == slot.param)
+            return index;
+        if (slot.hash == key.hash && slot.name->size() == key.length &&
+            0 == std::memcmp(slot.name->data(), key.text, key.length))
+            return index;
+    }
+}
+
+void ParamTable::reserve(std::size_t count)
+{
+    // at most half of the slots are used, which keeps the probe sequences short
+    if (2 * count <= _slots.size())
+        return;
+
+    std::size_t size = _slots.empty() ? 16 : 2 * _slots.size();
+    while (size < 2 * count)
+        size *= 2;
+    std::vector<Slot> slots(size, Slot{ nullptr, nullptr, 0, false });
+    slots.swap(_slots);
+    for (const Slot &slot : slots)
+    {
+        if (nullptr == slot.param)
+            continue;
+        const std::size_t mask = _slots.size() - 1;
+        std::size_t index = slot.hash & mask;
+        while (nullptr != _slots[index].param)
+            index = (index + 1) & mask;
+        _slots[index] = slot;
+    }
+}
+
+bool ParamTable::insert(Param *param)
+{
+    assert(param);
+    reserve(_used + 1);
+
+    const Key key(param->name);
+    Slot &slot = _slots[probe(key)];
+    if (nullptr != slot.param)
+    {
+        if (!slot.alias)
+            return false;
+        // the name stays with the alias, the parameter is still one of the table
+        _params.push_back(value_type(&param->name, param));
+        return true;
+    }
+
+    slot = Slot{ &param->name, param, key.hash, false };
+    _used++;
+    _params.push_back(value_type(&param->name, param));
+    return true;
+}
+
+bool ParamTable::insert_alias(const std::string &alias, Param *param)
+{
+    assert(param);
+    reserve(_used + 1);
+
+    const Key key(alias);
+    Slot &slot = _slots[probe(key)];
+    if (nullptr != slot.param)
+    {
+        if (slot.alias)
+            return false;
+        slot.param = param;
+        slot.alias = true;
+        return true;
+    }
+
+    _aliases.push_back(alias);
+    slot = Slot{ &_aliases.back(), param, key.hash, true };
+    _used++;
+    return true;
+}
+
+Param *ParamTable::find(const Key &key) const
+{
+    if (_slots.empty())
+        return nullptr;
+    return _slots[probe(key)].param;
+}
+
+
+// TESTS
+
+#include <TestRunner.hpp>
+
+#ifndef NDEBUG
+
+#include <memory>
+
+#define TEST(cond) if (!verify(#cond,cond)) return false
+
+struct ParamTableTest : public Test
+{
+    ParamTableTest() : Test("ParamTableTest")
+    {}
+
+    bool lookups()
+    {
+        std::vector<std::unique_ptr<Param>> params;
+        ParamTable table;
+        TEST(nullptr == table.find("zoom"));
+
+        // enough names to grow the table a few times
+        for (int i = 0; i < 200; i++)
+        {
+            params.emplace_back(Param::createUser("var" + std::to_string(i)));
+            TEST(table.insert(params.back().get()));
+        }
+        TEST(table.size() == 200);
+        for (int i = 0; i < 200; i++)
+        {
+            const std::string var = "var" + std::to_string(i);
+            TEST(table.find(var) == params[i].get());
+            TEST(table.find(ParamTable::Key(var.c_str(), var.size())) == params[i].get());
+        }
+        TEST(nullptr == table.find("var200"));
+        TEST(nullptr == table.find("var"));
+
+        // a key can be made from part of a longer text
+        TEST(table.find(ParamTable::Key("var17 = 1", 5)) == params[17].get());
+
+        std::unique_ptr<Param> duplicate(Param::createUser("var3"));
+        TEST(!table.insert(duplicate.get()));
+        TEST(table.find("var3") == params[3].get());
+
+        // iteration is in insertion order and skips aliases
+        TEST(table.insert_alias("other", params[5].get()));
+        TEST(table.find("other") == params[5].get());
+        TEST(table.size() == 200);
+        int index = 0;
+        for (auto &entry : table)
+        {
+            TEST(entry.second == params[index].get());
+            TEST(*entry.first == params[index]->name);
+            index++;
+        }
+
+        // an alias wins over a parameter of the same name, whichever came first
+        TEST(table.insert_alias("var7", params[8].get()));
+        TEST(table.find("var7") == params[8].get());
+        TEST(!table.insert_alias("var7", params[9].get()));
+        TEST(table.find("var7") == params[8].get());
+        params.emplace_back(Param::createUser("other"));
+        TEST(table.insert(params.back().get()));
+        TEST(table.find("other") == params[5].get());
+        TEST(table.size() == 201);
+        return true;
+    }
+
+    bool test() override
+    {
+        return lookups();
+    }
+};
+
+Test* ParamTable::test()
+{
+    return new ParamTableTest();
+}
+
+#else
+
+Test* ParamTable::test()
+{
+    return nullptr;
+}
+
+#endif
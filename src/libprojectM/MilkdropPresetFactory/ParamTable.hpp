@@ -0,0 +1,94 @@
+#ifndef PARAM_TABLE_HPP
+#define PARAM_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Param;
+class Test;
+
+/// Parameters by name: the builtins, the user variables of a preset, and the variables of a custom wave
+/// or shape. The parser looks up every identifier it reads, often in several of these tables.
+///
+/// A name is hashed once into a Key, which can then be looked up in any table. The slots are a flat
+/// array probed linearly and kept at most half full, so a lookup is one hash and usually a single
+/// string compare, and inserting allocates only when the table grows.
+///
+/// The table does not own the parameters. Iterating visits each parameter once in the order it was
+/// inserted, aliases are only seen by lookups.
+class ParamTable
+{
+public:
+    /// A name with its hash. It refers to the text it was made from, which has to outlive it.
+    struct Key
+    {
+        Key(const char *name) : Key(name, std::strlen(name)) {}
+        Key(const std::string &name) : Key(name.data(), name.size()) {}
+        Key(const char *name, std::size_t nameLength);
+
+        std::string str() const { return std::string(text, length); }
+
+        const char *text;
+        std::size_t length;
+        std::uint32_t hash;
+    };
+
+    typedef std::pair<const std::string *, Param *> value_type;
+    typedef std::vector<value_type>::iterator iterator;
+    typedef std::vector<value_type>::const_iterator const_iterator;
+
+    ParamTable() = default;
+    ParamTable(const ParamTable &) = delete;
+    ParamTable &operator=(const ParamTable &) = delete;
+
+    /// Adds param under param->name, which must not change while the parameter is in the table
+    /// \returns false if a parameter of that name was inserted before
+    bool insert(Param *param);
+
+    /// Makes param found under another name too. Like the alias map this replaces, an alias wins
+    /// over a parameter inserted under the same name, and the first alias of a name is kept.
+    bool insert_alias(const std::string &alias, Param *param);
+
+    /// \returns the parameter or nullptr
+    Param *find(const Key &key) const;
+
+    /// Makes room for count names, parameters and aliases together, so filling the table up to
+    /// that point does not grow it
+    void reserve(std::size_t count);
+
+    iterator begin() { return _params.begin(); }
+    iterator end() { return _params.end(); }
+    const_iterator begin() const { return _params.begin(); }
+    const_iterator end() const { return _params.end(); }
+
+    /// Number of parameters, not counting aliases
+    std::size_t size() const { return _params.size(); }
+    bool empty() const { return _params.empty(); }
+
+    static Test *test();
+
+private:
+    struct Slot
+    {
+        const std::string *name;
+        Param *param;
+        std::uint32_t hash;
+        bool alias;
+    };
+
+    /// The slot holding key, or the empty slot where it would go. The table must not be empty.
+    std::size_t probe(const Key &key) const;
+
+    std::vector<Slot> _slots;
+    std::size_t _used{ 0 };
+    std::vector<value_type> _params;
+    /// Alias names, the slots point into them
+    std::deque<std::string> _aliases;
+};
+
+#endif
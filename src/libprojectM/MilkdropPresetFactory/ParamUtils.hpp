@@ -9,18 +9,19 @@
 #include <map>
 #include <cassert>
 #include "BuiltinParams.hpp"
+#include "ParamTable.hpp"
 
 class ParamUtils
 {
 public:
-  static bool insert(Param * param, std::map<std::string,Param*> * paramTree)
+  static bool insert(Param * param, ParamTable * paramTree)
   {
 
     assert(param);
     assert(paramTree);
 
-    
-    return ((paramTree->insert(std::make_pair(param->name,param))).second);
+
+    return paramTree->insert(param);
 
   }
 
@@ -28,37 +29,32 @@ public:
   static const int NO_CREATE = 0;
 
   template <int FLAGS>
-  static Param * find(std::string name, std::map<std::string,Param*> * paramTree)
+  static Param * find(const ParamTable::Key & name, ParamTable * paramTree)
   {
 
     assert(paramTree);
 
-    Param * param;
-
     /* First look in the suggested database */
-    std::map<std::string,Param*>::iterator pos = paramTree->find(name);
-		
+    Param * param = paramTree->find(name);
 
-    if ((FLAGS == AUTO_CREATE) && ((pos == paramTree->end())))
+    if ((FLAGS == AUTO_CREATE) && (param == NULL))
     {
       /* Check if string is valid */
-      if (!Param::is_valid_param_string(name.c_str()))
+      const std::string nameString = name.str();
+      if (!Param::is_valid_param_string(nameString.c_str()))
         return NULL;
 
       /* Now, create the user defined parameter given the passed name */
-      if ((param = Param::createUser(name)) == NULL)
+      if ((param = Param::createUser(nameString)) == NULL)
         return NULL;
 
       /* Finally, insert the new parameter into this preset's parameter tree */
-      std::pair<std::map<std::string,Param*>::iterator, bool>  insertRetPair = 
-		paramTree->insert(std::make_pair(param->name, param));
+      const bool inserted = paramTree->insert(param);
+
+      assert(inserted);
+      (void) inserted;
 
-      assert(insertRetPair.second);
-	
-    } else if (pos != paramTree->end())
-	param = pos->second;
-    else
-	param = NULL;	
+    }
 
     /* Return the found (or created) parameter. Note that this could be null */
     return param;
@@ -67,7 +63,7 @@ public:
   }
 
 
-  static Param * find(const std::string & name, BuiltinParams * builtinParams, std::map<std::string,Param*> * insertionTree)
+  static Param * find(const ParamTable::Key & name, BuiltinParams * builtinParams, ParamTable * insertionTree)
   {
 
     Param * param;
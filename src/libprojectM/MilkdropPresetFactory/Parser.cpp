@@ -52,23 +52,6 @@
 /* Grabs the next token from the file. The second argument points
    to the raw string */
 
-line_mode_t Parser::line_mode;
-CustomWave *Parser::current_wave;
-CustomShape *Parser::current_shape;
-int Parser::string_line_buffer_index;
-char Parser::string_line_buffer[STRING_LINE_SIZE];
-unsigned int Parser::line_count;
-int Parser::per_frame_eqn_count;
-int Parser::per_frame_init_eqn_count;
-int Parser::last_custom_wave_id;
-int Parser::last_custom_shape_id;
-char Parser::last_eqn_type[MAX_TOKEN_SIZE+1];
-int Parser::last_token_size;
-
-std::string Parser::lastLinePrefix("");
-
-bool Parser::tokenWrapAroundEnabled(false);
-
 token_t Parser::parseToken(std::istream &  fs, char * string)
 {
 
@@ -885,13 +868,16 @@ Expr * Parser::_parse_gen_expr ( std::istream &  fs, TreeExpr * tree_expr, Milkd
     }
 
 
+    /* The name is looked up in up to three tables, hash it once */
+    const ParamTable::Key key(string);
+
     /* CASE 4: custom shape variable */
     if (current_shape != NULL)
     {
-      if ((param = ParamUtils::find<ParamUtils::NO_CREATE>(std::string(string), &current_shape->param_tree)) == NULL)
+      if ((param = ParamUtils::find<ParamUtils::NO_CREATE>(key, &current_shape->param_tree)) == NULL)
       {
-        if ((param = preset->builtinParams.find_builtin_param(std::string(string))) == NULL)
-          if ((param = ParamUtils::find<ParamUtils::AUTO_CREATE>(std::string(string), &current_shape->param_tree)) == NULL)
+        if ((param = preset->builtinParams.find_builtin_param(key)) == NULL)
+          if ((param = ParamUtils::find<ParamUtils::AUTO_CREATE>(key, &current_shape->param_tree)) == NULL)
           {
             if (tree_expr)
               Expr::delete_expr(tree_expr);
@@ -922,10 +908,10 @@ Expr * Parser::_parse_gen_expr ( std::istream &  fs, TreeExpr * tree_expr, Milkd
     /* CASE 5: custom wave variable */
     if (current_wave != NULL)
     {
-      if ((param = ParamUtils::find<ParamUtils::NO_CREATE>(std::string(string), &current_wave->param_tree)) == NULL)
+      if ((param = ParamUtils::find<ParamUtils::NO_CREATE>(key, &current_wave->param_tree)) == NULL)
       {
-        if ((param = preset->builtinParams.find_builtin_param(std::string(string))) == NULL)
-          if ((param = ParamUtils::find<ParamUtils::AUTO_CREATE>(std::string(string), &current_wave->param_tree)) == NULL)
+        if ((param = preset->builtinParams.find_builtin_param(key)) == NULL)
+          if ((param = ParamUtils::find<ParamUtils::AUTO_CREATE>(key, &current_wave->param_tree)) == NULL)
           {
             if (tree_expr)
               Expr::delete_expr(tree_expr);
@@ -955,7 +941,7 @@ Expr * Parser::_parse_gen_expr ( std::istream &  fs, TreeExpr * tree_expr, Milkd
     }
 
     /* CASE 6: regular parameter. Will be created if necessary and the string has no invalid characters */
-    if ((param = ParamUtils::find(string, &preset->builtinParams, &preset->user_param_tree)) != NULL)
+    if ((param = ParamUtils::find(key, &preset->builtinParams, &preset->user_param_tree)) != NULL)
     {
 
       if (PARSE_DEBUG)
@@ -1550,7 +1536,7 @@ void Parser::parse_string_block(std::istream &  fs, std::string * out_string) {
 
 }
 
-InitCond * Parser::parse_per_frame_init_eqn(std::istream &  fs, MilkdropPreset * preset, std::map<std::string,Param*> * database)
+InitCond * Parser::parse_per_frame_init_eqn(std::istream &  fs, MilkdropPreset * preset, ParamTable * database)
 {
 
   char name[MAX_TOKEN_SIZE];
@@ -2610,6 +2596,17 @@ else
 #ifndef NDEBUG
 
 #include <PresetLoader.hpp>
+#include "PerPointEqn.hpp"
+#include "Renderer/BeatDetect.hpp"
+#include "PCM.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#if USE_THREADS
+#include <atomic>
+#include <thread>
+#endif
 
 #define TEST(cond) if (!verify(#cond,cond)) return false
 #define TEST2(str,cond) if (!verify(str,cond)) return false
@@ -2619,6 +2616,7 @@ struct ParserTest : public Test
     ParserTest() : Test("ParserTest")
     {}
 
+    Parser parser;
     MilkdropPreset *preset;
     std::istringstream is;
     std::istringstream &ss(const char *s) { return is = std::istringstream(s); }
@@ -2633,33 +2631,33 @@ public:
     bool test_float()
     {
         float f=-1.0f;
-        TEST(PROJECTM_SUCCESS == Parser::parse_float(ss("1.1"),&f));
+        TEST(PROJECTM_SUCCESS == parser.parse_float(ss("1.1"),&f));
         TEST(1.1f == f);
-        TEST(PROJECTM_SUCCESS == Parser::parse_float(ss("+1.2"),&f));
-        TEST(PROJECTM_SUCCESS == Parser::parse_float(ss("-1.3"),&f));
-        TEST(PROJECTM_PARSE_ERROR == Parser::parse_float(ss(""),&f));
-        TEST(PROJECTM_PARSE_ERROR == Parser::parse_float(ss("\n"),&f));
-        TEST(PROJECTM_PARSE_ERROR == Parser::parse_float(ss("+"),&f));
+        TEST(PROJECTM_SUCCESS == parser.parse_float(ss("+1.2"),&f));
+        TEST(PROJECTM_SUCCESS == parser.parse_float(ss("-1.3"),&f));
+        TEST(PROJECTM_PARSE_ERROR == parser.parse_float(ss(""),&f));
+        TEST(PROJECTM_PARSE_ERROR == parser.parse_float(ss("\n"),&f));
+        TEST(PROJECTM_PARSE_ERROR == parser.parse_float(ss("+"),&f));
         return true;
     }
 
     bool test_int()
     {
         int i=-1;
-        TEST(PROJECTM_SUCCESS == Parser::parse_int(ss("1"),&i));
+        TEST(PROJECTM_SUCCESS == parser.parse_int(ss("1"),&i));
         TEST(1 == i);
-        TEST(PROJECTM_SUCCESS == Parser::parse_int(ss("+2"),&i));
-        TEST(PROJECTM_SUCCESS == Parser::parse_int(ss("-3"),&i));
-        TEST(PROJECTM_PARSE_ERROR == Parser::parse_int(ss(""),&i));
-        TEST(PROJECTM_PARSE_ERROR == Parser::parse_int(ss("\n"),&i));
-        TEST(PROJECTM_PARSE_ERROR == Parser::parse_int(ss("+"),&i));
+        TEST(PROJECTM_SUCCESS == parser.parse_int(ss("+2"),&i));
+        TEST(PROJECTM_SUCCESS == parser.parse_int(ss("-3"),&i));
+        TEST(PROJECTM_PARSE_ERROR == parser.parse_int(ss(""),&i));
+        TEST(PROJECTM_PARSE_ERROR == parser.parse_int(ss("\n"),&i));
+        TEST(PROJECTM_PARSE_ERROR == parser.parse_int(ss("+"),&i));
         return true;
     }
 
     bool eval_expr(float expected, const char *s)
     {
         float result;
-        Expr *expr_parse = Parser::parse_gen_expr(ss(s),nullptr,preset);
+        Expr *expr_parse = parser.parse_gen_expr(ss(s),nullptr,preset);
         TEST(expr_parse != nullptr);
         // Expr doesn't really expect to run 'non-optimized' expressions any longer
         Expr *expr = Expr::optimize(expr_parse);
@@ -2688,7 +2686,7 @@ public:
         TEST(eval_expr(0.99f, "rot"));
 
 				// random other stuff to parse
-				Parser::parse_gen_expr(ss("0.5 + 0.5*sin(q8*0.613 + 1);"),nullptr,preset);
+				parser.parse_gen_expr(ss("0.5 + 0.5*sin(q8*0.613 + 1);"),nullptr,preset);
         return true;
     }
 
@@ -2705,6 +2703,192 @@ public:
         return true;
     }
 
+    // per frame init equations are evaluated while parsing and may use rand(), so only compare
+    // their values for plain initial conditions
+    static void dump(std::ostream &out, const std::map<std::string,InitCond*> &conds, bool values)
+    {
+        for (auto &cond : conds)
+        {
+            out << cond.first << "=";
+            if (!values)
+            {
+                out << "; ";
+                continue;
+            }
+            switch (cond.second->param->type)
+            {
+            case P_TYPE_BOOL: out << cond.second->init_val.bool_val; break;
+            case P_TYPE_INT: out << cond.second->init_val.int_val; break;
+            default: out << cond.second->init_val.float_val; break;
+            }
+            out << "; ";
+        }
+        out << std::endl;
+    }
+
+    static void dump(std::ostream &out, const std::vector<PerFrameEqn*> &eqns)
+    {
+        for (auto eqn : eqns)
+            out << eqn->param->name << "=" << eqn->gen_expr << "; ";
+        out << std::endl;
+    }
+
+    /// Text form of everything the parser produced for a preset, used to compare parses
+    static std::string dump(const PresetLoader &loader, PresetIndex index)
+    {
+        std::ostringstream out;
+        std::unique_ptr<Preset> preset;
+        try {
+            preset = loader.loadPreset(loader.getPresetURL(index), loader.getPresetName(index));
+        } catch (const std::exception &e) {
+            out << "exception " << e.what();
+            return out.str();
+        }
+
+        auto milkdropPreset = dynamic_cast<MilkdropPreset *>(preset.get());
+        if (nullptr == milkdropPreset)
+            return out.str();
+
+        dump(out, milkdropPreset->init_cond_tree, true);
+        dump(out, milkdropPreset->per_frame_init_eqn_tree, false);
+        dump(out, milkdropPreset->per_frame_eqn_tree);
+        out << milkdropPreset->per_pixel_program.tree() << std::endl;
+        for (auto wave : milkdropPreset->customWaves)
+        {
+            out << "wave " << wave->id << std::endl;
+            dump(out, wave->init_cond_tree, true);
+            dump(out, wave->per_frame_init_eqn_tree, false);
+            dump(out, wave->per_frame_eqn_tree);
+            out << wave->per_point_program.tree() << std::endl;
+        }
+        for (auto shape : milkdropPreset->customShapes)
+        {
+            out << "shape " << shape->id << std::endl;
+            dump(out, shape->init_cond_tree, true);
+            dump(out, shape->per_frame_init_eqn_tree, false);
+            dump(out, shape->per_frame_eqn_tree);
+        }
+        return out.str();
+    }
+
+    // parse every preset in PROJECTM_TEST_PRESET_DIR (default "presets") on several threads at once
+    // and check that the results are the same as parsing them one after another
+    bool test_parallel()
+    {
+#if USE_THREADS
+        const char *dir = getenv("PROJECTM_TEST_PRESET_DIR");
+        PresetLoader loader(32, 24, dir ? dir : "presets");
+        if (0 == loader.size())
+        {
+            std::cout << "ParserTest: no presets found, skipping parallel parse" << std::endl;
+            return true;
+        }
+
+        std::vector<std::string> expected(loader.size());
+        for (PresetIndex i = 0; i < loader.size(); i++)
+            expected[i] = dump(loader, i);
+
+        std::vector<std::string> actual(loader.size());
+        std::atomic<PresetIndex> next(0);
+        std::vector<std::thread> threads;
+        unsigned int threadCount = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+        for (unsigned int t = 0; t < threadCount; t++)
+        {
+            threads.emplace_back([&]() {
+                for (PresetIndex i = next++; i < loader.size(); i = next++)
+                    actual[i] = dump(loader, i);
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+
+        for (PresetIndex i = 0; i < loader.size(); i++)
+            TEST2(loader.getPresetURL(i).c_str(), expected[i] == actual[i]);
+#endif
+        return true;
+    }
+
+
+    // render one frame of every preset in PROJECTM_TEST_PRESET_DIR and report how many per point node
+    // evaluations of the per pixel programs were moved to once per frame
+    bool test_hoisting()
+    {
+        const char *dir = getenv("PROJECTM_TEST_PRESET_DIR");
+        PresetLoader loader(32, 24, dir ? dir : "presets");
+        if (0 == loader.size())
+        {
+            std::cout << "ParserTest: no presets found, skipping hoisting report" << std::endl;
+            return true;
+        }
+
+        PCM pcm;
+        BeatDetect beatDetect(&pcm);
+        PipelineContext context;
+        context.fps = 60;
+        ExprHoistStats total;
+        int programs = 0;
+        for (PresetIndex i = 0; i < loader.size(); i++)
+        {
+            std::unique_ptr<Preset> loaded;
+            try {
+                loaded = loader.loadPreset(loader.getPresetURL(i), loader.getPresetName(i));
+            } catch (...) {
+                continue;
+            }
+            auto milkdropPreset = dynamic_cast<MilkdropPreset *>(loaded.get());
+            if (nullptr == milkdropPreset)
+                continue;
+
+            milkdropPreset->Render(beatDetect, context);
+            const ExprHoistStats &stats = milkdropPreset->per_pixel_hoist_stats;
+            TEST(stats.removed <= stats.nodes);
+            total.nodes += stats.nodes;
+            total.removed += stats.removed;
+            total.invariants += stats.invariants;
+            programs += milkdropPreset->per_pixel_program ? 1 : 0;
+        }
+        std::cout << "ParserTest: hoisting removed " << total.removed << " of " << total.nodes
+                  << " per point node evaluations (" << total.invariants << " subexpressions) in "
+                  << programs << " per pixel programs" << std::endl;
+        return true;
+    }
+
+    // parse every preset in PROJECTM_TEST_PRESET_DIR a few times and report the best rate. The
+    // equations stay on the tree, so this measures the parser and not the compilers.
+    bool test_throughput()
+    {
+        const char *dir = getenv("PROJECTM_TEST_PRESET_DIR");
+        PresetLoader loader(32, 24, dir ? dir : "presets");
+        if (0 == loader.size())
+        {
+            std::cout << "ParserTest: no presets found, skipping parse throughput" << std::endl;
+            return true;
+        }
+
+        const ExprEngine selected = Expr::engine();
+        Expr::set_engine(EXPR_ENGINE_TREE);
+        double best = 0;
+        std::size_t parsed = 0;
+        for (int round = 0; round < 3; round++)
+        {
+            parsed = 0;
+            const auto begin = std::chrono::steady_clock::now();
+            for (PresetIndex i = 0; i < loader.size(); i++)
+            {
+                try {
+                    parsed += loader.loadPreset(loader.getPresetURL(i), loader.getPresetName(i)) ? 1 : 0;
+                } catch (...) {
+                }
+            }
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            if (seconds > 0)
+                best = std::max(best, parsed / seconds);
+        }
+        Expr::set_engine(selected);
+
+        std::cout << "ParserTest: parsed " << parsed << " presets, " << best << " presets/s" << std::endl;
+        return true;
+    }
 
     bool _test()
     {
@@ -2714,6 +2898,9 @@ public:
         success &= test_eqn();
         success &= test_lines();
         success &= test_params();
+        success &= test_parallel();
+        success &= test_hoisting();
+        success &= test_throughput();
         return success;
     }
 
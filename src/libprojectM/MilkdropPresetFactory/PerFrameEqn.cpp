@@ -44,10 +44,8 @@ void PerFrameEqn::evaluate()
      }
 	 
     //*((float*)per_frame_eqn->param->engine_val) = eval(per_frame_eqn->gen_expr);
-	assert(gen_expr);
-	assert(param);
-	float v = gen_expr->eval(-1,-1);
-	param->set_param(v);
+	assert(assign_expr);
+	float v = assign_expr->eval(-1,-1);
 
 	if (PER_FRAME_EQN_DEBUG) printf(" = %.4f\n", v);
 }
@@ -56,11 +54,16 @@ void PerFrameEqn::evaluate()
 /* Frees perframe equation structure. Warning: assumes gen_expr pointer is not freed by anyone else! */
 PerFrameEqn::~PerFrameEqn()
 {
-    Expr::delete_expr(gen_expr);
+    Expr::delete_expr(assign_expr);
 
     // param is freed in param_tree container of some other class
 }
 
 /* Create a new per frame equation */
 PerFrameEqn::PerFrameEqn(int _index, Param * _param, Expr * _gen_expr) :
-	index(_index), param(_param), gen_expr(_gen_expr) {}
+	index(_index), param(_param), gen_expr(_gen_expr)
+{
+	assert(param);
+	assert(gen_expr);
+	assign_expr = Expr::create_assignment(param, gen_expr);
+}
@@ -40,6 +40,7 @@ public:
     int index; /* a unique id for each per frame eqn (generated by order in preset files) */
     Param *param; /* parameter to be assigned a value */
     Expr *gen_expr;   /* expression that paremeter is equal to */
+    Expr *assign_expr; /* param = gen_expr, owns gen_expr */
      
     PerFrameEqn(int index, Param * param, Expr * gen_expr);
     ~PerFrameEqn();
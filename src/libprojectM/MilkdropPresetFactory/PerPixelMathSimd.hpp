@@ -0,0 +1,143 @@
+#ifndef PER_PIXEL_MATH_SIMD_HPP
+#define PER_PIXEL_MATH_SIMD_HPP
+
+#include "SimdMath.hpp"
+
+namespace SimdMath {
+
+/// The mesh planes and per frame values of PresetOutputs::PerPixelMath as plain arrays, so the
+/// kernels do not use the inline accessors of MeshBuffer (see SimdMath_avx2.cpp).
+struct PerPixelMesh
+{
+    /// Points in each plane, including the padding at the end of the rows
+    int count;
+
+    float warpScaleInv;
+    /// Warp frequencies, f[] of PerPixelMath_c
+    float f[4];
+    /// Warp phases at the current time, reduced to [0, 2 pi)
+    float phase0333;
+    float phase0753;
+    float phase0375;
+    float phase0825;
+
+    const float *orig_x;
+    const float *orig_y;
+    const float *rad_mesh;
+    const float *zoom_mesh;
+    const float *zoomexp_mesh;
+    const float *cx_mesh;
+    const float *cy_mesh;
+    const float *sx_mesh;
+    const float *sy_mesh;
+    const float *warp_mesh;
+    const float *rot_mesh;
+    const float *dx_mesh;
+    const float *dy_mesh;
+
+    float *x_mesh;
+    float *y_mesh;
+};
+
+/// Vectorized version of PresetOutputs::PerPixelMath_c for the instruction set V.
+///
+/// Every output only depends on the inputs at the same mesh point, so the planes are processed as
+/// one flat array including the padding at the end of the rows.
+template <class V>
+void perPixelMath(const PerPixelMesh &mesh)
+{
+    typedef typename V::Float Float;
+
+    const Float phase0333 = V::set(mesh.phase0333);
+    const Float phase0753 = V::set(mesh.phase0753);
+    const Float phase0375 = V::set(mesh.phase0375);
+    const Float phase0825 = V::set(mesh.phase0825);
+
+    const Float warpScaleInv = V::set(mesh.warpScaleInv);
+    const Float f0 = V::set(mesh.f[0]);
+    const Float f1 = V::set(mesh.f[1]);
+    const Float f2 = V::set(mesh.f[2]);
+    const Float f3 = V::set(mesh.f[3]);
+    const Float zero = V::set(0.0f);
+    const Float half = V::set(0.5f);
+    const Float one = V::set(1.0f);
+    const Float two = V::set(2.0f);
+    const Float signBit = V::set(-0.0f);
+
+    for (int i = 0; i < mesh.count; i += V::width)
+    {
+        const Float orig_x2 = V::load(mesh.orig_x + i);
+        const Float orig_y2 = V::load(mesh.orig_y + i);
+
+        // zoom and stretch
+        // fZoom2Inv = pow(zoom_mesh, -pow(zoomexp_mesh, rad_mesh * 2 - 1))
+        const Float zoom_mesh2 = V::load(mesh.zoom_mesh + i);
+        Float fZoom2Inv = one;
+        if (!V::allTrue(V::equal(zoom_mesh2, one)))
+        {
+            const Float rad_mesh_scaled = V::sub(V::mul(V::load(mesh.rad_mesh + i), two), one);
+            const Float zoomExponent = pow<V>(V::load(mesh.zoomexp_mesh + i), rad_mesh_scaled);
+            fZoom2Inv = pow<V>(zoom_mesh2, V::bitXor(zoomExponent, signBit));
+        }
+        const Float halfZoomInv = V::mul(fZoom2Inv, half);
+
+        // u = (orig_x2 * 0.5f * fZoom2Inv + 0.5f - cx_mesh) / sx_mesh + cx_mesh
+        const Float cx_mesh2 = V::load(mesh.cx_mesh + i);
+        const Float cy_mesh2 = V::load(mesh.cy_mesh + i);
+        Float u = V::mulAdd(orig_x2, halfZoomInv, half);
+        u = V::add(V::div(V::sub(u, cx_mesh2), V::load(mesh.sx_mesh + i)), cx_mesh2);
+        Float v = V::mulAdd(orig_y2, halfZoomInv, half);
+        v = V::add(V::div(V::sub(v, cy_mesh2), V::load(mesh.sy_mesh + i)), cy_mesh2);
+
+        // warp
+        const Float warp_mesh1 = V::load(mesh.warp_mesh + i);
+        if (!V::allTrue(V::equal(warp_mesh1, zero)))
+        {
+            const Float warp_mesh2 = V::mul(warp_mesh1, V::set(0.0035f));
+
+            // u += warp_mesh2 * (sinf(fWarpTime * 0.333f + fWarpScaleInv * (orig_x2 * f[0] - orig_y2 * f[3])) +
+            //                    cosf(fWarpTime * 0.753f - fWarpScaleInv * (orig_x2 * f[1] - orig_y2 * f[2])));
+            const Float sinU = sin<V>(
+                    V::mulAdd(warpScaleInv, V::sub(V::mul(orig_x2, f0), V::mul(orig_y2, f3)), phase0333));
+            const Float cosU = cos<V>(
+                    V::negMulAdd(warpScaleInv, V::sub(V::mul(orig_x2, f1), V::mul(orig_y2, f2)), phase0753));
+            u = V::mulAdd(warp_mesh2, V::add(sinU, cosU), u);
+
+            // v += warp_mesh2 * (cosf(fWarpTime * 0.375f - fWarpScaleInv * (orig_x2 * f[2] + orig_y2 * f[1])) +
+            //                    sinf(fWarpTime * 0.825f + fWarpScaleInv * (orig_x2 * f[0] + orig_y2 * f[3])));
+            const Float cosV = cos<V>(
+                    V::negMulAdd(warpScaleInv, V::mulAdd(orig_x2, f2, V::mul(orig_y2, f1)), phase0375));
+            const Float sinV = sin<V>(
+                    V::mulAdd(warpScaleInv, V::mulAdd(orig_x2, f0, V::mul(orig_y2, f3)), phase0825));
+            v = V::mulAdd(warp_mesh2, V::add(cosV, sinV), v);
+        }
+
+        // rotate
+        const Float rot_mesh2 = V::load(mesh.rot_mesh + i);
+        if (!V::allTrue(V::equal(rot_mesh2, zero)))
+        {
+            Float sin_rot, cos_rot;
+            sincos<V>(rot_mesh2, sin_rot, cos_rot);
+
+            // u = u2 * cos_rot - v2 * sin_rot + cx_mesh
+            // v = u2 * sin_rot + v2 * cos_rot + cy_mesh
+            const Float u2 = V::sub(u, cx_mesh2);
+            const Float v2 = V::sub(v, cy_mesh2);
+            u = V::add(V::negMulAdd(v2, sin_rot, V::mul(u2, cos_rot)), cx_mesh2);
+            v = V::add(V::mulAdd(u2, sin_rot, V::mul(v2, cos_rot)), cy_mesh2);
+        }
+
+        // translate
+        V::store(mesh.x_mesh + i, V::sub(u, V::load(mesh.dx_mesh + i)));
+        V::store(mesh.y_mesh + i, V::sub(v, V::load(mesh.dy_mesh + i)));
+    }
+}
+
+#if HAVE_AVX2_KERNELS
+/// Defined in SimdMath_avx2.cpp, only call it if cpuSupportsAvx2Fma() is true
+void perPixelMathAvx2(const PerPixelMesh &mesh);
+#endif
+
+}
+
+#endif
@@ -6,9 +6,7 @@
 #include <cmath>
 #include "Renderer/BeatDetect.hpp"
 
-#ifdef __SSE2__
-#include <immintrin.h>
-#endif
+#include "PerPixelMathSimd.hpp"
 
 
 PresetInputs::PresetInputs() : PipelineContext()
@@ -37,31 +35,6 @@ void PresetInputs::update(const BeatDetect & music, const PipelineContext & cont
 }
 
 
-float **alloc_mesh(size_t gx, size_t gy)
-{
-	// round gy up to multiple 4 (for possible SSE optimization)
-	gy = (gy+3) & ~(size_t)3;
-
-	float **mesh = (float **)wipe_aligned_alloc(gx * sizeof(float *));
-	float *m = (float *)wipe_aligned_alloc(gx * gy * sizeof(float));
-	for (unsigned int x = 0; x < gx; x++ )
-		mesh[x] = m + (gy * x);
-	return mesh;
-}
-
-float **free_mesh(float **mesh)
-{
-	wipe_aligned_free(mesh[0]);
-	wipe_aligned_free(mesh);
-	return NULL;
-}
-
-void copy_mesh(float **dst, float **src, int gx, int gy)
-{
-	memcpy(dst[0], src[0], gx*gy*sizeof(float));
-}
-
-
 void PresetInputs::Initialize ( int _gx, int _gy )
 {
 	int x, y;
@@ -81,23 +54,20 @@ void PresetInputs::Initialize ( int _gx, int _gy )
 	ang_per_pixel = 0;
 	// ***
 
-	this->x_mesh    = alloc_mesh(gx, gy);
-	this->y_mesh    = alloc_mesh(gx, gy);
-	this->rad_mesh  = alloc_mesh(gx, gy);
-	this->theta_mesh= alloc_mesh(gx, gy);
-	this->origtheta = alloc_mesh(gx, gy);
-	this->origrad   = alloc_mesh(gx, gy);
-	this->origx     = alloc_mesh(gx, gy);
-	this->origy     = alloc_mesh(gx, gy);
+	meshBuffer.allocate(gx, gy, 4);
+	this->origtheta = meshBuffer.plane(0);
+	this->origrad   = meshBuffer.plane(1);
+	this->origx     = meshBuffer.plane(2);
+	this->origy     = meshBuffer.plane(3);
 
-	for ( x=0;x<gx;x++ )
+	for ( y=0;y<gy;y++ )
 	{
-		for ( y=0;y<gy;y++ )
+		for ( x=0;x<gx;x++ )
 		{
-			this->origx[x][y]=x/ ( float ) ( gx-1 );
-			this->origy[x][y]= - ( ( y/ ( float ) ( gy-1 ) )-1 );
-			this->origrad[x][y]=hypot ( ( this->origx[x][y]-.5 ) *2, ( this->origy[x][y]-.5 ) *2 ) * .7071067;
-			this->origtheta[x][y]=atan2 ( ( ( this->origy[x][y]-.5 ) *2 ), ( ( this->origx[x][y]-.5 ) *2 ) );
+			this->origx(x, y)=x/ ( float ) ( gx-1 );
+			this->origy(x, y)= - ( ( y/ ( float ) ( gy-1 ) )-1 );
+			this->origrad(x, y)=hypot ( ( this->origx(x, y)-.5 ) *2, ( this->origy(x, y)-.5 ) *2 ) * .7071067;
+			this->origtheta(x, y)=atan2 ( ( ( this->origy(x, y)-.5 ) *2 ), ( ( this->origx(x, y)-.5 ) *2 ) );
 		}
 	}
 }
@@ -111,20 +81,6 @@ PresetOutputs::~PresetOutputs()
 {
 	assert(this->gx > 0);
 
-	this->rad_mesh = free_mesh(this->rad_mesh);
-	this->sx_mesh  = free_mesh(this->sx_mesh);
-	this->sy_mesh  = free_mesh(this->sy_mesh);
-	this->dy_mesh  = free_mesh(this->dy_mesh);
-	this->dx_mesh  = free_mesh(this->dx_mesh);
-	this->cy_mesh  = free_mesh(this->cy_mesh);
-	this->cx_mesh  = free_mesh(this->cx_mesh);
-	this->warp_mesh = free_mesh(this->warp_mesh);
-	this->zoom_mesh = free_mesh(this->zoom_mesh);
-	this->zoomexp_mesh = free_mesh(this->zoomexp_mesh);
-	this->rot_mesh = free_mesh(this->rot_mesh);
-	this->orig_x   = free_mesh(this->orig_x);
-	this->orig_y   = free_mesh(this->orig_y);
-
     customWaves.clear();
     customShapes.clear();
     drawables.clear();
@@ -187,25 +143,25 @@ void PresetOutputs::PerPixelMath_c(const PipelineContext &context)
     f[2] = 10.54f + 3.0f * cosf(fWarpTime * 1.233f + 3);
     f[3] = 11.49f + 4.0f * cosf(fWarpTime * 0.933f + 5);
 
-    for (int x = 0; x < gx; x++)
+    for (int y = 0; y < gy; y++)
 	{
-		for (int y = 0; y < gy; y++)
+		for (int x = 0; x < gx; x++)
 		{
-            const float orig_x2 = this->orig_x[x][y];
-            const float orig_y2 = this->orig_y[x][y];
+            const float orig_x2 = this->orig_x(x, y);
+            const float orig_y2 = this->orig_y(x, y);
 
             // zoom and stretch
-            const float fZoom2Inv = this->zoom_mesh[x][y] == 1.0 ? 1.0 :
-                    std::pow(this->zoom_mesh[x][y], -1*std::pow(this->zoomexp_mesh[x][y], rad_mesh[x][y] * 2.0f - 1.0f));
+            const float fZoom2Inv = this->zoom_mesh(x, y) == 1.0 ? 1.0 :
+                    std::pow(this->zoom_mesh(x, y), -1*std::pow(this->zoomexp_mesh(x, y), rad_mesh(x, y) * 2.0f - 1.0f));
 			float u = orig_x2 * 0.5f * fZoom2Inv + 0.5f;
-			u = (u - this->cx_mesh[x][y]) / this->sx_mesh[x][y] + this->cx_mesh[x][y];
+			u = (u - this->cx_mesh(x, y)) / this->sx_mesh(x, y) + this->cx_mesh(x, y);
 			float v = orig_y2 * 0.5f * fZoom2Inv + 0.5f;
-			v = (v - this->cy_mesh[x][y]) / this->sy_mesh[x][y] + this->cy_mesh[x][y];
+			v = (v - this->cy_mesh(x, y)) / this->sy_mesh(x, y) + this->cy_mesh(x, y);
 
             // warp
-            if (this->warp_mesh[x][y] != 0.0)
+            if (this->warp_mesh(x, y) != 0.0)
             {
-                const float warp_mesh2 = this->warp_mesh[x][y] * 0.0035f;
+                const float warp_mesh2 = this->warp_mesh(x, y) * 0.0035f;
                 u += warp_mesh2 * (sinf(fWarpTime * 0.333f + fWarpScaleInv * (orig_x2 * f[0] - orig_y2 * f[3])) +
                                    cosf(fWarpTime * 0.753f - fWarpScaleInv * (orig_x2 * f[1] - orig_y2 * f[2])));
 
@@ -216,234 +172,96 @@ void PresetOutputs::PerPixelMath_c(const PipelineContext &context)
 			// rotate and translate
 			if (rot != 0.0)
             {
-                const float cos_rot = cosf(this->rot_mesh[x][y]);
-                const float sin_rot = sinf(this->rot_mesh[x][y]);
-                const float u2 = u - this->cx_mesh[x][y];
-                const float v2 = v - this->cy_mesh[x][y];
-                u = u2 * cos_rot - v2 * sin_rot + this->cx_mesh[x][y];
-                v = u2 * sin_rot + v2 * cos_rot + this->cy_mesh[x][y];
+                const float cos_rot = cosf(this->rot_mesh(x, y));
+                const float sin_rot = sinf(this->rot_mesh(x, y));
+                const float u2 = u - this->cx_mesh(x, y);
+                const float v2 = v - this->cy_mesh(x, y);
+                u = u2 * cos_rot - v2 * sin_rot + this->cx_mesh(x, y);
+                v = u2 * sin_rot + v2 * cos_rot + this->cy_mesh(x, y);
             }
-            this->x_mesh[x][y] = u - this->dx_mesh[x][y];
-            this->y_mesh[x][y] = v - this->dy_mesh[x][y];
+            this->x_mesh(x, y) = u - this->dx_mesh(x, y);
+            this->y_mesh(x, y) = v - this->dy_mesh(x, y);
 		}
 	}
 }
 
 
-#ifdef __SSE2__
-
-// is there an SSE way to do this?
-inline __m128 _mm_pow(__m128 x, __m128 y)
+SimdMath::PerPixelMesh PresetOutputs::perPixelMesh(const PipelineContext &context)
 {
-	float X[4];
-	float Y[4];
-	_mm_store_ps(X,x);
-	_mm_store_ps(Y,y);
-	X[0] = __builtin_powf(X[0],Y[0]);
-	X[1] = __builtin_powf(X[1],Y[1]);
-	X[2] = __builtin_powf(X[2],Y[2]);
-	X[3] = __builtin_powf(X[3],Y[3]);
-	return _mm_load_ps(X);
-}
-inline void _mm_sincosf(__m128 x, __m128 &sinx, __m128 &cosx)
-{
-	float X[4], S[4], C[4];
-	_mm_store_ps(X,x);
-	S[0] = sinf(X[0]);
-	C[0] = cosf(X[0]);
-	S[1] = sinf(X[1]);
-	C[1] = cosf(X[1]);
-	S[2] = sinf(X[2]);
-	C[2] = cosf(X[2]);
-	S[3] = sinf(X[3]);
-	C[3] = cosf(X[3]);
-	sinx = _mm_load_ps(S);
-	cosx = _mm_load_ps(C);
-}
-inline __m128 _mm_sinf(__m128 x)
-{
-	float X[4];
-	_mm_store_ps(X,x);
-	X[0] = sinf(X[0]);
-	X[1] = sinf(X[1]);
-	X[2] = sinf(X[2]);
-	X[3] = sinf(X[3]);
-	return _mm_load_ps(X);
+	SimdMath::PerPixelMesh mesh;
+	mesh.count = static_cast<int>(meshBuffer.planeSize());
+
+	const float fWarpTime = context.time * this->fWarpAnimSpeed;
+	mesh.warpScaleInv = 1.0f / this->fWarpScale;
+	mesh.f[0] = 11.68f + 4.0f * cosf(fWarpTime * 1.413f + 10);
+	mesh.f[1] = 8.77f + 3.0f * cosf(fWarpTime * 1.113f + 7);
+	mesh.f[2] = 10.54f + 3.0f * cosf(fWarpTime * 1.233f + 3);
+	mesh.f[3] = 11.49f + 4.0f * cosf(fWarpTime * 0.933f + 5);
+
+	// The warp phases grow with the time, reduce them here so the kernels stay in their accurate range
+	const double twoPi = 6.283185307179586;
+	mesh.phase0333 = static_cast<float>(std::fmod(fWarpTime * 0.333, twoPi));
+	mesh.phase0753 = static_cast<float>(std::fmod(fWarpTime * 0.753, twoPi));
+	mesh.phase0375 = static_cast<float>(std::fmod(fWarpTime * 0.375, twoPi));
+	mesh.phase0825 = static_cast<float>(std::fmod(fWarpTime * 0.825, twoPi));
+
+	mesh.orig_x = this->orig_x.data();
+	mesh.orig_y = this->orig_y.data();
+	mesh.rad_mesh = this->rad_mesh.data();
+	mesh.zoom_mesh = this->zoom_mesh.data();
+	mesh.zoomexp_mesh = this->zoomexp_mesh.data();
+	mesh.cx_mesh = this->cx_mesh.data();
+	mesh.cy_mesh = this->cy_mesh.data();
+	mesh.sx_mesh = this->sx_mesh.data();
+	mesh.sy_mesh = this->sy_mesh.data();
+	mesh.warp_mesh = this->warp_mesh.data();
+	mesh.rot_mesh = this->rot_mesh.data();
+	mesh.dx_mesh = this->dx_mesh.data();
+	mesh.dy_mesh = this->dy_mesh.data();
+	mesh.x_mesh = this->x_mesh.data();
+	mesh.y_mesh = this->y_mesh.data();
+	return mesh;
 }
-inline __m128 _mm_cosf(__m128 x)
+
+
+#ifdef __SSE2__
+void PresetOutputs::PerPixelMath_sse(const PipelineContext &context)
 {
-	float X[4];
-	_mm_store_ps(X,x);
-	X[0] = cosf(X[0]);
-	X[1] = cosf(X[1]);
-	X[2] = cosf(X[2]);
-	X[3] = cosf(X[3]);
-	return _mm_load_ps(X);
+	SimdMath::perPixelMath<SimdMath::Sse2>(perPixelMesh(context));
 }
+#endif
 
 
-void PresetOutputs::PerPixelMath_sse(const PipelineContext &context)
+#ifdef __ARM_NEON
+void PresetOutputs::PerPixelMath_neon(const PipelineContext &context)
 {
-	const float fWarpTime = context.time * this->fWarpAnimSpeed;
-	const float fWarpScaleInv = 1.0f / this->fWarpScale;
-	const float f[4] =
-	{
-		11.68f + 4.0f * cosf(fWarpTime * 1.413f + 10),
-		 8.77f + 3.0f * cosf(fWarpTime * 1.113f + 7),
-		10.54f + 3.0f * cosf(fWarpTime * 1.233f + 3),
-		11.49f + 4.0f * cosf(fWarpTime * 0.933f + 5)
-	};
+	SimdMath::perPixelMath<SimdMath::Neon>(perPixelMesh(context));
+}
+#endif
 
-	for (int x = 0; x < gx; x++)
-	{
-		for (int y = 0; y < gy; y += 4)
-		{
-            // const float orig_x2 = this->orig_x[x][y];
-            // const float orig_y2 = this->orig_y[x][y];
-			const __m128 orig_x2 = _mm_load_ps(&this->orig_x[x][y]);
-			const __m128 orig_y2 = _mm_load_ps(&this->orig_y[x][y]);
-
-			bool zoomOne = this->zoom_mesh[x][y] == 1.0 && this->zoom_mesh[x][y+1] == 1.0 && this->zoom_mesh[x][y+2] == 1.0 && this->zoom_mesh[x][y+3] == 1.0;
-			__m128 fZoom2Inv = _mm_set_ps1(1.0f);
-			if (!zoomOne)
-			{
-                // fZoom2 = std::pow(this->zoom_mesh[x][y], std::pow(this->zoomexp_mesh[x][y],
-                // 		rad_mesh[x][y] * 2.0f - 1.0f));
-                const __m128 rad_mesh_scaled =
-                    _mm_sub_ps(
-                        _mm_mul_ps(
-                            _mm_load_ps(&this->rad_mesh[x][y]),
-                            _mm_set_ps1(2.0f)),
-                        _mm_set_ps1(1.0f));
-                const __m128 zoom_mesh2 = _mm_load_ps(&this->zoom_mesh[x][y]);
-                const __m128 zoomexp_mesh2 = _mm_load_ps(&this->zoomexp_mesh[x][y]);
-                const __m128 fZoom2 = _mm_pow(zoom_mesh2, _mm_pow(zoomexp_mesh2, rad_mesh_scaled));
-                // fZoom2Inv = 1.0f / fZoom2;
-                fZoom2Inv = _mm_rcp_ps(fZoom2);
-			}
-
-			// float u = orig_x2 * 0.5f * fZoom2Inv + 0.5f;
-            __m128 u =
-				_mm_add_ps(
-					_mm_mul_ps(
-						orig_x2,
-						_mm_mul_ps(fZoom2Inv,_mm_set_ps1(0.5f))),		// CONSIDER: common sub-expression
-					_mm_set_ps1(0.5f));
-			// u = (u - this->cx_mesh[x][y]) / this->sx_mesh[x][y] + this->cx_mesh[x][y];
-            const __m128 cx_mesh2 = _mm_load_ps(&this->cx_mesh[x][y]);
-            const __m128 sx_mesh2 = _mm_load_ps(&this->sx_mesh[x][y]);
-			u = _mm_add_ps(
-					_mm_div_ps(
-                        _mm_sub_ps(u,cx_mesh2),
-                        sx_mesh2),
-                    cx_mesh2
-				);
-
-			// float v = orig_y2 * 0.5f * fZoom2Inv + 0.5f;
-            __m128 v =
-				_mm_add_ps(
-					_mm_mul_ps(
-						orig_y2,
-						_mm_mul_ps(fZoom2Inv,_mm_set_ps1(0.5f))),
-					_mm_set_ps1(0.5f));
-			// v = (v - this->cy_mesh[x][y]) / this->sy_mesh[x][y] + this->cy_mesh[x][y];
-            const __m128 cy_mesh2 = _mm_load_ps(&this->cy_mesh[x][y]);
-            const __m128 sy_mesh2 = _mm_load_ps(&this->sy_mesh[x][y]);
-			v = _mm_add_ps(
-					_mm_div_ps(
-                        _mm_sub_ps(v,cy_mesh2),
-                        sy_mesh2),
-                    cy_mesh2
-				);
 
-            // warp
-            bool warpZero = this->warp_mesh[x][y] == 0.0 && this->warp_mesh[x][y+1] == 0.00 && this->warp_mesh[x][y+2] == 0.00 && this->warp_mesh[x][y+3] == 0.00;
-            if (!warpZero)
-            {
-                // const float warp_mesh2 = this->warp_mesh[x][y] * 0.0035f;
-                const __m128 warp_mesh2 = _mm_mul_ps(_mm_load_ps(&this->warp_mesh[x][y]), _mm_set_ps1(0.0035f));
-
-                // u +=
-                // 	(warp_mesh * sinf(fWarpTime * 0.333f + fWarpScaleInv * (orig_x2 * f[0] - orig_y2 * f[3]))) +
-                // 	(warp_mesh * cosf(fWarpTime * 0.753f - fWarpScaleInv * (orig_x2 * f[1] - orig_y2 * f[2])));
-                u = _mm_add_ps(u,
-                        _mm_add_ps(
-                            _mm_mul_ps(warp_mesh2, _mm_sinf(
-                                _mm_add_ps(
-                                    _mm_set_ps1(fWarpTime*0.333f),
-                                    _mm_mul_ps(_mm_set_ps1(fWarpScaleInv),
-                                        _mm_sub_ps(
-                                            _mm_mul_ps(orig_x2, _mm_set_ps1(f[0])),
-                                            _mm_mul_ps(orig_y2, _mm_set_ps1(f[3]))
-                                        ))))),
-                            _mm_mul_ps(warp_mesh2, _mm_cosf(
-                                _mm_sub_ps(
-                                    _mm_set_ps1(fWarpTime*0.753f),
-                                    _mm_mul_ps(_mm_set_ps1(fWarpScaleInv),
-                                        _mm_sub_ps(
-                                            _mm_mul_ps(orig_x2, _mm_set_ps1(f[1])),
-                                            _mm_mul_ps(orig_y2, _mm_set_ps1(f[2]))
-                                        )))))));
-
-                // v +=
-                // 	(warp_mesh * cosf(fWarpTime * 0.375f - fWarpScaleInv * (orig_x2 * f[2] + orig_y2 * f[1]))) +
-                // 	(warp_mesh * sinf(fWarpTime * 0.825f + fWarpScaleInv * (orig_x2 * f[0] + orig_y2 * f[3])));
-                v = _mm_add_ps(v,
-                        _mm_add_ps(
-                            _mm_mul_ps(warp_mesh2, _mm_cosf(
-                                _mm_sub_ps(
-                                    _mm_set_ps1(fWarpTime*0.375f),
-                                    _mm_mul_ps(_mm_set_ps1(fWarpScaleInv),
-                                        _mm_add_ps(
-                                            _mm_mul_ps(orig_x2, _mm_set_ps1(f[2])),
-                                            _mm_mul_ps(orig_y2, _mm_set_ps1(f[1]))
-                                        ))))),
-                            _mm_mul_ps(warp_mesh2, _mm_sinf(
-                                _mm_add_ps(
-                                    _mm_set_ps1(fWarpTime*0.825f),
-                                    _mm_mul_ps(_mm_set_ps1(fWarpScaleInv),
-                                        _mm_add_ps(
-                                            _mm_mul_ps(orig_x2, _mm_set_ps1(f[0])),
-                                            _mm_mul_ps(orig_y2, _mm_set_ps1(f[3]))
-                                        )))))));
-			}
-
-            bool rotZero = this->rot_mesh[x][y] == 0.0 && this->rot_mesh[x][y+1] == 0.00 && this->rot_mesh[x][y+2] == 0.00 && this->rot_mesh[x][y+3] == 0.00;
-            if (!rotZero)
-            {
-                // const float u2 = u - this->cx_mesh[x][y];
-                // const float v2 = v - this->cy_mesh[x][y];
-                const __m128 u2 = _mm_sub_ps(u,_mm_load_ps(&this->cx_mesh[x][y]));
-                const __m128 v2 = _mm_sub_ps(v,_mm_load_ps(&this->cy_mesh[x][y]));
-
-                // const float cos_rot = cosf(this->rot_mesh[x][y]);
-                // const float sin_rot = sinf(this->rot_mesh[x][y]);
-                __m128 sin_rot, cos_rot;
-                _mm_sincosf(_mm_load_ps(&this->rot_mesh[x][y]), sin_rot, cos_rot);
-
-                // u = u2 * cos_rot - v2 * sin_rot + this->cx_mesh[x][y];
-                u = _mm_add_ps(
-                        _mm_sub_ps(_mm_mul_ps(u2, cos_rot), _mm_mul_ps(v2,sin_rot)),
-                        _mm_load_ps(&this->cx_mesh[x][y]));
-                // v = u2 * sin_rot + v2 * cos_rot + this->cy_mesh[x][y];
-                v = _mm_add_ps(
-                        _mm_add_ps(_mm_mul_ps(u2, sin_rot), _mm_mul_ps(v2,cos_rot)),
-                        _mm_load_ps(&this->cy_mesh[x][y]));
-			}
-            // this->x_mesh[x][y] = u - this->dx_mesh[x][y];
-            // this->y_mesh[x][y] = v  - this->dy_mesh[x][y];
-            _mm_store_ps(&this->x_mesh[x][y], _mm_sub_ps(u, _mm_load_ps(&this->dx_mesh[x][y])));
-            _mm_store_ps(&this->y_mesh[x][y], _mm_sub_ps(v, _mm_load_ps(&this->dy_mesh[x][y])));
-		}
-	}
+#if HAVE_AVX2_KERNELS
+void PresetOutputs::PerPixelMath_avx2(const PipelineContext &context)
+{
+	SimdMath::perPixelMathAvx2(perPixelMesh(context));
 }
 #endif
 
 
 void PresetOutputs::PerPixelMath(const PipelineContext &context)
 {
-#ifdef __SSE2__
+#if HAVE_AVX2_KERNELS
+	static const bool avx2 = SimdMath::cpuSupportsAvx2Fma();
+	if (avx2)
+	{
+		PerPixelMath_avx2(context);
+		return;
+	}
+#endif
+#if defined(__SSE2__)
 	PerPixelMath_sse(context);
+#elif defined(__ARM_NEON)
+	PerPixelMath_neon(context);
 #else
 	PerPixelMath_c(context);
 #endif
@@ -460,35 +278,35 @@ void PresetOutputs::Initialize ( int _gx, int _gy )
 	staticPerPixel = true;
 
 	assert(this->gx > 0);
-	int x;
-	this->x_mesh  = alloc_mesh( gx, gy );
-	this->y_mesh  = alloc_mesh( gx, gy );
-	this->sx_mesh = alloc_mesh( gx, gy );
-	this->sy_mesh = alloc_mesh( gx, gy );
-	this->dx_mesh = alloc_mesh( gx, gy );
-	this->dy_mesh = alloc_mesh( gx, gy );
-	this->cx_mesh = alloc_mesh( gx, gy );
-	this->cy_mesh = alloc_mesh( gx, gy );
-	this->zoom_mesh = alloc_mesh( gx, gy );
-	this->zoomexp_mesh = alloc_mesh( gx, gy );
-	this->rot_mesh = alloc_mesh( gx, gy );
-
-	this->warp_mesh = alloc_mesh( gx, gy );
-	this->rad_mesh = alloc_mesh( gx, gy );
-	this->orig_x  = alloc_mesh( gx, gy );
-	this->orig_y  = alloc_mesh( gx, gy );
+	meshBuffer.allocate(gx, gy, 15);
+	this->x_mesh = meshBuffer.plane(0);
+	this->y_mesh = meshBuffer.plane(1);
+	this->sx_mesh = meshBuffer.plane(2);
+	this->sy_mesh = meshBuffer.plane(3);
+	this->dx_mesh = meshBuffer.plane(4);
+	this->dy_mesh = meshBuffer.plane(5);
+	this->cx_mesh = meshBuffer.plane(6);
+	this->cy_mesh = meshBuffer.plane(7);
+	this->zoom_mesh = meshBuffer.plane(8);
+	this->zoomexp_mesh = meshBuffer.plane(9);
+	this->rot_mesh = meshBuffer.plane(10);
+
+	this->warp_mesh = meshBuffer.plane(11);
+	this->rad_mesh = meshBuffer.plane(12);
+	this->orig_x  = meshBuffer.plane(13);
+	this->orig_y  = meshBuffer.plane(14);
 
 	//initialize reference grid values
-	for (x = 0; x < gx; x++)
+	for (int y = 0; y < gy; y++)
 	{
-		for (int y = 0; y < gy; y++)
+		for (int x = 0; x < gx; x++)
 		{
 			float origx = x / (float) (gx - 1);
 			float origy = -((y / (float) (gy - 1)) - 1);
 
-			rad_mesh[x][y]=hypot ( ( origx-.5 ) *2, ( origy-.5 ) *2 );
-			orig_x[x][y] = (origx - .5) * 2;
-			orig_y[x][y] = (origy - .5) * 2;
+			rad_mesh(x, y)=hypot ( ( origx-.5 ) *2, ( origy-.5 ) *2 );
+			orig_x(x, y) = (origx - .5) * 2;
+			orig_y(x, y) = (origy - .5) * 2;
 		}
 	}
 }
@@ -496,28 +314,6 @@ void PresetOutputs::Initialize ( int _gx, int _gy )
 
 PresetInputs::~PresetInputs()
 {
-	this->origx = free_mesh ( this->origx );
-	this->origy = free_mesh ( this->origy );
-	this->origrad = free_mesh ( this->origrad );
-	this->origtheta = free_mesh ( this->origtheta );
-	this->x_mesh = free_mesh ( this->x_mesh );
-	this->y_mesh = free_mesh ( this->y_mesh );
-	this->rad_mesh = free_mesh ( this->rad_mesh );
-	this->theta_mesh = free_mesh ( this->theta_mesh );
-}
-
-
-void PresetInputs::resetMesh()
-{
-	assert ( x_mesh );
-	assert ( y_mesh );
-	assert ( rad_mesh );
-	assert ( theta_mesh );
-
-	copy_mesh(this->x_mesh, this->origx, gx, gy);
-	copy_mesh(this->y_mesh, this->origy, gx, gy);
-	copy_mesh(this->rad_mesh, this->origrad, gx, gy);
-	copy_mesh(this->theta_mesh, this->origtheta, gx, gy);
 }
 
 
@@ -576,18 +372,18 @@ double invratio = 1.0 - ratio;
 
   //Interpolate Per-Pixel mesh
 
-  for (int x=0;x<gx;x++)
+  for (int y=0;y<gy;y++)
     {
-      for(int y=0;y<gy;y++)
+      for(int x=0;x<gx;x++)
 	{
-	  A.x_mesh[x][y]  = A.x_mesh[x][y]* invratio + B.x_mesh[x][y]*ratio;
+	  A.x_mesh(x, y)  = A.x_mesh(x, y)* invratio + B.x_mesh(x, y)*ratio;
 	}
     }
- for (int x=0;x<gx;x++)
+ for (int y=0;y<gy;y++)
     {
-      for(int y=0;y<gy;y++)
+      for(int x=0;x<gx;x++)
 	{
-	  A.y_mesh[x][y]  = A.y_mesh[x][y]* invratio + B.y_mesh[x][y]*ratio;
+	  A.y_mesh(x, y)  = A.y_mesh(x, y)* invratio + B.y_mesh(x, y)*ratio;
 	}
     }
 
@@ -656,3 +452,136 @@ double invratio = 1.0 - ratio;
   return;
 }
 #endif
+
+
+// TESTS
+
+#include "TestRunner.hpp"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+#define TEST(cond) if (!verify(__FILE__ ": " #cond,cond)) return false
+
+/// Checks the vectorized PerPixelMath variants against PerPixelMath_c and times them.
+/// Also registered in release builds, where the timings are meaningful.
+struct PerPixelMathTest : public Test
+{
+    PerPixelMathTest() : Test("PerPixelMathTest")
+    {}
+
+    typedef std::function<void(PresetOutputs &, const PipelineContext &)> Variant;
+
+    std::uint32_t seed = 1;
+
+    float random(float low, float high)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return low + (high - low) * static_cast<float>(seed >> 8) / 16777216.0f;
+    }
+
+    // values in the range presets typically write from their per pixel equations
+    void fill(PresetOutputs & outputs)
+    {
+        outputs.fWarpAnimSpeed = 1.0f;
+        outputs.fWarpScale = 1.3f;
+        outputs.rot = 0.1f;
+        for (int y = 0; y < outputs.gy; y++)
+        {
+            for (int x = 0; x < outputs.gx; x++)
+            {
+                outputs.zoom_mesh(x, y) = random(0.9f, 1.1f);
+                outputs.zoomexp_mesh(x, y) = random(0.5f, 2.0f);
+                outputs.rot_mesh(x, y) = random(-0.2f, 0.2f);
+                outputs.warp_mesh(x, y) = random(0.0f, 2.0f);
+                outputs.sx_mesh(x, y) = random(0.9f, 1.1f);
+                outputs.sy_mesh(x, y) = random(0.9f, 1.1f);
+                outputs.cx_mesh(x, y) = random(0.4f, 0.6f);
+                outputs.cy_mesh(x, y) = random(0.4f, 0.6f);
+                outputs.dx_mesh(x, y) = random(-0.01f, 0.01f);
+                outputs.dy_mesh(x, y) = random(-0.01f, 0.01f);
+            }
+        }
+    }
+
+    // milliseconds per call
+    double time(PresetOutputs & outputs, const PipelineContext & context, const Variant & variant, int repeat)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeat; i++)
+            variant(outputs, context);
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / repeat;
+    }
+
+    bool test() override
+    {
+        std::vector<std::pair<const char *, Variant>> variants;
+#ifdef __SSE2__
+        variants.emplace_back("sse2", [](PresetOutputs & o, const PipelineContext & c) { o.PerPixelMath_sse(c); });
+#endif
+#ifdef __ARM_NEON
+        variants.emplace_back("neon", [](PresetOutputs & o, const PipelineContext & c) { o.PerPixelMath_neon(c); });
+#endif
+#if HAVE_AVX2_KERNELS
+        if (SimdMath::cpuSupportsAvx2Fma())
+            variants.emplace_back("avx2", [](PresetOutputs & o, const PipelineContext & c) { o.PerPixelMath_avx2(c); });
+#endif
+        const Variant scalar = [](PresetOutputs & o, const PipelineContext & c) { o.PerPixelMath_c(c); };
+
+        const int sizes[][2] = { { 32, 24 }, { 64, 48 }, { 128, 96 }, { 256, 192 } };
+        for (const auto & size : sizes)
+        {
+            const int gx = size[0];
+            const int gy = size[1];
+            PresetOutputs outputs;
+            outputs.Initialize(gx, gy);
+            fill(outputs);
+
+            PipelineContext context;
+            context.time = 12.5f;
+
+            // the old scalar math is the reference
+            scalar(outputs, context);
+            std::vector<float> expectedX, expectedY;
+            for (int y = 0; y < gy; y++)
+            {
+                expectedX.insert(expectedX.end(), outputs.x_mesh.row(y), outputs.x_mesh.row(y) + gx);
+                expectedY.insert(expectedY.end(), outputs.y_mesh.row(y), outputs.y_mesh.row(y) + gx);
+            }
+
+            for (const auto & variant : variants)
+            {
+                variant.second(outputs, context);
+                float maxError = 0;
+                for (int y = 0; y < gy; y++)
+                {
+                    for (int x = 0; x < gx; x++)
+                    {
+                        maxError = std::max(maxError, std::fabs(outputs.x_mesh(x, y) - expectedX[y * gx + x]));
+                        maxError = std::max(maxError, std::fabs(outputs.y_mesh(x, y) - expectedY[y * gx + x]));
+                    }
+                }
+                if (maxError > 1e-5f)
+                    std::cout << "PerPixelMathTest: " << variant.first << " differs by " << maxError << std::endl;
+                TEST(maxError <= 1e-5f);
+            }
+
+            const int repeat = 1 + 2000000 / (gx * gy);
+            const double scalarTime = time(outputs, context, scalar, repeat);
+            std::cout << "PerPixelMathTest: " << gx << "x" << gy << " c " << scalarTime << " ms";
+            for (const auto & variant : variants)
+            {
+                const double variantTime = time(outputs, context, variant.second, repeat);
+                std::cout << ", " << variant.first << " " << variantTime << " ms (" << scalarTime / variantTime << "x)";
+            }
+            std::cout << std::endl;
+        }
+        return true;
+    }
+};
+
+Test* PresetOutputs::test()
+{
+    return new PerPixelMathTest();
+}
@@ -8,6 +8,9 @@
 #include "CustomWave.hpp"
 #include "Renderer/VideoEcho.hpp"
 
+class Test;
+namespace SimdMath { struct PerPixelMesh; }
+
 
 /// Container for all *read only* engine variables a preset requires to
 /// evaluate milkdrop equations. Every preset object needs a reference to one of these.
@@ -33,17 +36,10 @@ public:
     /* variables were added in milkdrop 1.04 */
     int gx, gy;
 
-    float **x_mesh;
-    float **y_mesh;
-    float **rad_mesh;
-    float **theta_mesh;
-
-    float **origtheta;  //grid containing interpolated mesh reference values
-    float **origrad;
-    float **origx;  //original mesh
-    float **origy;
-
-    void resetMesh();
+    MeshPlane origtheta;  //grid containing interpolated mesh reference values
+    MeshPlane origrad;
+    MeshPlane origx;  //original mesh
+    MeshPlane origy;
 
     ~PresetInputs();
     PresetInputs();
@@ -59,6 +55,7 @@ public:
     void update (const BeatDetect & music, const PipelineContext & context);
 
     private:
+    MeshBuffer meshBuffer;
 };
 
 
@@ -104,8 +101,6 @@ public:
     Invert invert;
     Solarize solarize;
 
-
-    int gy,gx;
     /* PER_FRAME VARIABLES END */
 
     float fRating;
@@ -123,27 +118,41 @@ public:
     float fWarpScale;
     float fShader;
 
-    float **zoom_mesh;
-    float **zoomexp_mesh;
-    float **rot_mesh;
+    // all planes live in Pipeline::meshBuffer, next to x_mesh and y_mesh
+    MeshPlane zoom_mesh;
+    MeshPlane zoomexp_mesh;
+    MeshPlane rot_mesh;
 
-    float **sx_mesh;
-    float **sy_mesh;
-    float **dx_mesh;
-    float **dy_mesh;
-    float **cx_mesh;
-    float **cy_mesh;
-    float **warp_mesh;
+    MeshPlane sx_mesh;
+    MeshPlane sy_mesh;
+    MeshPlane dx_mesh;
+    MeshPlane dy_mesh;
+    MeshPlane cx_mesh;
+    MeshPlane cy_mesh;
+    MeshPlane warp_mesh;
 
-    float **orig_x;  //original mesh
-    float **orig_y;
-    float **rad_mesh;
+    MeshPlane orig_x;  //original mesh
+    MeshPlane orig_y;
+    MeshPlane rad_mesh;
+
+    static Test* test();
 
 private:
+    friend struct PerPixelMathTest;
+
     void PerPixelMath_c( const PipelineContext &context);
+    /// The planes and per frame values the vectorized PerPixelMath variants work on
+    SimdMath::PerPixelMesh perPixelMesh( const PipelineContext &context);
 #ifdef __SSE2__
     void PerPixelMath_sse( const PipelineContext &context);
 #endif
+#ifdef __ARM_NEON
+    void PerPixelMath_neon( const PipelineContext &context);
+#endif
+#if HAVE_AVX2_KERNELS
+    /// Only call it if SimdMath::cpuSupportsAvx2Fma() is true
+    void PerPixelMath_avx2( const PipelineContext &context);
+#endif
 };
 
 
@@ -0,0 +1,257 @@
+#include "SimdMath.hpp"
+
+bool SimdMath::cpuSupportsAvx2Fma()
+{
+#if HAVE_AVX2_KERNELS
+    // Also checks that the operating system saves the AVX registers
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
+
+std::vector<SimdMath::ArrayKernels> SimdMath::availableKernels()
+{
+    std::vector<ArrayKernels> kernels;
+#if defined(__SSE2__)
+    kernels.push_back(ArrayKernelsOf<Sse2>::get("sse2"));
+#elif defined(__ARM_NEON)
+    kernels.push_back(ArrayKernelsOf<Neon>::get("neon"));
+#endif
+#if HAVE_AVX2_KERNELS
+    if (cpuSupportsAvx2Fma())
+        kernels.push_back(avx2Kernels());
+#endif
+    return kernels;
+}
+
+
+// TESTS
+
+#include <iostream>
+#include "TestRunner.hpp"
+
+#ifndef NDEBUG
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#define TEST(cond) if (!verify(__FILE__ ": " #cond,cond)) return false
+
+namespace {
+
+/// Inputs are generated in multiples of this, enough for every vector width
+const std::size_t BATCH = 8;
+
+float fromBits(std::uint32_t bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+}
+
+struct SimdMathTest : public Test
+{
+    SimdMathTest() : Test("SimdMathTest")
+    {}
+
+    std::uint32_t seed = 1;
+
+    // deterministic, so a failure can be reproduced
+    float random(float low, float high)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return low + (high - low) * static_cast<float>(seed >> 8) / 16777216.0f;
+    }
+
+    std::vector<float> uniform(std::size_t count, float low, float high)
+    {
+        std::vector<float> values(count);
+        for (auto & value : values)
+            value = random(low, high);
+        return values;
+    }
+
+    bool test_sincos(const SimdMath::ArrayKernels & kernels)
+    {
+        std::vector<float> x = uniform(100000, -8192.0f, 8192.0f);
+        const std::vector<float> small = uniform(100000, -10.0f, 10.0f);
+        x.insert(x.end(), small.begin(), small.end());
+        for (float edge : { 0.0f, -0.0f, 0.78539816f, 1.57079633f, 3.14159265f, -3.14159265f, 8192.0f, -8192.0f })
+            x.push_back(edge);
+        x.resize((x.size() + BATCH - 1) / BATCH * BATCH, 1.0f);
+
+        std::vector<float> sinX(x.size()), cosX(x.size()), sinOnly(x.size()), cosOnly(x.size());
+        kernels.sincos(x.data(), sinX.data(), cosX.data(), x.size());
+        kernels.sin(x.data(), sinOnly.data(), x.size());
+        kernels.cos(x.data(), cosOnly.data(), x.size());
+
+        double maxError = 0;
+        for (std::size_t i = 0; i < x.size(); i++)
+        {
+            maxError = std::max(maxError, std::fabs(sinX[i] - std::sin(static_cast<double>(x[i]))));
+            maxError = std::max(maxError, std::fabs(cosX[i] - std::cos(static_cast<double>(x[i]))));
+            TEST(sinOnly[i] == sinX[i]);
+            TEST(cosOnly[i] == cosX[i]);
+        }
+        TEST(maxError < 2e-7);
+
+        float special[BATCH] = { NAN, INFINITY, -INFINITY, 0, 0, 0, 0, 0 };
+        float out[BATCH];
+        kernels.sin(special, out, BATCH);
+        TEST(std::isnan(out[0]));
+        TEST(std::isnan(out[1]));
+        TEST(std::isnan(out[2]));
+        TEST(out[3] == 0.0f);
+        return true;
+    }
+
+    bool test_exp2(const SimdMath::ArrayKernels & kernels)
+    {
+        std::vector<float> x = uniform(200000, -126.0f, 127.99f);
+        const std::vector<float> small = uniform(BATCH * 10000, -2.0f, 2.0f);
+        x.insert(x.end(), small.begin(), small.end());
+        std::vector<float> out(x.size());
+        kernels.exp2(x.data(), out.data(), x.size());
+
+        double maxError = 0;
+        for (std::size_t i = 0; i < x.size(); i++)
+        {
+            const double expected = std::exp2(static_cast<double>(x[i]));
+            maxError = std::max(maxError, std::fabs(out[i] - expected) / expected);
+        }
+        TEST(maxError < 2e-7);
+
+        float special[BATCH] = { NAN, INFINITY, -INFINITY, 128.0f, -127.0f, 0.0f, 1.0f, -1.0f };
+        float result[BATCH];
+        kernels.exp2(special, result, BATCH);
+        TEST(std::isnan(result[0]));
+        TEST(result[1] == INFINITY);
+        TEST(result[2] == 0.0f);
+        TEST(result[3] == INFINITY);
+        TEST(result[4] == 0.0f);
+        TEST(result[5] == 1.0f);
+        TEST(result[6] == 2.0f);
+        TEST(result[7] == 0.5f);
+        return true;
+    }
+
+    bool test_log2(const SimdMath::ArrayKernels & kernels)
+    {
+        // every exponent of the normal range, random mantissas
+        std::vector<float> x(200000);
+        for (auto & value : x)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            const std::uint32_t exponent = 1 + (seed >> 8) % 254;
+            seed = seed * 1664525u + 1013904223u;
+            value = fromBits((exponent << 23) | (seed >> 9));
+        }
+        const std::vector<float> nearOne = uniform(BATCH * 10000, 0.5f, 2.0f);
+        x.insert(x.end(), nearOne.begin(), nearOne.end());
+        std::vector<float> out(x.size());
+        kernels.log2(x.data(), out.data(), x.size());
+
+        double maxError = 0;
+        for (std::size_t i = 0; i < x.size(); i++)
+        {
+            const double expected = std::log2(static_cast<double>(x[i]));
+            maxError = std::max(maxError, std::fabs(out[i] - expected) / std::max(1.0, std::fabs(expected)));
+        }
+        TEST(maxError < 2e-7);
+
+        float special[BATCH] = { NAN, INFINITY, 0.0f, -0.0f, -1.0f, 1.0f, 1e-40f, 0.25f };
+        float result[BATCH];
+        kernels.log2(special, result, BATCH);
+        TEST(std::isnan(result[0]));
+        TEST(result[1] == INFINITY);
+        TEST(result[2] == -INFINITY);
+        TEST(result[3] == -INFINITY);
+        TEST(std::isnan(result[4]));
+        TEST(result[5] == 0.0f);
+        TEST(result[6] == -INFINITY);
+        TEST(result[7] == -2.0f);
+        return true;
+    }
+
+    bool test_pow(const SimdMath::ArrayKernels & kernels)
+    {
+        // the range of zoom and zoomexp in presets, and some wider
+        std::vector<float> x = uniform(100000, 0.5f, 2.0f);
+        std::vector<float> y = uniform(100000, -3.0f, 3.0f);
+        const std::vector<float> wideX = uniform(100000, 0.0f, 100.0f);
+        const std::vector<float> wideY = uniform(100000, -15.0f, 15.0f);
+        x.insert(x.end(), wideX.begin(), wideX.end());
+        y.insert(y.end(), wideY.begin(), wideY.end());
+        std::vector<float> out(x.size());
+        kernels.pow(x.data(), y.data(), out.data(), x.size());
+
+        bool withinBound = true;
+        for (std::size_t i = 0; i < x.size(); i++)
+        {
+            const double expected = std::pow(static_cast<double>(x[i]), static_cast<double>(y[i]));
+            const double magnitude = std::fabs(y[i] * std::log2(static_cast<double>(x[i])));
+            if (expected < 1e-37 || expected > 1e37)
+                continue;
+            if (std::fabs(out[i] - expected) / expected > 2e-7 * (2 + magnitude))
+                withinBound = false;
+        }
+        TEST(withinBound);
+
+        float specialX[BATCH * 2] = { 0.0f, 0.0f, -2.0f, -2.0f, -2.0f, 5.0f, 1.0f, NAN,
+                                      INFINITY, INFINITY, -0.0f, 0.5f, 0.5f, 3.0f, -1.0f, 2.0f };
+        float specialY[BATCH * 2] = { 2.0f, -1.0f, 3.0f, 2.0f, 0.5f, 0.0f, NAN, 0.0f,
+                                      2.0f, -2.0f, 3.0f, INFINITY, -INFINITY, NAN, 1e30f, -3.0f };
+        float result[BATCH * 2];
+        kernels.pow(specialX, specialY, result, BATCH * 2);
+        TEST(result[0] == 0.0f);
+        TEST(result[1] == INFINITY);
+        TEST(std::fabs(result[2] + 8.0f) < 1e-5f);
+        TEST(std::fabs(result[3] - 4.0f) < 1e-5f);
+        TEST(std::isnan(result[4]));
+        TEST(result[5] == 1.0f);
+        TEST(result[6] == 1.0f);
+        TEST(result[7] == 1.0f);
+        TEST(result[8] == INFINITY);
+        TEST(result[9] == 0.0f);
+        TEST(result[10] == 0.0f && std::signbit(result[10]));
+        TEST(result[11] == 0.0f);
+        TEST(result[12] == INFINITY);
+        TEST(std::isnan(result[13]));
+        TEST(std::fabs(result[14] - 1.0f) < 1e-5f);
+        TEST(std::fabs(result[15] - 0.125f) < 1e-6f);
+        return true;
+    }
+
+    bool test() override
+    {
+        const std::vector<SimdMath::ArrayKernels> available = SimdMath::availableKernels();
+        for (const auto & kernels : available)
+        {
+            if (!test_sincos(kernels) || !test_exp2(kernels) || !test_log2(kernels) || !test_pow(kernels))
+            {
+                std::cout << "SimdMathTest: " << kernels.name << " kernels failed" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+Test* SimdMath::test()
+{
+    return new SimdMathTest();
+}
+
+#else
+
+Test* SimdMath::test()
+{
+    return nullptr;
+}
+
+#endif
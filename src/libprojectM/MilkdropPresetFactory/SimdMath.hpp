@@ -0,0 +1,399 @@
+#ifndef SIMD_MATH_HPP
+#define SIMD_MATH_HPP
+
+#include <cstddef>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+class Test;
+
+/// Vectorized sin, cos, exp2, log2 and pow for the per-pixel mesh math.
+///
+/// The kernels are written once against a small set of vector operations (Sse2, Neon, and Avx2 in
+/// SimdMath_avx2.cpp) and instantiated for each instruction set. Error bounds, measured against double precision and
+/// checked by SimdMath::test():
+///
+///  - sin, cos, sincos: absolute error below 2e-7 for |x| <= 8192. Past that the range reduction
+///    slowly loses precision, arguments above 12000 should not be passed.
+///  - exp2: relative error below 2e-7. Results below 2^-126 are flushed to zero, x >= 128 gives +inf.
+///  - log2: absolute error below 2e-7 * max(1, |log2 x|). Denormal inputs count as zero.
+///  - pow: exp2(y * log2 |x|), relative error below 2e-7 * (2 + |y * log2 x|). Zero, infinite and
+///    negative bases, integral exponents and NaNs are handled like powf, except for (-1)^inf.
+namespace SimdMath {
+
+#if defined(__SSE2__)
+struct Sse2 {
+    typedef __m128 Float;
+    typedef __m128i Int;
+    static const int width = 4;
+
+    static Float load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, Float a) { _mm_storeu_ps(p, a); }
+    static Float set(float a) { return _mm_set1_ps(a); }
+
+    static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+    /// a * b + c
+    static Float mulAdd(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    /// c - a * b
+    static Float negMulAdd(Float a, Float b, Float c) { return _mm_sub_ps(c, _mm_mul_ps(a, b)); }
+    static Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+    static Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+
+    static Float bitAnd(Float a, Float b) { return _mm_and_ps(a, b); }
+    static Float bitOr(Float a, Float b) { return _mm_or_ps(a, b); }
+    static Float bitXor(Float a, Float b) { return _mm_xor_ps(a, b); }
+    /// a & ~b
+    static Float andNot(Float a, Float b) { return _mm_andnot_ps(b, a); }
+    /// Lanes of a where mask is set, b elsewhere
+    static Float select(Float mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+    static Float less(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+    static Float lessEqual(Float a, Float b) { return _mm_cmple_ps(a, b); }
+    static Float equal(Float a, Float b) { return _mm_cmpeq_ps(a, b); }
+    static bool allTrue(Float mask) { return _mm_movemask_ps(mask) == 0xf; }
+
+    /// Rounds to the nearest integer
+    static Int round(Float a) { return _mm_cvtps_epi32(a); }
+    static Float toFloat(Int a) { return _mm_cvtepi32_ps(a); }
+    static Int asInt(Float a) { return _mm_castps_si128(a); }
+    static Float asFloat(Int a) { return _mm_castsi128_ps(a); }
+
+    static Int setInt(int a) { return _mm_set1_epi32(a); }
+    static Int addInt(Int a, Int b) { return _mm_add_epi32(a, b); }
+    static Int subInt(Int a, Int b) { return _mm_sub_epi32(a, b); }
+    static Int andInt(Int a, Int b) { return _mm_and_si128(a, b); }
+    static Int orInt(Int a, Int b) { return _mm_or_si128(a, b); }
+    static Float equalInt(Int a, Int b) { return _mm_castsi128_ps(_mm_cmpeq_epi32(a, b)); }
+    template <int bits> static Int shiftLeft(Int a) { return _mm_slli_epi32(a, bits); }
+    /// Arithmetic shift, keeps the sign
+    template <int bits> static Int shiftRight(Int a) { return _mm_srai_epi32(a, bits); }
+};
+#endif
+
+#if defined(__ARM_NEON)
+/// Masks are kept as float vectors so the kernels can treat all instruction sets alike.
+struct Neon {
+    typedef float32x4_t Float;
+    typedef int32x4_t Int;
+    static const int width = 4;
+
+    static Float load(const float *p) { return vld1q_f32(p); }
+    static void store(float *p, Float a) { vst1q_f32(p, a); }
+    static Float set(float a) { return vdupq_n_f32(a); }
+
+    static Float add(Float a, Float b) { return vaddq_f32(a, b); }
+    static Float sub(Float a, Float b) { return vsubq_f32(a, b); }
+    static Float mul(Float a, Float b) { return vmulq_f32(a, b); }
+#if defined(__aarch64__)
+    static Float div(Float a, Float b) { return vdivq_f32(a, b); }
+    static Float mulAdd(Float a, Float b, Float c) { return vfmaq_f32(c, a, b); }
+    static Float negMulAdd(Float a, Float b, Float c) { return vfmsq_f32(c, a, b); }
+#else
+    /// ARMv7 has no vector division, two Newton-Raphson steps on the estimate get within 1 ulp
+    static Float div(Float a, Float b)
+    {
+        Float reciprocal = vrecpeq_f32(b);
+        reciprocal = vmulq_f32(vrecpsq_f32(b, reciprocal), reciprocal);
+        reciprocal = vmulq_f32(vrecpsq_f32(b, reciprocal), reciprocal);
+        return vmulq_f32(a, reciprocal);
+    }
+    static Float mulAdd(Float a, Float b, Float c) { return vmlaq_f32(c, a, b); }
+    static Float negMulAdd(Float a, Float b, Float c) { return vmlsq_f32(c, a, b); }
+#endif
+    static Float min(Float a, Float b) { return vminq_f32(a, b); }
+    static Float max(Float a, Float b) { return vmaxq_f32(a, b); }
+
+    static Float bitAnd(Float a, Float b) { return asFloat(vandq_s32(asInt(a), asInt(b))); }
+    static Float bitOr(Float a, Float b) { return asFloat(vorrq_s32(asInt(a), asInt(b))); }
+    static Float bitXor(Float a, Float b) { return asFloat(veorq_s32(asInt(a), asInt(b))); }
+    static Float andNot(Float a, Float b) { return asFloat(vbicq_s32(asInt(a), asInt(b))); }
+    static Float select(Float mask, Float a, Float b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+
+    static Float less(Float a, Float b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+    static Float lessEqual(Float a, Float b) { return vreinterpretq_f32_u32(vcleq_f32(a, b)); }
+    static Float equal(Float a, Float b) { return vreinterpretq_f32_u32(vceqq_f32(a, b)); }
+    static bool allTrue(Float mask)
+    {
+        const uint32x4_t bits = vreinterpretq_u32_f32(mask);
+#if defined(__aarch64__)
+        return vminvq_u32(bits) != 0;
+#else
+        const uint32x2_t half = vand_u32(vget_low_u32(bits), vget_high_u32(bits));
+        return vget_lane_u32(vpmin_u32(half, half), 0) != 0;
+#endif
+    }
+
+#if defined(__aarch64__)
+    static Int round(Float a) { return vcvtnq_s32_f32(a); }
+#else
+    /// Half away from zero, which only differs from the other instruction sets on exact ties
+    static Int round(Float a)
+    {
+        const Float half = vbslq_f32(vcltq_f32(a, vdupq_n_f32(0.0f)), vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f));
+        return vcvtq_s32_f32(vaddq_f32(a, half));
+    }
+#endif
+    static Float toFloat(Int a) { return vcvtq_f32_s32(a); }
+    static Int asInt(Float a) { return vreinterpretq_s32_f32(a); }
+    static Float asFloat(Int a) { return vreinterpretq_f32_s32(a); }
+
+    static Int setInt(int a) { return vdupq_n_s32(a); }
+    static Int addInt(Int a, Int b) { return vaddq_s32(a, b); }
+    static Int subInt(Int a, Int b) { return vsubq_s32(a, b); }
+    static Int andInt(Int a, Int b) { return vandq_s32(a, b); }
+    static Int orInt(Int a, Int b) { return vorrq_s32(a, b); }
+    static Float equalInt(Int a, Int b) { return vreinterpretq_f32_u32(vceqq_s32(a, b)); }
+    template <int bits> static Int shiftLeft(Int a) { return vshlq_n_s32(a, bits); }
+    template <int bits> static Int shiftRight(Int a) { return vshrq_n_s32(a, bits); }
+};
+#endif
+
+
+/// Special values from their bit patterns. The inline functions of std::numeric_limits would be
+/// emitted into SimdMath_avx2.cpp as well.
+template <class V>
+inline typename V::Float infinity()
+{
+    return V::asFloat(V::setInt(0x7f800000));
+}
+
+template <class V>
+inline typename V::Float quietNaN()
+{
+    return V::asFloat(V::setInt(0x7fc00000));
+}
+
+/// The smallest normal float
+template <class V>
+inline typename V::Float minNormal()
+{
+    return V::asFloat(V::setInt(0x00800000));
+}
+
+
+template <class V>
+inline void sincos(typename V::Float x, typename V::Float & sinOut, typename V::Float & cosOut)
+{
+    typedef typename V::Float Float;
+    typedef typename V::Int Int;
+
+    // x = r + quadrant * pi/2 with r in [-pi/4, pi/4]. pi/2 is split in three parts (Cody-Waite),
+    // the first two have few enough mantissa bits that their products with the quadrant are exact.
+    const Int quadrant = V::round(V::mul(x, V::set(0.636619772f)));
+    const Float q = V::toFloat(quadrant);
+    Float r = V::negMulAdd(q, V::set(1.5703125f), x);
+    r = V::negMulAdd(q, V::set(4.837512969970703125e-4f), r);
+    r = V::negMulAdd(q, V::set(7.54978995489188216e-8f), r);
+
+    // Minimax polynomials on [-pi/4, pi/4], coefficients from Cephes sinf and cosf
+    const Float r2 = V::mul(r, r);
+    Float s = V::mulAdd(V::set(-1.9515295891e-4f), r2, V::set(8.3321608736e-3f));
+    s = V::mulAdd(s, r2, V::set(-1.6666654611e-1f));
+    s = V::mulAdd(V::mul(s, r2), r, r);
+    Float c = V::mulAdd(V::set(2.443315711809948e-5f), r2, V::set(-1.388731625493765e-3f));
+    c = V::mulAdd(c, r2, V::set(4.166664568298827e-2f));
+    c = V::mulAdd(V::mul(c, r2), r2, V::negMulAdd(V::set(0.5f), r2, V::set(1.0f)));
+
+    // Odd quadrants swap sin and cos. The sign of sin flips in quadrants 2 and 3, the one of cos in 1 and 2.
+    const Int one = V::setInt(1);
+    const Int two = V::setInt(2);
+    const Float swap = V::equalInt(V::andInt(quadrant, one), one);
+    const Float sinSign = V::asFloat(V::template shiftLeft<30>(V::andInt(quadrant, two)));
+    const Float cosSign = V::asFloat(V::template shiftLeft<30>(V::andInt(V::addInt(quadrant, one), two)));
+    sinOut = V::bitXor(V::select(swap, c, s), sinSign);
+    cosOut = V::bitXor(V::select(swap, s, c), cosSign);
+}
+
+template <class V>
+inline typename V::Float sin(typename V::Float x)
+{
+    typename V::Float sinX, cosX;
+    sincos<V>(x, sinX, cosX);
+    return sinX;
+}
+
+template <class V>
+inline typename V::Float cos(typename V::Float x)
+{
+    typename V::Float sinX, cosX;
+    sincos<V>(x, sinX, cosX);
+    return cosX;
+}
+
+template <class V>
+inline typename V::Float exp2(typename V::Float x)
+{
+    typedef typename V::Float Float;
+    typedef typename V::Int Int;
+
+    // 2^x = 2^n * 2^f with n = round(x) and f in [-0.5, 0.5]
+    const Float clamped = V::min(V::max(x, V::set(-126.0f)), V::set(127.99999f));
+    const Int n = V::round(clamped);
+    const Float f = V::sub(clamped, V::toFloat(n));
+
+    // Taylor series of e^(f ln 2), the first dropped term is below 2^-27
+    Float p = V::mulAdd(V::set(1.5252734e-5f), f, V::set(1.5403530e-4f));
+    p = V::mulAdd(p, f, V::set(1.3333558e-3f));
+    p = V::mulAdd(p, f, V::set(9.6181291e-3f));
+    p = V::mulAdd(p, f, V::set(5.5504109e-2f));
+    p = V::mulAdd(p, f, V::set(2.4022651e-1f));
+    p = V::mulAdd(p, f, V::set(6.9314718e-1f));
+    p = V::mulAdd(p, f, V::set(1.0f));
+
+    // n is in [-126, 128], scale in two steps so both factors have a normal exponent
+    const Int low = V::template shiftRight<1>(n);
+    const Int bias = V::setInt(127);
+    Float result = V::mul(p, V::asFloat(V::template shiftLeft<23>(V::addInt(low, bias))));
+    result = V::mul(result, V::asFloat(V::template shiftLeft<23>(V::addInt(V::subInt(n, low), bias))));
+
+    result = V::select(V::less(x, V::set(-126.0f)), V::set(0.0f), result);
+    result = V::select(V::lessEqual(V::set(128.0f), x), infinity<V>(), result);
+    // Only NaN compares unequal to itself
+    return V::select(V::equal(x, x), result, x);
+}
+
+template <class V>
+inline typename V::Float log2(typename V::Float x)
+{
+    typedef typename V::Float Float;
+    typedef typename V::Int Int;
+
+    // x = 2^e * m with m in [sqrt(1/2), sqrt(2))
+    const Int bits = V::asInt(x);
+    Int exponent = V::subInt(V::template shiftRight<23>(bits), V::setInt(127));
+    Float m = V::asFloat(V::orInt(V::andInt(bits, V::setInt(0x007fffff)), V::setInt(0x3f800000)));
+    const Float upper = V::less(V::set(1.41421356f), m);
+    m = V::select(upper, V::mul(m, V::set(0.5f)), m);
+    exponent = V::subInt(exponent, V::asInt(upper));
+
+    // log2(m) = 2/ln(2) * atanh(t) with t = (m - 1) / (m + 1), |t| <= 0.172
+    const Float one = V::set(1.0f);
+    const Float t = V::div(V::sub(m, one), V::add(m, one));
+    const Float t2 = V::mul(t, t);
+    Float p = V::mulAdd(V::set(0.32059890f), t2, V::set(0.41219858f));
+    p = V::mulAdd(p, t2, V::set(0.57707802f));
+    p = V::mulAdd(p, t2, V::set(0.96179669f));
+    p = V::mulAdd(p, t2, V::set(2.88539008f));
+    Float result = V::mulAdd(p, t, V::toFloat(exponent));
+
+    const Float inf = infinity<V>();
+    result = V::select(V::less(x, minNormal<V>()), V::bitXor(inf, V::set(-0.0f)), result);
+    result = V::select(V::less(x, V::set(0.0f)), quietNaN<V>(), result);
+    result = V::select(V::equal(x, inf), inf, result);
+    return V::select(V::equal(x, x), result, x);
+}
+
+template <class V>
+inline typename V::Float pow(typename V::Float x, typename V::Float y)
+{
+    typedef typename V::Float Float;
+    typedef typename V::Int Int;
+
+    const Float signBit = V::set(-0.0f);
+    Float result = exp2<V>(V::mul(y, log2<V>(V::andNot(x, signBit))));
+
+    // Negative bases only have a real power for integral exponents, odd ones keep the sign.
+    // Every float from 2^24 up is an even integer.
+    const Float large = V::lessEqual(V::set(16777216.0f), V::andNot(y, signBit));
+    const Int rounded = V::round(y);
+    const Float integral = V::bitOr(V::equal(V::toFloat(rounded), y), large);
+    const Float odd = V::andNot(V::bitAnd(V::equal(V::toFloat(rounded), y),
+                                          V::equalInt(V::andInt(rounded, V::setInt(1)), V::setInt(1))), large);
+    result = V::bitOr(result, V::bitAnd(V::bitAnd(x, signBit), odd));
+    result = V::select(V::andNot(V::less(x, V::set(0.0f)), integral),
+                       quietNaN<V>(), result);
+
+    // x^0 and 1^y are 1, even for NaN operands
+    const Float one = V::set(1.0f);
+    return V::select(V::bitOr(V::equal(y, V::set(0.0f)), V::equal(x, one)), one, result);
+}
+
+
+/// The kernels of one instruction set applied to whole arrays, for tests and benchmarks.
+/// Counts must be a multiple of the vector width.
+struct ArrayKernels {
+    const char *name;
+    int width;
+    void (*sin)(const float *x, float *out, std::size_t count);
+    void (*cos)(const float *x, float *out, std::size_t count);
+    void (*sincos)(const float *x, float *sinOut, float *cosOut, std::size_t count);
+    void (*exp2)(const float *x, float *out, std::size_t count);
+    void (*log2)(const float *x, float *out, std::size_t count);
+    void (*pow)(const float *x, const float *y, float *out, std::size_t count);
+};
+
+template <class V>
+struct ArrayKernelsOf {
+    static void sin(const float *x, float *out, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i += V::width)
+            V::store(out + i, SimdMath::sin<V>(V::load(x + i)));
+    }
+
+    static void cos(const float *x, float *out, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i += V::width)
+            V::store(out + i, SimdMath::cos<V>(V::load(x + i)));
+    }
+
+    static void sincos(const float *x, float *sinOut, float *cosOut, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i += V::width)
+        {
+            typename V::Float sinX, cosX;
+            SimdMath::sincos<V>(V::load(x + i), sinX, cosX);
+            V::store(sinOut + i, sinX);
+            V::store(cosOut + i, cosX);
+        }
+    }
+
+    static void exp2(const float *x, float *out, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i += V::width)
+            V::store(out + i, SimdMath::exp2<V>(V::load(x + i)));
+    }
+
+    static void log2(const float *x, float *out, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i += V::width)
+            V::store(out + i, SimdMath::log2<V>(V::load(x + i)));
+    }
+
+    static void pow(const float *x, const float *y, float *out, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i += V::width)
+            V::store(out + i, SimdMath::pow<V>(V::load(x + i), V::load(y + i)));
+    }
+
+    static ArrayKernels get(const char *name)
+    {
+        return ArrayKernels{ name, V::width, &sin, &cos, &sincos, &exp2, &log2, &pow };
+    }
+};
+
+/// True if the CPU and operating system support AVX2 and FMA, checked once at runtime
+bool cpuSupportsAvx2Fma();
+
+/// The kernels this build and CPU can run, the baseline instruction set first
+std::vector<ArrayKernels> availableKernels();
+
+#if HAVE_AVX2_KERNELS
+/// Defined in SimdMath_avx2.cpp, which is the only file built with AVX2 code generation.
+/// Only call it if cpuSupportsAvx2Fma() is true.
+ArrayKernels avx2Kernels();
+#endif
+
+Test* test();
+
+}
+
+#endif
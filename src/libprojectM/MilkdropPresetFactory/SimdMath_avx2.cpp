@@ -0,0 +1,74 @@
+// Built with AVX2 and FMA code generation (see CMakeLists.txt), so nothing in here may run before
+// SimdMath::cpuSupportsAvx2Fma() said yes. Only the two entry points at the end have external
+// linkage: Avx2 is in an anonymous namespace, which makes every kernel instantiated for it internal,
+// and the kernels do not use inline functions of other headers, whose AVX2 copy the linker could
+// otherwise pick for everyone.
+#if HAVE_AVX2_KERNELS
+
+#if !defined(__AVX2__) || !defined(__FMA__)
+#error "SimdMath_avx2.cpp must be compiled with AVX2 and FMA enabled"
+#endif
+
+#include "PerPixelMathSimd.hpp"
+#include <immintrin.h>
+
+namespace {
+
+/// The SimdMath operations on 8 floats
+struct Avx2 {
+    typedef __m256 Float;
+    typedef __m256i Int;
+    static const int width = 8;
+
+    static Float load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, Float a) { _mm256_storeu_ps(p, a); }
+    static Float set(float a) { return _mm256_set1_ps(a); }
+
+    static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+    static Float mulAdd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+    static Float negMulAdd(Float a, Float b, Float c) { return _mm256_fnmadd_ps(a, b, c); }
+    static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+    static Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+
+    static Float bitAnd(Float a, Float b) { return _mm256_and_ps(a, b); }
+    static Float bitOr(Float a, Float b) { return _mm256_or_ps(a, b); }
+    static Float bitXor(Float a, Float b) { return _mm256_xor_ps(a, b); }
+    static Float andNot(Float a, Float b) { return _mm256_andnot_ps(b, a); }
+    static Float select(Float mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+
+    static Float less(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Float lessEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static Float equal(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static bool allTrue(Float mask) { return _mm256_movemask_ps(mask) == 0xff; }
+
+    static Int round(Float a) { return _mm256_cvtps_epi32(a); }
+    static Float toFloat(Int a) { return _mm256_cvtepi32_ps(a); }
+    static Int asInt(Float a) { return _mm256_castps_si256(a); }
+    static Float asFloat(Int a) { return _mm256_castsi256_ps(a); }
+
+    static Int setInt(int a) { return _mm256_set1_epi32(a); }
+    static Int addInt(Int a, Int b) { return _mm256_add_epi32(a, b); }
+    static Int subInt(Int a, Int b) { return _mm256_sub_epi32(a, b); }
+    static Int andInt(Int a, Int b) { return _mm256_and_si256(a, b); }
+    static Int orInt(Int a, Int b) { return _mm256_or_si256(a, b); }
+    static Float equalInt(Int a, Int b) { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)); }
+    template <int bits> static Int shiftLeft(Int a) { return _mm256_slli_epi32(a, bits); }
+    template <int bits> static Int shiftRight(Int a) { return _mm256_srai_epi32(a, bits); }
+};
+
+}
+
+SimdMath::ArrayKernels SimdMath::avx2Kernels()
+{
+    return ArrayKernelsOf<Avx2>::get("avx2");
+}
+
+void SimdMath::perPixelMathAvx2(const PerPixelMesh &mesh)
+{
+    perPixelMath<Avx2>(mesh);
+}
+
+#endif
@@ -88,8 +88,10 @@ public:
 };
 
 
-PCM::PCM() : start(0), newsamples(0)
+PCM::PCM() : queueWrite(0), queueRead(0), start(0), newsamples(0), level(0.01)
 {
+    static_assert((queuesamples & (queuesamples-1)) == 0, "queuesamples must be a power of two");
+
     leveler = new AutoLevel();
 
     //Allocate FFT workspace
@@ -104,6 +106,8 @@ PCM::PCM() : start(0), newsamples(0)
     ip = (int *)wipemalloc(34 * sizeof(int));
     ip[0]=0;
 
+    memset(queueL, 0, sizeof(queueL));
+    memset(queueR, 0, sizeof(queueR));
     memset(pcmL, 0, sizeof(pcmL));
     memset(pcmR, 0, sizeof(pcmR));
     memset(freqL, 0, sizeof(freqL));
@@ -123,108 +127,125 @@ PCM::~PCM()
 #include <iostream>
 
 
+size_t PCM::_beginWrite(size_t count, size_t &position)
+{
+    position = queueWrite.load(std::memory_order_relaxed);
+    size_t space = queuesamples - (position - queueRead.load(std::memory_order_acquire));
+    return count < space ? count : space;
+}
+
+
+void PCM::_endWrite(size_t position)
+{
+    queueWrite.store(position, std::memory_order_release);
+}
+
+
 void PCM::addPCMfloat(const float *PCMdata, size_t samples)
 {
-    float a,sum=0,max=0;
+    size_t pos;
+    samples = _beginWrite(samples, pos);
     for (size_t i=0; i<samples; i++)
     {
-        size_t j=(i+start)%maxsamples;
-        a=pcmL[j] = PCMdata[i];
-        pcmR[j] = PCMdata[i];
-        sum += fabs(a);
-        max = fmax(max,a);
+        size_t j=(pos+i)%queuesamples;
+        queueL[j] = PCMdata[i];
+        queueR[j] = PCMdata[i];
     }
-    start = (start+samples)%maxsamples;
-    newsamples += samples;
-    level = leveler->updateLevel(samples, sum, max);
+    _endWrite(pos+samples);
 }
 
 
 /* NOTE: this method expects total samples, not samples per channel */
 void PCM::addPCMfloat_2ch(const float *PCMdata, size_t count)
 {
-    size_t samples = count/2;
-    float a,b,sum=0,max=0;
+    size_t pos;
+    size_t samples = _beginWrite(count/2, pos);
     for (size_t i=0; i<samples; i++)
     {
-        size_t j=(start+i)%maxsamples;
-        a = pcmL[j] = PCMdata[i*2];
-        b = pcmR[j] = PCMdata[i*2+1];
-        sum += fabs(a) + fabs(b);
-        max = fmax(fmax(max,fabs(a)),fabs(b));
+        size_t j=(pos+i)%queuesamples;
+        queueL[j] = PCMdata[i*2];
+        queueR[j] = PCMdata[i*2+1];
     }
-    start = (start + samples) % maxsamples;
-    newsamples += samples;
-    level = leveler->updateLevel(samples, sum/2, max);
+    _endWrite(pos+samples);
 }
 
 
 void PCM::addPCM16Data(const short* pcm_data, size_t samples)
 {
-    float a, b, sum = 0, max = 0;
+    size_t pos;
+    samples = _beginWrite(samples, pos);
     for (size_t i = 0; i < samples; ++i)
     {
-        size_t j = (i + start) % maxsamples;
-        a = pcmL[j] = (pcm_data[i * 2 + 0] / 16384.0);
-        b = pcmR[j] = (pcm_data[i * 2 + 1] / 16384.0);
-        sum += fabs(a) + fabs(b);
-        max = fmax(fmax(max, a), b);
+        size_t j = (pos + i) % queuesamples;
+        queueL[j] = (pcm_data[i * 2 + 0] / 16384.0);
+        queueR[j] = (pcm_data[i * 2 + 1] / 16384.0);
     }
-    start = (start + samples) % maxsamples;
-    newsamples += samples;
-    level = leveler->updateLevel(samples, sum/2, max);
+    _endWrite(pos+samples);
 }
 
 
 void PCM::addPCM16(const short PCMdata[2][512])
 {
-    const int samples=512;
-    float a,b,sum=0,max=0;
+    size_t pos;
+    const size_t samples = _beginWrite(512, pos);
     for (size_t i=0;i<samples;i++)
     {
-		size_t j=(i+start) % maxsamples;
-        a=pcmL[j]=(PCMdata[0][i]/16384.0);
-        b=pcmR[j]=(PCMdata[1][i]/16384.0);
-        sum += fabs(a) + fabs(b);
-        max = fmax(fmax(max,a),b);
+        size_t j=(pos+i) % queuesamples;
+        queueL[j]=(PCMdata[0][i]/16384.0);
+        queueR[j]=(PCMdata[1][i]/16384.0);
     }
-	start = (start+samples) % maxsamples;
-    newsamples += samples;
-    level = leveler->updateLevel(samples, sum/2, max);
+    _endWrite(pos+samples);
 }
 
 
 void PCM::addPCM8(const unsigned char PCMdata[2][1024])
 {
-    const int samples=1024;
-    float a,b,sum=0,max=0;
+    size_t pos;
+    const size_t samples = _beginWrite(1024, pos);
     for (size_t i=0; i<samples; i++)
     {
-        size_t j= (i+start) % maxsamples;
-        a=pcmL[j]=(((float)PCMdata[0][i] - 128.0) / 64 );
-        b=pcmR[j]=(((float)PCMdata[1][i] - 128.0) / 64 );
-        sum += fabs(a) + fabs(b);
-        max = fmax(fmax(max,a),b);
+        size_t j= (pos+i) % queuesamples;
+        queueL[j]=(((float)PCMdata[0][i] - 128.0) / 64 );
+        queueR[j]=(((float)PCMdata[1][i] - 128.0) / 64 );
     }
-    start = (start + samples) % maxsamples;
-    newsamples += samples;
-    level = leveler->updateLevel(samples, sum/2, max);
+    _endWrite(pos+samples);
 }
 
 
 void PCM::addPCM8_512(const unsigned char PCMdata[2][512])
 {
-    const size_t samples=512;
-    float a,b,sum=0,max=0;
+    size_t pos;
+    const size_t samples = _beginWrite(512, pos);
     for (size_t i=0; i<samples; i++)
     {
-        size_t j = (i+start) % maxsamples;
-        a=pcmL[j]=(((float)PCMdata[0][i] - 128.0 ) / 64 );
-        b=pcmR[j]=(((float)PCMdata[1][i] - 128.0 ) / 64 );
+        size_t j = (pos+i) % queuesamples;
+        queueL[j]=(((float)PCMdata[0][i] - 128.0 ) / 64 );
+        queueR[j]=(((float)PCMdata[1][i] - 128.0 ) / 64 );
+    }
+    _endWrite(pos+samples);
+}
+
+
+void PCM::drainQueue()
+{
+    size_t pos = queueRead.load(std::memory_order_relaxed);
+    const size_t end = queueWrite.load(std::memory_order_acquire);
+    const size_t samples = end - pos;
+    if (0 == samples)
+        return;
+
+    float a,b,sum=0,max=0;
+    for (; pos != end; pos++)
+    {
+        size_t j = pos % queuesamples;
+        a = pcmL[start] = queueL[j];
+        b = pcmR[start] = queueR[j];
+        start = (start+1) % maxsamples;
         sum += fabs(a) + fabs(b);
-        max = fmax(fmax(max,a),b);
+        max = fmax(max,fmax(fabs(a),fabs(b)));
     }
-    start = (start + samples) % maxsamples;
+    queueRead.store(end, std::memory_order_release);
+
     newsamples += samples;
     level = leveler->updateLevel(samples, sum/2, max);
 }
@@ -406,6 +427,12 @@ void PCM::freePCM()
 
 #ifndef NDEBUG
 
+#if USE_THREADS
+#include <chrono>
+#include <cmath>
+#include <thread>
+#endif
+
 #define TEST(cond) if (!verify(__FILE__ ": " #cond,cond)) return false
 #define TEST2(str,cond) if (!verify(str,cond)) return false
 
@@ -434,6 +461,7 @@ public:
                 data[i] = ((float) i) / (samples - 1);
             for (size_t i = 0; i < 10; i++)
                 pcm.addPCMfloat(data, samples);
+            pcm.drainQueue();
             float *copy = new float[samples];
             pcm.level = 1.0;
             pcm._copyPCM(copy, 0, samples);
@@ -457,6 +485,7 @@ public:
             }
             for (size_t i = 0; i < 10; i++)
                 pcm.addPCMfloat_2ch(data, samples*2);
+            pcm.drainQueue();
             float *copy0 = new float[samples];
             float *copy1 = new float[samples];
             pcm.level = 1;
@@ -493,6 +522,7 @@ public:
             }
             pcm.addPCMfloat_2ch(data, samples * 2);
             pcm.addPCMfloat_2ch(data, samples * 2);
+            pcm.drainQueue();
             float *freq0 = new float[FFT_LENGTH];
             float *freq1 = new float[FFT_LENGTH];
             pcm.level = 1.0;
@@ -515,6 +545,7 @@ public:
             float data[4] = {1.0,0.0,0.0,1.0};
             for (size_t i = 0; i < 1024; i++)
                 pcm.addPCMfloat_2ch(data, samples * 2);
+            pcm.drainQueue();
             float *freq0 = new float[FFT_LENGTH];
             float *freq1 = new float[FFT_LENGTH];
             pcm.level = 1.0;
@@ -534,10 +565,76 @@ public:
         return true;
     }
 
+    /* one thread adds stereo samples at 192kHz, the other drains and reads them like the render loop */
+    bool test_concurrent()
+    {
+#if USE_THREADS
+        PCM *pcm = new PCM();
+        const size_t rate = 192000;
+        const size_t block = 480;   // 2.5ms
+        const size_t blocks = rate / block;
+        std::atomic<bool> done(false);
+
+        // left counts up, right is the negated left, so torn or reordered data is easy to spot
+        std::thread producer([&]() {
+            float data[block*2];
+            size_t n = 0;
+            auto next = std::chrono::steady_clock::now();
+            for (size_t b = 0; b < blocks; b++)
+            {
+                for (size_t i = 0; i < block; i++, n++)
+                {
+                    data[i*2] = (float)(n % 4096);
+                    data[i*2+1] = -data[i*2];
+                }
+                pcm->addPCMfloat_2ch(data, block*2);
+                next += std::chrono::microseconds(block * 1000000 / rate);
+                std::this_thread::sleep_until(next);
+            }
+            done = true;
+        });
+
+        size_t frames = 0;
+        bool ok = true;
+        float pcmdata[512];
+        float spectrum[FFT_LENGTH];
+        while (ok && !done)
+        {
+            pcm->drainQueue();
+            if (pcm->queueRead >= PCM::maxsamples)
+            {
+                const size_t size = PCM::maxsamples;
+                for (size_t i = 1; i < size; i++)
+                {
+                    size_t cur = (pcm->start + size - i) % size;
+                    size_t prev = (cur + size - 1) % size;
+                    ok &= pcm->pcmR[cur] == -pcm->pcmL[cur];
+                    ok &= pcm->pcmL[prev] == (float)(((size_t)pcm->pcmL[cur] + 4095) % 4096);
+                }
+            }
+            pcm->getPCM(pcmdata, CHANNEL_0, 512, 0.0);
+            for (size_t i = 0; i < 512; i++)
+                ok &= std::isfinite(pcmdata[i]);
+            pcm->getSpectrum(spectrum, CHANNEL_1, FFT_LENGTH, 0.0);
+            for (size_t i = 0; i < FFT_LENGTH; i++)
+                ok &= std::isfinite(spectrum[i]);
+            frames++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(4));
+        }
+        producer.join();
+        delete pcm;
+
+        TEST(ok);
+        TEST(frames > 10);
+#endif
+        return true;
+    }
+
 	bool test() override
 	{
 		TEST(test_addpcm());
 		TEST(test_fft());
+		TEST(test_concurrent());
 		return true;
 	}
 };
@@ -30,6 +30,7 @@
 #define _PCM_H
 
 #include <stdlib.h>
+#include <atomic>
 #include "dlldefs.h"
 
 
@@ -57,9 +58,17 @@ public:
     /* maximum number of sound samples that are actually stored. */
     static const size_t maxsamples=2048;
 
+    /* number of stereo samples that can be queued between two calls to drainQueue(). */
+    static const size_t queuesamples=16384;
+
     PCM();
     ~PCM();
 
+    /**
+     * The add methods are called from the audio thread. They never block or allocate, samples
+     * are put into a lock-free queue and only become visible to getPCM() and getSpectrum()
+     * after the next drainQueue(). If the queue is full, the newest samples are dropped.
+     */
     void addPCMfloat( const float *PCMdata, size_t samples );
     void addPCMfloat_2ch( const float *PCMdata, size_t count );
     void addPCM16( const short [2][512] );
@@ -67,6 +76,12 @@ public:
     void addPCM8( const unsigned char [2][1024] );
     void addPCM8_512( const unsigned char [2][512] );
 
+    /**
+     * Moves the queued samples into the buffer read by getPCM() and getSpectrum().
+     * Called once per frame on the render thread, so everything drawn in a frame sees the same samples.
+     */
+    void drainQueue();
+
     /**
      * PCM data
      * When smoothing=0 is copied directly from PCM buffers. smoothing=1.0 is almost a straight line.
@@ -89,7 +104,18 @@ private:
     // spectrum 2x512*4b = 4k
     // w = 512*8b        = 4k
 
-    // circular PCM buffer
+    // single producer (audio thread) / single consumer (render thread) queue
+    // the positions only ever increase, the index into the arrays is position % queuesamples
+    float queueL[queuesamples];
+    float queueR[queuesamples];
+    std::atomic<size_t> queueWrite;
+    std::atomic<size_t> queueRead;
+
+    // reserve room for up to count samples in the queue, returns the number of samples that fit
+    size_t _beginWrite(size_t count, size_t &position);
+    void _endWrite(size_t position);
+
+    // circular PCM buffer, only touched by the render thread
     // adjust "volume" of PCM data as we go, this simplifies everything downstream...
     // normalize to range [-1.0,1.0]
     float pcmL[maxsamples];
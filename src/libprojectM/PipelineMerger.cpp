@@ -92,18 +92,15 @@ void PipelineMerger::mergePipelines(const Pipeline & a, const Pipeline & b, Pipe
 	if (a.staticPerPixel && b.staticPerPixel)
 	{
 		out.staticPerPixel = true;
-		 for (int x=0;x<a.gx;x++)
+		 for (int y=0;y<a.gy;y++)
 		    {
-		      for(int y=0;y<a.gy;y++)
+		      const float *ax = a.x_mesh.row(y), *bx = b.x_mesh.row(y);
+		      const float *ay = a.y_mesh.row(y), *by = b.y_mesh.row(y);
+		      float *outx = out.x_mesh.row(y), *outy = out.y_mesh.row(y);
+		      for(int x=0;x<a.gx;x++)
 			{
-			  out.x_mesh[x][y]  = a.x_mesh[x][y]* invratio + b.x_mesh[x][y]*ratio;
-			}
-		    }
-		 for (int x=0;x<a.gx;x++)
-		    {
-		      for(int y=0;y<a.gy;y++)
-			{
-			  out.y_mesh[x][y]  = a.y_mesh[x][y]* invratio + b.y_mesh[x][y]*ratio;
+			  outx[x]  = ax[x]* invratio + bx[x]*ratio;
+			  outy[x]  = ay[x]* invratio + by[x]*ratio;
 			}
 		    }
 	}
@@ -123,3 +120,135 @@ void PipelineMerger::mergePipelines(const Pipeline & a, const Pipeline & b, Pipe
         out.compositeShaderFilename = b.compositeShaderFilename;
     }
 }
+
+
+// TESTS
+
+#include <iostream>
+#include "TestRunner.hpp"
+
+#ifndef NDEBUG
+
+#include <cmath>
+#include <cstdlib>
+#include "AllocationCounter.hpp"
+#include "BeatDetect.hpp"
+#include "MilkdropPresetFactory/MilkdropPreset.hpp"
+#include "PCM.hpp"
+#include "PipelineContext.hpp"
+#include "PresetLoader.hpp"
+#include "WorkerPool.hpp"
+
+#define TEST(cond) if (!verify(__FILE__ ": " #cond,cond)) return false
+
+struct PipelineMergerTest : public Test
+{
+    PipelineMergerTest() : Test("PipelineMergerTest")
+    {}
+
+    // Runs the part of a soft cut frame that does not need a GL context: audio analysis, both
+    // presets and the merge into the pipeline that is kept between frames.
+    void frame(int index, float ratio, PCM & pcm, BeatDetect & beatDetect, PipelineContext & context,
+               Preset & a, Preset & b, Pipeline & out, RenderItemMatcher & matcher, MasterRenderItemMerge & merger)
+    {
+        float samples[512];
+        for (int i = 0; i < 512; i++)
+            samples[i] = 0.5f * sinf((index * 512 + i) * 0.05f);
+        pcm.addPCMfloat(samples, 512);
+        pcm.drainQueue();
+        beatDetect.detectFromSamples();
+
+        context.time = index / 60.0f;
+        context.frame = index;
+        context.progress = ratio;
+
+        a.Render(beatDetect, context);
+        b.Render(beatDetect, context);
+
+        out.setStaticPerPixel(32, 24);
+        PipelineMerger::mergePipelines(a.pipeline(), b.pipeline(), out, matcher.matchResults(), merger, ratio);
+    }
+
+    // once a transition has run for a few frames, further frames must not allocate
+    bool test_no_allocations()
+    {
+        if (!AllocationCounter::enabled())
+            return true;
+
+        const char *dir = getenv("PROJECTM_TEST_PRESET_DIR");
+        PresetLoader loader(32, 24, dir ? dir : "presets");
+        if (loader.size() < 2)
+        {
+            std::cout << "PipelineMergerTest: no presets found, skipping allocation check" << std::endl;
+            return true;
+        }
+
+        PCM pcm;
+        BeatDetect beatDetect(&pcm);
+        WorkerPool workerPool(4);
+        PipelineContext context;
+        context.fps = 60;
+        context.workerPool = &workerPool;
+        RenderItemMatcher matcher;
+        MasterRenderItemMerge merger;
+        Pipeline out;
+
+        const PresetIndex step = std::max<PresetIndex>(1, loader.size() / 16);
+        for (PresetIndex i = 0; i + 1 < loader.size(); i += step)
+        {
+            std::unique_ptr<Preset> a, b;
+            try
+            {
+                a = loader.loadPreset(loader.getPresetURL(i), loader.getPresetName(i));
+                b = loader.loadPreset(loader.getPresetURL(i + 1), loader.getPresetName(i + 1));
+            }
+            catch (...)
+            {
+                continue;
+            }
+            if (!a || !b)
+                continue;
+
+            // the equations are compiled on another thread, which allocates while the frames are counted
+            for (Preset *preset : { a.get(), b.get() })
+            {
+                if (auto milkdropPreset = dynamic_cast<MilkdropPreset *>(preset))
+                    milkdropPreset->waitForCompiledPrograms();
+            }
+
+            // warm up on both sides of the half way point, the merge switches shaders there
+            int index = 0;
+            for (; index < 4; index++)
+                frame(index, index < 2 ? 0.25f : 0.75f, pcm, beatDetect, context, *a, *b, out, matcher, merger);
+
+            const std::size_t before = AllocationCounter::count();
+            for (; index < 24; index++)
+                frame(index, index / 24.0f, pcm, beatDetect, context, *a, *b, out, matcher, merger);
+            const std::size_t allocations = AllocationCounter::count() - before;
+            if (allocations != 0)
+                std::cout << "PipelineMergerTest: " << allocations << " allocations during the transition from "
+                          << loader.getPresetName(i) << " to " << loader.getPresetName(i + 1) << std::endl;
+            TEST(allocations == 0);
+        }
+        return true;
+    }
+
+    bool test() override
+    {
+        return test_no_allocations();
+    }
+};
+
+Test* PipelineMerger::test()
+{
+    return new PipelineMergerTest();
+}
+
+#else
+
+Test* PipelineMerger::test()
+{
+    return nullptr;
+}
+
+#endif
@@ -5,6 +5,8 @@
 #include "RenderItemMatcher.hpp"
 #include "RenderItemMergeFunction.hpp"
 
+class Test;
+
 class PipelineMerger
 {
  template <class T> inline static T lerp(T a, T b, float ratio)
@@ -17,6 +19,8 @@ public:
   static void mergePipelines(const Pipeline &a,  const Pipeline &b, Pipeline &out, 
 	RenderItemMatcher::MatchResults & matching, RenderItemMergeFunction & merger, float ratio);
 
+  static Test* test();
+
 private :
 
 static const double s;
@@ -81,8 +81,12 @@ std::unique_ptr<Preset> PresetLoader::loadPreset ( PresetIndex index )  const
 {
 	// Check that index isn't insane
 	assert ( index < _entries.size() );
-	return _presetFactoryManager.allocate
-		( _entries[index], _presetNames[index] );
+	return loadPreset ( _entries[index], _presetNames[index] );
+}
+
+std::unique_ptr<Preset> PresetLoader::loadPreset ( const std::string & url, const std::string & name )  const
+{
+	return _presetFactoryManager.allocate ( url, name );
 }
 
 std::unique_ptr<Preset> PresetLoader::loadPreset ( const std::string & url )  const
@@ -90,8 +94,7 @@ std::unique_ptr<Preset> PresetLoader::loadPreset ( const std::string & url )  co
 //    std::cout << "Loading preset " << url << std::endl;
 	try {
 		/// @bug probably should not use url for preset name
-		return _presetFactoryManager.allocate
-				(url, url);
+		return loadPreset(url, url);
 	} catch (const std::exception & e) {
 		throw PresetFactoryException(e.what());
 	} catch (...) {
@@ -26,6 +26,8 @@ class PresetLoader {
 		/// was added to this loader
 		std::unique_ptr<Preset> loadPreset(PresetIndex index) const;
 		std::unique_ptr<Preset> loadPreset ( const std::string & url )  const;
+		/// Load a preset by url and name. Safe to call from any thread, e.g. the prefetch worker.
+		std::unique_ptr<Preset> loadPreset ( const std::string & url, const std::string & name )  const;
 		/// Add a preset to the loader's collection.
 		/// \param url an url referencing the preset
 		/// \param presetName a name for the preset
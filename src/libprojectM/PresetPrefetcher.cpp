@@ -0,0 +1,153 @@
+#include "PresetPrefetcher.hpp"
+#include "Preset.hpp"
+#include "PresetFactoryManager.hpp"
+
+PresetPrefetcher::PresetPrefetcher(const PresetLoader & presetLoader) : _presetLoader(presetLoader)
+{
+#if USE_THREADS
+    _worker = std::thread(&PresetPrefetcher::workerLoop, this);
+#endif
+}
+
+PresetPrefetcher::~PresetPrefetcher()
+{
+#if USE_THREADS
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    _condition.notify_all();
+    _worker.join();
+#endif
+}
+
+void PresetPrefetcher::prefetch(PresetIndex index)
+{
+#if USE_THREADS
+    const std::string url = _presetLoader.getPresetURL(index);
+    const std::string name = _presetLoader.getPresetName(index);
+
+    // Declared before the lock so they are destroyed after it has been released.
+    std::unique_ptr<Preset> ready;
+    std::unique_ptr<Preset> superseded;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_state != State::Idle && _url == url && _name == name)
+            return;
+
+        discard(ready, superseded);
+
+        _url = url;
+        _name = name;
+        _state = State::Pending;
+        _prepared = false;
+    }
+    _condition.notify_all();
+#else
+    (void)index;
+#endif
+}
+
+std::unique_ptr<Preset> PresetPrefetcher::allocate(PresetIndex index)
+{
+    const std::string url = _presetLoader.getPresetURL(index);
+    const std::string name = _presetLoader.getPresetName(index);
+
+#if USE_THREADS
+    std::unique_ptr<Preset> ready;
+    std::unique_ptr<Preset> superseded;
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if ((_state == State::Loading || _state == State::Ready) && _url == url && _name == name)
+    {
+        _condition.wait(lock, [this] { return _state != State::Loading; });
+
+        std::string error = _error;
+        discard(ready, superseded);
+        lock.unlock();
+
+        if (!ready && !error.empty())
+            throw PresetFactoryException(error);
+
+        return ready;
+    }
+
+    // Not the preset we guessed, or the worker did not get to it yet.
+    discard(ready, superseded);
+    lock.unlock();
+#endif
+
+    return _presetLoader.loadPreset(url, name);
+}
+
+void PresetPrefetcher::prepareReady(const std::function<void(Preset &)> & prepare)
+{
+#if USE_THREADS
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_state != State::Ready || !_preset || _prepared)
+        return;
+
+    _prepared = true;
+    prepare(*_preset);
+#else
+    (void)prepare;
+#endif
+}
+
+#if USE_THREADS
+void PresetPrefetcher::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        _condition.wait(lock, [this] { return !_running || _state == State::Pending; });
+
+        if (!_running)
+            return;
+
+        _state = State::Loading;
+        const std::string url = _url;
+        const std::string name = _name;
+        lock.unlock();
+
+        std::unique_ptr<Preset> preset;
+        std::string error;
+        try {
+            preset = _presetLoader.loadPreset(url, name);
+        } catch (const PresetFactoryException & e) {
+            error = e.message();
+        } catch (const std::exception & e) {
+            error = e.what();
+        } catch (...) {
+            error = "preset factory exception of unknown cause";
+        }
+
+        lock.lock();
+
+        // Still Loading means nobody asked for a different preset in the meantime.
+        if (_state == State::Loading)
+        {
+            _preset = std::move(preset);
+            _error = error;
+            _state = State::Ready;
+        }
+        else
+        {
+            _superseded = std::move(preset);
+        }
+
+        _condition.notify_all();
+    }
+}
+
+void PresetPrefetcher::discard(std::unique_ptr<Preset> & ready, std::unique_ptr<Preset> & superseded)
+{
+    ready = std::move(_preset);
+    superseded = std::move(_superseded);
+    _error.clear();
+    _state = State::Idle;
+}
+#endif
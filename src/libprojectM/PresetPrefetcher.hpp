@@ -0,0 +1,78 @@
+#ifndef PRESET_PREFETCHER_HPP
+#define PRESET_PREFETCHER_HPP
+
+#include "PresetLoader.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#if USE_THREADS
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+class Preset;
+
+/// Loads and parses the preset that is most likely to be shown next on a background thread,
+/// so the actual switch only has to hand over the finished preset and set up the pipeline.
+///
+/// All methods must be called from the render thread. Presets are only ever destroyed on
+/// the render thread as well, since releasing a preset may delete GL objects.
+class PresetPrefetcher {
+
+public:
+    /// \param presetLoader the loader used to allocate presets. Must outlive the prefetcher.
+    explicit PresetPrefetcher(const PresetLoader & presetLoader);
+
+    ~PresetPrefetcher();
+
+    /// Schedules the preset at the given loader index to be loaded in the background.
+    /// Any previously prefetched preset that was not picked up is discarded.
+    /// Does nothing if projectM was built without thread support.
+    void prefetch(PresetIndex index);
+
+    /// Returns the preset at the given loader index. Uses the prefetched preset if it matches,
+    /// waits for it if it is still being parsed and loads it synchronously otherwise.
+    /// \throws PresetFactoryException if the preset could not be loaded
+    std::unique_ptr<Preset> allocate(PresetIndex index);
+
+    /// Calls prepare with the prefetched preset once it has been parsed, once per prefetch, so
+    /// resources it needs can be loaded before the switch. Never waits for the worker.
+    void prepareReady(const std::function<void(Preset &)> & prepare);
+
+private:
+    const PresetLoader & _presetLoader;
+
+#if USE_THREADS
+    enum class State {
+        Idle,    //!< Nothing requested.
+        Pending, //!< A preset was requested, the worker has not picked it up yet.
+        Loading, //!< The worker is parsing the requested preset.
+        Ready    //!< Result (preset or error) is waiting to be picked up.
+    };
+
+    void workerLoop();
+
+    /// Resets the slot to Idle and hands out any finished or superseded preset so the caller can
+    /// destroy them outside of the lock. Must be called with _mutex held.
+    void discard(std::unique_ptr<Preset> & ready, std::unique_ptr<Preset> & superseded);
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    State _state{ State::Idle };
+    bool _running{ true };
+    bool _prepared{ false }; //!< The Ready preset was handed to prepareReady already.
+
+    std::string _url;
+    std::string _name;
+    std::unique_ptr<Preset> _preset;
+    std::string _error;
+    std::unique_ptr<Preset> _superseded; //!< Finished after being superseded, destroyed by the render thread.
+
+    std::thread _worker;
+#endif
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef RANDOM_NUMBER_GENERATORS_HPP
 #define RANDOM_NUMBER_GENERATORS_HPP
 #include <cmath>
+#include <cstdlib>
 #include <vector>
 #include <cassert>
 #include <iostream>
@@ -9,6 +10,20 @@
 
 namespace RandomNumberGenerators {
 
+/// State of uniform(), taken from rand() on first use
+inline int & uniformSeed()
+{
+	static int iseed = rand();
+	return iseed;
+}
+
+/// Restarts rand() and uniform(), so the same seed gives the same sequences again
+inline void seed(unsigned int value)
+{
+	srand(value);
+	uniformSeed() = rand();
+}
+
 inline float uniform()
 /* Uniform random number generator x(n+1)= a*x(n) mod c
 				with a = pow(7,5) and c = pow(2,31)-1.
@@ -17,7 +32,7 @@ inline float uniform()
 		const int ia=16807,ic=2147483647,iq=127773,ir=2836;
 		int il,ih,it;
 		float rc;
-		static int iseed = rand();
+		int &iseed = uniformSeed();
 		ih = iseed/iq;
 		il = iseed%iq;
 		it = ia*il-ir*ih;
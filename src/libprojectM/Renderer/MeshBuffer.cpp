@@ -0,0 +1,39 @@
+#include "MeshBuffer.hpp"
+#include "wipemalloc.h"
+#include <cassert>
+
+MeshBuffer::MeshBuffer() : _data(nullptr), _width(0), _height(0), _stride(0), _planeCount(0)
+{}
+
+MeshBuffer::~MeshBuffer()
+{
+    if (_data)
+        wipe_aligned_free(_data);
+}
+
+void MeshBuffer::allocate(int width, int height, int planeCount)
+{
+    assert(width > 0 && height > 0 && planeCount > 0);
+
+    if (_data && width == _width && height == _height && planeCount == _planeCount)
+        return;
+
+    if (_data)
+        wipe_aligned_free(_data);
+
+    const int rowAlignment = static_cast<int>(ALIGNMENT / sizeof(float));
+    _width = width;
+    _height = height;
+    _stride = (width + rowAlignment - 1) & ~(rowAlignment - 1);
+    _planeCount = planeCount;
+
+    const std::size_t bytes = planeSize() * planeCount * sizeof(float);
+    _data = static_cast<float *>(wipe_aligned_alloc(ALIGNMENT, bytes));
+    memset(_data, 0, bytes);
+}
+
+MeshPlane MeshBuffer::plane(int index) const
+{
+    assert(index >= 0 && index < _planeCount);
+    return MeshPlane(_data + planeSize() * index, _stride);
+}
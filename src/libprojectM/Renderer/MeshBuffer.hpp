@@ -0,0 +1,70 @@
+#ifndef MeshBuffer_HPP
+#define MeshBuffer_HPP
+
+#include <cstddef>
+
+/// One float per point of a per pixel mesh. The points are stored row by row, in the order
+/// Renderer::Interpolation uploads the vertices: point (i, j) is row(j)[i]. Every row starts on a
+/// 64 byte boundary and is padded with zeros up to stride() floats, so a plane can be processed as
+/// one flat array of stride() * height floats.
+///
+/// A plane only refers to memory owned by a MeshBuffer and is cheap to copy.
+class MeshPlane
+{
+public:
+    MeshPlane() : _data(nullptr), _stride(0) {}
+    MeshPlane(float *data, int stride) : _data(data), _stride(stride) {}
+
+    float &operator()(int i, int j) { return _data[j * _stride + i]; }
+    float operator()(int i, int j) const { return _data[j * _stride + i]; }
+
+    float *row(int j) { return _data + j * _stride; }
+    const float *row(int j) const { return _data + j * _stride; }
+
+    float *data() { return _data; }
+    const float *data() const { return _data; }
+
+    /// Distance between two rows, in floats
+    int stride() const { return _stride; }
+
+private:
+    float *_data;
+    int _stride;
+};
+
+
+/// Owns all planes of a mesh in a single 64 byte aligned block
+class MeshBuffer
+{
+public:
+    /// Alignment of the block and of every row, in bytes
+    static const std::size_t ALIGNMENT = 64;
+
+    MeshBuffer();
+    ~MeshBuffer();
+
+    MeshBuffer(const MeshBuffer &) = delete;
+    MeshBuffer &operator=(const MeshBuffer &) = delete;
+
+    /// Allocates planeCount zeroed planes of width * height points. Keeps the current block if it
+    /// already has this size, in which case the planes keep their values.
+    void allocate(int width, int height, int planeCount);
+
+    MeshPlane plane(int index) const;
+
+    int width() const { return _width; }
+    int height() const { return _height; }
+    int stride() const { return _stride; }
+
+    /// Floats in one plane, including the padding of its rows
+    std::size_t planeSize() const { return static_cast<std::size_t>(_stride) * _height; }
+
+private:
+    float *_data;
+    int _width;
+    int _height;
+    int _stride;
+    int _planeCount;
+};
+
+#endif
@@ -17,22 +17,11 @@ MilkdropWaveform::MilkdropWaveform(): RenderItem(),
     x(0.5), y(0.5), r(1), g(0), b(0), a(1), mystery(0), mode(Line), additive(false), dots(false), thick(false),
     modulateAlphaByVolume(false), maximizeColors(false), scale(10), smoothing(0),
     modOpacityStart(0), modOpacityEnd(1), rot(0), samples(512), loop(false) {
-
-    Init();
 }
 
 MilkdropWaveform::~MilkdropWaveform() {
 }
 
-void MilkdropWaveform::InitVertexAttrib() {
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
-    glDisableVertexAttribArray(1);
-
-}
-
-
 void MilkdropWaveform::Draw(RenderContext &context)
 {
     // NOTE MilkdropWaveform does not have a "samples" parameter
@@ -41,74 +30,53 @@ void MilkdropWaveform::Draw(RenderContext &context)
     WaveformMath(context);
 	assert(samples<=512);
 
-    for (int waveno=1 ; waveno<=(two_waves?2:1) ; waveno++)
-    {
-        glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
-
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * samples * 2, NULL, GL_DYNAMIC_DRAW);
-        if (waveno == 1)
-            glBufferData(GL_ARRAY_BUFFER, sizeof(float) * samples * 2, wavearray, GL_DYNAMIC_DRAW);
-        else
-            glBufferData(GL_ARRAY_BUFFER, sizeof(float) * samples * 2, wavearray2, GL_DYNAMIC_DRAW);
-
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glm::mat4 mat_first_translation = glm::mat4(1.0);
+    mat_first_translation[3][0] = -0.5;
+    mat_first_translation[3][1] = -0.5;
 
-        glUseProgram(context.programID_v2f_c4f);
+    glm::mat4 mat_scale = glm::mat4(1.0);
+    mat_scale[0][0] = aspectScale;
 
-        glm::mat4 mat_first_translation = glm::mat4(1.0);
-        mat_first_translation[3][0] = -0.5;
-        mat_first_translation[3][1] = -0.5;
+    float s = glm::sin(glm::radians(-rot));
+    float c = glm::cos(glm::radians(-rot));
+    glm::mat4 mat_rotation = glm::mat4(c, -s, 0, 0,
+                                       s, c, 0, 0,
+                                       0, 0, 1, 0,
+                                       0, 0, 0, 1);
 
-        glm::mat4 mat_scale = glm::mat4(1.0);
-        mat_scale[0][0] = aspectScale;
+    glm::mat4 mat_second_translation = glm::mat4(1.0);
+    mat_second_translation[3][0] = 0.5;
+    mat_second_translation[3][1] = 0.5;
 
-        float s = glm::sin(glm::radians(-rot));
-        float c = glm::cos(glm::radians(-rot));
-        glm::mat4 mat_rotation = glm::mat4(c, -s, 0, 0,
-                                           s, c, 0, 0,
-                                           0, 0, 1, 0,
-                                           0, 0, 0, 1);
+    VertexArena::State state;
+    state.transform = context.mat_ortho;
+    state.transform = mat_first_translation * state.transform;
+    state.transform = mat_scale * state.transform;
+    state.transform = mat_rotation * state.transform;
+    state.transform = mat_second_translation * state.transform;
 
-        glm::mat4 mat_second_translation = glm::mat4(1.0);
-        mat_second_translation[3][0] = 0.5;
-        mat_second_translation[3][1] = 0.5;
+    //Thick wave drawing
+    if (thick == 1) state.lineWidth = (context.texsize < 512) ? 2 : 2 * context.texsize / 512;
+    else state.lineWidth = (context.texsize < 512) ? 1 : context.texsize / 512;
 
-        glm::mat4 mat_vertex = context.mat_ortho;
-        mat_vertex = mat_first_translation * mat_vertex;
-        mat_vertex = mat_scale * mat_vertex;
-        mat_vertex = mat_rotation * mat_vertex;
-        mat_vertex = mat_second_translation * mat_vertex;
-        glUniformMatrix4fv(context.uniform_v2f_c4f_vertex_tranformation, 1, GL_FALSE, glm::value_ptr(mat_vertex));
+    //Additive wave drawing (vice overwrite)
+    if (additive == 1) state.blendDestination = GL_ONE;
 
+    for (int waveno=1 ; waveno<=(two_waves?2:1) ; waveno++)
+    {
         if (modulateAlphaByVolume) ModulateOpacityByVolume(context);
         else temp_a = a;
         MaximizeColors(context);
 
-#ifndef GL_TRANSITION
-        if (dots == 1) glEnable(GL_LINE_STIPPLE);
-#endif
+        const float (*wave)[2] = (waveno == 1) ? wavearray : wavearray2;
 
-        //Thick wave drawing
-        if (thick == 1) glLineWidth((context.texsize < 512) ? 2 : 2 * context.texsize / 512);
-        else glLineWidth((context.texsize < 512) ? 1 : context.texsize / 512);
+        GLint first;
+        VertexArena::Vertex *points = context.vertexArena->append(samples, first);
+        for (int i = 0; i < samples; i++)
+            points[i] = { wave[i][0], wave[i][1], temp_r, temp_g, temp_b, temp_a * masterAlpha, 0, 0 };
 
-        //Additive wave drawing (vice overwrite)
-        if (additive == 1)glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-        else glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-        glBindVertexArray(m_vaoID);
-
-        if (loop)
-            glDrawArrays(GL_LINE_LOOP, 0, samples);
-        else
-            glDrawArrays(GL_LINE_STRIP, 0, samples);
-
-        glBindVertexArray(0);
+        context.vertexArena->draw(state, loop ? GL_LINE_LOOP : GL_LINE_STRIP, first, samples);
     }
-
-#ifndef GL_TRANSITION
-		if(dots==1) glDisable(GL_LINE_STIPPLE);
-#endif
 }
 
 void MilkdropWaveform::ModulateOpacityByVolume(RenderContext &context)
@@ -178,11 +146,15 @@ void MilkdropWaveform::MaximizeColors(RenderContext &context)
 		}
 
 
-        glVertexAttrib4f(1, wave_r_switch, wave_g_switch, wave_b_switch, temp_a * masterAlpha);
+        temp_r = wave_r_switch;
+        temp_g = wave_g_switch;
+        temp_b = wave_b_switch;
 	}
 	else
 	{
-        glVertexAttrib4f(1, r, g, b, temp_a * masterAlpha);
+        temp_r = r;
+        temp_g = g;
+        temp_b = b;
 	}
 }
 
@@ -45,12 +45,14 @@ public:
 	MilkdropWaveform();
     ~MilkdropWaveform();
 	void Draw(RenderContext &context);
-    void InitVertexAttrib();
 
 	float modOpacityStart;
 	float modOpacityEnd;
 
 private:
+	float temp_r;
+	float temp_g;
+	float temp_b;
 	float temp_a;
 	float rot;
 	float aspectScale;
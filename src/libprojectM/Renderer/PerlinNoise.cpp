@@ -11,60 +11,83 @@
 
 PerlinNoise::PerlinNoise()
 {
-    for (int x = 0; x < 256;x++) {
-        for (int y = 0; y < 256;y++) {
-            noise_lq[x][y][0] = noise(x , y);
-            noise_lq[x][y][1] = noise_lq[x][y][0];
-            noise_lq[x][y][2] = noise_lq[x][y][0];
-        }
-    }
+    generate(*this);
+}
 
-    for (int x = 0; x < 32;x++) {
-        for (int y = 0; y < 32;y++) {
-            noise_lq_lite[x][y][0] = noise(4*x,16*y);
-            noise_lq_lite[x][y][1] = noise_lq_lite[x][y][0];
-            noise_lq_lite[x][y][2] = noise_lq_lite[x][y][0];
-        }
-    }
+PerlinNoise::~PerlinNoise()
+{
+	// TODO Auto-generated destructor stub
+}
 
-    for (int x = 0; x < 256;x++) {
-        for (int y = 0; y < 256;y++) {
-            noise_mq[x][y][0] = InterpolatedNoise((float)x/(float)2.0,(float)y/(float)2.0);
-            noise_mq[x][y][1] = noise_mq[x][y][0];
-            noise_mq[x][y][2] = noise_mq[x][y][0];
-        }
-    }
 
-    for (int x = 0; x < 256;x++) {
-        for (int y = 0; y < 256;y++) {
-            noise_hq[x][y][0] = InterpolatedNoise((float)x/(float)3.0,(float)y/(float)3.0);
-            noise_hq[x][y][1] = noise_hq[x][y][0];
-            noise_hq[x][y][2] = noise_hq[x][y][0];
-        }
+// TESTS
+
+#include <cstring>
+#include <memory>
+#include "TestRunner.hpp"
+#include "PerlinNoiseWithAlpha.hpp"
+
+#ifndef NDEBUG
+
+#define TEST(cond) if (!verify(__FILE__ ": " #cond,cond)) return false
+
+struct PerlinNoiseTest : public Test
+{
+    PerlinNoiseTest() : Test("PerlinNoiseTest")
+    {}
+
+    // every channel holds value, bit for bit
+    template <std::size_t channels>
+    static bool same(const float (&texel)[channels], float value)
+    {
+        for (std::size_t c = 0; c < 3; c++)
+            if (memcmp(&texel[c], &value, sizeof(float)) != 0)
+                return false;
+        return channels == 3 || texel[3] == 1.f;
     }
 
-    for (int x = 0; x < 32;x++) {
-        for (int y = 0; y < 32;y++) {
-            for (int z = 0; z < 32;z++) {
-                noise_lq_vol[x][y][z][0] = noise(x,y,z);
-                noise_lq_vol[x][y][z][1] = noise_lq_vol[x][y][z][0];
-                noise_lq_vol[x][y][z][2] = noise_lq_vol[x][y][z][0];
+    // compares with the texel by texel generator the textures were made with before
+    template <class Noise>
+    bool test_generator(const Noise & generated)
+    {
+        for (int x = 0; x < 256; x++) {
+            for (int y = 0; y < 256; y++) {
+                TEST(same(generated.noise_lq[x][y], PerlinNoise::noise(x, y)));
+                TEST(same(generated.noise_mq[x][y], PerlinNoise::InterpolatedNoise((float)x/(float)2.0,(float)y/(float)2.0)));
+                TEST(same(generated.noise_hq[x][y], PerlinNoise::InterpolatedNoise((float)x/(float)3.0,(float)y/(float)3.0)));
             }
         }
-    }
 
-    for (int x = 0; x < 32;x++) {
-        for (int y = 0; y < 32;y++) {
-            for (int z = 0; z < 32;z++) {
-                noise_hq_vol[x][y][z][0] = noise(x,y,z);
-                noise_hq_vol[x][y][z][1] = noise_hq_vol[x][y][z][0];
-                noise_hq_vol[x][y][z][2] = noise_hq_vol[x][y][z][0];
+        for (int x = 0; x < 32; x++) {
+            for (int y = 0; y < 32; y++) {
+                TEST(same(generated.noise_lq_lite[x][y], PerlinNoise::noise(4*x, 16*y)));
+                for (int z = 0; z < 32; z++) {
+                    TEST(same(generated.noise_lq_vol[x][y][z], PerlinNoise::noise(x, y, z)));
+                    TEST(same(generated.noise_hq_vol[x][y][z], PerlinNoise::noise(x, y, z)));
+                }
             }
         }
+        return true;
+    }
+
+    bool test() override
+    {
+        std::unique_ptr<PerlinNoise> noise(new PerlinNoise());
+        std::unique_ptr<PerlinNoiseWithAlpha> noiseWithAlpha(new PerlinNoiseWithAlpha());
+        return test_generator(*noise) && test_generator(*noiseWithAlpha);
     }
+};
+
+Test* PerlinNoise::test()
+{
+    return new PerlinNoiseTest();
 }
 
-PerlinNoise::~PerlinNoise()
+#else
+
+Test* PerlinNoise::test()
 {
-	// TODO Auto-generated destructor stub
+    return nullptr;
 }
+
+#endif
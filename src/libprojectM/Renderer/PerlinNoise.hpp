@@ -9,6 +9,14 @@
 #define PERLINNOISE_HPP_
 
 #include <math.h>
+#include <cstddef>
+#include <vector>
+
+#if USE_THREADS
+#include <thread>
+#endif
+
+class Test;
 
 class PerlinNoise
 {
@@ -25,12 +33,44 @@ public:
 	PerlinNoise();
 	virtual ~PerlinNoise();
 
+	/// Fills the textures of a PerlinNoise or a PerlinNoiseWithAlpha, split across threads. The
+	/// values are the same as evaluating noise() and InterpolatedNoise() texel by texel.
+	template <class Noise>
+	static void generate(Noise &target);
+
+	static Test *test();
+
 private:
 
+	friend struct PerlinNoiseTest;
+
+	template <class Noise>
+	static void generateColumns(Noise &target, int begin, int end);
+
+	template <std::size_t channels>
+	static void generateInterpolated(float (&texels)[256][256][channels], float scale, int begin, int end);
+
+	static inline void setTexel(float (&texel)[3], float value)
+	{
+		texel[0] = value;
+		texel[1] = value;
+		texel[2] = value;
+	}
+
+	static inline void setTexel(float (&texel)[4], float value)
+	{
+		texel[0] = value;
+		texel[1] = value;
+		texel[2] = value;
+		texel[3] = 1.f;
+	}
+
 	static inline float noise( int x)
 	{
-	    x = (x<<13)^x;
-	    return (((x * (x * x * 15731 + 789221) + 1376312589) & 0x7fffffff) / 2147483648.0);
+	    // unsigned, so the hash wraps around instead of overflowing, which optimizers may assume never happens
+	    unsigned int n = x;
+	    n = (n<<13)^n;
+	    return (((n * (n * n * 15731 + 789221) + 1376312589) & 0x7fffffff) / 2147483648.0);
 	   }
 
 	static inline float noise(int x, int y)
@@ -54,6 +94,16 @@ private:
 		return P*pow(x,3) + Q * pow(x,2) + R*x + v1;
 	}
 
+	// cubic_interp with the powers of x computed once for many calls
+	static inline float cubic_interp(float v0, float v1, float v2, float v3, float x, double x2, double x3)
+	{
+		float P = (v3 - v2) - (v0 - v1);
+		float Q = (v0 - v1) - P;
+		float R = v2 - v0;
+
+		return P*x3 + Q * x2 + R*x + v1;
+	}
+
 	static inline float InterpolatedNoise(float x, float y)
 	{
 		int integer_X = int(x);
@@ -167,4 +217,95 @@ private:
 
 };
 
+template <class Noise>
+void PerlinNoise::generate(Noise &target)
+{
+#if USE_THREADS
+	// every thread takes a band of x for all textures
+	unsigned int threads = std::thread::hardware_concurrency();
+	threads = threads < 1 ? 1 : (threads > 4 ? 4 : threads);
+
+	std::vector<std::thread> workers;
+	for (unsigned int i = 1; i < threads; i++)
+		workers.emplace_back(&PerlinNoise::generateColumns<Noise>, std::ref(target), 256 * i / threads, 256 * (i + 1) / threads);
+	generateColumns(target, 0, 256 / threads);
+	for (auto & worker : workers)
+		worker.join();
+#else
+	generateColumns(target, 0, 256);
+#endif
+}
+
+// x in [begin, end) of the 256 wide textures, the matching eighth of it for the 32 wide ones
+template <class Noise>
+void PerlinNoise::generateColumns(Noise &target, int begin, int end)
+{
+	for (int x = begin; x < end; x++)
+		for (int y = 0; y < 256; y++)
+			setTexel(target.noise_lq[x][y], noise(x, y));
+
+	for (int x = begin / 8; x < end / 8; x++) {
+		for (int y = 0; y < 32; y++)
+			setTexel(target.noise_lq_lite[x][y], noise(4*x, 16*y));
+
+		for (int y = 0; y < 32; y++) {
+			for (int z = 0; z < 32; z++) {
+				float value = noise(x, y, z);
+				setTexel(target.noise_lq_vol[x][y][z], value);
+				setTexel(target.noise_hq_vol[x][y][z], value);
+			}
+		}
+	}
+
+	generateInterpolated(target.noise_mq, 2.0f, begin, end);
+	generateInterpolated(target.noise_hq, 3.0f, begin, end);
+}
+
+// InterpolatedNoise(x / scale, y / scale), split into one pass along x for every row of samples and
+// one along y. The row below the texel's cell starts at X instead of X - 1, as in InterpolatedNoise.
+template <std::size_t channels>
+void PerlinNoise::generateInterpolated(float (&texels)[256][256][channels], float scale, int begin, int end)
+{
+	int integerY[256];
+	float fractionalY[256];
+	double fractionalY2[256];
+	double fractionalY3[256];
+	for (int y = 0; y < 256; y++) {
+		float fy = (float)y / scale;
+		integerY[y] = int(fy);
+		fractionalY[y] = fy - integerY[y];
+		fractionalY2[y] = pow(fractionalY[y], 2);
+		fractionalY3[y] = pow(fractionalY[y], 3);
+	}
+
+	// rows integerY - 1 to integerY + 2, stored from row -1 on
+	const int rows = integerY[255] + 4;
+	std::vector<float> row(rows);
+	std::vector<float> rowFromX(rows);
+
+	for (int x = begin; x < end; x++) {
+		float fx = (float)x / scale;
+		int integerX = int(fx);
+		float fractionalX = fx - integerX;
+		double fractionalX2 = pow(fractionalX, 2);
+		double fractionalX3 = pow(fractionalX, 3);
+
+		for (int i = 0; i < rows; i++) {
+			int sampleY = i - 1;
+			float n0 = noise(integerX - 1, sampleY);
+			float n1 = noise(integerX,     sampleY);
+			float n2 = noise(integerX + 1, sampleY);
+			float n3 = noise(integerX + 2, sampleY);
+			row[i] = cubic_interp(n0, n1, n2, n3, fractionalX, fractionalX2, fractionalX3);
+			rowFromX[i] = cubic_interp(n1, n1, n2, n3, fractionalX, fractionalX2, fractionalX3);
+		}
+
+		for (int y = 0; y < 256; y++) {
+			const int i = integerY[y] + 1;
+			setTexel(texels[x][y], cubic_interp(row[i - 1], row[i], rowFromX[i + 1], row[i + 2],
+			                                    fractionalY[y], fractionalY2[y], fractionalY3[y]));
+		}
+	}
+}
+
 #endif /* PERLINNOISE_HPP_ */
@@ -5,7 +5,6 @@
  *      Author: pete
  */
 #include "Pipeline.hpp"
-#include "wipemalloc.h"
 
 Pipeline::Pipeline() : staticPerPixel(false),gx(0),gy(0),blur1n(1), blur2n(1), blur3n(1),
 blur1x(1), blur2x(1), blur3x(1),
@@ -17,18 +16,13 @@ void Pipeline::setStaticPerPixel(int _gx, int _gy)
     this->gx = _gx;
     this->gy = _gy;
 
-	this->x_mesh = alloc_mesh(gx, gy);
-	this->y_mesh = alloc_mesh(gx, gy);
+	meshBuffer.allocate(gx, gy, 2);
+	this->x_mesh = meshBuffer.plane(0);
+	this->y_mesh = meshBuffer.plane(1);
 }
 
 Pipeline::~Pipeline()
-{
-	if (staticPerPixel)
-	{
-		free_mesh(x_mesh);
-		free_mesh(y_mesh);
-	}
-}
+{}
 
 PixelPoint Pipeline::PerPixel(PixelPoint p, const PerPixelContext context)
 {return p;}
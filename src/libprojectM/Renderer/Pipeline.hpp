@@ -2,6 +2,7 @@
 #define Pipeline_HPP
 
 #include <vector>
+#include "MeshBuffer.hpp"
 #include "PerPixelMesh.hpp"
 #include "Renderable.hpp"
 #include "Filters.hpp"
@@ -22,8 +23,8 @@ public:
 	 int gx;
 	 int gy;
 
-	 float** x_mesh;
-	 float** y_mesh;
+	 MeshPlane x_mesh;
+	 MeshPlane y_mesh;
 	 //end static per pixel
 
 	 bool  textureWrap;
@@ -50,12 +51,14 @@ public:
 	 std::vector<RenderItem*> compositeDrawables;
 
 	 Pipeline();
+     /// Allocates x_mesh and y_mesh, keeps them if they already have this size
      void setStaticPerPixel(int _gx, int _gy);
 	 virtual ~Pipeline();
 	 virtual PixelPoint PerPixel(PixelPoint p, const PerPixelContext context);
-};
 
-float **alloc_mesh(size_t gx, size_t gy);
-float **free_mesh(float **mesh);
+protected:
+	 /// Storage of x_mesh and y_mesh, subclasses may put more planes in it
+	 MeshBuffer meshBuffer;
+};
 
 #endif
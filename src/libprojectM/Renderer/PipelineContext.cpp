@@ -7,5 +7,5 @@
 
 #include "PipelineContext.hpp"
 
-PipelineContext::PipelineContext() {}
+PipelineContext::PipelineContext() : workerPool(nullptr) {}
 PipelineContext::~PipelineContext() {}
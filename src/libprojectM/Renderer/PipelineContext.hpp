@@ -8,6 +8,8 @@
 #ifndef PIPELINECONTEXT_HPP_
 #define PIPELINECONTEXT_HPP_
 
+class WorkerPool;
+
 class PipelineContext
 {
 public:
@@ -16,6 +18,7 @@ public:
     float presetStartTime;
 	int   frame;
 	float progress;
+	WorkerPool * workerPool; /* threads presets may use for per pixel work, null if there are none */
 
 	PipelineContext();
 	virtual ~PipelineContext();
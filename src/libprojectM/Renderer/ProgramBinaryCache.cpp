@@ -0,0 +1,282 @@
+#include "ProgramBinaryCache.hpp"
+#include "ShaderCache.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef WIN32
+#include "dirent.h"
+#include <direct.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <utime.h>
+#endif
+
+namespace {
+
+// start of every entry, followed by the binary format and the binary
+const char MAGIC[4] = { 'P', 'M', 'B', '1' };
+const char EXTENSION[] = ".bin";
+
+struct Entry
+{
+    std::string path;
+    std::size_t size;
+    time_t lastUse;
+
+    bool operator<(const Entry &other) const
+    {
+        return lastUse != other.lastUse ? lastUse < other.lastUse : path < other.path;
+    }
+};
+
+std::vector<Entry> listEntries(const std::string &directory)
+{
+    std::vector<Entry> entries;
+    DIR *dir = opendir(directory.c_str());
+    if (dir == NULL)
+        return entries;
+
+    const std::size_t extensionLength = sizeof(EXTENSION) - 1;
+    struct dirent *dir_entry;
+    while ((dir_entry = readdir(dir)) != NULL)
+    {
+        const std::string name = dir_entry->d_name;
+        if (name.size() <= extensionLength || name.compare(name.size() - extensionLength, extensionLength, EXTENSION) != 0)
+            continue;
+
+        Entry entry;
+        entry.path = directory + "/" + name;
+        struct stat status;
+        if (stat(entry.path.c_str(), &status) != 0)
+            continue;
+        entry.size = static_cast<std::size_t>(status.st_size);
+        entry.lastUse = status.st_mtime;
+        entries.push_back(entry);
+    }
+    closedir(dir);
+    return entries;
+}
+
+}
+
+ProgramBinaryCache::ProgramBinaryCache(std::size_t sizeLimit) : _sizeLimit(sizeLimit)
+{}
+
+void ProgramBinaryCache::setDirectory(const std::string &directory)
+{
+    _directory = directory;
+    if (_directory.empty())
+        return;
+
+#ifdef WIN32
+    _mkdir(_directory.c_str());
+#else
+    mkdir(_directory.c_str(), 0755);
+#endif
+}
+
+ProgramBinaryCache::Key ProgramBinaryCache::key(const std::string &driver, const std::string &vertexSource,
+                                                const std::string &fragmentSource)
+{
+    Key result = ShaderCache::hash(ShaderCache::INITIAL_HASH, driver);
+    result = ShaderCache::hash(result, vertexSource);
+    return ShaderCache::hash(result, fragmentSource);
+}
+
+std::string ProgramBinaryCache::path(Key key) const
+{
+    char name[24];
+    snprintf(name, sizeof(name), "%016llx%s", static_cast<unsigned long long>(key), EXTENSION);
+    return _directory + "/" + name;
+}
+
+bool ProgramBinaryCache::load(Key key, std::uint32_t &format, std::vector<char> &binary)
+{
+    if (!enabled())
+        return false;
+
+    const std::string entryPath = path(key);
+    std::ifstream file(entryPath.c_str(), std::ios_base::in | std::ios_base::binary);
+    if (!file)
+        return false;
+
+    char magic[sizeof(MAGIC)];
+    if (!file.read(magic, sizeof(magic)) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+        return false;
+    if (!file.read(reinterpret_cast<char *>(&format), sizeof(format)))
+        return false;
+
+    binary.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (binary.empty())
+        return false;
+
+    // the modification time orders the entries for eviction
+    file.close();
+    utime(entryPath.c_str(), NULL);
+    return true;
+}
+
+void ProgramBinaryCache::store(Key key, std::uint32_t format, const std::vector<char> &binary)
+{
+    if (!enabled() || binary.empty() || binary.size() > _sizeLimit)
+        return;
+
+    // write to a temporary file first, so a reader never sees a partial entry
+    const std::string target = path(key);
+    const std::string temporary = target + ".tmp";
+    {
+        std::ofstream file(temporary.c_str(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+        if (!file)
+            return;
+        file.write(MAGIC, sizeof(MAGIC));
+        file.write(reinterpret_cast<const char *>(&format), sizeof(format));
+        file.write(binary.data(), binary.size());
+        if (!file)
+        {
+            file.close();
+            std::remove(temporary.c_str());
+            return;
+        }
+    }
+    std::remove(target.c_str());
+    if (std::rename(temporary.c_str(), target.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        return;
+    }
+
+    evict();
+}
+
+void ProgramBinaryCache::remove(Key key)
+{
+    if (enabled())
+        std::remove(path(key).c_str());
+}
+
+std::size_t ProgramBinaryCache::size() const
+{
+    std::size_t total = 0;
+    for (const Entry &entry : listEntries(_directory))
+        total += entry.size;
+    return total;
+}
+
+void ProgramBinaryCache::evict()
+{
+    std::vector<Entry> entries = listEntries(_directory);
+
+    std::size_t total = 0;
+    for (const Entry &entry : entries)
+        total += entry.size;
+    if (total <= _sizeLimit)
+        return;
+
+    std::sort(entries.begin(), entries.end());
+    for (std::vector<Entry>::const_iterator oldest = entries.begin(); oldest != entries.end() && total > _sizeLimit; ++oldest)
+    {
+        if (std::remove(oldest->path.c_str()) == 0)
+            total -= oldest->size;
+    }
+}
+
+
+// TESTS
+
+#include <iostream>
+#include "TestRunner.hpp"
+
+#ifndef NDEBUG
+
+#include <ctime>
+
+#define TEST(cond) if (!verify(__FILE__ ": " #cond,cond)) return false
+
+struct ProgramBinaryCacheTest : public Test
+{
+    ProgramBinaryCacheTest() : Test("ProgramBinaryCacheTest")
+    {}
+
+    const std::string directory = "ProgramBinaryCacheTest.tmp";
+
+    // sets the last use of an entry, the file system only keeps seconds
+    void setLastUse(ProgramBinaryCache::Key key, time_t time)
+    {
+        char fileName[24];
+        snprintf(fileName, sizeof(fileName), "%016llx.bin", static_cast<unsigned long long>(key));
+        struct utimbuf times;
+        times.actime = time;
+        times.modtime = time;
+        utime((directory + "/" + fileName).c_str(), &times);
+    }
+
+    bool test_entries(ProgramBinaryCache & cache)
+    {
+        const std::vector<char> a(100, 'a'), b(100, 'b'), c(100, 'c');
+        std::uint32_t format = 0;
+        std::vector<char> binary;
+
+        const ProgramBinaryCache::Key keyA = ProgramBinaryCache::key("driver", "vertex", "a");
+        TEST(keyA != ProgramBinaryCache::key("other driver", "vertex", "a"));
+        TEST(!cache.load(keyA, format, binary));
+
+        cache.store(keyA, 0x1234, a);
+        TEST(cache.load(keyA, format, binary));
+        TEST(format == 0x1234);
+        TEST(binary == a);
+
+        // a rejected binary is gone
+        cache.remove(keyA);
+        TEST(!cache.load(keyA, format, binary));
+
+        // the least recently used entry goes first, a hit counts as a use
+        const time_t now = time(NULL);
+        cache.store(keyA, 1, a);
+        setLastUse(keyA, now - 100);
+        const ProgramBinaryCache::Key keyB = ProgramBinaryCache::key("driver", "vertex", "b");
+        cache.store(keyB, 1, b);
+        setLastUse(keyB, now - 50);
+        TEST(cache.load(keyA, format, binary));
+
+        const ProgramBinaryCache::Key keyC = ProgramBinaryCache::key("driver", "vertex", "c");
+        cache.store(keyC, 1, c);
+        TEST(cache.size() <= 250);
+        TEST(cache.load(keyA, format, binary) && binary == a);
+        TEST(!cache.load(keyB, format, binary));
+        TEST(cache.load(keyC, format, binary) && binary == c);
+        return true;
+    }
+
+    bool test() override
+    {
+        // each entry has 8 bytes of header, so two entries of 100 bytes fit
+        ProgramBinaryCache cache(250);
+        cache.setDirectory(directory);
+        const bool result = test_entries(cache);
+
+        for (const char *fragment : { "a", "b", "c" })
+            cache.remove(ProgramBinaryCache::key("driver", "vertex", fragment));
+        std::remove(directory.c_str());
+        return result;
+    }
+};
+
+Test* ProgramBinaryCache::test()
+{
+    return new ProgramBinaryCacheTest();
+}
+
+#else
+
+Test* ProgramBinaryCache::test()
+{
+    return nullptr;
+}
+
+#endif
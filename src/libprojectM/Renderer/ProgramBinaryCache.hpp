@@ -0,0 +1,54 @@
+#ifndef ProgramBinaryCache_HPP
+#define ProgramBinaryCache_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Test;
+
+/// Linked GL programs as returned by glGetProgramBinary, stored in a directory so later loads of the
+/// same preset skip compiling and linking.
+///
+/// Entries are addressed by a hash of the GLSL sources and the driver, and keep the binary format next
+/// to the data. The directory is kept below a size limit by deleting the least recently used entries,
+/// a hit counts as a use. Drivers may still reject a binary, for example after an update that kept
+/// the version string, so callers must be ready to compile and replace the entry.
+class ProgramBinaryCache
+{
+public:
+    typedef std::uint64_t Key;
+
+    explicit ProgramBinaryCache(std::size_t sizeLimit = 64 * 1024 * 1024);
+
+    /// Directory holding the entries, created if missing. Empty disables the cache.
+    void setDirectory(const std::string &directory);
+    bool enabled() const { return !_directory.empty(); }
+
+    /// driver identifies the GL implementation, e.g. its vendor, renderer and version strings
+    static Key key(const std::string &driver, const std::string &vertexSource, const std::string &fragmentSource);
+
+    /// Reads the binary and its format and marks the entry as used. Returns false if there is none.
+    bool load(Key key, std::uint32_t &format, std::vector<char> &binary);
+
+    /// Writes an entry, then evicts the least recently used ones until the directory fits the limit
+    void store(Key key, std::uint32_t format, const std::vector<char> &binary);
+
+    /// Deletes an entry the driver did not accept
+    void remove(Key key);
+
+    /// Total size of the entries in the directory, in bytes
+    std::size_t size() const;
+
+    static Test *test();
+
+private:
+    std::string path(Key key) const;
+    void evict();
+
+    std::size_t _sizeLimit;
+    std::string _directory;
+};
+
+#endif
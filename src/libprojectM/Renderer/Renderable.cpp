@@ -6,79 +6,35 @@
 #include "ShaderEngine.hpp"
 #include <glm/gtc/type_ptr.hpp>
 
-typedef float floatPair[2];
-typedef float floatTriple[3];
-typedef float floatQuad[4];
-
 RenderContext::RenderContext()
-	: time(0),texsize(512), aspectRatio(1), aspectCorrect(false){};
+	: time(0),texsize(512), aspectRatio(1), aspectCorrect(false), vertexArena(nullptr){};
 
 RenderItem::RenderItem():masterAlpha(1){}
 
-void RenderItem::Init() {
-    glGenVertexArrays(1, &m_vaoID);
-    glGenBuffers(1, &m_vboID);
-
-    glBindVertexArray(m_vaoID);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
-
-    InitVertexAttrib();
-
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-}
-
-RenderItem::~RenderItem() {
-    glDeleteBuffers(1, &m_vboID);
-    glDeleteVertexArrays(1, &m_vaoID);
-}
-
 
 DarkenCenter::DarkenCenter():RenderItem(){
-    Init();
 }
 
 MotionVectors::MotionVectors():RenderItem() {
-    Init();
 }
 
 Border::Border():RenderItem() {
-    Init();
 }
 
-void DarkenCenter::InitVertexAttrib() {
-    float points_colors[6][6] = {
-        { 0.5,  0.5,      0, 0, 0, (3.0f/32.0f) * masterAlpha},
-        { 0.45, 0.5,      0, 0, 0, 0},
-        { 0.5,  0.45,     0, 0, 0, 0},
-        { 0.55, 0.5,      0, 0, 0, 0},
-        { 0.5,  0.55,     0, 0, 0, 0},
-        { 0.45, 0.5,      0, 0, 0, 0}};
-
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(float)*6, (void*)0); // points
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(float)*6, (void*)(sizeof(float)*2)); // colors
-
-    glBufferData(GL_ARRAY_BUFFER, sizeof(points_colors), points_colors, GL_STATIC_DRAW);
-
-}
-
-
 void DarkenCenter::Draw(RenderContext &context)
-	{
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    glUseProgram(context.programID_v2f_c4f);
-
-    glUniformMatrix4fv(context.uniform_v2f_c4f_vertex_tranformation, 1, GL_FALSE, glm::value_ptr(context.mat_ortho));
-
-    glBindVertexArray(m_vaoID);
-
-	glDrawArrays(GL_TRIANGLE_FAN,0,6);
-
-    glBindVertexArray(0);
+{
+    const VertexArena::Vertex points_colors[6] = {
+        { 0.5f,  0.5f,      0, 0, 0, (3.0f/32.0f) * masterAlpha,  0, 0},
+        { 0.45f, 0.5f,      0, 0, 0, 0,  0, 0},
+        { 0.5f,  0.45f,     0, 0, 0, 0,  0, 0},
+        { 0.55f, 0.5f,      0, 0, 0, 0,  0, 0},
+        { 0.5f,  0.55f,     0, 0, 0, 0,  0, 0},
+        { 0.45f, 0.5f,      0, 0, 0, 0,  0, 0}};
+
+    VertexArena::State state;
+    state.transform = context.mat_ortho;
+
+    context.vertexArena->drawFan(state, points_colors, 6);
 }
 
 Shape::Shape():RenderItem()
@@ -111,210 +67,126 @@ Shape::Shape():RenderItem()
 	     border_g = 0.0; /* green color value */
 	     border_b = 0.0; /* blue color value */
 	     border_a = 0.0; /* alpha color value */
-
-
-    glGenVertexArrays(1, &m_vaoID_texture);
-    glGenBuffers(1, &m_vboID_texture);
-
-    glGenVertexArrays(1, &m_vaoID_not_texture);
-    glGenBuffers(1, &m_vboID_not_texture);
-
-    glBindVertexArray(m_vaoID_texture);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vboID_texture);
-
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(struct_data), (void*)0);     // Positions
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(struct_data), (void*)(sizeof(float)*2));     // Colors
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(struct_data), (void*)(sizeof(float)*6)); // Textures
-
-    glBindVertexArray(m_vaoID_not_texture);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vboID_not_texture);
-
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(struct_data), (void*)0);   // points
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(struct_data), (void*)(sizeof(float)*2));     // Colors
-
-    Init();
 }
 
-Shape::~Shape() {
-    glDeleteBuffers(1, &m_vboID_texture);
-    glDeleteVertexArrays(1, &m_vaoID_texture);
-
-    glDeleteBuffers(1, &m_vboID_not_texture);
-    glDeleteVertexArrays(1, &m_vaoID_not_texture);
-}
-
-void Shape::InitVertexAttrib() {
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);   // points
-    glDisableVertexAttribArray(1);
-}
-
-
 void Shape::Draw(RenderContext &context)
 {
-
 	float xval, yval;
 	float t;
 
 	float temp_radius= radius*(.707*.707*.707*1.04);
 
 	//Additive Drawing or Overwrite
-	if ( additive==0)  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	else    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+	VertexArena::State state;
+	state.transform = context.mat_ortho;
+	if (additive) state.blendDestination = GL_ONE;
 
 	xval= x;
 	yval= -(y-1);
 
-    struct_data *buffer_data = new struct_data[sides+2];
+    m_buffer_data.resize(sides+2);
+    VertexArena::Vertex *buffer_data = m_buffer_data.data();
 
 	if ( textured)
 	{
+		VertexArena::State textureState = state;
+		textureState.textured = true;
+
 		if (imageUrl !="")
 		{
             TextureSamplerDesc tex = context.textureManager->getTexture(imageUrl, GL_CLAMP_TO_EDGE, GL_LINEAR);
             if (tex.first != NULL)
 			{
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, tex.first->texID);
-                glBindSampler(0, tex.second->samplerID);
+                textureState.texture = tex.first->texID;
+                textureState.sampler = tex.second->samplerID;
 
 				context.aspectRatio=1.0;
 			}
 		}
 		else
         {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, context.textureManager->getMainTexture()->texID);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            textureState.texture = context.textureManager->getMainTexture()->texID;
+            textureState.wrap = GL_REPEAT;
         }
 
 		//Define the center point of the shape
-        buffer_data[0].color_r = r;
-        buffer_data[0].color_g = g;
-        buffer_data[0].color_b = b;
-        buffer_data[0].color_a = a * masterAlpha;
-        buffer_data[0].tex_x = 0.5;
-        buffer_data[0].tex_y = 0.5;
-        buffer_data[0].point_x = xval;
-        buffer_data[0].point_y = yval;
+        buffer_data[0].r = r;
+        buffer_data[0].g = g;
+        buffer_data[0].b = b;
+        buffer_data[0].a = a * masterAlpha;
+        buffer_data[0].u = 0.5;
+        buffer_data[0].v = 0.5;
+        buffer_data[0].x = xval;
+        buffer_data[0].y = yval;
 
 		for ( int i=1;i< sides+2;i++)
 		{
-            buffer_data[i].color_r=r2;
-            buffer_data[i].color_g=g2;
-            buffer_data[i].color_b=b2;
-            buffer_data[i].color_a=a2 * masterAlpha;
+            buffer_data[i].r=r2;
+            buffer_data[i].g=g2;
+            buffer_data[i].b=b2;
+            buffer_data[i].a=a2 * masterAlpha;
 
 		  t = (i-1)/(float) sides;
-            buffer_data[i].tex_x =0.5f + 0.5f*cosf(t*3.1415927f*2 +  tex_ang + 3.1415927f*0.25f)*(context.aspectCorrect ? context.aspectRatio : 1.0)/ tex_zoom;
-            buffer_data[i].tex_y =  0.5f + 0.5f*sinf(t*3.1415927f*2 +  tex_ang + 3.1415927f*0.25f)/ tex_zoom;
-            buffer_data[i].point_x=temp_radius*cosf(t*3.1415927f*2 +  ang + 3.1415927f*0.25f)*(context.aspectCorrect ? context.aspectRatio : 1.0)+xval;
-            buffer_data[i].point_y=temp_radius*sinf(t*3.1415927f*2 +  ang + 3.1415927f*0.25f)+yval;
+            buffer_data[i].u =0.5f + 0.5f*cosf(t*3.1415927f*2 +  tex_ang + 3.1415927f*0.25f)*(context.aspectCorrect ? context.aspectRatio : 1.0)/ tex_zoom;
+            buffer_data[i].v =  0.5f + 0.5f*sinf(t*3.1415927f*2 +  tex_ang + 3.1415927f*0.25f)/ tex_zoom;
+            buffer_data[i].x=temp_radius*cosf(t*3.1415927f*2 +  ang + 3.1415927f*0.25f)*(context.aspectCorrect ? context.aspectRatio : 1.0)+xval;
+            buffer_data[i].y=temp_radius*sinf(t*3.1415927f*2 +  ang + 3.1415927f*0.25f)+yval;
 
 		}
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_vboID_texture);
-
-        glBufferData(GL_ARRAY_BUFFER, sizeof(struct_data)*(sides+2), NULL, GL_DYNAMIC_DRAW);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(struct_data)*(sides+2), buffer_data, GL_DYNAMIC_DRAW);
-
-        glUseProgram(context.programID_v2f_c4f_t2f);
-
-        glUniformMatrix4fv(context.uniform_v2f_c4f_t2f_vertex_tranformation, 1, GL_FALSE, glm::value_ptr(context.mat_ortho));
-        glUniform1i(context.uniform_v2f_c4f_t2f_frag_texture_sampler, 0);
-
-        glBindVertexArray(m_vaoID_texture);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, sides+2);
-        glBindVertexArray(0);
+        context.vertexArena->drawFan(textureState, buffer_data, sides+2);
 	}
 	else
 	{//Untextured (use color values)
 
 	  //Define the center point of the shape
-        buffer_data[0].color_r=r;
-        buffer_data[0].color_g=g;
-        buffer_data[0].color_b=b;
-        buffer_data[0].color_a=a * masterAlpha;
-        buffer_data[0].point_x=xval;
-        buffer_data[0].point_y=yval;
+        buffer_data[0].r=r;
+        buffer_data[0].g=g;
+        buffer_data[0].b=b;
+        buffer_data[0].a=a * masterAlpha;
+        buffer_data[0].u=0;
+        buffer_data[0].v=0;
+        buffer_data[0].x=xval;
+        buffer_data[0].y=yval;
 
 
 	  for ( int i=1;i< sides+2;i++)
 	    {
-            buffer_data[i].color_r=r2;
-            buffer_data[i].color_g=g2;
-            buffer_data[i].color_b=b2;
-            buffer_data[i].color_a=a2 * masterAlpha;
+            buffer_data[i].r=r2;
+            buffer_data[i].g=g2;
+            buffer_data[i].b=b2;
+            buffer_data[i].a=a2 * masterAlpha;
+            buffer_data[i].u=0;
+            buffer_data[i].v=0;
 	      t = (i-1)/(float) sides;
-            buffer_data[i].point_x=temp_radius*cosf(t*3.1415927f*2 +  ang + 3.1415927f*0.25f)*(context.aspectCorrect ? context.aspectRatio : 1.0)+xval;
-            buffer_data[i].point_y=temp_radius*sinf(t*3.1415927f*2 +  ang + 3.1415927f*0.25f)+yval;
+            buffer_data[i].x=temp_radius*cosf(t*3.1415927f*2 +  ang + 3.1415927f*0.25f)*(context.aspectCorrect ? context.aspectRatio : 1.0)+xval;
+            buffer_data[i].y=temp_radius*sinf(t*3.1415927f*2 +  ang + 3.1415927f*0.25f)+yval;
 	    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_vboID_not_texture);
-
-        glBufferData(GL_ARRAY_BUFFER, sizeof(struct_data)*(sides+2), NULL, GL_DYNAMIC_DRAW);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(struct_data)*(sides+2), buffer_data, GL_DYNAMIC_DRAW);
-
-        glUseProgram(context.programID_v2f_c4f);
-
-        glUniformMatrix4fv(context.uniform_v2f_c4f_vertex_tranformation, 1, GL_FALSE, glm::value_ptr(context.mat_ortho));
-
-        glBindVertexArray(m_vaoID_not_texture);
-	  	glDrawArrays(GL_TRIANGLE_FAN,0,sides+2);
-        glBindVertexArray(0);
+        context.vertexArena->drawFan(state, buffer_data, sides+2);
 	}
 
 
-	floatPair *points = new float[sides+1][2];
+	GLint first;
+	VertexArena::Vertex *points = context.vertexArena->append(sides, first);
 
 	for ( int i=0;i< sides;i++)
 	{
 		t = (i-1)/(float) sides;
-		points[i][0]= temp_radius*cosf(t*3.1415927f*2 +  ang + 3.1415927f*0.25f)*(context.aspectCorrect ? context.aspectRatio : 1.0)+xval;
-		points[i][1]=  temp_radius*sinf(t*3.1415927f*2 +  ang + 3.1415927f*0.25f)+yval;
+		points[i].x= temp_radius*cosf(t*3.1415927f*2 +  ang + 3.1415927f*0.25f)*(context.aspectCorrect ? context.aspectRatio : 1.0)+xval;
+		points[i].y=  temp_radius*sinf(t*3.1415927f*2 +  ang + 3.1415927f*0.25f)+yval;
+		points[i].r = border_r;
+		points[i].g = border_g;
+		points[i].b = border_b;
+		points[i].a = border_a * masterAlpha;
+		points[i].u = 0;
+		points[i].v = 0;
 	}
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
-
-    glBufferData(GL_ARRAY_BUFFER, sizeof(floatPair)*(sides), NULL, GL_DYNAMIC_DRAW);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(floatPair)*(sides), points, GL_DYNAMIC_DRAW);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    glUseProgram(context.programID_v2f_c4f);
-
-    glUniformMatrix4fv(context.uniform_v2f_c4f_vertex_tranformation, 1, GL_FALSE, glm::value_ptr(context.mat_ortho));
+	if (thickOutline==1)  state.lineWidth = context.texsize < 512 ? 1 : 2*context.texsize/512;
+	else  state.lineWidth = context.texsize < 512 ? 1 : context.texsize/512;
 
-    glVertexAttrib4f(1, border_r, border_g, border_b, border_a * masterAlpha);
-
-	if (thickOutline==1)  glLineWidth(context.texsize < 512 ? 1 : 2*context.texsize/512);
-
-    glBindVertexArray(m_vaoID);
-	glDrawArrays(GL_LINE_LOOP,0,sides);
-    glBindVertexArray(0);
-
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glBindSampler(0, 0);
-
-	if (thickOutline==1)  glLineWidth(context.texsize < 512 ? 1 : context.texsize/512);
-
-    delete[] buffer_data;
-	delete[] points;
-}
-
-void MotionVectors::InitVertexAttrib() {
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
-    glDisableVertexAttribArray(1);
+	context.vertexArena->draw(state, GL_LINE_LOOP, first, sides);
 }
 
 void MotionVectors::Draw(RenderContext &context)
@@ -322,66 +194,37 @@ void MotionVectors::Draw(RenderContext &context)
 	float  intervalx=1.0/x_num;
 	float  intervaly=1.0/y_num;
 
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
 	if (x_num + y_num < 600)
 	{
 		int size = x_num * y_num ;
 
-		floatPair *points = new float[size][2];
+		GLint first;
+		VertexArena::Vertex *points = context.vertexArena->append(size, first);
 
 		for (int x=0;x<(int)x_num;x++)
 		{
 			for(int y=0;y<(int)y_num;y++)
 			{
-                float lx, ly;
-				lx = x_offset+x*intervalx;
-				ly = y_offset+y*intervaly;
-
-				points[(x * (int)y_num) + y][0] = lx;
-				points[(x * (int)y_num) + y][1] = ly;
+                VertexArena::Vertex &point = points[(x * (int)y_num) + y];
+				point.x = x_offset+x*intervalx;
+				point.y = y_offset+y*intervaly;
+				point.r = r;
+				point.g = g;
+				point.b = b;
+				point.a = a * masterAlpha;
+				point.u = 0;
+				point.v = 0;
 			}
 		}
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
-
-        glBufferData(GL_ARRAY_BUFFER, sizeof(floatPair) * size, NULL, GL_DYNAMIC_DRAW);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(floatPair) * size, points, GL_DYNAMIC_DRAW);
+		VertexArena::State state;
+		state.transform = context.mat_ortho;
+		state.pointSize = length;
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        delete[] points;
-
-
-		glUseProgram(context.programID_v2f_c4f);
-
-        glUniformMatrix4fv(context.uniform_v2f_c4f_vertex_tranformation, 1, GL_FALSE, glm::value_ptr(context.mat_ortho));
-
-		#ifndef GL_TRANSITION
-        if (length <= 0.0) {
-            glPointSize(1.0);
-        } else {
-            glPointSize(length);
-        }
-        #endif
-
-        glUniform1f(context.uniform_v2f_c4f_vertex_point_size, length);
-		glVertexAttrib4f(1, r, g, b, a * masterAlpha);
-
-        glBindVertexArray(m_vaoID);
-
-		glDrawArrays(GL_POINTS,0,size);
-
-        glBindVertexArray(0);
+		context.vertexArena->draw(state, GL_POINTS, first, size);
 	  }
 }
 
-void Border::InitVertexAttrib() {
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
-    glDisableVertexAttribArray(1);
-}
-
 void Border::Draw(RenderContext &context)
 {
     //Draw Borders
@@ -389,15 +232,15 @@ void Border::Draw(RenderContext &context)
     float iff=inner_size*.5;
     float texof=1.0-of;
 
-    float points[40] = {
-        // Outer
+    const float outer[20] = {
         0,0,            of,0,
         0,1,            of,texof,
         1,1,            texof,texof,
         1,0,            texof,of,
         of,0,           of,of,
+    };
 
-        // Inner
+    const float inner[20] = {
         of,of,          of+iff,of,
         of,texof,       of+iff,texof-iff,
         texof,texof,    texof-iff,texof-iff,
@@ -405,33 +248,22 @@ void Border::Draw(RenderContext &context)
         of+iff,of,      of+iff,of+iff,
     };
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
-
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 40, NULL, GL_DYNAMIC_DRAW);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 40, points, GL_DYNAMIC_DRAW);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    glUseProgram(context.programID_v2f_c4f);
-
-    glUniformMatrix4fv(context.uniform_v2f_c4f_vertex_tranformation, 1, GL_FALSE, glm::value_ptr(context.mat_ortho));
-
-    glVertexAttrib4f(1, outer_r, outer_g, outer_b, outer_a * masterAlpha);
+    VertexArena::Vertex points[10];
 
     //no additive drawing for borders
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    VertexArena::State state;
+    state.transform = context.mat_ortho;
 
-    glBindVertexArray(m_vaoID);
+    for (int i = 0; i < 10; i++)
+        points[i] = { outer[i*2], outer[i*2+1], outer_r, outer_g, outer_b, outer_a * masterAlpha, 0, 0 };
+    context.vertexArena->drawStrip(state, points, 10);
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 10);
-
-    glVertexAttrib4f(1, inner_r, inner_g, inner_b, inner_a * masterAlpha);
+    for (int i = 0; i < 10; i++)
+        points[i] = { inner[i*2], inner[i*2+1], inner_r, inner_g, inner_b, inner_a * masterAlpha, 0, 0 };
 
     // 1st pass for inner
-    glDrawArrays(GL_TRIANGLE_STRIP, 10, 10);
+    context.vertexArena->drawStrip(state, points, 10);
 
     // 2nd pass for inner
-    glDrawArrays(GL_TRIANGLE_STRIP, 10, 10);
-
-    glBindVertexArray(0);
+    context.vertexArena->drawStrip(state, points, 10);
 }
@@ -3,6 +3,7 @@
 #include <vector>
 #include <typeinfo>
 #include "TextureManager.hpp"
+#include "VertexArena.hpp"
 #include "projectM-opengl.h"
 #include <glm/mat4x4.hpp>
 
@@ -18,6 +19,7 @@ public:
 	bool aspectCorrect;
 	BeatDetect *beatDetect;
 	TextureManager *textureManager;
+	VertexArena *vertexArena;   //!< render items draw through it, the renderer flushes it
     GLuint programID_v2f_c4f;
     GLuint programID_v2f_c4f_t2f;
     GLint uniform_v2f_c4f_vertex_tranformation;
@@ -33,17 +35,12 @@ class RenderItem
 {
 public:
     RenderItem();
-    ~RenderItem();
 
 	float masterAlpha;
-    virtual void InitVertexAttrib() = 0;
-	virtual void Draw(RenderContext &context) = 0;
-
-protected:
-    virtual void Init();
 
-    GLuint m_vboID;
-    GLuint m_vaoID;
+    /// Appends the item's vertices and draws to context.vertexArena. Items own no GL objects, so
+    /// they can be created while a preset is parsed on a background thread.
+	virtual void Draw(RenderContext &context) = 0;
 };
 
 typedef std::vector<RenderItem*> RenderItemList;
@@ -52,7 +49,6 @@ class DarkenCenter : public RenderItem
 {
 public:
 	DarkenCenter();
-    void InitVertexAttrib();
 	void Draw(RenderContext &context);
 };
 
@@ -91,28 +87,11 @@ public:
 
 
     Shape();
-    ~Shape();
-    void InitVertexAttrib();
     virtual void Draw(RenderContext &context);
 
 private:
-
-    struct struct_data {
-        float point_x;
-        float point_y;
-        float color_r;
-        float color_g;
-        float color_b;
-        float color_a;
-        float tex_x;
-        float tex_y;
-    };
-
-    GLuint m_vboID_texture;
-    GLuint m_vaoID_texture;
-
-    GLuint m_vboID_not_texture;
-    GLuint m_vaoID_not_texture;
+    // vertices of the last Draw(), kept so drawing does not allocate every frame
+    std::vector<VertexArena::Vertex> m_buffer_data;
 };
 
 class Text : RenderItem
@@ -132,7 +111,6 @@ public:
     float x_offset;
     float y_offset;
 
-    void InitVertexAttrib();
     void Draw(RenderContext &context);
     MotionVectors();
 };
@@ -152,7 +130,6 @@ public:
     float inner_b;
     float inner_a;
 
-    void InitVertexAttrib();
     void Draw(RenderContext &context);
     Border();
 };
@@ -209,33 +209,17 @@ Renderer::Renderer(int width, int height, int gx, int gy, BeatDetect* _beatDetec
 
 	/// @bug put these on member init list
 	this->textureManager = nullptr;
+	this->textureMemoryBudget = 0;
 	this->beatDetect = _beatDetect;
 
 	textureRenderToTexture = 0;
+	framebufferRenderToTexture = 0;
+	outputFramebuffer = 0;
 
-	int size = (mesh.height - 1) * mesh.width * 4 * 2;
+	int size = mesh.width * mesh.height * 2;
 	p = static_cast<float *>(wipemalloc(size * sizeof(float)));
 
-
-	for (int j = 0; j < mesh.height - 1; j++)
-	{
-		int base = j * mesh.width * 4 * 2;
-
-
-		for (int i = 0; i < mesh.width; i++)
-		{
-			int index = j * mesh.width + i;
-			int index2 = (j + 1) * mesh.width + i;
-
-			int strip = base + i * 8;
-			p[strip + 0] = mesh.identity[index].x;
-			p[strip + 1] = mesh.identity[index].y;
-
-			p[strip + 4] = mesh.identity[index2].x;
-			p[strip + 5] = mesh.identity[index2].y;
-		}
-	}
-
+	renderContext.vertexArena = &vertexArena;
 	renderContext.programID_v2f_c4f = shaderEngine.programID_v2f_c4f;
 	renderContext.programID_v2f_c4f_t2f = shaderEngine.programID_v2f_c4f_t2f;
 
@@ -245,22 +229,58 @@ Renderer::Renderer(int width, int height, int gx, int gy, BeatDetect* _beatDetec
 	renderContext.uniform_v2f_c4f_t2f_frag_texture_sampler = shaderEngine.uniform_v2f_c4f_t2f_frag_texture_sampler;
 
 	// Interpolation VAO/VBO's
+	// The mesh points never move, only their texture coordinates do. The rows are drawn as one
+	// triangle strip, joined by degenerate triangles.
+	std::vector<float> positions(size);
+	for (int index = 0; index < mesh.width * mesh.height; index++)
+	{
+		positions[index * 2 + 0] = mesh.identity[index].x;
+		positions[index * 2 + 1] = mesh.identity[index].y;
+	}
+
+	std::vector<GLuint> indices;
+	indices.reserve((mesh.height - 1) * (mesh.width * 2 + 2));
+	for (int j = 0; j < mesh.height - 1; j++)
+	{
+		if (j > 0)
+			indices.push_back(j * mesh.width);
+
+		for (int i = 0; i < mesh.width; i++)
+		{
+			indices.push_back(j * mesh.width + i);
+			indices.push_back((j + 1) * mesh.width + i);
+		}
+
+		if (j < mesh.height - 2)
+			indices.push_back((j + 1) * mesh.width + mesh.width - 1);
+	}
+	m_count_Interpolation = indices.size();
+
 	glGenBuffers(1, &m_vbo_Interpolation);
+	glGenBuffers(1, &m_vbo_InterpolationTexture);
+	glGenBuffers(1, &m_ibo_Interpolation);
 	glGenVertexArrays(1, &m_vao_Interpolation);
 
 	glBindVertexArray(m_vao_Interpolation);
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_Interpolation);
 
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_Interpolation);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * size, positions.data(), GL_STATIC_DRAW);
 	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 4, static_cast<void*>(nullptr)); // Positions
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, static_cast<void*>(nullptr)); // Positions
 
 	glDisableVertexAttribArray(1);
 
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_InterpolationTexture);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * size, nullptr, GL_STREAM_DRAW);
 	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 4, (void*)(sizeof(float) * 2)); // Textures
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, static_cast<void*>(nullptr)); // Textures
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo_Interpolation);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), indices.data(), GL_STATIC_DRAW);
 
 	glBindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
 	// CompositeOutput VAO/VBO's
 	glGenBuffers(1, &m_vbo_CompositeOutput);
@@ -296,30 +316,32 @@ Renderer::Renderer(int width, int height, int gx, int gy, BeatDetect* _beatDetec
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 
-	// CompositeShaderOutput VAO/VBO's
+	// CompositeShaderOutput VAO/VBO's, filled by InitCompositeShaderVertex()
 	glGenBuffers(1, &m_vbo_CompositeShaderOutput);
+	glGenBuffers(1, &m_ibo_CompositeShaderOutput);
 	glGenVertexArrays(1, &m_vao_CompositeShaderOutput);
 
 	glBindVertexArray(m_vao_CompositeShaderOutput);
 	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_CompositeShaderOutput);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo_CompositeShaderOutput);
 
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(composite_shader_vertex), static_cast<void*>(nullptr));
 	// Positions
 
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(composite_shader_vertex), (void*)(sizeof(float) * 2));
-	// Colors
+	glDisableVertexAttribArray(1);
+	// Colors are blended from uniforms by the vertex shader
 
 	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(composite_shader_vertex), (void*)(sizeof(float) * 6)); // UV
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(composite_shader_vertex), (void*)(sizeof(float) * 2)); // UV
 
 	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(composite_shader_vertex), (void*)(sizeof(float) * 8));
+	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(composite_shader_vertex), (void*)(sizeof(float) * 4));
 	// RAD ANG
 
 	glBindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 std::string Renderer::SetPipeline(Pipeline& pipeline)
@@ -343,6 +365,13 @@ void Renderer::ResetTextures()
 	textureManager->Preload();
 }
 
+void Renderer::setTextureMemoryBudget(std::size_t bytes)
+{
+	textureMemoryBudget = bytes;
+	if (textureManager != nullptr)
+		textureManager->setMemoryBudget(bytes);
+}
+
 void Renderer::SetupPass1(const Pipeline& pipeline, const PipelineContext& pipelineContext)
 {
 	totalframes++;
@@ -363,6 +392,7 @@ void Renderer::SetupPass1(const Pipeline& pipeline, const PipelineContext& pipel
 			this->lastTimeFPS = nowMilliseconds();
 		}
 	}
+	glBindFramebuffer(GL_FRAMEBUFFER, textureManager->getMainFramebuffer());
 	glViewport(0, 0, texsizeX, texsizeY);
 
 	renderContext.mat_ortho = glm::ortho(0.0f, 1.0f, 0.0f, 1.0f, -40.0f, 40.0f);
@@ -387,6 +417,8 @@ void Renderer::RenderItems(const Pipeline& pipeline, const PipelineContext& pipe
 	if (waveformList.size() >= 1) {
 		RenderTouch(pipeline,pipelineContext);
 	}
+
+	vertexArena.flush(renderContext);
 }
 
 void Renderer::RenderTouch(const Pipeline& pipeline, const PipelineContext& pipelineContext)
@@ -411,6 +443,8 @@ void Renderer::FinishPass1()
 	draw_title_to_texture();
 
 	textureManager->updateMainTexture();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
 }
 
 void Renderer::Pass2(const Pipeline& pipeline, const PipelineContext& pipelineContext)
@@ -424,6 +458,7 @@ void Renderer::Pass2(const Pipeline& pipeline, const PipelineContext& pipelineCo
 	/** Reset the viewport size */
 	if (textureRenderToTexture)
 	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebufferRenderToTexture);
 		glViewport(0, 0, texsizeX, texsizeY);
 	}
 	else
@@ -431,7 +466,7 @@ void Renderer::Pass2(const Pipeline& pipeline, const PipelineContext& pipelineCo
 
 	if (shaderEngine.enableCompositeShader(currentPipe->compositeShader, pipeline, pipelineContext))
 	{
-		CompositeShaderOutput(pipeline, pipelineContext);
+		CompositeShaderOutput();
 	}
 	else
 	{
@@ -461,6 +496,9 @@ void Renderer::Pass2(const Pipeline& pipeline, const PipelineContext& pipelineCo
 	// We should always draw toasts last so they are on top of other text (lp/menu).
 	if (this->showtoast == true) 
 		draw_toast();
+
+	if (textureRenderToTexture)
+		glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
 }
 
 void Renderer::RenderFrame(const Pipeline& pipeline,
@@ -473,6 +511,15 @@ void Renderer::RenderFrame(const Pipeline& pipeline,
 
 void Renderer::RenderFrameOnlyPass1(const Pipeline& pipeline, const PipelineContext& pipelineContext)
 {
+	shaderEngine.startFrameStats();
+	vertexArena.resetStats();
+
+	// pass 1 draws into our own framebuffers, whatever the application had bound gets the output
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &outputFramebuffer);
+
+	// textures requested ahead of their preset, a little each frame
+	textureManager->uploadDecodedTextures();
+
 	shaderEngine.RenderBlurTextures(pipeline, pipelineContext);
 
 	SetupPass1(pipeline, pipelineContext);
@@ -515,22 +562,20 @@ void Renderer::Interpolation(const Pipeline& pipeline, const PipelineContext& pi
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	}
 
-	int size = (mesh.height - 1) * mesh.width * 4 * 2;
+	int size = mesh.width * mesh.height * 2;
 
 	if (pipeline.staticPerPixel)
 	{
-		for (int j = 0; j < mesh.height - 1; j++)
+		for (int j = 0; j < mesh.height; j++)
 		{
-			int base = j * mesh.width * 2 * 4;
+			const float *x = pipeline.x_mesh.row(j);
+			const float *y = pipeline.y_mesh.row(j);
+			float *row = p + j * mesh.width * 2;
 
 			for (int i = 0; i < mesh.width; i++)
 			{
-				int strip = base + i * 8;
-				p[strip + 2] = pipeline.x_mesh[i][j];
-				p[strip + 3] = pipeline.y_mesh[i][j];
-
-				p[strip + 6] = pipeline.x_mesh[i][j + 1];
-				p[strip + 7] = pipeline.y_mesh[i][j + 1];
+				row[i * 2 + 0] = x[i];
+				row[i * 2 + 1] = y[i];
 			}
 		}
 	}
@@ -543,29 +588,17 @@ void Renderer::Interpolation(const Pipeline& pipeline, const PipelineContext& pi
 				return cp->PerPixel(p, context);
 			});
 
-		for (int j = 0; j < mesh.height - 1; j++)
+		for (int index = 0; index < mesh.width * mesh.height; index++)
 		{
-			int base = j * mesh.width * 2 * 4;
-
-			for (int i = 0; i < mesh.width; i++)
-			{
-				int strip = base + i * 8;
-				int index = j * mesh.width + i;
-				int index2 = (j + 1) * mesh.width + i;
-
-				p[strip + 2] = mesh.p[index].x;
-				p[strip + 3] = mesh.p[index].y;
-
-				p[strip + 6] = mesh.p[index2].x;
-				p[strip + 7] = mesh.p[index2].y;
-			}
+			p[index * 2 + 0] = mesh.p[index].x;
+			p[index * 2 + 1] = mesh.p[index].y;
 		}
 	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_Interpolation);
+	// only the texture coordinates change from frame to frame
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_InterpolationTexture);
 
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * size, nullptr, GL_DYNAMIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * size, p, GL_DYNAMIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * size, p, GL_STREAM_DRAW);
 
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
@@ -577,8 +610,7 @@ void Renderer::Interpolation(const Pipeline& pipeline, const PipelineContext& pi
 
 	glBindVertexArray(m_vao_Interpolation);
 
-	for (int j = 0; j < mesh.height - 1; j++)
-		glDrawArrays(GL_TRIANGLE_STRIP, j * mesh.width * 2, mesh.width * 2);
+	glDrawElements(GL_TRIANGLE_STRIP, m_count_Interpolation, GL_UNSIGNED_INT, nullptr);
 
 	glBindVertexArray(0);
 
@@ -596,11 +628,18 @@ Renderer::~Renderer()
 	free(p);
 
 	glDeleteBuffers(1, &m_vbo_Interpolation);
+	glDeleteBuffers(1, &m_vbo_InterpolationTexture);
+	glDeleteBuffers(1, &m_ibo_Interpolation);
 	glDeleteVertexArrays(1, &m_vao_Interpolation);
 
 	glDeleteBuffers(1, &m_vbo_CompositeOutput);
 	glDeleteVertexArrays(1, &m_vao_CompositeOutput);
 
+	glDeleteBuffers(1, &m_vbo_CompositeShaderOutput);
+	glDeleteBuffers(1, &m_ibo_CompositeShaderOutput);
+	glDeleteVertexArrays(1, &m_vao_CompositeShaderOutput);
+
+	glDeleteFramebuffers(1, &framebufferRenderToTexture);
 	glDeleteTextures(1, &textureRenderToTexture);
 }
 
@@ -641,6 +680,7 @@ void Renderer::reset(int w, int h)
 		delete textureManager;
 	}
 	textureManager = new TextureManager(presetURL, texsizeX, texsizeY, m_datadir);
+	textureManager->setMemoryBudget(textureMemoryBudget);
 
 	shaderEngine.setParams(texsizeX, texsizeY, beatDetect, textureManager);
 	shaderEngine.reset();
@@ -679,6 +719,15 @@ GLuint Renderer::initRenderToTexture()
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		glBindTexture(GL_TEXTURE_2D, 0);
+
+		GLint previous;
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+		glGenFramebuffers(1, &framebufferRenderToTexture);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebufferRenderToTexture);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureRenderToTexture, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cerr << "Render to texture framebuffer is incomplete" << std::endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, previous);
 	}
 
 	return textureRenderToTexture;
@@ -944,6 +993,10 @@ void Renderer::draw_stats()
 	stats += "Preset:""\n";
 	stats += "Warp Shader: " + warpShader + "\n";
 	stats += "Composite Shader: " + compShader + "\n";
+	stats += "Uniform Lookups Saved: " + std::to_string(shaderEngine.uniformStats().lookupsSaved) + "\n";
+	stats += "Uniform Uploads Saved: " + std::to_string(shaderEngine.uniformStats().uploadsSaved) + "\n";
+	stats += "Item Draws: " + std::to_string(vertexArena.getDrawCount()) + " in " + std::to_string(vertexArena.getBatchCount()) + " calls\n";
+	stats += "Texture Memory: " + std::to_string(textureManager->getMemoryUsed() / (1024 * 1024)) + " MB\n";
 	drawText(stats.c_str(), 30, 20, 2.5);
 #endif /** USE_TEXT_MENU */
 }
@@ -1000,6 +1053,7 @@ void Renderer::CompositeOutput(const Pipeline& pipeline, const PipelineContext&
 
 	for (auto drawable : pipeline.compositeDrawables)
 		drawable->Draw(renderContext);
+	vertexArena.flush(renderContext);
 
 	glBindTexture(GL_TEXTURE_2D, 0);
 }
@@ -1146,7 +1200,7 @@ void Renderer::InitCompositeShaderVertex()
 
 	// build index list for final composite blit -
 	// order should be friendly for interpolation of 'ang' value!
-	int* cur_index = &m_comp_indices[0];
+	GLuint* cur_index = &m_comp_indices[0];
 	for (int y = 0; y < FCGSY - 1; y++)
 	{
 		if (y == FCGSY / 2 - 1)
@@ -1181,80 +1235,29 @@ void Renderer::InitCompositeShaderVertex()
 			cur_index += 6;
 		}
 	}
-}
-
 
-void Renderer::CompositeShaderOutput(const Pipeline& pipeline, const PipelineContext& pipelineContext)
-{
-	// hue shader
-	float shade[4][3] = {
-		{1.0f, 1.0f, 1.0f},
-		{1.0f, 1.0f, 1.0f},
-		{1.0f, 1.0f, 1.0f},
-		{1.0f, 1.0f, 1.0f}
-	}; // for each vertex, then each comp.
-
-	// pick 4 colors for the 4 corners
-	for (int i = 0; i < 4; i++)
-	{
-		shade[i][0] = 0.6f + 0.3f * sinf(pipelineContext.time * 30.0f * 0.0143f + 3 + i * 21);
-		shade[i][1] = 0.6f + 0.3f * sinf(pipelineContext.time * 30.0f * 0.0107f + 1 + i * 13);
-		shade[i][2] = 0.6f + 0.3f * sinf(pipelineContext.time * 30.0f * 0.0129f + 6 + i * 9);
-		float max = ((shade[i][0] > shade[i][1]) ? shade[i][0] : shade[i][1]);
-		if (shade[i][2] > max) max = shade[i][2];
-		for (int k = 0; k < 3; k++)
-		{
-			shade[i][k] /= max;
-			shade[i][k] = 0.5f + 0.5f * shade[i][k];
-		}
-	}
+	// the grid only changes with the aspect ratio
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_CompositeShaderOutput);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(m_comp_verts), m_comp_verts, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	// interpolate the 4 colors & apply to all the verts
-	for (int j = 0; j < FCGSY; j++)
-	{
-		for (int i = 0; i < FCGSX; i++)
-		{
-			composite_shader_vertex* pComp = &m_comp_verts[i + j * FCGSX];
-			float x = pComp->x * 0.5f + 0.5f;
-			float y = pComp->y * 0.5f + 0.5f;
-
-			float col[3] = {1, 1, 1};
-			for (int c = 0; c < 3; c++)
-				col[c] = shade[0][c] * (x) * (y) +
-					shade[1][c] * (1 - x) * (y) +
-					shade[2][c] * (x) * (1 - y) +
-					shade[3][c] * (1 - x) * (1 - y);
-
-			pComp->Diffuse[0] = col[0];
-			pComp->Diffuse[1] = col[1];
-			pComp->Diffuse[2] = col[2];
-			pComp->Diffuse[3] = 1.0;
-		}
-	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo_CompositeShaderOutput);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(m_comp_indices), m_comp_indices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
 
 
+void Renderer::CompositeShaderOutput()
+{
+	// the grid is static, enableCompositeShader() has set the hue shading colors
 	const int primCount = (FCGSX - 2) * (FCGSY - 2) * 6;
-	composite_shader_vertex tempv[primCount];
-	memset(tempv, 0, sizeof(composite_shader_vertex) * primCount);
-	int src_idx = 0;
-	for (int i = 0; i < primCount; i++)
-	{
-		tempv[i] = m_comp_verts[m_comp_indices[src_idx++]];
-	}
-
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_CompositeShaderOutput);
-
-	glBufferData(GL_ARRAY_BUFFER, sizeof(composite_shader_vertex) * primCount, nullptr, GL_DYNAMIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(composite_shader_vertex) * primCount, tempv, GL_DYNAMIC_DRAW);
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	glBlendFunc(GL_ONE, GL_ZERO);
 
 	glBindVertexArray(m_vao_CompositeShaderOutput);
 
 	// Now do the final composite blit, fullscreen;
-	glDrawArrays(GL_TRIANGLES, 0, primCount);
+	glDrawElements(GL_TRIANGLES, primCount, GL_UNSIGNED_INT, nullptr);
 
 	glBindVertexArray(0);
 
@@ -38,9 +38,8 @@ using namespace std::chrono;
 typedef struct
 {
     float x, y;     // screen position + Z-buffer depth
-    float Diffuse[4];     // diffuse color
-    float tu, tv;           // DYNAMIC
-    float rad, ang;         // STATIC
+    float tu, tv;
+    float rad, ang;
 } composite_shader_vertex;
 
 
@@ -135,6 +134,20 @@ public:
 
   std::string SetPipeline(Pipeline &pipeline);
 
+  /// Starts loading the textures of a preset that is about to be shown, see ShaderEngine::requestPresetTextures
+  void requestPresetTextures(const Pipeline &pipeline) { shaderEngine.requestPresetTextures(pipeline); }
+
+  /// Reuses GLSL transpiled from preset shaders and linked preset programs, see ShaderCache and
+  /// ProgramBinaryCache. The caches must outlive the renderer, either may be null.
+  void setShaderCaches(ShaderCache *shaderCache, ProgramBinaryCache *programBinaryCache)
+  {
+    shaderEngine.setShaderCache(shaderCache);
+    shaderEngine.setProgramBinaryCache(programBinaryCache);
+  }
+
+  /// Memory for textures decoded from image files, see TextureManager::setMemoryBudget
+  void setTextureMemoryBudget(std::size_t bytes);
+
   void setPresetName(const std::string& theValue)
   {
     m_presetName = theValue;
@@ -191,6 +204,7 @@ private:
   PerPixelMesh mesh;
   BeatDetect *beatDetect;
   TextureManager *textureManager;
+  std::size_t textureMemoryBudget;
   Pipeline* currentPipe;
   TimeKeeper *timeKeeperFPS;
   TimeKeeper *timeKeeperToast;
@@ -204,6 +218,7 @@ private:
 
 #endif /** USE_TEXT_MENU */
   RenderContext renderContext;
+  VertexArena vertexArena;
   //per pixel equation variables
   ShaderEngine shaderEngine;
   std::string m_presetName;
@@ -212,7 +227,7 @@ private:
   std::string m_toastMessage;
   std::string m_searchText;
 
-  float* p;
+  float* p; //!< texture coordinates of the mesh points, uploaded every frame
 
   int vstartx; /* view start x position - normally 0, but could be different if doing a subset of the window - like
                   for virtual reality */
@@ -229,13 +244,17 @@ private:
   std::string menu_fontURL;
   std::string presetURL;
 
-  GLuint m_vbo_Interpolation;
+  GLuint m_vbo_Interpolation;           //!< mesh points, static
+  GLuint m_vbo_InterpolationTexture;    //!< texture coordinates of the points, streamed every frame
+  GLuint m_ibo_Interpolation;
+  GLsizei m_count_Interpolation;
   GLuint m_vao_Interpolation;
 
   GLuint m_vbo_CompositeOutput;
   GLuint m_vao_CompositeOutput;
 
   GLuint m_vbo_CompositeShaderOutput;
+  GLuint m_ibo_CompositeShaderOutput;
   GLuint m_vao_CompositeShaderOutput;
 
 #ifdef USE_TEXT_MENU
@@ -250,7 +269,7 @@ private:
   void RenderTouch(const Pipeline &pipeline, const PipelineContext &pipelineContext);
   void FinishPass1();
   void Pass2 (const Pipeline &pipeline, const PipelineContext &pipelineContext);
-  void CompositeShaderOutput(const Pipeline &pipeline, const PipelineContext &pipelineContext);
+  void CompositeShaderOutput();
   void CompositeOutput(const Pipeline &pipeline, const PipelineContext &pipelineContext);
 
   void rescale_per_pixel_matrices();
@@ -271,12 +290,15 @@ private:
 int nearestPower2( int value );
 
   GLuint textureRenderToTexture;
+  GLuint framebufferRenderToTexture;
+  /// Framebuffer bound by the application when the frame started, pass 2 draws into it
+  GLint outputFramebuffer;
 
   void InitCompositeShaderVertex();
   float SquishToCenter(float x, float fExp);
   void UvToMathSpace(float u, float v, float* rad, float* ang);
   composite_shader_vertex    m_comp_verts[FCGSX*FCGSY];
-  int         m_comp_indices[(FCGSX-2)*(FCGSY-2)*6];
+  GLuint      m_comp_indices[(FCGSX-2)*(FCGSY-2)*6];
 
 };
 
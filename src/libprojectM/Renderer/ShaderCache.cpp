@@ -0,0 +1,239 @@
+#include "ShaderCache.hpp"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#ifdef WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+const ShaderCache::Key FNV_PRIME = 1099511628211ull;
+
+ShaderCache::Key hashBytes(ShaderCache::Key hash, const char *data, std::size_t length)
+{
+    for (std::size_t i = 0; i < length; i++)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+}
+
+const ShaderCache::Key ShaderCache::INITIAL_HASH;
+
+// includes the length, so the boundary between two strings is part of the hash
+ShaderCache::Key ShaderCache::hash(Key hash, const std::string &text)
+{
+    const std::uint64_t length = text.size();
+    hash = hashBytes(hash, reinterpret_cast<const char *>(&length), sizeof(length));
+    return hashBytes(hash, text.data(), text.size());
+}
+
+ShaderCache::ShaderCache(std::size_t memoryBudget) : _memoryBudget(memoryBudget), _memoryUsed(0)
+{}
+
+void ShaderCache::setDirectory(const std::string &directory)
+{
+    _directory = directory;
+    if (_directory.empty())
+        return;
+
+#ifdef WIN32
+    _mkdir(_directory.c_str());
+#else
+    mkdir(_directory.c_str(), 0755);
+#endif
+}
+
+ShaderCache::Key ShaderCache::key(int generatorVersion, const std::string &source, const std::string &declarations)
+{
+    const int versions[2] = { TRANSPILER_VERSION, generatorVersion };
+    Key result = hashBytes(INITIAL_HASH, reinterpret_cast<const char *>(versions), sizeof(versions));
+    result = hash(result, source);
+    return hash(result, declarations);
+}
+
+std::string ShaderCache::path(Key key) const
+{
+    char name[24];
+    snprintf(name, sizeof(name), "%016llx.glsl", static_cast<unsigned long long>(key));
+    return _directory + "/" + name;
+}
+
+bool ShaderCache::find(Key key, std::string &glsl)
+{
+    std::map<Key, std::string>::const_iterator found = _entries.find(key);
+    if (found != _entries.end())
+    {
+        glsl = found->second;
+        return true;
+    }
+
+    if (_directory.empty())
+        return false;
+
+    std::ifstream file(path(key).c_str(), std::ios_base::in | std::ios_base::binary);
+    if (!file)
+        return false;
+
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    if (!file || contents.str().empty())
+        return false;
+
+    glsl = contents.str();
+    insert(key, glsl);
+    return true;
+}
+
+void ShaderCache::store(Key key, const std::string &glsl)
+{
+    insert(key, glsl);
+
+    if (_directory.empty())
+        return;
+
+    // write to a temporary file first, so a reader never sees a partial entry
+    const std::string target = path(key);
+    const std::string temporary = target + ".tmp";
+    {
+        std::ofstream file(temporary.c_str(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+        if (!file)
+            return;
+        file << glsl;
+        if (!file)
+        {
+            file.close();
+            std::remove(temporary.c_str());
+            return;
+        }
+    }
+    if (std::rename(temporary.c_str(), target.c_str()) != 0)
+        std::remove(temporary.c_str());
+}
+
+void ShaderCache::insert(Key key, const std::string &glsl)
+{
+    if (glsl.size() > _memoryBudget)
+        return;
+
+    std::pair<std::map<Key, std::string>::iterator, bool> inserted = _entries.insert(std::make_pair(key, glsl));
+    if (!inserted.second)
+        return;
+
+    _memoryUsed += glsl.size();
+    _insertionOrder.push_back(key);
+
+    while (_memoryUsed > _memoryBudget)
+    {
+        std::map<Key, std::string>::iterator oldest = _entries.find(_insertionOrder.front());
+        _memoryUsed -= oldest->second.size();
+        _entries.erase(oldest);
+        _insertionOrder.pop_front();
+    }
+}
+
+
+// TESTS
+
+#include <iostream>
+#include "TestRunner.hpp"
+
+#ifndef NDEBUG
+
+#define TEST(cond) if (!verify(__FILE__ ": " #cond,cond)) return false
+
+struct ShaderCacheTest : public Test
+{
+    ShaderCacheTest() : Test("ShaderCacheTest")
+    {}
+
+    bool test_key()
+    {
+        const ShaderCache::Key key = ShaderCache::key(3, "source", "declarations");
+        TEST(key == ShaderCache::key(3, "source", "declarations"));
+        TEST(key != ShaderCache::key(4, "source", "declarations"));
+        TEST(key != ShaderCache::key(3, "sourc", "declarations"));
+        TEST(key != ShaderCache::key(3, "source", "declaration"));
+        // moving text between source and declarations is a different shader
+        TEST(key != ShaderCache::key(3, "sourcedeclarations", ""));
+        return true;
+    }
+
+    bool test_memory()
+    {
+        ShaderCache cache(10);
+        std::string glsl;
+        TEST(!cache.find(1, glsl));
+
+        cache.store(1, "1234");
+        cache.store(2, "5678");
+        TEST(cache.find(1, glsl) && glsl == "1234");
+        TEST(cache.memoryUsed() == 8);
+
+        // the oldest entry makes room
+        cache.store(3, "9abc");
+        TEST(!cache.find(1, glsl));
+        TEST(cache.find(2, glsl) && glsl == "5678");
+        TEST(cache.find(3, glsl) && glsl == "9abc");
+        TEST(cache.memoryUsed() == 8);
+
+        // too large to keep
+        cache.store(4, "0123456789a");
+        TEST(!cache.find(4, glsl));
+        return true;
+    }
+
+    bool test_directory()
+    {
+        const std::string directory = "ShaderCacheTest.tmp";
+        const ShaderCache::Key key = ShaderCache::key(1, "float4 main", "uniform sampler2D sampler_main;\n");
+        {
+            ShaderCache cache;
+            cache.setDirectory(directory);
+            cache.store(key, "void main() {}\n");
+        }
+
+        // a new cache, as after a restart
+        ShaderCache cache;
+        cache.setDirectory(directory);
+        std::string glsl, other;
+        const bool found = cache.find(key, glsl);
+        const bool foundOther = cache.find(key + 1, other);
+
+        char fileName[24];
+        snprintf(fileName, sizeof(fileName), "%016llx.glsl", static_cast<unsigned long long>(key));
+        std::remove((directory + "/" + fileName).c_str());
+        std::remove(directory.c_str());
+
+        TEST(found);
+        TEST(glsl == "void main() {}\n");
+        TEST(!foundOther);
+        return true;
+    }
+
+    bool test() override
+    {
+        return test_key() && test_memory() && test_directory();
+    }
+};
+
+Test* ShaderCache::test()
+{
+    return new ShaderCacheTest();
+}
+
+#else
+
+Test* ShaderCache::test()
+{
+    return nullptr;
+}
+
+#endif
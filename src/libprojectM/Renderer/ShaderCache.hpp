@@ -0,0 +1,61 @@
+#ifndef ShaderCache_HPP
+#define ShaderCache_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+
+class Test;
+
+/// GLSL transpiled from preset shaders, addressed by a hash of everything the transpiler reads.
+///
+/// Entries are kept in memory up to a budget, oldest first out. If a directory is set, every entry
+/// is also written there as <key>.glsl and read back on a miss, so the cache survives restarts.
+/// Only used from the render thread.
+class ShaderCache
+{
+public:
+    typedef std::uint64_t Key;
+
+    /// Changes whenever ShaderEngine transforms the preset source differently before or after
+    /// M4::GLSLGenerator, so entries from older versions are no longer found
+    static const int TRANSPILER_VERSION = 1;
+
+    explicit ShaderCache(std::size_t memoryBudget = 16 * 1024 * 1024);
+
+    /// Directory for the persistent copy, created if missing. Empty keeps the cache in memory only.
+    void setDirectory(const std::string &directory);
+    const std::string &directory() const { return _directory; }
+
+    /// Hash of the HLSL source as given to the preprocessor, the declarations prepended after
+    /// preprocessing and the GLSL version generated
+    static Key key(int generatorVersion, const std::string &source, const std::string &declarations);
+
+    /// 64 bit FNV-1a of a sequence of strings: start with hash(INITIAL_HASH, first), then pass the
+    /// result along. The length of each string is hashed too.
+    static Key hash(Key hash, const std::string &text);
+    static const Key INITIAL_HASH = 14695981039346656037ull;
+
+    /// Copies the GLSL for key into glsl and returns true if it is cached
+    bool find(Key key, std::string &glsl);
+
+    void store(Key key, const std::string &glsl);
+
+    std::size_t memoryUsed() const { return _memoryUsed; }
+
+    static Test *test();
+
+private:
+    std::string path(Key key) const;
+    void insert(Key key, const std::string &glsl);
+
+    std::size_t _memoryBudget;
+    std::size_t _memoryUsed;
+    std::string _directory;
+    std::map<Key, std::string> _entries;
+    std::deque<Key> _insertionOrder;
+};
+
+#endif
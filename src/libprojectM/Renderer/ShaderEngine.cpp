@@ -20,8 +20,25 @@
 
 #define FRAND ((rand() % 7381)/7380.0f)
 
-ShaderEngine::ShaderEngine() : presetCompShaderLoaded(false), presetWarpShaderLoaded(false)
+ShaderEngine::ShaderEngine() : textureManager(nullptr), presetCompShaderLoaded(false), presetWarpShaderLoaded(false),
+    shaderCache(nullptr), programBinaryCache(nullptr)
 {
+    lastFrameUniformStats.lookupsSaved = 0;
+    lastFrameUniformStats.uploadsSaved = 0;
+
+    // program binaries need GL 4.1, ARB_get_program_binary or GLES 3.0, and a driver offering a format
+    GLint binaryFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+    while (glGetError() != GL_NO_ERROR) {}
+    if (binaryFormats > 0) {
+        const GLubyte *driverStrings[3] = { glGetString(GL_VENDOR), glGetString(GL_RENDERER), glGetString(GL_VERSION) };
+        for (const GLubyte *driverString : driverStrings) {
+            if (driverString)
+                programBinaryDriver.append(reinterpret_cast<const char *>(driverString));
+            programBinaryDriver.push_back('\n');
+        }
+    }
+
     std::shared_ptr<StaticGlShaders> static_gl_shaders = StaticGlShaders::Get();
 
     programID_v2f_c4f = CompileShaderProgram(
@@ -128,6 +145,44 @@ void ShaderEngine::setParams(const int _texsizeX, const int _texsizeY, BeatDetec
 }
 
 
+// names following "sampler_" in a preset shader, in order of appearance
+std::vector<std::string> ShaderEngine::samplerNames(const std::string &program)
+{
+    std::vector<std::string> names;
+    size_t found = program.find("sampler_");
+    while (found != std::string::npos)
+    {
+        found += 8;
+        size_t end = program.find_first_of(" ;,\n\r)", found);
+
+        if (end != std::string::npos)
+            names.push_back(program.substr((int) found, (int) end - found));
+
+        found = program.find("sampler_", found);
+    }
+    return names;
+}
+
+void ShaderEngine::requestPresetTextures(const Pipeline &pipeline)
+{
+    if (textureManager == nullptr)
+        return;
+
+    const std::string *programs[2] = { &pipeline.warpShader.programSource, &pipeline.compositeShader.programSource };
+    for (const std::string *program : programs)
+    {
+        const std::vector<std::string> samplers = samplerNames(*program);
+        for (std::vector<std::string>::const_iterator name = samplers.begin(); name != samplers.end(); ++name)
+        {
+            // random textures are picked when the shader is compiled
+            std::string lowerCaseName(*name);
+            std::transform(lowerCaseName.begin(), lowerCaseName.end(), lowerCaseName.begin(), tolower);
+            if (lowerCaseName.substr(0, 4) != "rand" && lowerCaseName.substr(2, 5) != "_rand")
+                textureManager->requestTexture(*name);
+        }
+    }
+}
+
 // compile a user-defined shader from a preset. returns program ID if successful.
 GLuint ShaderEngine::compilePresetShader(const PresentShaderType shaderType, Shader &pmShader, const std::string &shaderFilename) {
     std::string program = pmShader.programSource;
@@ -195,52 +250,43 @@ GLuint ShaderEngine::compilePresetShader(const PresentShaderType shaderType, Sha
 
 
     // set up texture samplers for all samplers references in the shader program
-    found = 0;
-    found = program.find("sampler_", found);
-    while (found != std::string::npos)
+    const std::vector<std::string> samplers = samplerNames(program);
+    for (std::vector<std::string>::const_iterator name = samplers.begin(); name != samplers.end(); ++name)
     {
-        found += 8;
-        size_t end = program.find_first_of(" ;,\n\r)", found);
+        const std::string & sampler = *name;
+        std::string lowerCaseName(sampler);
+        std::transform(lowerCaseName.begin(), lowerCaseName.end(), lowerCaseName.begin(), tolower);
 
-        if (end != std::string::npos)
-        {
-            std::string sampler = program.substr((int) found, (int) end - found);
-            std::string lowerCaseName(sampler);
-            std::transform(lowerCaseName.begin(), lowerCaseName.end(), lowerCaseName.begin(), tolower);
-
-            TextureSamplerDesc texDesc = textureManager->getTexture(sampler, GL_REPEAT, GL_LINEAR);
-
-            if (texDesc.first == NULL)
-            {
-                if (lowerCaseName.substr(0, 4) == "rand" || lowerCaseName.substr(2, 5) == "_rand")
-                {
-                    texDesc = textureManager->getRandomTextureName(sampler);
-                }
-                else
-                {
-                    texDesc = textureManager->tryLoadingTexture(sampler);
-                }
-            }
+        TextureSamplerDesc texDesc = textureManager->getTexture(sampler, GL_REPEAT, GL_LINEAR);
 
-            if (texDesc.first == NULL)
+        if (texDesc.first == NULL)
+        {
+            if (lowerCaseName.substr(0, 4) == "rand" || lowerCaseName.substr(2, 5) == "_rand")
             {
-                std::cerr << "Texture loading error for: " << sampler << std::endl;
+                texDesc = textureManager->getRandomTextureName(sampler);
             }
             else
             {
-                std::map<std::string, TextureSamplerDesc>::const_iterator iter = pmShader.textures.cbegin();
-                for ( ; iter != pmShader.textures.cend(); ++iter)
-                {
-                    if (iter->first == sampler)
-                        break;
-                }
-
-                if (iter == pmShader.textures.cend())
-                    pmShader.textures[sampler] = texDesc;
+                texDesc = textureManager->tryLoadingTexture(sampler);
             }
         }
 
-        found = program.find("sampler_", found);
+        if (texDesc.first == NULL)
+        {
+            std::cerr << "Texture loading error for: " << sampler << std::endl;
+        }
+        else
+        {
+            std::map<std::string, TextureSamplerDesc>::const_iterator iter = pmShader.textures.cbegin();
+            for ( ; iter != pmShader.textures.cend(); ++iter)
+            {
+                if (iter->first == sampler)
+                    break;
+            }
+
+            if (iter == pmShader.textures.cend())
+                pmShader.textures[sampler] = texDesc;
+        }
     }
 
     textureManager->clearRandomTextures();
@@ -303,6 +349,82 @@ GLuint ShaderEngine::compilePresetShader(const PresentShaderType shaderType, Sha
     default:    shaderTypeString = "Other";
     }
 
+    // Declare samplers and texsizes, they replace the declarations of the preset
+    std::string declarations;
+    std::set<std::string> texsizes;
+    std::map<std::string, TextureSamplerDesc>::const_iterator iter_samplers = pmShader.textures.cbegin();
+    for ( ; iter_samplers != pmShader.textures.cend(); ++iter_samplers)
+    {
+        Texture * texture = iter_samplers->second.first;
+
+        if (texture->type == GL_TEXTURE_3D) {
+            declarations.append("uniform sampler3D sampler_" + iter_samplers->first + ";\n");
+        } else {
+            declarations.append("uniform sampler2D sampler_" + iter_samplers->first + ";\n");
+        }
+
+        texsizes.insert(iter_samplers->first);
+        texsizes.insert(texture->name);
+    }
+
+    std::set<std::string>::const_iterator iter_texsizes = texsizes.cbegin();
+    for ( ; iter_texsizes != texsizes.cend(); ++iter_texsizes)
+    {
+        declarations.append("uniform float4 texsize_" + *iter_texsizes + ";\n");
+    }
+
+    // the same preset source and textures always transpile to the same GLSL
+    const M4::GLSLGenerator::Version generatorVersion = StaticGlShaders::Get()->GetGlslGeneratorVersion();
+    const ShaderCache::Key cacheKey = ShaderCache::key(generatorVersion, fullSource, declarations);
+    std::string glsl;
+    if (!shaderCache || !shaderCache->find(cacheKey, glsl))
+    {
+        if (!transpilePresetShader(fullSource, declarations, shaderFilename, shaderTypeString, glsl))
+            return GL_FALSE;
+
+        if (shaderCache)
+            shaderCache->store(cacheKey, glsl);
+    }
+
+    // now we have GLSL source for the preset shader program (hopefully it's
+    // valid!) copmile the preset shader fragment shader with the standard
+    // vertex shader and cross our fingers
+    GLuint ret = 0;
+    if (shaderType == PresentWarpShader) {
+        ret = linkPresetProgram(
+            StaticGlShaders::Get()->GetPresetWarpVertexShader(),
+            glsl, shaderTypeString);
+    } else {
+        ret = linkPresetProgram(
+            StaticGlShaders::Get()->GetPresetCompVertexShader(),
+            glsl, shaderTypeString);
+    }
+
+    if (ret != GL_FALSE) {
+#ifdef DEBUG
+        std::cerr << "Successful compilation of " << shaderTypeString << std::endl;
+#endif
+    } else {
+        std::cerr << "Compilation error (step3) of " << shaderTypeString << std::endl;
+
+#if !DUMP_SHADERS_ON_ERROR
+        std::cerr << "Source:" << std::endl << glsl << std::endl;
+#else
+        std::ofstream out3("/tmp/shader_" + shaderTypeString + "_step3.txt");
+            out3 << glsl;
+            out3.close();
+#endif
+    }
+
+    return ret;
+}
+
+
+// transpile a preset shader from HLSL (aka directX shader) to GLSL (aka OpenGL shader lang),
+// declaring the given samplers and texsizes instead of those of the preset
+bool ShaderEngine::transpilePresetShader(const std::string &fullSource, const std::string &declarations,
+                                         const std::string &shaderFilename, const std::string &shaderTypeString,
+                                         std::string &glsl) {
     M4::GLSLGenerator generator;
     M4::Allocator allocator;
 
@@ -321,43 +443,16 @@ GLuint ShaderEngine::compilePresetShader(const PresentShaderType shaderType, Sha
             out << fullSource;
             out.close();
 #endif
-            return GL_FALSE;
-    }
-
-    // Remove previous shader declarations
-    std::smatch matches;
-    while(std::regex_search(sourcePreprocessed, matches, std::regex("sampler(2D|3D|)(\\s+|\\().*"))) {
-        sourcePreprocessed.replace(matches.position(), matches.length(), "");
+            return false;
     }
 
-    // Remove previous texsize declarations
-    while(std::regex_search(sourcePreprocessed, matches, std::regex("float4\\s+texsize_.*"))) {
-        sourcePreprocessed.replace(matches.position(), matches.length(), "");
-    }
-
-    // Declare samplers
-    std::set<std::string> texsizes;
-    std::map<std::string, TextureSamplerDesc>::const_iterator iter_samplers = pmShader.textures.cbegin();
-    for ( ; iter_samplers != pmShader.textures.cend(); ++iter_samplers)
-    {
-        Texture * texture = iter_samplers->second.first;
-
-        if (texture->type == GL_TEXTURE_3D) {
-            sourcePreprocessed.insert(0, "uniform sampler3D sampler_" + iter_samplers->first + ";\n");
-        } else {
-            sourcePreprocessed.insert(0, "uniform sampler2D sampler_" + iter_samplers->first + ";\n");
-        }
-
-        texsizes.insert(iter_samplers->first);
-        texsizes.insert(texture->name);
-    }
+    // Remove previous shader and texsize declarations
+    static const std::regex samplerDeclaration("sampler(2D|3D|)(\\s+|\\().*");
+    static const std::regex texsizeDeclaration("float4\\s+texsize_.*");
+    sourcePreprocessed = std::regex_replace(sourcePreprocessed, samplerDeclaration, "");
+    sourcePreprocessed = std::regex_replace(sourcePreprocessed, texsizeDeclaration, "");
 
-    // Declare texsizes
-    std::set<std::string>::const_iterator iter_texsizes = texsizes.cbegin();
-    for ( ; iter_texsizes != texsizes.cend(); ++iter_texsizes)
-    {
-        sourcePreprocessed.insert(0, "uniform float4 texsize_" + *iter_texsizes + ";\n");
-    }
+    sourcePreprocessed.insert(0, declarations);
 
 
     // transpile from HLSL (aka preset shader aka directX shader) to GLSL (aka OpenGL shader lang)
@@ -373,7 +468,7 @@ GLuint ShaderEngine::compilePresetShader(const PresentShaderType shaderType, Sha
             out2 << sourcePreprocessed;
             out2.close();
 #endif
-            return GL_FALSE;
+            return false;
     }
 
     // generate GLSL
@@ -388,44 +483,60 @@ GLuint ShaderEngine::compilePresetShader(const PresentShaderType shaderType, Sha
             out2 << sourcePreprocessed;
             out2.close();
 #endif
-        return GL_FALSE;
+        return false;
     }
 
-    // now we have GLSL source for the preset shader program (hopefully it's
-    // valid!) copmile the preset shader fragment shader with the standard
-    // vertex shader and cross our fingers
-    GLuint ret = 0;
-    if (shaderType == PresentWarpShader) {
-        ret = CompileShaderProgram(
-            StaticGlShaders::Get()->GetPresetWarpVertexShader(),
-            generator.GetResult(), shaderTypeString);
-    } else {
-        ret = CompileShaderProgram(
-            StaticGlShaders::Get()->GetPresetCompVertexShader(),
-            generator.GetResult(), shaderTypeString);
+    glsl = generator.GetResult();
+    return true;
+}
+
+
+// compile and link a preset program, or load it from the program binary cache
+GLuint ShaderEngine::linkPresetProgram(const std::string &vertexSource, const std::string &fragmentSource,
+                                       const std::string &shaderTypeString) {
+    if (!programBinaryCache || !programBinaryCache->enabled() || programBinaryDriver.empty())
+        return CompileShaderProgram(vertexSource, fragmentSource, shaderTypeString);
+
+    const ProgramBinaryCache::Key key = ProgramBinaryCache::key(programBinaryDriver, vertexSource, fragmentSource);
+    std::uint32_t format = 0;
+    std::vector<char> binary;
+    if (programBinaryCache->load(key, format, binary)) {
+        GLuint programID = glCreateProgram();
+        glProgramBinary(programID, format, binary.data(), binary.size());
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(programID, GL_LINK_STATUS, &linked);
+        if (linked == GL_TRUE)
+            return programID;
+
+        // the driver does not take this binary (any more), compile as usual and replace it
+        glDeleteProgram(programID);
+        while (glGetError() != GL_NO_ERROR) {}
+        programBinaryCache->remove(key);
     }
 
-    if (ret != GL_FALSE) {
-#ifdef DEBUG
-        std::cerr << "Successful compilation of " << shaderTypeString << std::endl;
-#endif
-    } else {
-        std::cerr << "Compilation error (step3) of " << shaderTypeString << std::endl;
+    GLuint programID = CompileShaderProgram(vertexSource, fragmentSource, shaderTypeString, true);
+    if (programID == GL_FALSE)
+        return GL_FALSE;
 
-#if !DUMP_SHADERS_ON_ERROR
-        std::cerr << "Source:" << std::endl << generator.GetResult() << std::endl;
-#else
-        std::ofstream out3("/tmp/shader_" + shaderTypeString + "_step3.txt");
-            out3 << generator.GetResult();
-            out3.close();
-#endif
+    GLint length = 0;
+    glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length > 0) {
+        binary.resize(length);
+        GLsizei written = 0;
+        GLenum binaryFormat = 0;
+        glGetProgramBinary(programID, length, &written, &binaryFormat, binary.data());
+        if (written > 0) {
+            binary.resize(written);
+            programBinaryCache->store(key, binaryFormat, binary);
+        }
     }
 
-    return ret;
+    return programID;
 }
 
 
-void ShaderEngine::SetupShaderVariables(GLuint program, const Pipeline &pipeline, const PipelineContext &context)
+void ShaderEngine::SetupShaderVariables(UniformCache &uniforms, const Pipeline &pipeline, const PipelineContext &context)
 {
     // pass info from projectM to the shader uniforms
     // these are the inputs: http://www.geisswerks.com/milkdrop/milkdrop_preset_authoring.html#3f6
@@ -436,40 +547,40 @@ void ShaderEngine::SetupShaderVariables(GLuint program, const Pipeline &pipeline
     float mip_y = logf((float)texsizeX)/logf(2.0f);
     float mip_avg = 0.5f*(mip_x + mip_y);
 
-    glUniform4f(glGetUniformLocation(program, "rand_frame"), (rand() % 100) * .01, (rand() % 100) * .01, (rand()% 100) * .01, (rand() % 100) * .01);
-    glUniform4f(glGetUniformLocation(program, "rand_preset"), rand_preset[0], rand_preset[1], rand_preset[2], rand_preset[3]);
+    uniforms.set4f(UniformCache::RandFrame, (rand() % 100) * .01, (rand() % 100) * .01, (rand()% 100) * .01, (rand() % 100) * .01);
+    uniforms.set4f(UniformCache::RandPreset, rand_preset[0], rand_preset[1], rand_preset[2], rand_preset[3]);
 
-    glUniform4f(glGetUniformLocation(program, "_c0"), aspectX, aspectY, 1 / aspectX, 1 / aspectY);
-    glUniform4f(glGetUniformLocation(program, "_c1"), 0.0, 0.0, 0.0, 0.0);
-    glUniform4f(glGetUniformLocation(program, "_c2"), time_since_preset_start_wrapped, context.fps,  context.frame, context.progress);
-    glUniform4f(glGetUniformLocation(program, "_c3"), beatDetect->bass/100, beatDetect->mid/100, beatDetect->treb/100, beatDetect->vol/100);
-    glUniform4f(glGetUniformLocation(program, "_c4"), beatDetect->bass_att/100, beatDetect->mid_att/100, beatDetect->treb_att/100, beatDetect->vol_att/100);
-    glUniform4f(glGetUniformLocation(program, "_c5"), pipeline.blur1x-pipeline.blur1n, pipeline.blur1n, pipeline.blur2x-pipeline.blur2n, pipeline.blur2n);
-    glUniform4f(glGetUniformLocation(program, "_c6"), pipeline.blur3x-pipeline.blur3n, pipeline.blur3n, pipeline.blur1n, pipeline.blur1x);
-    glUniform4f(glGetUniformLocation(program, "_c7"), texsizeX, texsizeY, 1 / (float) texsizeX, 1 / (float) texsizeY);
+    uniforms.set4f(UniformCache::C0, aspectX, aspectY, 1 / aspectX, 1 / aspectY);
+    uniforms.set4f(UniformCache::C1, 0.0, 0.0, 0.0, 0.0);
+    uniforms.set4f(UniformCache::C2, time_since_preset_start_wrapped, context.fps,  context.frame, context.progress);
+    uniforms.set4f(UniformCache::C3, beatDetect->bass/100, beatDetect->mid/100, beatDetect->treb/100, beatDetect->vol/100);
+    uniforms.set4f(UniformCache::C4, beatDetect->bass_att/100, beatDetect->mid_att/100, beatDetect->treb_att/100, beatDetect->vol_att/100);
+    uniforms.set4f(UniformCache::C5, pipeline.blur1x-pipeline.blur1n, pipeline.blur1n, pipeline.blur2x-pipeline.blur2n, pipeline.blur2n);
+    uniforms.set4f(UniformCache::C6, pipeline.blur3x-pipeline.blur3n, pipeline.blur3n, pipeline.blur1n, pipeline.blur1x);
+    uniforms.set4f(UniformCache::C7, texsizeX, texsizeY, 1 / (float) texsizeX, 1 / (float) texsizeY);
 
-    glUniform4f(glGetUniformLocation(program, "_c8"), 0.5f+0.5f*cosf(context.time* 0.329f+1.2f),
+    uniforms.set4f(UniformCache::C8, 0.5f+0.5f*cosf(context.time* 0.329f+1.2f),
                                                                       0.5f+0.5f*cosf(context.time* 1.293f+3.9f),
                                                                       0.5f+0.5f*cosf(context.time* 5.070f+2.5f),
                                                                       0.5f+0.5f*cosf(context.time*20.051f+5.4f));
 
-    glUniform4f(glGetUniformLocation(program, "_c9"), 0.5f+0.5f*sinf(context.time* 0.329f+1.2f),
+    uniforms.set4f(UniformCache::C9, 0.5f+0.5f*sinf(context.time* 0.329f+1.2f),
                                                                       0.5f+0.5f*sinf(context.time* 1.293f+3.9f),
                                                                       0.5f+0.5f*sinf(context.time* 5.070f+2.5f),
                                                                       0.5f+0.5f*sinf(context.time*20.051f+5.4f));
 
-    glUniform4f(glGetUniformLocation(program, "_c10"),  0.5f+0.5f*cosf(context.time*0.0050f+2.7f),
+    uniforms.set4f(UniformCache::C10,  0.5f+0.5f*cosf(context.time*0.0050f+2.7f),
                                                                         0.5f+0.5f*cosf(context.time*0.0085f+5.3f),
                                                                         0.5f+0.5f*cosf(context.time*0.0133f+4.5f),
                                                                         0.5f+0.5f*cosf(context.time*0.0217f+3.8f));
 
-    glUniform4f(glGetUniformLocation(program, "_c11"),  0.5f+0.5f*sinf(context.time*0.0050f+2.7f),
+    uniforms.set4f(UniformCache::C11,  0.5f+0.5f*sinf(context.time*0.0050f+2.7f),
                                                                         0.5f+0.5f*sinf(context.time*0.0085f+5.3f),
                                                                         0.5f+0.5f*sinf(context.time*0.0133f+4.5f),
                                                                         0.5f+0.5f*sinf(context.time*0.0217f+3.8f));
 
-    glUniform4f(glGetUniformLocation(program, "_c12"), mip_x, mip_y, mip_avg, 0 );
-    glUniform4f(glGetUniformLocation(program, "_c13"), pipeline.blur2n, pipeline.blur2x, pipeline.blur3n, pipeline.blur3x);
+    uniforms.set4f(UniformCache::C12, mip_x, mip_y, mip_avg, 0 );
+    uniforms.set4f(UniformCache::C13, pipeline.blur2n, pipeline.blur2x, pipeline.blur3n, pipeline.blur3x);
 
 
     glm::mat4 temp_mat[24];
@@ -506,88 +617,46 @@ void ShaderEngine::SetupShaderVariables(GLuint program, const Pipeline &pipeline
         temp_mat[i] = my * temp_mat[i];
     }
 
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_s1"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[0])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_s2"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[1])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_s3"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[2])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_s4"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[3])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_d1"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[4])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_d2"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[5])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_d3"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[6])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_d4"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[7])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_f1"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[8])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_f2"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[9])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_f3"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[10])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_f4"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[11])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_vf1"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[12])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_vf2"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[13])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_vf3"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[14])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_vf4"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[15])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_uf1"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[16])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_uf2"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[17])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_uf3"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[18])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_uf4"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[19])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_rand1"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[20])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_rand2"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[21])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_rand3"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[22])));
-    glUniformMatrix3x4fv(glGetUniformLocation(program, "rot_rand4"), 1, GL_FALSE, glm::value_ptr(glm::mat3x4(temp_mat[23])));
+    for (int i=0; i<24; i++)
+    {
+        const glm::mat3x4 rot(temp_mat[i]);
+        uniforms.setMatrix3x4(static_cast<UniformCache::Uniform>(UniformCache::RotS1 + i), glm::value_ptr(rot));
+    }
 
     // set program uniform "_q[a-h]" values (_qa.x, _qa.y, _qa.z, _qa.w, _qb.x, _qb.y ... ) alias q[1-32]
     for (int i=0; i < 32; i+=4) {
-        std::string varName = "_q";
-        varName.push_back('a' + i/4);
-        glUniform4f(glGetUniformLocation(program, varName.c_str()), pipeline.q[i], pipeline.q[i+1], pipeline.q[i+2], pipeline.q[i+3]);
+        uniforms.set4f(static_cast<UniformCache::Uniform>(UniformCache::QA + i/4), pipeline.q[i], pipeline.q[i+1], pipeline.q[i+2], pipeline.q[i+3]);
     }
 }
 
-void ShaderEngine::SetupTextures(GLuint program, const Shader &shader)
+void ShaderEngine::SetupTextures(UniformCache &uniforms, const Shader &shader)
 {
 
     unsigned int texNum = 0;
-    std::map<std::string, Texture*> texsizes;
 
     // Set samplers
     for (std::map<std::string, TextureSamplerDesc>::const_iterator iter_samplers = shader.textures.begin(); iter_samplers
                     != shader.textures.end(); ++iter_samplers)
     {
-        std::string texName = iter_samplers->first;
+        const std::string & texName = iter_samplers->first;
         Texture * texture = iter_samplers->second.first;
         Sampler * sampler = iter_samplers->second.second;
-        std::string samplerName = "sampler_" + texName;
 
         // https://www.khronos.org/opengl/wiki/Sampler_(GLSL)#Binding_textures_to_samplers
-        GLint param = glGetUniformLocation(program, samplerName.c_str());
-        if (param < 0) {
+        if (!uniforms.setSampler(texName, texNum)) {
             // unused uniform have been optimized out by glsl compiler
             continue;
         }
 
-        texsizes[texName] = texture;
-        texsizes[texture->name] = texture;
-
         glActiveTexture(GL_TEXTURE0 + texNum);
         glBindTexture(texture->type, texture->texID);
         glBindSampler(texNum, sampler->samplerID);
-
-        glUniform1i(param, texNum);
         texNum++;
-    }
-
 
-    // Set texsizes
-    std::map<std::string, Texture*>::const_iterator iter_textures = texsizes.cbegin();
-    for ( ; iter_textures != texsizes.cend(); ++iter_textures)
-    {
-        Texture * texture = iter_textures->second;
-
-        std::string texsizeName = "texsize_" + iter_textures->first;
-        GLint textSizeParam = glGetUniformLocation(program, texsizeName.c_str());
-        if (textSizeParam >= 0) {
-            glUniform4f(textSizeParam, texture->width, texture->height,
-                            1 / (float) texture->width, 1 / (float) texture->height);
-        } else {
-            // unused uniform have been optimized out by glsl compiler
-            continue;
-        }
+        // Set texsizes, under the sampler's name and the texture's own
+        uniforms.setTexsize(texName, texture->width, texture->height);
+        if (texture->name != texName)
+            uniforms.setTexsize(texture->name, texture->width, texture->height);
     }
 }
 
@@ -657,8 +726,12 @@ void ShaderEngine::RenderBlurTextures(const Pipeline &pipeline, const PipelineCo
     fbias [2] = -temp_min * fscale[2];
 
     const std::vector<Texture*> & blurTextures = textureManager->getBlurTextures();
+    const std::vector<GLuint> & blurFramebuffers = textureManager->getBlurFramebuffers();
     const Texture * mainTexture = textureManager->getMainTexture();
 
+    GLint outputFramebuffer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &outputFramebuffer);
+
     glBlendFunc(GL_ONE, GL_ZERO);
     glBindVertexArray(vaoBlur);
 
@@ -675,6 +748,8 @@ void ShaderEngine::RenderBlurTextures(const Pipeline &pipeline, const PipelineCo
 
         }
 
+        // draw straight into the blur texture
+        glBindFramebuffer(GL_FRAMEBUFFER, blurFramebuffers[i]);
         glViewport(0, 0, blurTextures[i]->width, blurTextures[i]->height);
 
         // hook up correct source texture - assume there is only one, at stage 0
@@ -743,12 +818,9 @@ void ShaderEngine::RenderBlurTextures(const Pipeline &pipeline, const PipelineCo
 
         // draw fullscreen quad
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-        // save to blur texture
-        glBindTexture(GL_TEXTURE_2D, blurTextures[i]->texID);
-        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, blurTextures[i]->width, blurTextures[i]->height);
     }
 
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
     glBindVertexArray(0);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
@@ -787,11 +859,21 @@ bool ShaderEngine::loadPresetShaders(Pipeline &pipeline, const std::string & pre
 
     m_presetName = presetName;
 
+    // the previous preset's textures are no longer bound. Presets set before the first reset()
+    // have no texture manager yet, reset() loads their shaders again.
+    if (textureManager != nullptr) {
+        textureManager->startPresetTextures();
+
+        // decode the images of both shaders in parallel, compiling waits for them
+        requestPresetTextures(pipeline);
+    }
+
     // compile and link warp and composite shaders from pipeline
     if (!pipeline.warpShader.programSource.empty()) {
         programID_presetWarp = loadPresetShader(PresentWarpShader, pipeline.warpShader, pipeline.warpShaderFilename);
         if (programID_presetWarp != GL_FALSE) {
             uniform_vertex_transf_warp_shader = glGetUniformLocation(programID_presetWarp, "vertex_transformation");
+            uniforms_presetWarp.resolve(programID_presetWarp);
             presetWarpShaderLoaded = true;
         } else {
             ok = false;
@@ -801,6 +883,7 @@ bool ShaderEngine::loadPresetShaders(Pipeline &pipeline, const std::string & pre
     if (!pipeline.compositeShader.programSource.empty()) {
         programID_presetComp = loadPresetShader(PresentCompositeShader, pipeline.compositeShader, pipeline.compositeShaderFilename);
         if (programID_presetComp != GL_FALSE) {
+            uniforms_presetComp.resolve(programID_presetComp);
             presetCompShaderLoaded = true;
         } else {
             ok = false;
@@ -833,6 +916,9 @@ void ShaderEngine::disablePresetShaders() {
 
     presetCompShaderLoaded = false;
     presetWarpShaderLoaded = false;
+
+    uniforms_presetComp.clear();
+    uniforms_presetWarp.clear();
 }
 
 void ShaderEngine::reset()
@@ -865,7 +951,15 @@ void ShaderEngine::reset()
     while (k < sizeof(xlate)/sizeof(xlate[0]));
 }
 
-GLuint ShaderEngine::CompileShaderProgram(const std::string & VertexShaderCode, const std::string & FragmentShaderCode, const std::string & shaderTypeString){
+void ShaderEngine::startFrameStats()
+{
+    lastFrameUniformStats.lookupsSaved = uniforms_presetComp.stats().lookupsSaved + uniforms_presetWarp.stats().lookupsSaved;
+    lastFrameUniformStats.uploadsSaved = uniforms_presetComp.stats().uploadsSaved + uniforms_presetWarp.stats().uploadsSaved;
+    uniforms_presetComp.resetStats();
+    uniforms_presetWarp.resetStats();
+}
+
+GLuint ShaderEngine::CompileShaderProgram(const std::string & VertexShaderCode, const std::string & FragmentShaderCode, const std::string & shaderTypeString, bool retrievableBinary){
 
 #if defined(WIN32) && !defined(EYETUNE_WINRT)
 	GLenum err = glewInit();
@@ -903,6 +997,8 @@ GLuint ShaderEngine::CompileShaderProgram(const std::string & VertexShaderCode,
 
     glAttachShader(programID, VertexShaderID);
     glAttachShader(programID, FragmentShaderID);
+    if (retrievableBinary)
+        glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     bool linkOK = linkProgram(programID);
 
     glDetachShader(programID, VertexShaderID);
@@ -930,15 +1026,38 @@ void ShaderEngine::validateProgram(const GLuint programID) {
     }
 }
 
+// the composite vertex shader blends these over the grid
+void ShaderEngine::SetupHueShade(UniformCache &uniforms, const PipelineContext &pipelineContext)
+{
+    float shade[4][3]; // for each corner, then each comp.
+
+    // pick 4 colors for the 4 corners
+    for (int i = 0; i < 4; i++)
+    {
+        shade[i][0] = 0.6f + 0.3f * sinf(pipelineContext.time * 30.0f * 0.0143f + 3 + i * 21);
+        shade[i][1] = 0.6f + 0.3f * sinf(pipelineContext.time * 30.0f * 0.0107f + 1 + i * 13);
+        shade[i][2] = 0.6f + 0.3f * sinf(pipelineContext.time * 30.0f * 0.0129f + 6 + i * 9);
+        float max = ((shade[i][0] > shade[i][1]) ? shade[i][0] : shade[i][1]);
+        if (shade[i][2] > max) max = shade[i][2];
+        for (int k = 0; k < 3; k++)
+        {
+            shade[i][k] /= max;
+            shade[i][k] = 0.5f + 0.5f * shade[i][k];
+        }
+    }
+
+    uniforms.set3fv(UniformCache::Shade, 4, &shade[0][0]);
+}
+
 // use the appropriate shader program for rendering the interpolation.
 // it will use the preset shader if available, otherwise the textured shader
 bool ShaderEngine::enableWarpShader(Shader &shader, const Pipeline &pipeline, const PipelineContext &pipelineContext, const glm::mat4 & mat_ortho) {
     if (presetWarpShaderLoaded) {
         glUseProgram(programID_presetWarp);
 
-        SetupTextures(programID_presetWarp, shader);
+        SetupTextures(uniforms_presetWarp, shader);
 
-        SetupShaderVariables(programID_presetWarp, pipeline, pipelineContext);
+        SetupShaderVariables(uniforms_presetWarp, pipeline, pipelineContext);
 
         glUniformMatrix4fv(uniform_vertex_transf_warp_shader, 1, GL_FALSE, glm::value_ptr(mat_ortho));
 
@@ -961,9 +1080,11 @@ bool ShaderEngine::enableCompositeShader(Shader &shader, const Pipeline &pipelin
     if (presetCompShaderLoaded) {
         glUseProgram(programID_presetComp);
 
-        SetupTextures(programID_presetComp, shader);
+        SetupTextures(uniforms_presetComp, shader);
+
+        SetupShaderVariables(uniforms_presetComp, pipeline, pipelineContext);
 
-        SetupShaderVariables(programID_presetComp, pipeline, pipelineContext);
+        SetupHueShade(uniforms_presetComp, pipelineContext);
 
 #if OGL_DEBUG
         validateProgram(programID_presetComp);
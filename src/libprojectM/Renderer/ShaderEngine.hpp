@@ -21,7 +21,11 @@ class ShaderEngine;
 #include <iostream>
 #include <map>
 #include <sstream>
+#include <vector>
 #include "Shader.hpp"
+#include "ProgramBinaryCache.hpp"
+#include "ShaderCache.hpp"
+#include "UniformCache.hpp"
 #include <glm/vec3.hpp>
 
 
@@ -39,13 +43,28 @@ public:
     ShaderEngine();
     virtual ~ShaderEngine();
     bool loadPresetShaders(Pipeline &pipeline, const std::string &presetName);
+
+    /// Starts decoding the images sampled by a preset's shaders, so loading them later does not have to
+    void requestPresetTextures(const Pipeline &pipeline);
     bool enableWarpShader(Shader &shader, const Pipeline &pipeline, const PipelineContext &pipelineContext, const glm::mat4 & mat_ortho);
     bool enableCompositeShader(Shader &shader, const Pipeline &pipeline, const PipelineContext &pipelineContext);
     void RenderBlurTextures(const Pipeline  &pipeline, const PipelineContext &pipelineContext);
     void setParams(const int _texsizeX, const int texsizeY, BeatDetect *beatDetect, TextureManager *_textureManager);
     void reset();
 
-    static GLuint CompileShaderProgram(const std::string & VertexShaderCode, const std::string & FragmentShaderCode, const std::string & shaderTypeString);
+    /// Keeps the GLSL transpiled from preset shaders in cache, which must outlive the engine. Null transpiles every time.
+    void setShaderCache(ShaderCache *cache) { shaderCache = cache; }
+
+    /// Keeps the linked preset programs in cache, which must outlive the engine. Null compiles every time.
+    void setProgramBinaryCache(ProgramBinaryCache *cache) { programBinaryCache = cache; }
+
+    /// Starts counting the GL calls saved by the uniform caches for a new frame
+    void startFrameStats();
+
+    /// GL calls the uniform caches of the preset programs saved during the last complete frame
+    const UniformCache::Stats & uniformStats() const { return lastFrameUniformStats; }
+
+    static GLuint CompileShaderProgram(const std::string & VertexShaderCode, const std::string & FragmentShaderCode, const std::string & shaderTypeString, bool retrievableBinary = false);
     static bool checkCompileStatus(GLuint shader, const std::string & shaderTitle);
     static bool linkProgram(GLuint programID);
 
@@ -100,9 +119,14 @@ private:
     glm::vec3 rot_base[20];
     glm::vec3 rot_speed[20];
 
-    void SetupShaderVariables(GLuint program, const Pipeline &pipeline, const PipelineContext &pipelineContext);
-    void SetupTextures(GLuint program, const Shader &shader);
+    void SetupShaderVariables(UniformCache &uniforms, const Pipeline &pipeline, const PipelineContext &pipelineContext);
+    void SetupTextures(UniformCache &uniforms, const Shader &shader);
+    void SetupHueShade(UniformCache &uniforms, const PipelineContext &pipelineContext);
+    static std::vector<std::string> samplerNames(const std::string &program);
     GLuint compilePresetShader(const ShaderEngine::PresentShaderType shaderType, Shader &shader, const std::string &shaderFilename);
+    bool transpilePresetShader(const std::string &fullSource, const std::string &declarations,
+                               const std::string &shaderFilename, const std::string &shaderTypeString, std::string &glsl);
+    GLuint linkPresetProgram(const std::string &vertexSource, const std::string &fragmentSource, const std::string &shaderTypeString);
 
     void disablePresetShaders();
     GLuint loadPresetShader(const PresentShaderType shaderType, Shader &shader, std::string &shaderFilename);
@@ -116,6 +140,16 @@ private:
 
     bool presetCompShaderLoaded, presetWarpShaderLoaded;
 
+    // uniform locations and values of the preset programs
+    UniformCache uniforms_presetComp, uniforms_presetWarp;
+    UniformCache::Stats lastFrameUniformStats;
+
+    ShaderCache *shaderCache;
+    ProgramBinaryCache *programBinaryCache;
+
+    // vendor, renderer and version of the GL driver, empty if it cannot return program binaries
+    std::string programBinaryDriver;
+
     std::string m_presetName;
 };
 
@@ -28,10 +28,11 @@ void main(){
 
 const std::string kPresetCompVertexShaderGlsl120 = R"(
 attribute vec2 vertex_position;
-attribute vec4 vertex_color;
 attribute vec2 vertex_texture;
 attribute vec2 vertex_rad_ang;
 
+uniform vec3 vertex_shade[4];
+
 varying vec4 frag_COLOR;
 varying vec2 frag_TEXCOORD0;
 varying vec2 frag_TEXCOORD1;
@@ -39,7 +40,13 @@ varying vec2 frag_TEXCOORD1;
 void main(){
     vec4 position = vec4(vertex_position, 0.0, 1.0);
     gl_Position = position;
-    frag_COLOR = vertex_color;
+
+    // hue shading, blended from the colors of the four corners
+    vec2 corner = vertex_position * 0.5 + 0.5;
+    frag_COLOR = vec4(vertex_shade[0] * corner.x * corner.y +
+                      vertex_shade[1] * (1.0 - corner.x) * corner.y +
+                      vertex_shade[2] * corner.x * (1.0 - corner.y) +
+                      vertex_shade[3] * (1.0 - corner.x) * (1.0 - corner.y), 1.0);
     frag_TEXCOORD0 = vertex_texture;
     frag_TEXCOORD1 = vertex_rad_ang;
 }
@@ -395,10 +402,11 @@ void main(){
 
 const std::string kPresetCompVertexShaderGlsl330 = R"(
 layout(location = 0) in vec2 vertex_position;
-layout(location = 1) in vec4 vertex_color;
 layout(location = 2) in vec2 vertex_texture;
 layout(location = 3) in vec2 vertex_rad_ang;
 
+uniform vec3 vertex_shade[4];
+
 out vec4 frag_COLOR;
 out vec2 frag_TEXCOORD0;
 out vec2 frag_TEXCOORD1;
@@ -406,7 +414,13 @@ out vec2 frag_TEXCOORD1;
 void main(){
     vec4 position = vec4(vertex_position, 0.0, 1.0);
     gl_Position = position;
-    frag_COLOR = vertex_color;
+
+    // hue shading, blended from the colors of the four corners
+    vec2 corner = vertex_position * 0.5 + 0.5;
+    frag_COLOR = vec4(vertex_shade[0] * corner.x * corner.y +
+                      vertex_shade[1] * (1.0 - corner.x) * corner.y +
+                      vertex_shade[2] * corner.x * (1.0 - corner.y) +
+                      vertex_shade[3] * (1.0 - corner.x) * (1.0 - corner.y), 1.0);
     frag_TEXCOORD0 = vertex_texture;
     frag_TEXCOORD1 = vertex_rad_ang;
 }
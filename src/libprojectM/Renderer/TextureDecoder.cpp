@@ -0,0 +1,185 @@
+#include "TextureDecoder.hpp"
+#include "SOIL2/SOIL2.h"
+
+TextureDecoder::Image::Image() : width(0), height(0), pixels(NULL)
+{}
+
+TextureDecoder::Image::~Image()
+{
+    if (pixels != NULL)
+        SOIL_free_image_data(pixels);
+}
+
+std::shared_ptr<const TextureDecoder::Image> TextureDecoder::decodeFile(const std::string &path)
+{
+    std::shared_ptr<Image> image = std::make_shared<Image>();
+    int channels;
+    image->pixels = SOIL_load_image(path.c_str(), &image->width, &image->height, &channels, SOIL_LOAD_RGBA);
+    if (image->pixels == NULL || channels < 4)
+        return image;
+
+    // same rounding as SOIL_FLAG_MULTIPLY_ALPHA, which would darken opaque pixels by one step
+    unsigned char *pixel = image->pixels;
+    for (std::size_t i = 0; i < image->size(); i += 4, pixel += 4)
+    {
+        if (pixel[3] == 255)
+            continue;
+        pixel[0] = (pixel[0] * pixel[3] + 128) >> 8;
+        pixel[1] = (pixel[1] * pixel[3] + 128) >> 8;
+        pixel[2] = (pixel[2] * pixel[3] + 128) >> 8;
+    }
+    return image;
+}
+
+#if USE_THREADS
+
+TextureDecoder::TextureDecoder(unsigned int threads)
+{
+    if (threads == 0)
+        threads = 1;
+    for (unsigned int i = 0; i < threads; i++)
+        _threads.emplace_back(&TextureDecoder::workerLoop, this);
+}
+
+TextureDecoder::~TextureDecoder()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    _condition.notify_all();
+    for (auto & thread : _threads)
+        thread.join();
+}
+
+TextureDecoder::Result TextureDecoder::decode(const std::string &path)
+{
+    Job job;
+    job.path = path;
+    Result result = job.promise.get_future().share();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.push_back(std::move(job));
+    }
+    _condition.notify_one();
+    return result;
+}
+
+void TextureDecoder::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        _condition.wait(lock, [this] { return !_running || !_jobs.empty(); });
+
+        // queued requests are abandoned, nobody waits for them once the decoder is gone
+        if (!_running)
+            return;
+
+        Job job = std::move(_jobs.front());
+        _jobs.pop_front();
+        lock.unlock();
+
+        job.promise.set_value(decodeFile(job.path));
+
+        lock.lock();
+    }
+}
+
+#else
+
+TextureDecoder::TextureDecoder(unsigned int threads)
+{
+    (void)threads;
+}
+
+TextureDecoder::~TextureDecoder()
+{}
+
+TextureDecoder::Result TextureDecoder::decode(const std::string &path)
+{
+    std::promise<std::shared_ptr<const Image>> promise;
+    promise.set_value(decodeFile(path));
+    return promise.get_future().share();
+}
+
+#endif
+
+
+// TESTS
+
+#include <cstdio>
+#include <iostream>
+#include "TestRunner.hpp"
+
+#ifndef NDEBUG
+
+#define TEST(cond) if (!verify(__FILE__ ": " #cond,cond)) return false
+
+struct TextureDecoderTest : public Test
+{
+    TextureDecoderTest() : Test("TextureDecoderTest")
+    {}
+
+    bool test_decode(const std::string &path)
+    {
+        const unsigned char rgba[] = { 200, 100, 50, 128,   255, 200, 1, 255 };
+        TEST(SOIL_save_image(path.c_str(), SOIL_SAVE_TYPE_TGA, 2, 1, 4, rgba) != 0);
+
+        TextureDecoder decoder(2);
+        TextureDecoder::Result result = decoder.decode(path);
+        TextureDecoder::Result missing = decoder.decode(path + ".missing");
+
+        std::shared_ptr<const TextureDecoder::Image> image = result.get();
+        TEST(image->pixels != NULL);
+        TEST(image->width == 2 && image->height == 1);
+        TEST(image->size() == 8);
+
+        // alpha is multiplied into the colour, opaque pixels come back unchanged
+        const unsigned char expected[] = { 100, 50, 25, 128,   255, 200, 1, 255 };
+        for (int i = 0; i < 8; i++)
+            TEST(image->pixels[i] == expected[i]);
+
+        TEST(missing.get()->pixels == NULL);
+        return true;
+    }
+
+    bool test_decode_opaque(const std::string &path)
+    {
+        const unsigned char rgb[] = { 255, 200, 1,   128, 64, 3 };
+        TEST(SOIL_save_image(path.c_str(), SOIL_SAVE_TYPE_TGA, 2, 1, 3, rgb) != 0);
+
+        std::shared_ptr<const TextureDecoder::Image> image = TextureDecoder::decodeFile(path);
+        TEST(image->pixels != NULL);
+        TEST(image->size() == 8);
+
+        // without an alpha channel every pixel is opaque
+        const unsigned char expected[] = { 255, 200, 1, 255,   128, 64, 3, 255 };
+        for (int i = 0; i < 8; i++)
+            TEST(image->pixels[i] == expected[i]);
+        return true;
+    }
+
+    bool test() override
+    {
+        const std::string path = "TextureDecoderTest.tga";
+        const bool result = test_decode(path) && test_decode_opaque(path);
+        std::remove(path.c_str());
+        return result;
+    }
+};
+
+Test* TextureDecoder::test()
+{
+    return new TextureDecoderTest();
+}
+
+#else
+
+Test* TextureDecoder::test()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef TextureDecoder_HPP
+#define TextureDecoder_HPP
+
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <string>
+
+#if USE_THREADS
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+class Test;
+
+/// Decodes image files on background threads, so the GL thread only has to upload the pixels.
+///
+/// Images are decoded to RGBA with the alpha multiplied into the colour, as TextureManager loaded
+/// them through SOIL before. Requests are served in order. Without thread support decode() works
+/// before returning.
+class TextureDecoder
+{
+public:
+    /// Decoded pixels, rows top to bottom. Null pixels if the file could not be decoded.
+    struct Image
+    {
+        Image();
+        ~Image();
+        Image(const Image &) = delete;
+        Image & operator=(const Image &) = delete;
+
+        int width;
+        int height;
+        unsigned char *pixels;
+
+        std::size_t size() const { return static_cast<std::size_t>(width) * height * 4; }
+    };
+
+    typedef std::shared_future<std::shared_ptr<const Image>> Result;
+
+    /// \param threads number of decoding threads, at least one
+    explicit TextureDecoder(unsigned int threads);
+    ~TextureDecoder();
+
+    /// Queues a file for decoding
+    Result decode(const std::string &path);
+
+    /// Decodes a file on the calling thread
+    static std::shared_ptr<const Image> decodeFile(const std::string &path);
+
+    static Test *test();
+
+private:
+#if USE_THREADS
+    struct Job
+    {
+        std::string path;
+        std::promise<std::shared_ptr<const Image>> promise;
+    };
+
+    void workerLoop();
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<Job> _jobs;
+    bool _running{ true };
+    std::vector<std::thread> _threads;
+#endif
+};
+
+#endif
@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <vector>
 #include <memory>
 #include "projectM-opengl.h"
@@ -26,9 +28,31 @@ So because of this, we switch to a PerlinNoiseWithAlpha class to generate the no
  
 #define NUM_BLUR_TEX    6
 
+namespace {
+
+// a framebuffer drawing into texID, leaves the current binding alone
+GLuint createFramebuffer(GLuint texID)
+{
+    GLint previous;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texID, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Framebuffer for texture " << texID << " is incomplete" << std::endl;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previous);
+    return framebuffer;
+}
+
+}
+
 
 TextureManager::TextureManager(const std::string _presetsURL, const int texsizeX, const int texsizeY, std::string datadir):
-    presetsURL(_presetsURL) {
+    presetsURL(_presetsURL), memoryBudget(0), memoryUsed(0), useCount(0), presetStart(0),
+    decoder(new TextureDecoder(DECODE_THREADS)), uploadBuffer(0) {
         
     extensions.push_back(".jpg");
     extensions.push_back(".dds");
@@ -40,9 +64,11 @@ TextureManager::TextureManager(const std::string _presetsURL, const int texsizeX
     std::vector<std::string> dirsToScan{datadir + "/presets", datadir + "/textures", _presetsURL};
     FileScanner fileScanner = FileScanner(dirsToScan, extensions);
 
-    // scan for textures
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
+    // index the textures, they are loaded when a preset uses them
     using namespace std::placeholders;
-    fileScanner.scan(std::bind(&TextureManager::loadTexture, this, _1, _2));
+    fileScanner.scan(std::bind(&TextureManager::indexTexture, this, _1, _2));
 
     Preload();
     // if not data directory specified from user code
@@ -62,6 +88,15 @@ TextureManager::TextureManager(const std::string _presetsURL, const int texsizeX
     mainTexture->getSampler(GL_CLAMP_TO_EDGE, GL_NEAREST);
     textures["main"] = mainTexture;
 
+    // pass 1 draws into the other texture of the pair while the main texture holds the previous frame
+    Texture renderTarget("main", texsizeX, texsizeY, false);
+    mainTextureIDs[0] = mainTexture->texID;
+    mainTextureIDs[1] = renderTarget.texID;
+    renderTarget.texID = 0;
+    mainFramebuffers[0] = createFramebuffer(mainTextureIDs[0]);
+    mainFramebuffers[1] = createFramebuffer(mainTextureIDs[1]);
+    mainTarget = 1;
+
     // Initialize blur textures
     int w = texsizeX;
     int h = texsizeY;
@@ -92,6 +127,7 @@ TextureManager::TextureManager(const std::string _presetsURL, const int texsizeX
         textureBlur->getSampler(GL_CLAMP_TO_EDGE, GL_LINEAR);
         textures[texname] = textureBlur;
         blurTextures.push_back(textureBlur);
+        blurFramebuffers.push_back(createFramebuffer(textureBlur->texID));
     }
 
 #ifdef GL_ES_VERSION_2_0
@@ -154,6 +190,12 @@ TextureManager::TextureManager(const std::string _presetsURL, const int texsizeX
 TextureManager::~TextureManager()
 {
     Clear();
+    glDeleteBuffers(1, &uploadBuffer);
+
+    // the main texture deleted the other one
+    glDeleteTextures(1, &mainTextureIDs[mainTarget]);
+    glDeleteFramebuffers(2, mainFramebuffers);
+    glDeleteFramebuffers(blurFramebuffers.size(), blurFramebuffers.data());
 }
 
 void TextureManager::Preload()
@@ -207,17 +249,202 @@ void TextureManager::Clear()
         delete(iter->second);
 
     textures.clear();
+    loadedTextures.clear();
+    memoryUsed = 0;
+
+    for (std::map<std::string, PendingTexture>::const_iterator iter = pendingTextures.begin(); iter != pendingTextures.end(); iter++)
+        glDeleteTextures(1, &iter->second.texID);
+    pendingTextures.clear();
 }
 
+void TextureManager::setMemoryBudget(std::size_t bytes)
+{
+    memoryBudget = bytes;
+    evictTextures();
+}
 
-TextureSamplerDesc TextureManager::getTexture(const std::string fullName, const GLenum defaultWrap, const GLenum defaultFilter)
+void TextureManager::startPresetTextures()
+{
+    presetStart = ++useCount;
+}
+
+void TextureManager::indexTexture(const std::string imageUrl, const std::string name)
+{
+    // a later directory overrides an earlier one
+    textureFiles[name] = imageUrl;
+}
+
+void TextureManager::requestTexture(const std::string fullName)
 {
-    std::string fileName = fullName;
-    std::string unqualifiedName;
     GLint wrap_mode;
     GLint filter_mode;
+    std::string unqualifiedName;
+
+    ExtractTextureSettings(removeExtension(fullName), wrap_mode, filter_mode, unqualifiedName);
+    if (textures.find(unqualifiedName) != textures.end())
+        return;
+
+    std::map<std::string, std::string>::const_iterator file = textureFiles.find(unqualifiedName);
+    if (file == textureFiles.end() || pendingTextures.find(file->second) != pendingTextures.end())
+        return;
+
+    PendingTexture pending;
+    pending.name = unqualifiedName;
+    pending.image = decoder->decode(file->second);
+    pending.texID = 0;
+    pending.rowsUploaded = 0;
+    pendingTextures[file->second] = pending;
+}
+
+void TextureManager::uploadDecodedTextures(std::size_t bytes)
+{
+    std::size_t uploaded = 0;
+    std::map<std::string, PendingTexture>::iterator iter = pendingTextures.begin();
+    while (iter != pendingTextures.end() && uploaded < bytes)
+    {
+        PendingTexture & pending = iter->second;
+        if (pending.image.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            iter++;
+            continue;
+        }
+
+        // a preset asking for a file SOIL has to load itself will do so in loadTexture
+        const TextureDecoder::Image & image = *pending.image.get();
+        if (!uploadable(image))
+        {
+            iter = pendingTextures.erase(iter);
+            continue;
+        }
+
+        const std::size_t rowSize = static_cast<std::size_t>(image.width) * 4;
+        const int rows = static_cast<int>(std::min<std::size_t>(image.height - pending.rowsUploaded,
+                                                                std::max<std::size_t>(1, (bytes - uploaded) / rowSize)));
+        uploadRows(pending, rows);
+        uploaded += rows * rowSize;
+
+        if (pending.rowsUploaded < image.height)
+            break;
+
+        addTexture(pending.name, pending.texID, image.width, image.height);
+        iter = pendingTextures.erase(iter);
+    }
+}
+
+bool TextureManager::uploadable(const TextureDecoder::Image & image) const
+{
+    return image.pixels != NULL && image.width <= maxTextureSize && image.height <= maxTextureSize;
+}
+
+// Copies the next rows of a decoded image into its texture. The copy goes through a pixel buffer, so
+// the driver can transfer it while the render thread goes on.
+void TextureManager::uploadRows(PendingTexture & pending, int rows)
+{
+    const TextureDecoder::Image & image = *pending.image.get();
+
+    if (pending.texID == 0)
+    {
+        glGenTextures(1, &pending.texID);
+        glBindTexture(GL_TEXTURE_2D, pending.texID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    else
+    {
+        glBindTexture(GL_TEXTURE_2D, pending.texID);
+    }
+
+    const std::size_t rowSize = static_cast<std::size_t>(image.width) * 4;
+    const std::size_t size = rows * rowSize;
+    const unsigned char * source = image.pixels + pending.rowsUploaded * rowSize;
+
+    if (uploadBuffer == 0)
+        glGenBuffers(1, &uploadBuffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer);
+
+    // orphan the storage of the previous upload, the driver may still be reading it
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    void * mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped != NULL)
+    {
+        memcpy(mapped, source, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        source = NULL;
+    }
+    else
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    // with the pixel buffer bound, the pointer is an offset into it
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, pending.rowsUploaded, image.width, rows, GL_RGBA, GL_UNSIGNED_BYTE, source);
 
-    // Remove extension
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    pending.rowsUploaded += rows;
+}
+
+Texture * TextureManager::findTexture(const std::string name)
+{
+    std::map<std::string, Texture*>::const_iterator found = textures.find(name);
+    if (found == textures.end())
+    {
+        std::map<std::string, std::string>::const_iterator file = textureFiles.find(name);
+        if (file == textureFiles.end())
+            return NULL;
+        return loadTexture(file->second, name).first;
+    }
+
+    std::map<std::string, LoadedTexture>::iterator loaded = loadedTextures.find(name);
+    if (loaded != loadedTextures.end())
+        loaded->second.lastUse = ++useCount;
+    return found->second;
+}
+
+void TextureManager::unloadTexture(const std::string name)
+{
+    std::map<std::string, Texture*>::iterator texture = textures.find(name);
+    if (texture != textures.end())
+    {
+        delete texture->second;
+        textures.erase(texture);
+    }
+
+    std::map<std::string, LoadedTexture>::iterator loaded = loadedTextures.find(name);
+    if (loaded != loadedTextures.end())
+    {
+        memoryUsed -= loaded->second.size;
+        loadedTextures.erase(loaded);
+    }
+}
+
+// Unloads least recently used textures until the loaded ones fit the budget. Textures of the current
+// preset are still bound to its shaders, so the budget may be exceeded if they alone are too large.
+void TextureManager::evictTextures()
+{
+    while (memoryBudget > 0 && memoryUsed > memoryBudget)
+    {
+        std::map<std::string, LoadedTexture>::const_iterator oldest = loadedTextures.end();
+        for (std::map<std::string, LoadedTexture>::const_iterator iter = loadedTextures.begin(); iter != loadedTextures.end(); iter++)
+        {
+            if (iter->second.lastUse < presetStart && (oldest == loadedTextures.end() || iter->second.lastUse < oldest->second.lastUse))
+                oldest = iter;
+        }
+
+        if (oldest == loadedTextures.end())
+            break;
+
+        unloadTexture(oldest->first);
+    }
+}
+
+
+std::string TextureManager::removeExtension(const std::string fullName) const
+{
+    std::string fileName = fullName;
     std::string lowerCaseFileName(fullName);
     std::transform(lowerCaseFileName.begin(), lowerCaseFileName.end(), lowerCaseFileName.begin(), tolower);
     for (auto ext : extensions)
@@ -229,9 +456,19 @@ TextureSamplerDesc TextureManager::getTexture(const std::string fullName, const
             break;
         }
     }
+    return fileName;
+}
+
+TextureSamplerDesc TextureManager::getTexture(const std::string fullName, const GLenum defaultWrap, const GLenum defaultFilter)
+{
+    std::string fileName = removeExtension(fullName);
+    std::string unqualifiedName;
+    GLint wrap_mode;
+    GLint filter_mode;
 
     ExtractTextureSettings(fileName, wrap_mode, filter_mode, unqualifiedName);
-    if (textures.find(unqualifiedName) == textures.end())
+    Texture * texture = findTexture(unqualifiedName);
+    if (texture == NULL)
     {
         return TextureSamplerDesc(NULL, NULL);
     }
@@ -243,7 +480,6 @@ TextureSamplerDesc TextureManager::getTexture(const std::string fullName, const
         filter_mode = defaultFilter;
     }
 
-    Texture * texture = textures[unqualifiedName];
     Sampler * sampler = texture->getSampler(wrap_mode, filter_mode);
 
     return TextureSamplerDesc(texture, sampler);
@@ -283,18 +519,55 @@ TextureSamplerDesc TextureManager::loadTexture(const std::string fileName, const
     int width, height;
 //    std::cout << "Loading texture " << name << " at " << fileName << std::endl;
 
-    unsigned int tex = SOIL_load_OGL_texture(
-                fileName.c_str(),
-                SOIL_LOAD_AUTO,
-                SOIL_CREATE_NEW_ID,
-                SOIL_FLAG_MULTIPLY_ALPHA
-                ,&width,&height);
+    // finish a requested decode, or decode right away
+    PendingTexture pending;
+    std::map<std::string, PendingTexture>::iterator requested = pendingTextures.find(fileName);
+    if (requested != pendingTextures.end())
+    {
+        pending = requested->second;
+        pendingTextures.erase(requested);
+    }
+    else
+    {
+        std::promise<std::shared_ptr<const TextureDecoder::Image>> decoded;
+        decoded.set_value(TextureDecoder::decodeFile(fileName));
+        pending.image = decoded.get_future().share();
+        pending.texID = 0;
+        pending.rowsUploaded = 0;
+    }
+
+    const TextureDecoder::Image & image = *pending.image.get();
+    unsigned int tex;
+    if (uploadable(image))
+    {
+        uploadRows(pending, image.height - pending.rowsUploaded);
+        tex = pending.texID;
+        width = image.width;
+        height = image.height;
+    }
+    else
+    {
+        // SOIL uploads formats the decoder leaves to it, e.g. compressed DDS, and scales down
+        // images too large for the driver
+        glDeleteTextures(1, &pending.texID);
+        tex = SOIL_load_OGL_texture(
+                    fileName.c_str(),
+                    SOIL_LOAD_AUTO,
+                    SOIL_CREATE_NEW_ID,
+                    SOIL_FLAG_MULTIPLY_ALPHA
+                    ,&width,&height);
+    }
 
     if (tex == 0)
     {
         return TextureSamplerDesc(NULL, NULL);
     }
 
+    return addTexture(name, tex, width, height);
+}
+
+TextureSamplerDesc TextureManager::addTexture(const std::string name, const GLuint tex, const int width, const int height)
+{
     GLint wrap_mode;
     GLint filter_mode;
     std::string unqualifiedName;
@@ -303,12 +576,18 @@ TextureSamplerDesc TextureManager::loadTexture(const std::string fileName, const
     Texture * newTexture = new Texture(unqualifiedName, tex, GL_TEXTURE_2D, width, height, true);
     Sampler * sampler = newTexture->getSampler(wrap_mode, filter_mode);
 
-    if (textures.find(name) != textures.end()) {
-        // found duplicate.. this could be optimized
-        delete textures[name];
-    }
+    // found duplicate.. this could be optimized
+    unloadTexture(name);
 
     textures[name] = newTexture;
+
+    // assumes four bytes per pixel, as the driver usually stores RGB padded
+    LoadedTexture loaded;
+    loaded.size = static_cast<std::size_t>(width) * height * 4;
+    loaded.lastUse = ++useCount;
+    loadedTextures[name] = loaded;
+    memoryUsed += loaded.size;
+    evictTextures();
 //    std::cout << "Loaded texture " << name << std::endl;
 
     return TextureSamplerDesc(newTexture, sampler);
@@ -332,20 +611,33 @@ TextureSamplerDesc TextureManager::getRandomTextureName(std::string random_id)
         unqualifiedName = unqualifiedName.substr(0, separator);
     }
 
+    // image files count whether they are loaded yet or not
+    for(std::map<std::string, std::string>::const_iterator iter = textureFiles.begin(); iter != textureFiles.end(); iter++)
+    {
+        if (textureNameFilter.empty() || iter->first.find(textureNameFilter) == 0)
+            user_texture_names.push_back(iter->first);
+    }
+
     for(std::map<std::string, Texture*>::const_iterator iter = textures.begin(); iter != textures.end(); iter++)
     {
-        if (iter->second->userTexture) {
+        if (iter->second->userTexture && textureFiles.find(iter->first) == textureFiles.end()) {
             if (textureNameFilter.empty() || iter->first.find(textureNameFilter) == 0)
                 user_texture_names.push_back(iter->first);
         }
     }
 
+    Texture * texture = NULL;
     if (user_texture_names.size() > 0)
     {
         std::string random_name = user_texture_names[rand() % user_texture_names.size()];
+        texture = findTexture(random_name);
+    }
+
+    if (texture != NULL)
+    {
         random_textures.push_back(random_id);
 
-        Texture * randomTexture = new Texture(*textures[random_name]);
+        Texture * randomTexture = new Texture(*texture);
         Sampler * sampler = randomTexture->getSampler(wrap_mode, filter_mode);
         randomTexture->name = unqualifiedName;
         textures[random_id] = randomTexture;
@@ -413,9 +705,18 @@ const std::vector<Texture*> & TextureManager::getBlurTextures() const {
 }
 
 
+const std::vector<GLuint> & TextureManager::getBlurFramebuffers() const {
+    return blurFramebuffers;
+}
+
+GLuint TextureManager::getMainFramebuffer() const {
+    return mainFramebuffers[mainTarget];
+}
+
+// Everyone holding the main texture sees the new frame, its texture id is swapped with the render
+// target's instead of copying the pixels over
 void TextureManager::updateMainTexture()
 {
-    glBindTexture(GL_TEXTURE_2D, mainTexture->texID);
-    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, mainTexture->width, mainTexture->height);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    mainTexture->texID = mainTextureIDs[mainTarget];
+    mainTarget = 1 - mainTarget;
 }
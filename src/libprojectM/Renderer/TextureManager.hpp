@@ -1,24 +1,67 @@
 #ifndef TextureManager_HPP
 #define TextureManager_HPP
 
+#include <cstddef>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <map>
 #include <vector>
 #include "projectM-opengl.h"
 #include "Texture.hpp"
+#include "TextureDecoder.hpp"
 #include "FileScanner.hpp"
 
 
 class TextureManager
 {
+  // a texture decoded from an image file, kept until the budget needs its memory
+  struct LoadedTexture
+  {
+    std::size_t size;
+    unsigned long lastUse;
+  };
+
+  // an image file being decoded or uploaded, not yet available to presets
+  struct PendingTexture
+  {
+    std::string name;
+    TextureDecoder::Result image;
+    GLuint texID;
+    int rowsUploaded;
+  };
+
+  static const unsigned int DECODE_THREADS = 2;
+
   std::string presetsURL;
   std::map<std::string, Texture*> textures;
+  std::map<std::string, std::string> textureFiles;
+  std::map<std::string, LoadedTexture> loadedTextures;
+  std::size_t memoryBudget;
+  std::size_t memoryUsed;
+  unsigned long useCount;
+  unsigned long presetStart;
+  std::unique_ptr<TextureDecoder> decoder;
+  std::map<std::string, PendingTexture> pendingTextures;
+  GLuint uploadBuffer;
+  GLint maxTextureSize;
   std::vector<Texture*> blurTextures;
+  std::vector<GLuint> blurFramebuffers;
   Texture * mainTexture;
+  GLuint mainTextureIDs[2];
+  GLuint mainFramebuffers[2];
+  int mainTarget;
 
   std::vector<std::string> random_textures;
   TextureSamplerDesc loadTexture(const std::string name, const std::string imageUrl);
+  TextureSamplerDesc addTexture(const std::string name, const GLuint tex, const int width, const int height);
+  std::string removeExtension(const std::string fullName) const;
+  bool uploadable(const TextureDecoder::Image & image) const;
+  void uploadRows(PendingTexture & pending, int rows);
+  void indexTexture(const std::string imageUrl, const std::string name);
+  Texture * findTexture(const std::string name);
+  void unloadTexture(const std::string name);
+  void evictTextures();
   void ExtractTextureSettings(const std::string qualifiedName, GLint &_wrap_mode, GLint &_filter_mode, std::string & name);
   std::vector<std::string> extensions;
 
@@ -29,11 +72,37 @@ public:
 
   void Clear();
   void Preload();
+
+  /// Image files are only decoded when a preset first asks for them. Once their estimated size
+  /// exceeds bytes, the least recently used ones are unloaded. 0 never unloads.
+  void setMemoryBudget(std::size_t bytes);
+  std::size_t getMemoryUsed() const { return memoryUsed; }
+
+  /// Textures handed out from now on belong to the preset being loaded and stay loaded until the
+  /// next call, earlier presets' textures may be unloaded to stay within the budget
+  void startPresetTextures();
+
+  /// Starts decoding the image for a sampler name on a background thread, if it is not loaded yet.
+  /// getTexture waits for the decode instead of starting its own.
+  void requestTexture(const std::string fullName);
+
+  /// Uploads decoded images, up to about bytes per call. Called once a frame, so textures requested
+  /// ahead of their preset are ready without stalling a single frame.
+  void uploadDecodedTextures(std::size_t bytes = UPLOAD_BYTES_PER_FRAME);
+  static const std::size_t UPLOAD_BYTES_PER_FRAME = 2 * 1024 * 1024;
+
   TextureSamplerDesc tryLoadingTexture(const std::string name);
   TextureSamplerDesc getTexture(const std::string fullName, const GLenum defaultWrap, const GLenum defaultFilter);
   const Texture * getMainTexture() const;
   const std::vector<Texture *> & getBlurTextures() const;
 
+  /// Framebuffers drawing into the blur textures, in the same order
+  const std::vector<GLuint> & getBlurFramebuffers() const;
+
+  /// Framebuffer pass 1 draws into. The main texture keeps the previous frame meanwhile.
+  GLuint getMainFramebuffer() const;
+
+  /// Makes the frame drawn into the main framebuffer the main texture
   void updateMainTexture();
 
   TextureSamplerDesc getRandomTextureName(std::string rand_name);
@@ -0,0 +1,133 @@
+#include "UniformCache.hpp"
+#include <cstring>
+
+namespace {
+
+const char *const builtinNames[UniformCache::UniformCount] =
+{
+    "rand_frame", "rand_preset",
+    "_c0", "_c1", "_c2", "_c3", "_c4", "_c5", "_c6", "_c7", "_c8", "_c9", "_c10", "_c11", "_c12", "_c13",
+    "_qa", "_qb", "_qc", "_qd", "_qe", "_qf", "_qg", "_qh",
+    "rot_s1", "rot_s2", "rot_s3", "rot_s4",
+    "rot_d1", "rot_d2", "rot_d3", "rot_d4",
+    "rot_f1", "rot_f2", "rot_f3", "rot_f4",
+    "rot_vf1", "rot_vf2", "rot_vf3", "rot_vf4",
+    "rot_uf1", "rot_uf2", "rot_uf3", "rot_uf4",
+    "rot_rand1", "rot_rand2", "rot_rand3", "rot_rand4",
+    "vertex_shade",
+};
+
+}
+
+UniformCache::UniformCache() : _program(0)
+{
+    clear();
+    resetStats();
+}
+
+void UniformCache::resolve(GLuint program)
+{
+    clear();
+    _program = program;
+    for (int i = 0; i < UniformCount; i++)
+    {
+        _builtin[i].location = glGetUniformLocation(program, builtinNames[i]);
+    }
+}
+
+void UniformCache::clear()
+{
+    _program = 0;
+    for (int i = 0; i < UniformCount; i++)
+    {
+        _builtin[i].location = -1;
+        _builtin[i].uploaded = false;
+    }
+    _textures.clear();
+}
+
+void UniformCache::resetStats()
+{
+    _stats.lookupsSaved = 0;
+    _stats.uploadsSaved = 0;
+}
+
+bool UniformCache::changed(Value &value, const float *data, int count)
+{
+    // unused uniforms have been optimized out by the glsl compiler
+    if (value.location < 0 || (value.uploaded && memcmp(value.data, data, count * sizeof(float)) == 0))
+    {
+        _stats.uploadsSaved++;
+        return false;
+    }
+
+    memcpy(value.data, data, count * sizeof(float));
+    value.uploaded = true;
+    return true;
+}
+
+void UniformCache::set4f(Uniform uniform, float x, float y, float z, float w)
+{
+    const float data[4] = { x, y, z, w };
+    Value &value = _builtin[uniform];
+    _stats.lookupsSaved++;
+    if (changed(value, data, 4))
+        glUniform4fv(value.location, 1, data);
+}
+
+void UniformCache::setMatrix3x4(Uniform uniform, const float *data)
+{
+    Value &value = _builtin[uniform];
+    _stats.lookupsSaved++;
+    if (changed(value, data, 12))
+        glUniformMatrix3x4fv(value.location, 1, GL_FALSE, data);
+}
+
+void UniformCache::set3fv(Uniform uniform, int count, const float *data)
+{
+    Value &value = _builtin[uniform];
+    _stats.lookupsSaved++;
+    if (changed(value, data, count * 3))
+        glUniform3fv(value.location, count, data);
+}
+
+UniformCache::TextureUniforms &UniformCache::texture(const std::string &textureName)
+{
+    std::map<std::string, TextureUniforms>::iterator found = _textures.find(textureName);
+    if (found != _textures.end())
+    {
+        _stats.lookupsSaved++;
+        return found->second;
+    }
+
+    TextureUniforms &uniforms = _textures[textureName];
+    uniforms.sampler.location = glGetUniformLocation(_program, ("sampler_" + textureName).c_str());
+    uniforms.sampler.uploaded = false;
+    uniforms.texsize.location = glGetUniformLocation(_program, ("texsize_" + textureName).c_str());
+    uniforms.texsize.uploaded = false;
+    return uniforms;
+}
+
+bool UniformCache::setSampler(const std::string &textureName, GLint unit)
+{
+    Value &value = texture(textureName).sampler;
+    if (value.location < 0)
+        return false;
+
+    const float data = static_cast<float>(unit);
+    if (changed(value, &data, 1))
+        glUniform1i(value.location, unit);
+    return true;
+}
+
+void UniformCache::setTexsize(const std::string &textureName, int width, int height)
+{
+    Value &value = texture(textureName).texsize;
+    if (value.location < 0)
+        return;
+
+    const float data[4] = { static_cast<float>(width), static_cast<float>(height),
+                            1 / static_cast<float>(width), 1 / static_cast<float>(height) };
+    if (changed(value, data, 4))
+        glUniform4fv(value.location, 1, data);
+}
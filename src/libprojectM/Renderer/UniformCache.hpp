@@ -0,0 +1,89 @@
+#ifndef UniformCache_HPP
+#define UniformCache_HPP
+
+#include "projectM-opengl.h"
+#include <map>
+#include <string>
+
+/// Uniform locations of one linked preset program, and the values last uploaded to them.
+///
+/// The builtin uniforms are looked up once when the program is linked. The sampler_ and texsize_
+/// uniforms are named after textures and are looked up the first time a texture is used. Uploads of
+/// values the program already holds are skipped, uniforms keep their values between draws.
+class UniformCache
+{
+public:
+    /// The builtin uniforms, see http://www.geisswerks.com/milkdrop/milkdrop_preset_authoring.html#3f6
+    enum Uniform
+    {
+        RandFrame, RandPreset,
+        C0, C1, C2, C3, C4, C5, C6, C7, C8, C9, C10, C11, C12, C13,
+        QA, QB, QC, QD, QE, QF, QG, QH,
+        RotS1, RotS2, RotS3, RotS4,
+        RotD1, RotD2, RotD3, RotD4,
+        RotF1, RotF2, RotF3, RotF4,
+        RotVF1, RotVF2, RotVF3, RotVF4,
+        RotUF1, RotUF2, RotUF3, RotUF4,
+        RotRand1, RotRand2, RotRand3, RotRand4,
+        Shade,      //!< hue shading colors of the composite grid corners, not a Milkdrop uniform
+        UniformCount
+    };
+
+    /// GL calls made unnecessary by the cache, counted until reset
+    struct Stats
+    {
+        unsigned int lookupsSaved;
+        unsigned int uploadsSaved;
+    };
+
+    UniformCache();
+
+    /// Looks up the builtin uniforms of a freshly linked program and forgets all uploaded values
+    void resolve(GLuint program);
+
+    /// Forgets the program, for when it is deleted
+    void clear();
+
+    void set4f(Uniform uniform, float x, float y, float z, float w);
+
+    /// value points to 12 floats, 3 columns of 4 rows
+    void setMatrix3x4(Uniform uniform, const float *value);
+
+    /// value points to count vec3s, at most 4
+    void set3fv(Uniform uniform, int count, const float *value);
+
+    /// Points sampler_<textureName> at a texture unit. Returns false if the program does not use the sampler.
+    bool setSampler(const std::string &textureName, GLint unit);
+
+    /// Sets texsize_<textureName> to the size and inverse size of a texture
+    void setTexsize(const std::string &textureName, int width, int height);
+
+    const Stats &stats() const { return _stats; }
+    void resetStats();
+
+private:
+    struct Value
+    {
+        GLint location;
+        bool uploaded;
+        float data[12];
+    };
+
+    struct TextureUniforms
+    {
+        Value sampler;
+        Value texsize;
+    };
+
+    /// Copies count floats into value and returns true if the program needs them uploaded
+    bool changed(Value &value, const float *data, int count);
+
+    TextureUniforms &texture(const std::string &textureName);
+
+    GLuint _program;
+    Value _builtin[UniformCount];
+    std::map<std::string, TextureUniforms> _textures;
+    Stats _stats;
+};
+
+#endif
@@ -0,0 +1,447 @@
+#include <cstring>
+#include "VertexArena.hpp"
+#include "Renderable.hpp"
+#include <glm/gtc/type_ptr.hpp>
+
+namespace {
+
+// enough for a few shapes and waves before the buffer has to grow
+const std::size_t INITIAL_REGION_VERTICES = 16384;
+
+// primitives that do not connect to the vertices before them
+bool independent(GLenum mode)
+{
+    return mode == GL_POINTS || mode == GL_LINES || mode == GL_TRIANGLES;
+}
+
+}
+
+VertexArena::State::State()
+    : textured(false), blendSource(GL_SRC_ALPHA), blendDestination(GL_ONE_MINUS_SRC_ALPHA),
+      texture(0), sampler(0), wrap(0), lineWidth(0), pointSize(0), transform(1.0f)
+{}
+
+bool VertexArena::State::operator==(const State &other) const
+{
+    return textured == other.textured &&
+           blendSource == other.blendSource && blendDestination == other.blendDestination &&
+           texture == other.texture && sampler == other.sampler && wrap == other.wrap &&
+           lineWidth == other.lineWidth && pointSize == other.pointSize &&
+           transform == other.transform;
+}
+
+VertexArena::VertexArena()
+    : _initialized(false), _persistent(false), _buffer(0), _vao(0), _mapped(nullptr),
+      _regionVertices(0), _region(0), _regionUsed(0), _drawCount(0), _batchCount(0)
+{
+    for (int i = 0; i < REGIONS; i++)
+        _fences[i] = 0;
+}
+
+VertexArena::~VertexArena()
+{
+    release();
+}
+
+VertexArena::Vertex *VertexArena::append(GLsizei count, GLint &first)
+{
+    first = static_cast<GLint>(_vertices.size());
+    _vertices.resize(_vertices.size() + count);
+    return _vertices.data() + first;
+}
+
+void VertexArena::draw(const State &state, GLenum mode, GLint first, GLsizei count)
+{
+    if (count <= 0)
+        return;
+
+    Command command;
+    command.state = state;
+    command.mode = mode;
+    command.first = first;
+    command.count = count;
+    _commands.push_back(command);
+    _drawCount++;
+}
+
+void VertexArena::drawFan(const State &state, const Vertex *vertices, GLsizei count)
+{
+    if (count < 3)
+        return;
+
+    GLint first;
+    Vertex *triangles = append((count - 2) * 3, first);
+    for (GLsizei i = 1; i < count - 1; i++)
+    {
+        *triangles++ = vertices[0];
+        *triangles++ = vertices[i];
+        *triangles++ = vertices[i + 1];
+    }
+    draw(state, GL_TRIANGLES, first, (count - 2) * 3);
+}
+
+void VertexArena::drawStrip(const State &state, const Vertex *vertices, GLsizei count)
+{
+    if (count < 3)
+        return;
+
+    // every other triangle of a strip is reversed to keep the winding
+    GLint first;
+    Vertex *triangles = append((count - 2) * 3, first);
+    for (GLsizei i = 0; i < count - 2; i++)
+    {
+        *triangles++ = vertices[i % 2 == 0 ? i : i + 1];
+        *triangles++ = vertices[i % 2 == 0 ? i + 1 : i];
+        *triangles++ = vertices[i + 2];
+    }
+    draw(state, GL_TRIANGLES, first, (count - 2) * 3);
+}
+
+void VertexArena::resetStats()
+{
+    _drawCount = 0;
+    _batchCount = 0;
+}
+
+void VertexArena::batch()
+{
+    std::size_t merged = 0;
+    for (std::size_t i = 0; i < _commands.size(); i++)
+    {
+        const Command &command = _commands[i];
+        if (merged > 0)
+        {
+            Command &previous = _commands[merged - 1];
+            if (independent(command.mode) && command.mode == previous.mode &&
+                command.first == previous.first + previous.count && command.state == previous.state)
+            {
+                previous.count += command.count;
+                continue;
+            }
+        }
+        if (merged != i)
+            _commands[merged] = command;
+        merged++;
+    }
+    _commands.resize(merged);
+}
+
+void VertexArena::flush(const RenderContext &context)
+{
+    if (_commands.empty())
+    {
+        _vertices.clear();
+        return;
+    }
+
+    batch();
+    const GLint base = upload();
+
+    glBindVertexArray(_vao);
+
+    // nothing is known about the state other code left behind
+    const State *current = nullptr;
+    bool transformSet[2] = { false, false };
+    glm::mat4 transform[2];
+    bool pointSizeSet = false;
+    float pointSize = 0;
+    float lineWidth = 0;
+    GLuint texture = 0;
+    GLint wrap = 0;
+    bool samplerSet = false;
+    GLuint sampler = 0;
+
+    for (const Command &command : _commands)
+    {
+        const State &state = command.state;
+        const int program = state.textured ? 1 : 0;
+
+        if (current == nullptr || state.textured != current->textured)
+        {
+            if (state.textured)
+            {
+                glUseProgram(context.programID_v2f_c4f_t2f);
+                glUniform1i(context.uniform_v2f_c4f_t2f_frag_texture_sampler, 0);
+            }
+            else
+                glUseProgram(context.programID_v2f_c4f);
+        }
+
+        if (!transformSet[program] || state.transform != transform[program])
+        {
+            glUniformMatrix4fv(state.textured ? context.uniform_v2f_c4f_t2f_vertex_tranformation
+                                              : context.uniform_v2f_c4f_vertex_tranformation,
+                               1, GL_FALSE, glm::value_ptr(state.transform));
+            transform[program] = state.transform;
+            transformSet[program] = true;
+        }
+
+        // uploaded as is, even if 0, like the motion vectors always did
+        if (!state.textured && command.mode == GL_POINTS && (!pointSizeSet || state.pointSize != pointSize))
+        {
+            glUniform1f(context.uniform_v2f_c4f_vertex_point_size, state.pointSize);
+            pointSize = state.pointSize;
+            pointSizeSet = true;
+        }
+
+        if (current == nullptr || state.blendSource != current->blendSource ||
+            state.blendDestination != current->blendDestination)
+            glBlendFunc(state.blendSource, state.blendDestination);
+
+        if (state.lineWidth > 0 && state.lineWidth != lineWidth)
+        {
+            glLineWidth(state.lineWidth);
+            lineWidth = state.lineWidth;
+        }
+
+        if (state.textured && state.texture != 0)
+        {
+            if (state.texture != texture)
+            {
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, state.texture);
+                texture = state.texture;
+                wrap = 0;
+            }
+            if (state.wrap != 0 && state.wrap != wrap)
+            {
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, state.wrap);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, state.wrap);
+                wrap = state.wrap;
+            }
+            if (!samplerSet || state.sampler != sampler)
+            {
+                glBindSampler(0, state.sampler);
+                sampler = state.sampler;
+                samplerSet = true;
+            }
+        }
+
+        glDrawArrays(command.mode, base + command.first, command.count);
+        current = &state;
+    }
+
+    _batchCount += static_cast<int>(_commands.size());
+
+    glBindVertexArray(0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (lineWidth > 0)
+        glLineWidth(context.texsize < 512 ? 1 : context.texsize/512);
+    if (texture != 0)
+        glBindTexture(GL_TEXTURE_2D, 0);
+    if (sampler != 0)
+        glBindSampler(0, 0);
+
+    _vertices.clear();
+    _commands.clear();
+}
+
+GLint VertexArena::upload()
+{
+    const std::size_t count = _vertices.size();
+
+    if (!_initialized)
+    {
+        _persistent = supportsPersistentMapping();
+        _initialized = true;
+        allocate(INITIAL_REGION_VERTICES);
+    }
+
+    if (count > _regionVertices)
+    {
+        std::size_t regionVertices = _regionVertices;
+        while (regionVertices < count)
+            regionVertices *= 2;
+        allocate(regionVertices);
+    }
+    else if (_regionUsed + count > _regionVertices)
+    {
+        // move on to the next region once the GPU is done with it
+        _fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        _region = (_region + 1) % REGIONS;
+        if (_fences[_region] != 0)
+        {
+            while (glClientWaitSync(_fences[_region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+                ;
+            glDeleteSync(_fences[_region]);
+            _fences[_region] = 0;
+        }
+        _regionUsed = 0;
+    }
+
+    const std::size_t first = _region * _regionVertices + _regionUsed;
+    const std::size_t bytes = count * sizeof(Vertex);
+
+    if (_mapped != nullptr)
+        std::memcpy(_mapped + first, _vertices.data(), bytes);
+    else
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+        void *target = glMapBufferRange(GL_ARRAY_BUFFER, first * sizeof(Vertex), bytes,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (target != nullptr)
+        {
+            std::memcpy(target, _vertices.data(), bytes);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        else
+            glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Vertex), bytes, _vertices.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    _regionUsed += count;
+    return static_cast<GLint>(first);
+}
+
+void VertexArena::allocate(std::size_t regionVertices)
+{
+    release();
+
+    _regionVertices = regionVertices;
+    _region = 0;
+    _regionUsed = 0;
+
+    const GLsizeiptr size = REGIONS * regionVertices * sizeof(Vertex);
+
+    glGenVertexArrays(1, &_vao);
+    glGenBuffers(1, &_buffer);
+
+    glBindVertexArray(_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+
+#ifdef GL_MAP_PERSISTENT_BIT
+    if (_persistent)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+        _mapped = static_cast<Vertex *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+    }
+    else
+#endif
+        glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);                  // points
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(float)*2));  // colors
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(float)*6));  // textures
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void VertexArena::release()
+{
+    for (int i = 0; i < REGIONS; i++)
+    {
+        if (_fences[i] != 0)
+            glDeleteSync(_fences[i]);
+        _fences[i] = 0;
+    }
+
+    if (_buffer == 0)
+        return;
+
+    if (_mapped != nullptr)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        _mapped = nullptr;
+    }
+
+    glDeleteBuffers(1, &_buffer);
+    glDeleteVertexArrays(1, &_vao);
+    _buffer = 0;
+    _vao = 0;
+}
+
+bool VertexArena::supportsPersistentMapping()
+{
+#ifdef GL_MAP_PERSISTENT_BIT
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 4))
+        return true;
+
+    GLint extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (GLint i = 0; i < extensions; i++)
+    {
+        const char *name = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+        if (name != nullptr && std::strcmp(name, "GL_ARB_buffer_storage") == 0)
+            return true;
+    }
+#endif
+    return false;
+}
+
+
+// TESTS
+
+#include "TestRunner.hpp"
+
+#ifndef NDEBUG
+
+#define TEST(cond) if (!verify(__FILE__ ": " #cond,cond)) return false
+
+struct VertexArenaTest : public Test
+{
+    VertexArenaTest() : Test("VertexArenaTest")
+    {}
+
+    bool test_batch()
+    {
+        VertexArena arena;
+        VertexArena::State additive;
+        additive.blendDestination = GL_ONE;
+
+        GLint first;
+        arena.append(9, first);
+        TEST(first == 0);
+        arena.draw(VertexArena::State(), GL_TRIANGLES, 0, 3);
+        arena.draw(VertexArena::State(), GL_TRIANGLES, 3, 3);
+        // different blending
+        arena.draw(additive, GL_TRIANGLES, 6, 3);
+        // not adjacent
+        arena.draw(additive, GL_TRIANGLES, 0, 3);
+
+        arena.append(8, first);
+        TEST(first == 9);
+        // strips connect to the vertices before them
+        arena.draw(VertexArena::State(), GL_LINE_STRIP, 9, 4);
+        arena.draw(VertexArena::State(), GL_LINE_STRIP, 13, 4);
+
+        TEST(arena.getDrawCount() == 6);
+        arena.batch();
+        TEST(arena._commands.size() == 5);
+        TEST(arena._commands[0].first == 0 && arena._commands[0].count == 6);
+        TEST(arena._commands[1].first == 6 && arena._commands[1].state == additive);
+        TEST(arena._commands[2].first == 0 && arena._commands[2].count == 3);
+        TEST(arena._commands[3].mode == GL_LINE_STRIP && arena._commands[4].first == 13);
+        return true;
+    }
+
+    bool test() override
+    {
+        TEST(test_batch());
+        return true;
+    }
+};
+
+Test* VertexArena::test()
+{
+    return new VertexArenaTest();
+}
+
+#else
+
+Test* VertexArena::test()
+{
+    return nullptr;
+}
+
+#endif
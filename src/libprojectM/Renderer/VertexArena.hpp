@@ -0,0 +1,121 @@
+#ifndef VertexArena_HPP
+#define VertexArena_HPP
+
+#include <cstddef>
+#include <vector>
+#include "projectM-opengl.h"
+#include <glm/mat4x4.hpp>
+
+class RenderContext;
+class Test;
+
+/// Streams the vertices of all render items through one buffer.
+///
+/// Render items append their vertices and record draws instead of uploading and drawing on their
+/// own. flush() then uploads everything appended since the previous flush at once and issues the
+/// draws in the order they were recorded, only changing GL state where it differs from the draw
+/// before. Consecutive draws of independent primitives with the same state and adjacent vertices
+/// become a single glDrawArrays.
+///
+/// The buffer is split in regions that are filled one after the other and reused once the GPU has
+/// finished the draws reading them. It stays mapped if the driver has persistent mapping
+/// (GL 4.4 or ARB_buffer_storage), otherwise every flush maps its range unsynchronized.
+class VertexArena
+{
+public:
+    /// Layout of the v2f_c4f_t2f shader inputs, v2f_c4f ignores the texture coordinates
+    struct Vertex
+    {
+        float x, y;
+        float r, g, b, a;
+        float u, v;
+    };
+
+    /// Everything a draw depends on besides its vertices
+    struct State
+    {
+        State();
+
+        bool textured;          //!< draw with programID_v2f_c4f_t2f instead of programID_v2f_c4f
+        GLenum blendSource;
+        GLenum blendDestination;
+        GLuint texture;         //!< bound to unit 0 for textured draws
+        GLuint sampler;         //!< bound to unit 0, 0 uses the texture's own parameters
+        GLint wrap;             //!< wrap mode set on the texture, 0 leaves it alone
+        float lineWidth;        //!< 0 for draws without lines
+        float pointSize;        //!< gl_PointSize of untextured GL_POINTS draws
+        glm::mat4 transform;
+
+        bool operator==(const State &other) const;
+        bool operator!=(const State &other) const { return !(*this == other); }
+    };
+
+    VertexArena();
+    ~VertexArena();
+
+    VertexArena(const VertexArena &) = delete;
+    VertexArena &operator=(const VertexArena &) = delete;
+
+    /// Adds count vertices to be filled in by the caller. first is set to the index of the first
+    /// one for draw(). The pointer is only valid until the next append().
+    Vertex *append(GLsizei count, GLint &first);
+
+    /// Records a draw of count appended vertices starting at first
+    void draw(const State &state, GLenum mode, GLint first, GLsizei count);
+
+    /// Append a triangle fan or strip as separate triangles and draw them, so they can be batched
+    /// with the draws around them
+    void drawFan(const State &state, const Vertex *vertices, GLsizei count);
+    void drawStrip(const State &state, const Vertex *vertices, GLsizei count);
+
+    /// Uploads the appended vertices and issues the recorded draws. Must be called on the render thread.
+    void flush(const RenderContext &context);
+
+    /// Draws recorded and glDrawArrays calls issued since the last resetStats()
+    int getDrawCount() const { return _drawCount; }
+    int getBatchCount() const { return _batchCount; }
+    void resetStats();
+
+    static Test *test();
+
+private:
+    struct Command
+    {
+        State state;
+        GLenum mode;
+        GLint first;
+        GLsizei count;
+    };
+
+    static const int REGIONS = 3;
+
+    static bool supportsPersistentMapping();
+
+    /// Merges consecutive commands that can be drawn with one call
+    void batch();
+
+    /// Copies the vertices to the buffer, returns the index of the first one in it
+    GLint upload();
+    void allocate(std::size_t regionVertices);
+    void release();
+
+    std::vector<Vertex> _vertices;
+    std::vector<Command> _commands;
+
+    bool _initialized;
+    bool _persistent;
+    GLuint _buffer;
+    GLuint _vao;
+    Vertex *_mapped;                //!< whole buffer when mapped persistently
+    std::size_t _regionVertices;
+    int _region;
+    std::size_t _regionUsed;        //!< vertices of the current region already written
+    GLsync _fences[REGIONS];        //!< signalled when the GPU is done with a region
+
+    int _drawCount;
+    int _batchCount;
+
+    friend struct VertexArenaTest;
+};
+
+#endif
@@ -7,27 +7,15 @@
 
 #include "VideoEcho.hpp"
 #include "ShaderEngine.hpp"
-#include <glm/gtc/type_ptr.hpp>
 
 VideoEcho::VideoEcho(): a(0), zoom(1), orientation(Normal)
 {
-    Init();
 }
 
 VideoEcho::~VideoEcho()
 {
 }
 
-void VideoEcho::InitVertexAttrib() {
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(float)*4, (void*)0);   // Positions
-
-    glDisableVertexAttribArray(1);
-
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(float)*4, (void*)(sizeof(float)*2)); // Textures
-}
-
 void VideoEcho::Draw(RenderContext &context)
 {
 		int flipx=1, flipy=1;
@@ -40,18 +28,12 @@ void VideoEcho::Draw(RenderContext &context)
 			default: flipx=1;flipy=1; break;
 		}
 
-    float buffer_data[8][2] = {
-        {-0.5f*flipx, -0.5f*flipy},
-        {0.0, 1.0},
-
-        {-0.5f*flipx,  0.5f*flipy},
-        {0.0, 0.0},
-
-        { 0.5f*flipx,  0.5f*flipy},
-        {1.0, 0.0},
-
-        { 0.5f*flipx, -0.5f*flipy},
-        {1.0, 1.0}
+    const float alpha = a * masterAlpha;
+    VertexArena::Vertex buffer_data[4] = {
+        {-0.5f*flipx, -0.5f*flipy,  1.0, 1.0, 1.0, alpha,  0.0, 1.0},
+        {-0.5f*flipx,  0.5f*flipy,  1.0, 1.0, 1.0, alpha,  0.0, 0.0},
+        { 0.5f*flipx,  0.5f*flipy,  1.0, 1.0, 1.0, alpha,  1.0, 0.0},
+        { 0.5f*flipx, -0.5f*flipy,  1.0, 1.0, 1.0, alpha,  1.0, 1.0}
     };
 
     glm::mat4 mat_first_translation = glm::mat4(1.0);
@@ -66,41 +48,22 @@ void VideoEcho::Draw(RenderContext &context)
     mat_second_translation[3][0] = 0.5;
     mat_second_translation[3][1] = 0.5;
 
-    for (int i = 1; i < 8; i+=2) {
-        glm::vec4 texture = glm::vec4(buffer_data[i][0], buffer_data[i][1], 0, 1);
+    for (int i = 0; i < 4; i++) {
+        glm::vec4 texture = glm::vec4(buffer_data[i].u, buffer_data[i].v, 0, 1);
         texture = mat_first_translation * texture;
         texture = mat_scale * texture;
         texture = mat_second_translation * texture;
 
-        buffer_data[i][0] = texture[0];
-        buffer_data[i][1] = texture[1];
+        buffer_data[i].u = texture[0];
+        buffer_data[i].v = texture[1];
     }
 
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
-
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 16, NULL, GL_DYNAMIC_DRAW);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 16, buffer_data, GL_DYNAMIC_DRAW);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    glUseProgram(context.programID_v2f_c4f_t2f);
-
-    glUniformMatrix4fv(context.uniform_v2f_c4f_t2f_vertex_tranformation, 1, GL_FALSE, glm::value_ptr(context.mat_ortho));
-    glUniform1i(context.uniform_v2f_c4f_t2f_frag_texture_sampler, 0);
-
-
     //Now Blend the Video Echo
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    glVertexAttrib4f(1, 1.0, 1.0, 1.0, a * masterAlpha);
-
-    glBindVertexArray(m_vaoID);
+    VertexArena::State state;
+    state.textured = true;
+    state.texture = context.textureManager->getMainTexture()->texID;
+    state.transform = context.mat_ortho;
 
     //draw video echo
-    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-
-    glBindVertexArray(0);
-
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    context.vertexArena->drawFan(state, buffer_data, 4);
 }
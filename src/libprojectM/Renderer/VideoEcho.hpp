@@ -27,7 +27,6 @@ public:
 	float zoom;
 	Orientation orientation;
 
-    void InitVertexAttrib();
 	void Draw(RenderContext &context);
 };
 
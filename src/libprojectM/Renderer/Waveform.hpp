@@ -53,7 +53,6 @@ public:
     int sep;  /* no idea what this is yet... */
 
     Waveform(int _samples);
-    void InitVertexAttrib();
     void Draw(RenderContext &context);
 
 private:
@@ -61,5 +60,9 @@ private:
 	std::vector<ColoredPoint> points;
 	std::vector<float> pointContext;
 
+	// scratch buffers of Draw(), kept so drawing a frame does not allocate
+	std::vector<float> value1;
+	std::vector<float> value2;
+
 };
 #endif /* WAVEFORM_HPP_ */
@@ -5,7 +5,21 @@
 #include <iostream>
 #include <MilkdropPresetFactory/Parser.hpp>
 #include <TestRunner.hpp>
+#include <MilkdropPresetFactory/ExprBytecode.hpp>
+#include <MilkdropPresetFactory/ExprCompiler.hpp>
+#include <MilkdropPresetFactory/JitObjectCache.hpp>
 #include <MilkdropPresetFactory/Param.hpp>
+#include <MilkdropPresetFactory/ParamTable.hpp>
+#include <MilkdropPresetFactory/PresetFrameIO.hpp>
+#include <MilkdropPresetFactory/SimdMath.hpp>
+#include <PipelineMerger.hpp>
+#include <TimeKeeper.hpp>
+#include <Renderer/PerlinNoise.hpp>
+#include <Renderer/ProgramBinaryCache.hpp>
+#include <Renderer/ShaderCache.hpp>
+#include <Renderer/TextureDecoder.hpp>
+#include <Renderer/VertexArena.hpp>
+#include <WorkerPool.hpp>
 
 std::vector<Test *> TestRunner::tests;
 
@@ -17,9 +31,23 @@ bool TestRunner::run()
         // We still call register/run tests in NDEBUG (useful for performance testing)
         //   but tests may choose to comment out body to save space
         tests.push_back(Param::test());
+        tests.push_back(ParamTable::test());
         tests.push_back(Parser::test());
         tests.push_back(Expr::test());
+        tests.push_back(BytecodeProgram::test());
+        tests.push_back(ExprCompiler::test());
+        tests.push_back(JitObjectCache::test());
         tests.push_back(PCM::test());
+        tests.push_back(WorkerPool::test());
+        tests.push_back(SimdMath::test());
+        tests.push_back(PresetOutputs::test());
+        tests.push_back(PipelineMerger::test());
+        tests.push_back(ShaderCache::test());
+        tests.push_back(ProgramBinaryCache::test());
+        tests.push_back(TextureDecoder::test());
+        tests.push_back(PerlinNoise::test());
+        tests.push_back(VertexArena::test());
+        tests.push_back(TimeKeeper::test());
     }
 
     int count = 0;
@@ -20,22 +20,35 @@ TimeKeeper::TimeKeeper(double presetDuration, double smoothDuration, double hard
 	startTime = GetTickCount();
 #endif /** !WIN32 */
 
-	UpdateTimers();
+	_currentTime = 0;
+	_presetTimeA = _presetTimeB = 0;
+	_presetFrameA = _presetFrameB = 0;
+	_isSmoothing = false;
+	_externalTime = false;
   }
 
   void TimeKeeper::UpdateTimers()
   {
+	if (!_externalTime)
+	{
 #ifndef WIN32
 	_currentTime = getTicks ( &startTime ) * 0.001;
 #else
 	_currentTime = getTicks ( startTime ) * 0.001;
 #endif /** !WIN32 */
+	}
 
 	_presetFrameA++;
 	_presetFrameB++;
 
   }
 
+  void TimeKeeper::SetTime(double seconds)
+  {
+    _externalTime = true;
+    _currentTime = seconds;
+  }
+
   void TimeKeeper::StartPreset()
   {
     _isSmoothing = false;
@@ -115,3 +128,91 @@ double TimeKeeper::sampledPresetDuration() {
 			(_presetDuration, _easterEgg)));
 #endif
 }
+
+
+#include "TestRunner.hpp"
+
+#ifndef NDEBUG
+
+#include <vector>
+
+#define TEST(cond) if (!verify(__FILE__ ": " #cond,cond)) return false
+
+struct TimeKeeperTest : public Test
+{
+    TimeKeeperTest() : Test("TimeKeeperTest")
+    {}
+
+    bool test_external_time()
+    {
+        // no easter egg, so presets last exactly presetDuration
+        TimeKeeper timeKeeper(10.0, 5.0, 60.0, 0.0);
+        TEST(!timeKeeper.UsesExternalTime());
+
+        timeKeeper.SetTime(2.0);
+        TEST(timeKeeper.UsesExternalTime());
+        timeKeeper.StartPreset();
+        TEST(timeKeeper.PresetTimeA() == 2);
+
+        timeKeeper.SetTime(7.0);
+        timeKeeper.UpdateTimers();
+        TEST(timeKeeper.GetRunningTime() == 7.0);
+        TEST(timeKeeper.PresetProgressA() == 0.5);
+        TEST(timeKeeper.PresetFrameA() == 2);
+
+        // the wall clock is not consulted anymore
+        timeKeeper.UpdateTimers();
+        TEST(timeKeeper.GetRunningTime() == 7.0);
+
+        timeKeeper.StartSmoothing();
+        timeKeeper.SetTime(9.5);
+        TEST(timeKeeper.SmoothRatio() == 0.5);
+        return true;
+    }
+
+    std::vector<double> draw()
+    {
+        std::vector<double> values;
+        for (int i = 0; i < 8; i++)
+        {
+            values.push_back(RandomNumberGenerators::uniform());
+            values.push_back(RandomNumberGenerators::uniformInteger(1000));
+            values.push_back(RandomNumberGenerators::gaussian(15.0f, 3.0f));
+        }
+        TimeKeeper timeKeeper(15.0, 5.0, 60.0, 3.0);
+        values.push_back(timeKeeper.sampledPresetDuration());
+        return values;
+    }
+
+    bool test_seed()
+    {
+        RandomNumberGenerators::seed(1234);
+        std::vector<double> first = draw();
+        RandomNumberGenerators::seed(1234);
+        TEST(draw() == first);
+        RandomNumberGenerators::seed(4321);
+        TEST(draw() != first);
+        return true;
+    }
+
+    bool test() override
+    {
+        TEST(test_external_time());
+        TEST(test_seed());
+        return true;
+    }
+};
+
+Test* TimeKeeper::test()
+{
+    return new TimeKeeperTest();
+}
+
+#else
+
+Test* TimeKeeper::test()
+{
+    return nullptr;
+}
+
+#endif
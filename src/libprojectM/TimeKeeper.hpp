@@ -9,6 +9,8 @@
 
 #define HARD_CUT_DELAY 3
 
+class Test;
+
 class TimeKeeper
 {
 
@@ -18,6 +20,11 @@ public:
 
   void UpdateTimers();
 
+  /// Uses seconds since the TimeKeeper was created as the current time instead of the wall clock.
+  /// Once set, time only changes through SetTime(), so frames can be rendered at exact timestamps.
+  void SetTime(double seconds);
+  bool UsesExternalTime() const { return _externalTime; }
+
   void StartPreset();
   void StartSmoothing();
   void EndSmoothing();
@@ -45,6 +52,8 @@ public:
   void ChangeHardcutDuration(double seconds) { _hardcutDuration = seconds; }
   void ChangePresetDuration(double seconds) { _presetDuration = seconds; }
 
+  static Test *test();
+
 #ifndef WIN32
   /* The first ticks value of the application */
   struct timeval startTime;
@@ -68,7 +77,8 @@ private:
   int _presetFrameB;
 
   bool _isSmoothing;
-  
+  bool _externalTime;
+
 
 };
 #endif
@@ -0,0 +1,273 @@
+#include "WorkerPool.hpp"
+
+#if USE_THREADS
+namespace {
+
+inline std::uint64_t packRange(std::uint64_t begin, std::uint64_t end)
+{
+    return (begin << 32) | end;
+}
+
+inline std::uint64_t rangeBegin(std::uint64_t range)
+{
+    return range >> 32;
+}
+
+inline std::uint64_t rangeEnd(std::uint64_t range)
+{
+    return range & 0xffffffffu;
+}
+
+}
+
+WorkerPool::WorkerPool(unsigned int threads)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    _size = threads > 0 ? threads : 1;
+
+    _shares.reset(new Share[_size]);
+    for (unsigned int participant = 1; participant < _size; participant++)
+        _threads.emplace_back(&WorkerPool::workerLoop, this, participant);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    _startCondition.notify_all();
+    for (auto & thread : _threads)
+        thread.join();
+}
+
+void WorkerPool::run(std::size_t count, const Task & task)
+{
+    std::unique_lock<std::mutex> runLock(_runMutex, std::try_to_lock);
+    if (_size == 1 || count <= 1 || !runLock.owns_lock())
+    {
+        for (std::size_t index = 0; index < count; index++)
+            task(index, 0);
+        return;
+    }
+
+    for (unsigned int participant = 0; participant < _size; participant++)
+    {
+        _shares[participant].range.store(packRange(count * participant / _size, count * (participant + 1) / _size),
+                                         std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _task = &task;
+        _busy = _size - 1;
+        _generation++;
+    }
+    _startCondition.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _doneCondition.wait(lock, [this] { return _busy == 0; });
+    _task = nullptr;
+}
+
+void WorkerPool::workerLoop(unsigned int participant)
+{
+    std::uint64_t generation = 0;
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        _startCondition.wait(lock, [this, generation] { return !_running || _generation != generation; });
+
+        if (!_running)
+            return;
+
+        generation = _generation;
+        lock.unlock();
+
+        work(participant);
+
+        lock.lock();
+        if (--_busy == 0)
+            _doneCondition.notify_one();
+    }
+}
+
+void WorkerPool::work(unsigned int participant)
+{
+    const Task & task = *_task;
+    std::size_t index;
+
+    do
+    {
+        while (popFront(participant, index))
+            task(index, participant);
+    } while (steal(participant));
+}
+
+bool WorkerPool::popFront(unsigned int participant, std::size_t & index)
+{
+    std::atomic<std::uint64_t> & range = _shares[participant].range;
+    std::uint64_t current = range.load(std::memory_order_acquire);
+
+    while (rangeBegin(current) < rangeEnd(current))
+    {
+        if (range.compare_exchange_weak(current, packRange(rangeBegin(current) + 1, rangeEnd(current)),
+                                        std::memory_order_acq_rel))
+        {
+            index = rangeBegin(current);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WorkerPool::steal(unsigned int thief)
+{
+    for (unsigned int offset = 1; offset < _size; offset++)
+    {
+        std::atomic<std::uint64_t> & victim = _shares[(thief + offset) % _size].range;
+        std::uint64_t current = victim.load(std::memory_order_acquire);
+
+        while (rangeBegin(current) < rangeEnd(current))
+        {
+            // Take the back half, rounded up so a single remaining index can be stolen as well.
+            const std::uint64_t begin = rangeBegin(current);
+            const std::uint64_t end = rangeEnd(current);
+            const std::uint64_t middle = begin + (end - begin) / 2;
+
+            if (victim.compare_exchange_weak(current, packRange(begin, middle), std::memory_order_acq_rel))
+            {
+                // Our own share is empty, nobody else can have changed it.
+                _shares[thief].range.store(packRange(middle, end), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+#else
+
+WorkerPool::WorkerPool(unsigned int threads) : _size(1)
+{
+    (void)threads;
+}
+
+WorkerPool::~WorkerPool() = default;
+
+void WorkerPool::run(std::size_t count, const Task & task)
+{
+    for (std::size_t index = 0; index < count; index++)
+        task(index, 0);
+}
+
+#endif
+
+
+// TESTS
+
+#include <iostream>
+#include "TestRunner.hpp"
+
+#ifndef NDEBUG
+
+#include <vector>
+#if USE_THREADS
+#include <thread>
+#endif
+
+#define TEST(cond) if (!verify(__FILE__ ": " #cond,cond)) return false
+
+struct WorkerPoolTest : public Test
+{
+    WorkerPoolTest() : Test("WorkerPoolTest")
+    {}
+
+    // every index must be processed exactly once, by a valid participant
+    bool run_once(WorkerPool & pool, std::size_t count)
+    {
+        std::vector<int> visits(count, 0);
+        bool participantsValid = true;
+        pool.run(count, [&](std::size_t index, unsigned int participant) {
+            visits[index]++;
+            if (participant >= pool.size())
+                participantsValid = false;
+        });
+        TEST(participantsValid);
+        for (std::size_t index = 0; index < count; index++)
+            TEST(visits[index] == 1);
+        return true;
+    }
+
+    bool test_run()
+    {
+        WorkerPool single(1);
+        TEST(single.size() == 1);
+        TEST(run_once(single, 100));
+
+        WorkerPool pool(4);
+#if USE_THREADS
+        TEST(pool.size() == 4);
+#endif
+        for (std::size_t count : { 0, 1, 3, 4, 5, 97, 1000 })
+            TEST(run_once(pool, count));
+
+        // uneven work, the threads that finish first have to steal the rest
+        for (int repeat = 0; repeat < 20; repeat++)
+        {
+            std::vector<int> visits(64, 0);
+            pool.run(visits.size(), [&](std::size_t index, unsigned int) {
+                volatile float sink = 0;
+                for (std::size_t i = 0; i < (index < 8 ? 200000 : 10); i++)
+                    sink = sink + 1;
+                visits[index]++;
+            });
+            for (int visited : visits)
+                TEST(visited == 1);
+        }
+        return true;
+    }
+
+    bool test_concurrent_callers()
+    {
+#if USE_THREADS
+        WorkerPool pool(4);
+        bool ok[2] = { true, true };
+        auto caller = [&](int id) {
+            for (int repeat = 0; repeat < 200 && ok[id]; repeat++)
+                ok[id] = run_once(pool, 50);
+        };
+        std::thread other(caller, 1);
+        caller(0);
+        other.join();
+        TEST(ok[0]);
+        TEST(ok[1]);
+#endif
+        return true;
+    }
+
+    bool test() override
+    {
+        TEST(test_run());
+        TEST(test_concurrent_callers());
+        return true;
+    }
+};
+
+Test* WorkerPool::test()
+{
+    return new WorkerPoolTest();
+}
+
+#else
+
+Test* WorkerPool::test()
+{
+    return nullptr;
+}
+
+#endif
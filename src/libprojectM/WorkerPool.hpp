@@ -0,0 +1,83 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+#if USE_THREADS
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+class Test;
+
+/// A fixed set of threads that stay alive for the lifetime of projectM and share the work of a loop.
+///
+/// Every participant starts with an equal, contiguous share of the indices and processes it front to back.
+/// A participant that runs out of work steals the back half of the share of another one, so a slow band
+/// of the mesh does not hold up the whole frame.
+class WorkerPool {
+
+public:
+    /// Signature of a loop body: the index to process and the participant running it, which is
+    /// in [0, size()) and can be used to pick per thread scratch memory.
+    typedef std::function<void(std::size_t index, unsigned int participant)> Task;
+
+    /// \param threads total number of threads sharing a loop, including the calling thread.
+    ///                0 uses one per hardware thread. Ignored if projectM was built without thread support.
+    explicit WorkerPool(unsigned int threads);
+
+    ~WorkerPool();
+
+    /// Number of participants of a loop, including the calling thread
+    unsigned int size() const { return _size; }
+
+    /// Calls task for every index in [0, count) and returns once all of them are done. The calling
+    /// thread takes part as participant 0. If the pool is already running a loop for another thread,
+    /// the caller processes all indices itself. The task must not throw.
+    void run(std::size_t count, const Task & task);
+
+    static Test* test();
+
+private:
+    unsigned int _size;
+
+#if USE_THREADS
+    /// Remaining indices of one participant, begin in the upper and end in the lower 32 bits, so the
+    /// owner and thieves can both update it with a single compare and swap. Padded to the size of a
+    /// cache line, so every line holds the range of one participant only. alignas would need the
+    /// aligned operator new of C++17 for the array.
+    struct Share {
+        std::atomic<std::uint64_t> range{ 0 };
+        char padding[64 - sizeof(std::atomic<std::uint64_t>)];
+    };
+
+    void workerLoop(unsigned int participant);
+
+    /// Processes the participant's own share, then steals from the others until no work is left
+    void work(unsigned int participant);
+
+    bool popFront(unsigned int participant, std::size_t & index);
+    bool steal(unsigned int thief);
+
+    std::unique_ptr<Share[]> _shares;
+    std::vector<std::thread> _threads;
+
+    std::mutex _runMutex; //!< Held by the thread whose loop is currently running.
+
+    std::mutex _mutex;
+    std::condition_variable _startCondition;
+    std::condition_variable _doneCondition;
+    bool _running{ true };
+    std::uint64_t _generation{ 0 };
+    unsigned int _busy{ 0 };
+    const Task * _task{ nullptr };
+#endif
+};
+
+#endif
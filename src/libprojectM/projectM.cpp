@@ -47,9 +47,17 @@
 #include "PCM.hpp"                    //Sound data handler (buffering, FFT, etc.)
 
 #include <map>
+#include <algorithm>
 
 #include "Renderer.hpp"
 #include "PresetChooser.hpp"
+#include "PresetPrefetcher.hpp"
+#include "RandomNumberGenerators.hpp"
+#include "Expr.hpp"
+#include "WorkerPool.hpp"
+#include "ShaderCache.hpp"
+#include "ProgramBinaryCache.hpp"
+#include "JitObjectCache.hpp"
 #include "ConfigFile.h"
 #include "TextureManager.hpp"
 #include "TimeKeeper.hpp"
@@ -84,6 +92,8 @@ projectM::~projectM()
     std::cout << std::endl;
 #endif
     destroyPresetTools();
+    // the presets are gone, nothing is compiled with the cache anymore
+    Expr::set_jit_cache(nullptr);
 
     if ( renderer )
         delete ( renderer );
@@ -116,7 +126,7 @@ void projectM::projectM_resetTextures()
 
 projectM::projectM ( std::string config_file, int flags) :
         renderer ( 0 ), _pcm(0), beatDetect ( 0 ), _pipelineContext(new PipelineContext()), _pipelineContext2(new PipelineContext()), m_presetPos(0),
-        timeKeeper(NULL), m_flags(flags), _matcher(NULL), _merger(NULL)
+        timeKeeper(NULL), m_flags(flags), _matcher(NULL), _merger(NULL), m_transitionPipeline(new Pipeline())
 {
     readConfig(config_file);
     projectM_reset();
@@ -126,7 +136,7 @@ projectM::projectM ( std::string config_file, int flags) :
 
 projectM::projectM(Settings settings, int flags):
         renderer ( 0 ), _pcm(0), beatDetect ( 0 ), _pipelineContext(new PipelineContext()), _pipelineContext2(new PipelineContext()), m_presetPos(0),
-        timeKeeper(NULL), m_flags(flags), _matcher(NULL), _merger(NULL)
+        timeKeeper(NULL), m_flags(flags), _matcher(NULL), _merger(NULL), m_transitionPipeline(new Pipeline())
 {
     readSettings(settings);
     projectM_reset();
@@ -154,6 +164,11 @@ bool projectM::writeConfig(const std::string & configFile, const Settings & sett
     config.add("Easter Egg Parameter", settings.easterEgg);
     config.add("Shuffle Enabled", settings.shuffleEnabled);
     config.add("Soft Cut Ratings Enabled", settings.softCutRatingsEnabled);
+    config.add("Worker Threads", settings.workerThreads);
+    config.add("Shader Cache Directory", settings.shaderCacheDir);
+    config.add("Texture Memory Budget", settings.textureMemoryBudget);
+    config.add("Random Seed", settings.randomSeed);
+    config.add("Expression Engine", settings.expressionEngine);
     std::fstream file(configFile.c_str(), std::ios_base::trunc | std::ios_base::out);
     if (file) {
         file << config;
@@ -220,6 +235,21 @@ void projectM::readConfig (const std::string & configFile)
     _settings.softCutRatingsEnabled =
             config.read<bool> ( "Soft Cut Ratings Enabled", false);
 
+    // Threads evaluating per pixel equations, including the render thread. 0 uses all hardware threads.
+    _settings.workerThreads = config.read<int> ( "Worker Threads", 0 );
+
+    // Directory keeping transpiled and linked preset shaders between runs. Empty keeps GLSL in memory only.
+    _settings.shaderCacheDir = config.read<string> ( "Shader Cache Directory", "" );
+
+    // Megabytes of preset textures kept loaded, least recently used ones are unloaded first. 0 keeps all.
+    _settings.textureMemoryBudget = config.read<int> ( "Texture Memory Budget", 256 );
+
+    // Seed for reproducible runs, 0 seeds from the current time.
+    _settings.randomSeed = config.read<unsigned int> ( "Random Seed", 0 );
+
+    // Engine evaluating preset equations: tree, bytecode or jit. Empty picks the fastest one built.
+    _settings.expressionEngine = config.read<string> ( "Expression Engine", "" );
+
     // Hard Cuts are preset transitions that occur when your music becomes louder. They only occur after a hard cut duration threshold has passed.
     _settings.hardcutEnabled = config.read<bool> ( "Hard Cuts Enabled", false );
     // Hard Cut duration is the number of seconds before you become eligible for a hard cut.
@@ -261,6 +291,11 @@ void projectM::readSettings (const Settings & settings )
     _settings.smoothPresetDuration = settings.smoothPresetDuration;
     _settings.presetDuration = settings.presetDuration;
     _settings.softCutRatingsEnabled = settings.softCutRatingsEnabled;
+    _settings.workerThreads = settings.workerThreads;
+    _settings.shaderCacheDir = settings.shaderCacheDir;
+    _settings.textureMemoryBudget = settings.textureMemoryBudget;
+    _settings.randomSeed = settings.randomSeed;
+    _settings.expressionEngine = settings.expressionEngine;
 
     _settings.presetURL = settings.presetURL;
     _settings.titleFontURL = settings.titleFontURL;
@@ -317,16 +352,22 @@ void projectM::evaluateSecondPreset()
 
 void projectM::renderFrame()
 {
-    Pipeline pipeline;
     Pipeline *comboPipeline;
     
-    comboPipeline = renderFrameOnlyPass1(&pipeline);
+    comboPipeline = renderFrameOnlyPass1(m_transitionPipeline.get());
     
     renderFrameOnlyPass2(comboPipeline,0,0,0);
     
     projectM::renderFrameEndOnSeparatePasses(comboPipeline);
 }
 
+void projectM::renderFrame(double time)
+{
+    timeKeeper->SetTime(time);
+
+    renderFrame();
+}
+
 
 
 
@@ -366,6 +407,7 @@ Pipeline * projectM::renderFrameOnlyPass1(Pipeline *pPipeline) /*pPipeline is a
     pipelineContext().frame = timeKeeper->PresetFrameA();
     pipelineContext().progress = timeKeeper->PresetProgressA();
 
+    _pcm->drainQueue();
     beatDetect->detectFromSamples();
 
     //m_activePreset->evaluateFrame();
@@ -390,6 +432,14 @@ Pipeline * projectM::renderFrameOnlyPass1(Pipeline *pPipeline) /*pPipeline is a
         }
     }
 
+    if (m_prefetchNeeded)
+        prefetchNextPreset();
+
+    // decode the textures of the next preset while this one is still showing
+    m_presetPrefetcher->prepareReady([this](Preset & preset) {
+        renderer->requestPresetTextures(preset.pipeline());
+    });
+
 
     if ( timeKeeper->IsSmoothing() && timeKeeper->SmoothRatio() <= 1.0 && !m_presetChooser->empty() )
     {
@@ -397,14 +447,20 @@ Pipeline * projectM::renderFrameOnlyPass1(Pipeline *pPipeline) /*pPipeline is a
         assert ( m_activePreset2.get() );
 
 #if USE_THREADS
-        worker_sync.wake_up_bg();
-#endif
-
-        m_activePreset->Render(*beatDetect, pipelineContext());
-
-#if USE_THREADS
-        worker_sync.wait_for_bg_to_finish();
+        // both presets draw from rand(), evaluating them one after the other keeps seeded runs reproducible
+        if (_settings.randomSeed == 0)
+        {
+            worker_sync.wake_up_bg();
+            m_activePreset->Render(*beatDetect, pipelineContext());
+            worker_sync.wait_for_bg_to_finish();
+        }
+        else
+        {
+            m_activePreset->Render(*beatDetect, pipelineContext());
+            evaluateSecondPreset();
+        }
 #else
+        m_activePreset->Render(*beatDetect, pipelineContext());
         evaluateSecondPreset();
 #endif
 
@@ -515,7 +571,8 @@ void projectM::renderFrameEndOnSeparatePasses(Pipeline *pPipeline) {
 #ifndef UNLOCK_FPS
     int timediff = getTicks ( &timeKeeper->startTime )-this->timestart;
 
-    if ( timediff < this->mspf )
+    /** Never wait on a clock installed with pprojectm_gettimeofday or time given to renderFrame(), it only advances between frames */
+    if ( timediff < this->mspf && pprojectm_gettimeofday == nullptr && !timeKeeper->UsesExternalTime() )
     {
         // printf("%s:",this->mspf-timediff);
         int sleepTime = ( unsigned int ) ( this->mspf-timediff ) * 1000;
@@ -568,6 +625,20 @@ void projectM::projectM_init ( int gx, int gy, int fps, int texsize, int width,
 
     this->renderer = new Renderer ( width, height, gx, gy, beatDetect, settings().presetURL, settings().titleFontURL, settings().menuFontURL, settings().datadir );
 
+    m_shaderCache.reset(new ShaderCache());
+    m_shaderCache->setDirectory(_settings.shaderCacheDir);
+    m_programBinaryCache.reset(new ProgramBinaryCache());
+    m_programBinaryCache->setDirectory(_settings.shaderCacheDir);
+    renderer->setShaderCaches(m_shaderCache.get(), m_programBinaryCache.get());
+    m_jitObjectCache.reset(new JitObjectCache());
+    m_jitObjectCache->setDirectory(_settings.shaderCacheDir);
+    Expr::set_jit_cache(m_jitObjectCache.get());
+    renderer->setTextureMemoryBudget(static_cast<std::size_t>(std::max(_settings.textureMemoryBudget, 0)) * 1024 * 1024);
+
+    m_workerPool.reset(new WorkerPool(_settings.workerThreads > 0 ? _settings.workerThreads : 0));
+    pipelineContext().workerPool = m_workerPool.get();
+    pipelineContext2().workerPool = m_workerPool.get();
+
     initPresetTools(gx, gy);
 
 
@@ -635,8 +706,10 @@ void projectM::projectM_setTitle ( std::string title ) {
 int projectM::initPresetTools(int gx, int gy)
 {
 
-    /* Set the seed to the current time in seconds */
-    srand ( time ( NULL ) );
+    /* Set the seed to the current time in seconds, unless the run has to be reproducible */
+    RandomNumberGenerators::seed ( _settings.randomSeed != 0 ? _settings.randomSeed : time ( NULL ) );
+
+    Expr::set_engine ( Expr::engine_from_name ( _settings.expressionEngine, Expr::engine() ) );
 
     std::string url = (m_flags & FLAG_DISABLE_PLAYLIST_LOAD) ? std::string() : settings().presetURL;
 
@@ -658,6 +731,8 @@ int projectM::initPresetTools(int gx, int gy)
         return PROJECTM_FAILURE;
     }
 
+    m_presetPrefetcher.reset(new PresetPrefetcher(*m_presetLoader));
+
     // Start the iterator
     if (!m_presetPos)
         m_presetPos = new PresetIterator();
@@ -700,12 +775,17 @@ int projectM::initPresetTools(int gx, int gy)
 
     projectM_resetengine();
 
+    m_prefetchNeeded = true;
+
     //std::cerr << "[projectM] engine has been reset." << std::endl;
     return PROJECTM_SUCCESS;
 }
 
 void projectM::destroyPresetTools()
 {
+    // Stops the worker before the loader it uses goes away
+    m_presetPrefetcher.reset();
+
     m_activePreset.reset();
     m_activePreset2.reset();
 
@@ -862,6 +942,7 @@ bool projectM::startPresetTransition(bool hard_cut) {
 
   presetSwitchedEvent(hard_cut, **m_presetPos);
   errorLoadingCurrentPreset = false;
+  m_prefetchNeeded = true;
 
   populatePresetMenu();
 
@@ -873,8 +954,18 @@ void projectM::selectRandom(const bool hardCut) {
         return;
     presetHistory.push_back(m_presetPos->lastIndex());
 
+    // The prediction was drawn for a soft cut, so it only applies if both use the same ratings.
+    bool usePrediction = m_hasPredictedRandom && (!hardCut || !settings().softCutRatingsEnabled)
+        && m_predictedRandomIndex < m_presetChooser->size();
+    m_hasPredictedRandom = false;
+
     for(int i = 0; i < kMaxSwitchRetries; ++i) {
-        *m_presetPos = m_presetChooser->weightedRandom(hardCut);
+        if (usePrediction) {
+            *m_presetPos = m_presetChooser->begin(m_predictedRandomIndex);
+            usePrediction = false;
+        } else {
+            *m_presetPos = m_presetChooser->weightedRandom(hardCut);
+        }
         if(startPresetTransition(hardCut)) {
             break;
         }
@@ -961,7 +1052,7 @@ std::unique_ptr<Preset> projectM::switchToCurrentPreset() {
   pthread_mutex_lock(&preset_mutex);
 #endif
   try {
-    new_preset = m_presetPos->allocate();
+    new_preset = m_presetPrefetcher->allocate(**m_presetPos);
   } catch (const PresetFactoryException &e) {
     std::cerr << "problem allocating target preset: " << e.message()
               << std::endl;
@@ -989,6 +1080,30 @@ std::unique_ptr<Preset> projectM::switchToCurrentPreset() {
   return new_preset;
 }
 
+void projectM::prefetchNextPreset()
+{
+    m_prefetchNeeded = false;
+    m_hasPredictedRandom = false;
+
+    // Parsing runs per frame init equations, which may call rand() while the render thread does too.
+    // Seeded runs load presets when switching instead.
+    if (isPresetLocked() || m_presetChooser->empty() || _settings.randomSeed != 0)
+        return;
+
+    if (!settings().shuffleEnabled) {
+        PresetIterator next = *m_presetPos;
+        m_presetChooser->nextPreset(next);
+        m_presetPrefetcher->prefetch(*next);
+    } else if (!presetFuture.empty() && static_cast<std::size_t>(presetFuture.back()) < m_presetLoader->size()) {
+        m_presetPrefetcher->prefetch(presetFuture.back());
+    } else {
+        // Draw the next random preset now; selectRandom() picks it up instead of drawing again.
+        m_predictedRandomIndex = *m_presetChooser->weightedRandom(false);
+        m_hasPredictedRandom = true;
+        m_presetPrefetcher->prefetch(m_predictedRandomIndex);
+    }
+}
+
 void projectM::setPresetLock ( bool isLocked )
 {
     renderer->noSwitch = isLocked;
@@ -1117,6 +1232,11 @@ void projectM::changeTextureSize(int size) {
                             beatDetect, _settings.presetURL,
                             _settings.titleFontURL, _settings.menuFontURL,
                             _settings.datadir);
+    renderer->setShaderCaches(m_shaderCache.get(), m_programBinaryCache.get());
+    m_jitObjectCache.reset(new JitObjectCache());
+    m_jitObjectCache->setDirectory(_settings.shaderCacheDir);
+    Expr::set_jit_cache(m_jitObjectCache.get());
+    renderer->setTextureMemoryBudget(static_cast<std::size_t>(std::max(_settings.textureMemoryBudget, 0)) * 1024 * 1024);
 }
 
 void projectM::changeHardcutDuration(int seconds) {
@@ -75,6 +75,11 @@ class Preset;
 class PresetIterator;
 class PresetChooser;
 class PresetLoader;
+class PresetPrefetcher;
+class WorkerPool;
+class ShaderCache;
+class ProgramBinaryCache;
+class JitObjectCache;
 class TimeKeeper;
 class Pipeline;
 class RenderItemMatcher;
@@ -143,6 +148,11 @@ public:
         float easterEgg;
         bool shuffleEnabled;
         bool softCutRatingsEnabled;
+        int workerThreads; //!< Threads evaluating per pixel equations, including the render thread. 0 uses all hardware threads.
+        std::string shaderCacheDir; //!< Keeps transpiled and linked preset shaders and JIT compiled equations between runs. Empty keeps GLSL in memory only.
+        int textureMemoryBudget; //!< Megabytes of preset textures kept loaded, least recently used ones are unloaded first. 0 keeps all.
+        unsigned int randomSeed; //!< Seeds the random choices of presets and shaders for reproducible runs. 0 seeds from the current time.
+        std::string expressionEngine; //!< Evaluates preset equations: "tree", "bytecode" or "jit". Empty picks the fastest one built.
 
         Settings() :
             meshX(32),
@@ -160,7 +170,10 @@ public:
             aspectCorrection(true),
             easterEgg(0.0),
             shuffleEnabled(true),
-            softCutRatingsEnabled(false) {}
+            softCutRatingsEnabled(false),
+            workerThreads(0),
+            textureMemoryBudget(256),
+            randomSeed(0) {}
     };
 
   projectM(std::string config_file, int flags = FLAG_NONE);
@@ -170,6 +183,10 @@ public:
   void projectM_resetTextures();
   void projectM_setTitle( std::string title );
   void renderFrame();
+  /// Renders the frame at the given time in seconds since projectM was created. From the first call on,
+  /// time only advances through this call, so frames can be rendered faster than real time. Together
+  /// with Settings::randomSeed and the same audio this renders the same frames on every run.
+  void renderFrame(double time);
   Pipeline * renderFrameOnlyPass1(Pipeline *pPipeline);
   void renderFrameOnlyPass2(Pipeline *pPipeline,int xoffset,int yoffset,int eye);
   void renderFrameEndOnSeparatePasses(Pipeline *pPipeline);
@@ -192,6 +209,10 @@ public:
   void setHelpText(const std::string & helpText);
   void toggleSearchText(); // turn search text input on / off
   void setToastMessage(const std::string & toastMessage);
+  /// Keeps the object code of JIT compiled presets in the shader cache directory, its stats report the
+  /// hit rate and the compile time saved. Null before the first initialization.
+  const JitObjectCache *jitObjectCache() const { return m_jitObjectCache.get(); }
+
   const Settings & settings() const {
 		return _settings;
   }
@@ -375,6 +396,28 @@ private:
   /// Provides accessor functions to choose presets
   PresetChooser * m_presetChooser;
 
+  /// Loads the preset most likely to be shown next in the background
+  std::unique_ptr<PresetPrefetcher> m_presetPrefetcher;
+
+  /// Threads shared by the presets for per pixel equations, lives as long as projectM
+  std::unique_ptr<WorkerPool> m_workerPool;
+
+  /// GLSL transpiled from preset shaders, kept when the renderer is recreated
+  std::unique_ptr<ShaderCache> m_shaderCache;
+
+  /// Linked preset programs in the shader cache directory
+  std::unique_ptr<ProgramBinaryCache> m_programBinaryCache;
+
+  /// Object code of JIT compiled presets in the shader cache directory
+  std::unique_ptr<JitObjectCache> m_jitObjectCache;
+
+  /// Set after a preset switch, the next frame starts prefetching the following preset
+  bool m_prefetchNeeded = false;
+
+  /// Index drawn in advance for the next soft cut random switch, so it can be prefetched
+  std::size_t m_predictedRandomIndex = 0;
+  bool m_hasPredictedRandom = false;
+
   /// Currently loaded preset
   std::unique_ptr<Preset> m_activePreset;
 
@@ -388,6 +431,10 @@ private:
   RenderItemMatcher * _matcher;
   MasterRenderItemMerge * _merger;
 
+  /// Receives the merged presets during a soft cut. Kept between frames, so the render loop
+  /// reuses its meshes and vectors instead of allocating them every frame.
+  std::unique_ptr<Pipeline> m_transitionPipeline;
+
   bool running;
   bool errorLoadingCurrentPreset;
 
@@ -396,6 +443,9 @@ private:
   std::unique_ptr<Preset> switchToCurrentPreset();
   bool startPresetTransition(bool hard_cut);
 
+  /// Guesses the preset the next automatic or "next" switch will select and prefetches it
+  void prefetchNextPreset();
+
 
 
 };
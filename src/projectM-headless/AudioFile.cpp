@@ -0,0 +1,138 @@
+#include "AudioFile.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+const int WAVE_FORMAT_PCM = 1;
+const int WAVE_FORMAT_IEEE_FLOAT = 3;
+const int WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+bool readFile(const std::string &path, std::vector<unsigned char> &contents, std::string &error)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = "can't open " + path;
+        return false;
+    }
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+uint32_t read32(const unsigned char *p)
+{
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+uint16_t read16(const unsigned char *p)
+{
+    return uint16_t(p[0] | p[1] << 8);
+}
+
+/// One sample of the given format scaled to [-1, 1]
+float decodeSample(const unsigned char *p, int format, int bits)
+{
+    if (format == WAVE_FORMAT_IEEE_FLOAT) {
+        uint32_t bitPattern = read32(p);
+        float value;
+        std::memcpy(&value, &bitPattern, sizeof(value));
+        return value;
+    }
+
+    switch (bits) {
+        case 8:
+            return (p[0] - 128) / 128.0f;
+        case 16:
+            return int16_t(read16(p)) / 32768.0f;
+        case 24:
+            return int32_t(uint32_t(p[0]) << 8 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 24) / 2147483648.0f;
+        default:
+            return int32_t(read32(p)) / 2147483648.0f;
+    }
+}
+
+}
+
+AudioFile::AudioFile() : _sampleRate(0)
+{
+}
+
+bool AudioFile::loadWav(const std::string &path, std::string &error)
+{
+    std::vector<unsigned char> contents;
+    if (!readFile(path, contents, error))
+        return false;
+
+    if (contents.size() < 12 || std::memcmp(contents.data(), "RIFF", 4) != 0 ||
+        std::memcmp(contents.data() + 8, "WAVE", 4) != 0) {
+        error = path + " is not a WAVE file";
+        return false;
+    }
+
+    int format = 0, channels = 0, bits = 0;
+    const unsigned char *samples = nullptr;
+    std::size_t sampleBytes = 0;
+
+    // Chunks are padded to an even size
+    std::size_t offset = 12;
+    while (offset + 8 <= contents.size()) {
+        const unsigned char *chunk = contents.data() + offset;
+        std::size_t size = read32(chunk + 4);
+        std::size_t available = std::min(size, contents.size() - offset - 8);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && available >= 16) {
+            format = read16(chunk + 8);
+            channels = read16(chunk + 10);
+            _sampleRate = int(read32(chunk + 12));
+            bits = read16(chunk + 22);
+            if (format == WAVE_FORMAT_EXTENSIBLE && available >= 26)
+                format = read16(chunk + 32);
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            samples = chunk + 8;
+            sampleBytes = available;
+        }
+
+        offset += 8 + size + (size & 1);
+    }
+
+    if (format == 0 || samples == nullptr) {
+        error = path + " has no format or data chunk";
+        return false;
+    }
+    bool supported = (format == WAVE_FORMAT_PCM && (bits == 8 || bits == 16 || bits == 24 || bits == 32)) ||
+                     (format == WAVE_FORMAT_IEEE_FLOAT && bits == 32);
+    if (!supported || channels < 1 || _sampleRate <= 0) {
+        error = path + ": unsupported sample format " + std::to_string(format) + " with " +
+                std::to_string(bits) + " bits and " + std::to_string(channels) + " channels";
+        return false;
+    }
+
+    std::size_t stride = std::size_t(channels) * (bits / 8);
+    std::size_t count = sampleBytes / stride;
+    _samples.resize(count * 2);
+    for (std::size_t i = 0; i < count; i++) {
+        const unsigned char *frame = samples + i * stride;
+        _samples[i * 2] = decodeSample(frame, format, bits);
+        _samples[i * 2 + 1] = channels > 1 ? decodeSample(frame + bits / 8, format, bits) : _samples[i * 2];
+    }
+
+    return true;
+}
+
+bool AudioFile::loadRaw(const std::string &path, int sampleRate, std::string &error)
+{
+    std::vector<unsigned char> contents;
+    if (!readFile(path, contents, error))
+        return false;
+
+    _sampleRate = sampleRate;
+    _samples.resize(contents.size() / 4 * 2);
+    for (std::size_t i = 0; i < _samples.size(); i++)
+        _samples[i] = decodeSample(contents.data() + i * 2, WAVE_FORMAT_PCM, 16);
+
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef AudioFile_HPP
+#define AudioFile_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/// Audio read completely into memory as interleaved stereo floats in [-1, 1].
+///
+/// Reads RIFF WAVE files with 8, 16, 24 or 32 bit integer or 32 bit float samples, and raw
+/// signed 16 bit little endian stereo. Mono is duplicated to both channels, channels beyond
+/// the second are dropped.
+class AudioFile
+{
+public:
+    AudioFile();
+
+    /// Returns false and sets error if the file can't be read
+    bool loadWav(const std::string &path, std::string &error);
+    bool loadRaw(const std::string &path, int sampleRate, std::string &error);
+
+    int sampleRate() const { return _sampleRate; }
+
+    /// Number of stereo sample pairs
+    std::size_t frames() const { return _samples.size() / 2; }
+
+    double duration() const { return _sampleRate > 0 ? double(frames()) / _sampleRate : 0.0; }
+
+    /// Interleaved left and right samples of sample pair first onwards
+    const float *data(std::size_t first) const { return _samples.data() + first * 2; }
+
+private:
+    std::vector<float> _samples;
+    int _sampleRate;
+};
+
+#endif
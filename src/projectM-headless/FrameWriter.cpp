@@ -0,0 +1,122 @@
+#include "FrameWriter.hpp"
+
+#include "SOIL2/SOIL2.h"
+
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+unsigned char clampByte(float value)
+{
+    return value < 0.0f ? 0 : value > 255.0f ? 255 : (unsigned char) (value + 0.5f);
+}
+
+/// True if pattern has exactly one printf conversion, an int one like %d or %05d, besides escaped %%.
+/// The path is the format string of snprintf(), anything else would read arguments that aren't there.
+bool isFramePattern(const std::string &pattern)
+{
+    int conversions = 0;
+    for (std::size_t i = 0; i < pattern.size(); i++) {
+        if (pattern[i] != '%')
+            continue;
+        if (++i < pattern.size() && pattern[i] == '%')
+            continue;
+        while (i < pattern.size() && std::strchr("-+ #0", pattern[i]) != nullptr)
+            i++;
+        while (i < pattern.size() && std::isdigit((unsigned char) pattern[i]))
+            i++;
+        if (i < pattern.size() && pattern[i] == '.') {
+            i++;
+            while (i < pattern.size() && std::isdigit((unsigned char) pattern[i]))
+                i++;
+        }
+        if (i >= pattern.size() || (pattern[i] != 'd' && pattern[i] != 'i'))
+            return false;
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+}
+
+FrameWriter *FrameWriter::create(Format format, const std::string &path, int width, int height, int fps,
+                                 std::string &error)
+{
+    if (format == PNG && !isFramePattern(path)) {
+        error = "png output needs a path with one frame number conversion like frame%05d.png, not " + path;
+        return nullptr;
+    }
+
+    FrameWriter *writer = new FrameWriter(format, path, width, height);
+
+    if (format == PNG)
+        return writer;
+
+    writer->_file = path == "-" ? stdout : std::fopen(path.c_str(), "wb");
+    if (writer->_file == nullptr) {
+        error = "can't open " + path + " for writing";
+        delete writer;
+        return nullptr;
+    }
+
+    if (format == Y4M)
+        std::fprintf(writer->_file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, fps);
+
+    return writer;
+}
+
+FrameWriter::FrameWriter(Format format, const std::string &path, int width, int height) :
+    _format(format), _path(path), _width(width), _height(height), _frame(0), _file(nullptr),
+    _buffer(std::size_t(width) * height * 4)
+{
+}
+
+FrameWriter::~FrameWriter()
+{
+    if (_file != nullptr && _file != stdout)
+        std::fclose(_file);
+    else if (_file != nullptr)
+        std::fflush(_file);
+}
+
+bool FrameWriter::write(const unsigned char *pixels)
+{
+    const std::size_t stride = std::size_t(_width) * 4;
+    const std::size_t plane = std::size_t(_width) * _height;
+
+    switch (_format) {
+        case RAW_RGBA:
+        case PNG:
+            for (int y = 0; y < _height; y++)
+                std::memcpy(&_buffer[y * stride], pixels + (_height - 1 - y) * stride, stride);
+            break;
+
+        case Y4M:
+            for (int y = 0; y < _height; y++) {
+                const unsigned char *row = pixels + (_height - 1 - y) * stride;
+                for (int x = 0; x < _width; x++) {
+                    float r = row[x * 4], g = row[x * 4 + 1], b = row[x * 4 + 2];
+                    std::size_t i = std::size_t(y) * _width + x;
+                    _buffer[i] = clampByte(16.0f + 0.257f * r + 0.504f * g + 0.098f * b);
+                    _buffer[plane + i] = clampByte(128.0f - 0.148f * r - 0.291f * g + 0.439f * b);
+                    _buffer[plane * 2 + i] = clampByte(128.0f + 0.439f * r - 0.368f * g - 0.071f * b);
+                }
+            }
+            break;
+    }
+
+    bool written;
+    if (_format == PNG) {
+        char filename[4096];
+        std::snprintf(filename, sizeof(filename), _path.c_str(), _frame);
+        written = SOIL_save_image(filename, SOIL_SAVE_TYPE_PNG, _width, _height, 4, _buffer.data()) != 0;
+    } else if (_format == Y4M) {
+        written = std::fputs("FRAME\n", _file) >= 0 && std::fwrite(_buffer.data(), 1, plane * 3, _file) == plane * 3;
+    } else {
+        written = std::fwrite(_buffer.data(), 1, plane * 4, _file) == plane * 4;
+    }
+
+    _frame++;
+    return written;
+}
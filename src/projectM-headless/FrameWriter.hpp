@@ -0,0 +1,45 @@
+#ifndef FrameWriter_HPP
+#define FrameWriter_HPP
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/// Writes rendered frames to disk or stdout.
+///
+/// Frames are passed as read back from OpenGL, RGBA rows from the bottom of the image up.
+class FrameWriter
+{
+public:
+    enum Format
+    {
+        RAW_RGBA,   //!< frames appended to one file without any header
+        Y4M,        //!< YUV4MPEG2 stream with 4:4:4 BT.601 studio range frames
+        PNG         //!< one numbered file per frame, path is a printf pattern like frame%05d.png
+    };
+
+    /// Returns nullptr and sets error if the output can't be opened. A path of "-" writes
+    /// RAW_RGBA and Y4M to stdout.
+    static FrameWriter *create(Format format, const std::string &path, int width, int height, int fps,
+                               std::string &error);
+
+    ~FrameWriter();
+
+    FrameWriter(const FrameWriter &) = delete;
+    FrameWriter &operator=(const FrameWriter &) = delete;
+
+    bool write(const unsigned char *pixels);
+
+private:
+    FrameWriter(Format format, const std::string &path, int width, int height);
+
+    Format _format;
+    std::string _path;
+    int _width;
+    int _height;
+    int _frame;
+    FILE *_file;
+    std::vector<unsigned char> _buffer;   //!< converted frame
+};
+
+#endif
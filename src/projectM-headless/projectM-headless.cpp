@@ -0,0 +1,346 @@
+/**
+ * projectM -- Milkdrop-esque visualisation SDK
+ * Copyright (C)2003-2021 projectM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * See 'LICENSE.txt' included within this release
+ *
+ * projectM-headless
+ * Renders an audio file to video frames offline, without a window or display server.
+ *
+ * The GL context comes from EGL on the surfaceless platform where available (Mesa, including
+ * llvmpipe), otherwise the default display with a pbuffer. projectM draws into a framebuffer
+ * object of the output size. The audio is fed to projectM in chunks of one frame and each
+ * frame is rendered at its own timestamp with a fixed random seed, so the output doesn't
+ * depend on how fast the machine renders, nothing waits for the wall clock, and the same
+ * input renders the same frames again.
+ */
+
+#include "AudioFile.hpp"
+#include "FrameWriter.hpp"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "projectM-opengl.h"
+#include "projectM.hpp"
+#include "PCM.hpp"
+#include "MilkdropPresetFactory/JitObjectCache.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <iostream>
+#include <memory>
+
+namespace {
+
+bool hasExtension(const char *extensions, const char *name)
+{
+    if (extensions == nullptr)
+        return false;
+    std::size_t length = std::strlen(name);
+    for (const char *p = std::strstr(extensions, name); p != nullptr; p = std::strstr(p + length, name)) {
+        if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+            return true;
+    }
+    return false;
+}
+
+/// Makes a desktop OpenGL context current, 3.3 core if the driver has it
+bool createContext(EGLDisplay &display, EGLContext &context, EGLSurface &surface)
+{
+    const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    display = EGL_NO_DISPLAY;
+
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay != nullptr)
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+#endif
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::cerr << "Can't initialize EGL: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "EGL " << major << "." << minor << " has no desktop OpenGL" << std::endl;
+        return false;
+    }
+
+    const bool surfaceless = hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configs = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configs) || configs == 0) {
+        std::cerr << "No EGL config for desktop OpenGL rendering" << std::endl;
+        return false;
+    }
+
+    const EGLint coreAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+        EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+        EGL_NONE
+    };
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, coreAttributes);
+    if (context == EGL_NO_CONTEXT)
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+    if (context == EGL_NO_CONTEXT) {
+        std::cerr << "Can't create an OpenGL context: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+        return false;
+    }
+
+    // Everything is drawn into a framebuffer object, the surface only has to exist
+    surface = EGL_NO_SURFACE;
+    if (!surfaceless) {
+        const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+    }
+    if (!eglMakeCurrent(display, surface, surface, context)) {
+        std::cerr << "Can't make the OpenGL context current: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options] -i <audio file> -o <output>\n"
+              << "\n"
+              << "  -i, --input FILE        WAVE file, or raw signed 16 bit little endian stereo with --raw\n"
+              << "  -r, --raw RATE          read the input as raw samples at RATE Hz\n"
+              << "  -o, --output PATH       output file, - for stdout, or a pattern like frame%05d.png\n"
+              << "  -f, --format FORMAT     y4m (default), rgba or png\n"
+              << "  -p, --preset PATH       preset file to render, or a directory to play through\n"
+              << "  -w, --width PIXELS      frame width, default 1280\n"
+              << "  -h, --height PIXELS     frame height, default 720\n"
+              << "  -s, --fps FPS           frames per second of the output, default 60\n"
+              << "  -n, --frames COUNT      stop after COUNT frames instead of the end of the audio\n"
+              << "  -d, --preset-duration SECONDS\n"
+              << "                          time before switching to the next preset of a directory\n"
+              << "  -S, --seed SEED         seed for random choices, default 1. The same seed renders the same\n"
+              << "                          frames, 0 seeds from the clock\n"
+              << "  -e, --engine ENGINE     evaluates preset equations with tree, bytecode or jit\n"
+              << "  -c, --cache DIR         keeps compiled shaders and JIT compiled equations in DIR between runs\n";
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    std::string input, output, preset = PROJECTM_PREFIX "/share/projectM/presets";
+    FrameWriter::Format format = FrameWriter::Y4M;
+    int rawRate = 0, width = 1280, height = 720, fps = 60;
+    long maxFrames = -1;
+    double presetDuration = 30.0;
+    unsigned int seed = 1;
+    std::string engine, cacheDir;
+
+    const option options[] = {
+        { "input", required_argument, nullptr, 'i' },
+        { "raw", required_argument, nullptr, 'r' },
+        { "output", required_argument, nullptr, 'o' },
+        { "format", required_argument, nullptr, 'f' },
+        { "preset", required_argument, nullptr, 'p' },
+        { "width", required_argument, nullptr, 'w' },
+        { "height", required_argument, nullptr, 'h' },
+        { "fps", required_argument, nullptr, 's' },
+        { "frames", required_argument, nullptr, 'n' },
+        { "preset-duration", required_argument, nullptr, 'd' },
+        { "seed", required_argument, nullptr, 'S' },
+        { "engine", required_argument, nullptr, 'e' },
+        { "cache", required_argument, nullptr, 'c' },
+        { nullptr, 0, nullptr, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "i:r:o:f:p:w:h:s:n:d:S:e:c:", options, nullptr)) != -1) {
+        switch (option) {
+            case 'i': input = optarg; break;
+            case 'r': rawRate = std::atoi(optarg); break;
+            case 'o': output = optarg; break;
+            case 'p': preset = optarg; break;
+            case 'w': width = std::atoi(optarg); break;
+            case 'h': height = std::atoi(optarg); break;
+            case 's': fps = std::atoi(optarg); break;
+            case 'n': maxFrames = std::atol(optarg); break;
+            case 'd': presetDuration = std::atof(optarg); break;
+            case 'S': seed = std::strtoul(optarg, nullptr, 10); break;
+            case 'e': engine = optarg; break;
+            case 'c': cacheDir = optarg; break;
+            case 'f':
+                if (std::strcmp(optarg, "y4m") == 0)
+                    format = FrameWriter::Y4M;
+                else if (std::strcmp(optarg, "rgba") == 0)
+                    format = FrameWriter::RAW_RGBA;
+                else if (std::strcmp(optarg, "png") == 0)
+                    format = FrameWriter::PNG;
+                else {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (input.empty() || output.empty() || width <= 0 || height <= 0 || fps <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    AudioFile audio;
+    std::string error;
+    if (!(rawRate > 0 ? audio.loadRaw(input, rawRate, error) : audio.loadWav(input, error))) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    long frames = long(audio.duration() * fps);
+    if (maxFrames >= 0 && maxFrames < frames)
+        frames = maxFrames;
+
+    std::unique_ptr<FrameWriter> writer(FrameWriter::create(format, output, width, height, fps, error));
+    if (!writer) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    EGLDisplay display;
+    EGLContext context;
+    EGLSurface surface;
+    if (!createContext(display, context, surface))
+        return 1;
+    std::cerr << "Rendering with " << glGetString(GL_RENDERER) << ", OpenGL " << glGetString(GL_VERSION) << std::endl;
+
+    GLuint renderbuffer, framebuffer;
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Can't render to a " << width << "x" << height << " framebuffer" << std::endl;
+        return 1;
+    }
+
+    // Frames are read back asynchronously into alternating pixel buffers, so one frame is
+    // rendered while the previous one is copied out and written
+    const GLsizeiptr frameBytes = GLsizeiptr(width) * height * 4;
+    GLuint readBuffers[2];
+    glGenBuffers(2, readBuffers);
+    for (GLuint buffer : readBuffers) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, nullptr, GL_STREAM_READ);
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    projectM::Settings settings;
+    settings.windowWidth = width;
+    settings.windowHeight = height;
+    settings.fps = fps;
+    settings.presetDuration = presetDuration;
+    settings.smoothPresetDuration = 5.0;
+    settings.presetURL = preset;
+    settings.shuffleEnabled = false;
+    settings.randomSeed = seed;
+    settings.expressionEngine = engine;
+    settings.shaderCacheDir = cacheDir;
+
+    const bool singlePreset = preset.size() > 5 &&
+        (preset.compare(preset.size() - 5, 5, ".milk") == 0 || preset.compare(preset.size() - 5, 5, ".prjm") == 0);
+    if (singlePreset)
+        settings.presetURL = preset.substr(0, preset.find_last_of('/') + 1);
+
+    std::unique_ptr<projectM> pm(
+        new projectM(settings, singlePreset ? projectM::FLAG_DISABLE_PLAYLIST_LOAD : projectM::FLAG_NONE));
+    if (singlePreset) {
+        unsigned int index = pm->addPresetURL(preset, preset.substr(preset.find_last_of('/') + 1),
+                                              RatingList(TOTAL_RATING_TYPES, 3));
+        pm->selectPreset(index, true);
+        pm->setPresetLock(true);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::size_t sampleStart = 0;
+    bool failed = false;
+
+    for (long frame = 0; frame <= frames && !failed; frame++) {
+        if (frame < frames) {
+            std::size_t sampleEnd = std::size_t((frame + 1) * (long long) audio.sampleRate() / fps);
+            pm->pcm()->addPCMfloat_2ch(audio.data(sampleStart), (sampleEnd - sampleStart) * 2);
+            sampleStart = sampleEnd;
+
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            pm->renderFrame(double(frame) / fps);
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readBuffers[frame % 2]);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+
+        if (frame > 0) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readBuffers[(frame - 1) % 2]);
+            auto pixels = (const unsigned char *) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+            if (pixels == nullptr || !writer->write(pixels)) {
+                std::cerr << "Writing frame " << frame - 1 << " failed" << std::endl;
+                failed = true;
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (seconds > 0.0 && frames > 0) {
+        std::cerr << "Rendered " << frames << " frames in " << seconds << " s: " << frames / seconds << " fps, "
+                  << frames / seconds / fps << "x real time" << std::endl;
+    }
+    const JitObjectCache::Stats jitStats = pm->jitObjectCache()->stats();
+    if (jitStats.hits + jitStats.misses > 0) {
+        std::cerr << "JIT cache: " << jitStats.hits << " hits, " << jitStats.misses << " misses ("
+                  << jitStats.hitRate() * 100 << "% hit rate), " << jitStats.millisecondsSaved << " ms saved" << std::endl;
+    }
+
+    writer.reset();
+    pm.reset();
+    glDeleteBuffers(2, readBuffers);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &renderbuffer);
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, surface);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,72 @@
+// Replaces the global operator new of the test executable, so the tests of libprojectM can check
+// with AllocationCounter that the render loop does not allocate. The library itself never replaces
+// the allocator of an application.
+
+#include "AllocationCounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+void* countedAllocation(std::size_t size)
+{
+    AllocationCounter::countAllocation();
+    // malloc(0) may return null, operator new has to return a unique pointer
+    return std::malloc(size ? size : 1);
+}
+
+}
+
+void* operator new(std::size_t size)
+{
+    void* ptr = countedAllocation(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAllocation(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAllocation(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}